@@ -0,0 +1,137 @@
+#include "color_convert.h"
+#include <opencv2/opencv.hpp>
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdlib>
+
+using namespace ColorConvert;
+
+namespace {
+
+// 对应的OpenCV转换代码
+int openCVCode(SourceFormat src, TargetFormat dst) {
+    static const int codes[3][3] = {
+        {cv::COLOR_YUV2BGR_YUYV, cv::COLOR_YUV2RGB_YUYV, cv::COLOR_YUV2RGBA_YUYV},
+        {cv::COLOR_YUV2BGR_UYVY, cv::COLOR_YUV2RGB_UYVY, cv::COLOR_YUV2RGBA_UYVY},
+        {cv::COLOR_YUV2BGR_NV12, cv::COLOR_YUV2RGB_NV12, cv::COLOR_YUV2RGBA_NV12}
+    };
+    return codes[static_cast<int>(src)][static_cast<int>(dst)];
+}
+
+// 计时运行iterations次，返回MPix/s
+template <typename Func>
+double measure(Func func, int width, int height, int iterations) {
+    func();  // 预热
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) {
+        func();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    return static_cast<double>(width) * height * iterations / seconds / 1e6;
+}
+
+// 两幅图像的最大逐像素差
+int maxDifference(const cv::Mat& a, const cv::Mat& b) {
+    int maxDiff = 0;
+    for (int y = 0; y < a.rows; y++) {
+        const uint8_t* pa = a.ptr<uint8_t>(y);
+        const uint8_t* pb = b.ptr<uint8_t>(y);
+        for (size_t x = 0; x < a.cols * a.elemSize(); x++) {
+            maxDiff = std::max(maxDiff, std::abs(pa[x] - pb[x]));
+        }
+    }
+    return maxDiff;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    int width = argc > 1 ? std::atoi(argv[1]) : 1920;
+    int height = argc > 2 ? std::atoi(argv[2]) : 1080;
+    int iterations = argc > 3 ? std::atoi(argv[3]) : 100;
+
+    if (width <= 0 || height <= 0 || (width & 1) || (height & 1) || iterations <= 0) {
+        std::cerr << "用法: " << argv[0] << " [宽度(偶数)] [高度(偶数)] [迭代次数]" << std::endl;
+        return 1;
+    }
+
+    std::cout << "颜色转换基准: " << width << "x" << height << ", " << iterations << " 次迭代" << std::endl;
+    std::cout << "默认指令集: " << getIsaName(getActiveIsa()) << std::endl << std::endl;
+
+    // 随机输入数据
+    cv::Mat packed(height, width, CV_8UC2);
+    cv::Mat nv12(height * 3 / 2, width, CV_8UC1);
+    cv::randu(packed, cv::Scalar::all(0), cv::Scalar::all(256));
+    cv::randu(nv12, cv::Scalar::all(0), cv::Scalar::all(256));
+
+    const SourceFormat sources[] = {SourceFormat::YUYV, SourceFormat::UYVY, SourceFormat::NV12};
+    const TargetFormat targets[] = {TargetFormat::BGR, TargetFormat::RGB, TargetFormat::RGBA};
+    const Isa isas[] = {Isa::Scalar, Isa::SSE41, Isa::AVX2, Isa::NEON};
+    Isa defaultIsa = getActiveIsa();
+
+    std::cout << std::left << std::setw(14) << "转换"
+              << std::setw(10) << "实现"
+              << std::right << std::setw(12) << "MPix/s"
+              << std::setw(10) << "加速比"
+              << std::setw(12) << "与标量差"
+              << std::setw(12) << "与OpenCV差" << std::endl;
+
+    int failures = 0;
+    for (SourceFormat src : sources) {
+        const cv::Mat& input = src == SourceFormat::NV12 ? nv12 : packed;
+
+        for (TargetFormat dst : targets) {
+            std::string name = std::string(getFormatName(src)) + "->" + getFormatName(dst);
+
+            // OpenCV基线
+            cv::Mat openCVOutput;
+            int code = openCVCode(src, dst);
+            double openCVRate = measure([&] { cv::cvtColor(input, openCVOutput, code); },
+                                        width, height, iterations);
+            std::cout << std::left << std::setw(14) << name << std::setw(10) << "opencv"
+                      << std::right << std::fixed << std::setprecision(1)
+                      << std::setw(12) << openCVRate << std::setw(10) << 1.0
+                      << std::setw(12) << "-" << std::setw(12) << "-" << std::endl;
+
+            // 标量结果作为各向量化实现的正确性基准
+            cv::Mat scalarOutput;
+            setActiveIsa(Isa::Scalar);
+            convert(input, src, scalarOutput, dst);
+
+            for (Isa isa : isas) {
+                if (!setActiveIsa(isa)) {
+                    continue;
+                }
+
+                cv::Mat output;
+                double rate = measure([&] { convert(input, src, output, dst); }, width, height, iterations);
+                int scalarDiff = maxDifference(output, scalarOutput);
+                int openCVDiff = maxDifference(output, openCVOutput);
+                if (scalarDiff != 0) {
+                    failures++;
+                }
+
+                std::cout << std::left << std::setw(14) << name << std::setw(10) << getIsaName(isa)
+                          << std::right << std::setw(12) << rate
+                          << std::setw(10) << rate / openCVRate
+                          << std::setw(12) << scalarDiff
+                          << std::setw(12) << openCVDiff << std::endl;
+            }
+        }
+        std::cout << std::endl;
+    }
+
+    setActiveIsa(defaultIsa);
+
+    if (failures > 0) {
+        std::cerr << failures << " 个向量化实现与标量结果不一致" << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
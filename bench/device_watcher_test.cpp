@@ -0,0 +1,167 @@
+#include "device_watcher.h"
+#include <iostream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <thread>
+#include <cstdlib>
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+// 设备监视测试：在临时目录中创建、删除和改名假的video节点，检查DeviceWatcher发出的事件
+// 探测函数用假节点的权限位模拟udev设置权限之前打不开的设备（root不受文件权限限制，不能用access判断）
+
+namespace {
+
+const auto kEventTimeout = std::chrono::seconds(2);     // 等待应该到达的事件
+const auto kQuietPeriod = std::chrono::milliseconds(300);  // 确认不应该到达的事件没有到达
+
+// 收集监视线程发出的事件
+class EventLog {
+public:
+    void push(const DeviceEvent& event) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_events.push_back(event);
+        m_cond.notify_all();
+    }
+
+    // 等待指定事件，之前到达的其他事件原样保留
+    bool waitFor(DeviceEventType type, const std::string& devicePath) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        return m_cond.wait_for(lock, kEventTimeout, [&]() {
+            for (auto it = m_events.begin(); it != m_events.end(); ++it) {
+                if (it->type == type && it->devicePath == devicePath) {
+                    m_events.erase(it);
+                    return true;
+                }
+            }
+            return false;
+        });
+    }
+
+    // 一段时间内没有新事件
+    bool quiet() {
+        std::this_thread::sleep_for(kQuietPeriod);
+        std::lock_guard<std::mutex> lock(m_mutex);
+        bool empty = m_events.empty();
+        for (const auto& event : m_events) {
+            std::cerr << "多余的事件: " << (event.type == DeviceEventType::Added ? "Added " : "Removed ")
+                      << event.devicePath << std::endl;
+        }
+        m_events.clear();
+        return empty;
+    }
+
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    std::deque<DeviceEvent> m_events;
+};
+
+int g_failures = 0;
+
+void check(bool condition, const std::string& what) {
+    std::cout << (condition ? "通过  " : "失败  ") << what << std::endl;
+    if (!condition) {
+        g_failures++;
+    }
+}
+
+// 创建假节点，mode为0时模拟udev尚未设置权限
+void createNode(const std::string& path, mode_t mode) {
+    int fd = open(path.c_str(), O_CREAT | O_EXCL | O_WRONLY | O_CLOEXEC, mode);
+    if (fd < 0) {
+        perror(path.c_str());
+        exit(1);
+    }
+    close(fd);
+}
+
+}  // namespace
+
+int main() {
+    char dirTemplate[] = "/tmp/device_watcher_XXXXXX";
+    if (!mkdtemp(dirTemplate)) {
+        perror("mkdtemp");
+        return 1;
+    }
+    std::string dir = dirTemplate;
+    auto node = [&](const std::string& name) { return dir + "/" + name; };
+
+    EventLog log;
+    DeviceWatcher watcher;
+    watcher.setEventCallback([&](const DeviceEvent& event) { log.push(event); });
+
+    // 可读的节点即为捕获设备；探测故意放慢，检查start不等待已有节点的探测
+    watcher.setProbeFunction([](const std::string& devicePath, CameraDeviceInfo& info) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        struct stat st;
+        if (stat(devicePath.c_str(), &st) != 0 || !(st.st_mode & S_IRUSR)) {
+            return false;
+        }
+        info.devicePath = devicePath;
+        info.deviceName = "假设备";
+        return true;
+    });
+
+    // 启动前已有的节点
+    createNode(node("video0"), 0660);
+
+    auto startTime = std::chrono::steady_clock::now();
+    bool started = watcher.start(dir);
+    double startMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+    check(started, "开始监视临时目录 " + dir);
+    if (!started) {
+        rmdir(dir.c_str());
+        return 1;
+    }
+    check(startMs < 100.0, "start不等待已有节点的探测（" + std::to_string(static_cast<int>(startMs)) + " ms）");
+    check(log.waitFor(DeviceEventType::Added, node("video0")), "已有节点video0: Added");
+
+    createNode(node("video1"), 0660);
+    check(log.waitFor(DeviceEventType::Added, node("video1")), "新建video1: Added");
+
+    // 没有权限时探测失败，chmod触发IN_ATTRIB后重试
+    createNode(node("video2"), 0);
+    check(log.quiet(), "新建没有权限的video2: 无事件");
+    chmod(node("video2").c_str(), 0660);
+    check(log.waitFor(DeviceEventType::Added, node("video2")), "chmod video2: Added");
+
+    // 不是videoN的名称不探测
+    createNode(node("video-meta"), 0660);
+    createNode(node("media0"), 0660);
+    check(log.quiet(), "新建video-meta、media0: 无事件");
+
+    unlink(node("video1").c_str());
+    check(log.waitFor(DeviceEventType::Removed, node("video1")), "删除video1: Removed");
+
+    // 改名：移出视为删除，移入视为新建
+    rename(node("video0").c_str(), node("renamed").c_str());
+    check(log.waitFor(DeviceEventType::Removed, node("video0")), "video0改名为renamed: Removed");
+    rename(node("renamed").c_str(), node("video3").c_str());
+    check(log.waitFor(DeviceEventType::Added, node("video3")), "renamed改名为video3: Added");
+
+    // 从未探测成功的节点删除时没有Removed
+    createNode(node("video4"), 0);
+    unlink(node("video4").c_str());
+    check(log.quiet(), "新建并删除没有权限的video4: 无事件");
+
+    std::vector<CameraDeviceInfo> devices = watcher.getDevices();
+    check(devices.size() == 2 && devices[0].devicePath == node("video2") && devices[1].devicePath == node("video3"),
+          "设备列表为video2、video3");
+
+    watcher.stop();
+    check(!watcher.isRunning() && watcher.getDevices().empty(), "停止监视");
+
+    for (const char* name : {"video2", "video3", "video-meta", "media0"}) {
+        unlink(node(name).c_str());
+    }
+    rmdir(dir.c_str());
+
+    return g_failures > 0 ? 1 : 0;
+}
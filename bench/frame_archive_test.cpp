@@ -0,0 +1,224 @@
+#include "frame_archive.h"
+#include <opencv2/opencv.hpp>
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <random>
+#include <filesystem>
+#include <functional>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+
+// 帧归档测试：多个线程乱序写入不压缩（Raw）的帧，再用mmap读取逐帧核对，并检查截断、文件尾损坏和越界的索引项被拒绝
+// Raw编码不需要liblz4，像素原样保存，读出的内容应与写入的逐字节相同
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// 宽度为奇数，每帧长度不是8的倍数，索引前需要补齐
+const int kWidth = 37;
+const int kHeight = 23;
+const int kFrames = 40;
+const int kFrameStep = 3;  // 帧号0、3、6…，中间的帧号不在归档中
+
+int g_failures = 0;
+
+void check(bool condition, const std::string& what) {
+    std::cout << (condition ? "通过  " : "失败  ") << what << std::endl;
+    if (!condition) {
+        g_failures++;
+    }
+}
+
+// 由帧号导出的像素，每帧内容不同
+cv::Mat makeFrame(int frameNumber) {
+    cv::Mat frame(kHeight, kWidth, CV_8UC3);
+    for (size_t i = 0; i < frame.total() * frame.elemSize(); i++) {
+        frame.data[i] = static_cast<uint8_t>(frameNumber * 31 + i * 7 + i / 97);
+    }
+    return frame;
+}
+
+bool sameBytes(const uint8_t* data, size_t size, const cv::Mat& frame) {
+    return size == frame.total() * frame.elemSize() && memcmp(data, frame.data, size) == 0;
+}
+
+std::string readFile(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    return std::string((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+}
+
+// 把修改后的内容写到另一个文件，返回能否打开
+bool opensAfter(const std::string& original, const std::string& path,
+                const std::function<void(std::string&)>& corrupt) {
+    std::string data = original;
+    corrupt(data);
+    std::ofstream(path, std::ios::binary | std::ios::trunc).write(data.data(), static_cast<std::streamsize>(data.size()));
+    FrameArchiveReader reader;
+    return reader.open(path);
+}
+
+FrameArchiveFooter footerOf(const std::string& data) {
+    FrameArchiveFooter footer;
+    memcpy(&footer, data.data() + data.size() - sizeof(footer), sizeof(footer));
+    return footer;
+}
+
+void setEntry(std::string& data, size_t i, const std::function<void(FrameArchiveEntry&)>& change) {
+    size_t position = footerOf(data).indexOffset + i * sizeof(FrameArchiveEntry);
+    FrameArchiveEntry entry;
+    memcpy(&entry, &data[position], sizeof(entry));
+    change(entry);
+    memcpy(&data[position], &entry, sizeof(entry));
+}
+
+void setFooter(std::string& data, const std::function<void(FrameArchiveFooter&)>& change) {
+    FrameArchiveFooter footer = footerOf(data);
+    change(footer);
+    memcpy(&data[data.size() - sizeof(footer)], &footer, sizeof(footer));
+}
+
+}  // namespace
+
+int main() {
+    char dirTemplate[] = "/tmp/frame_archive_XXXXXX";
+    if (!mkdtemp(dirTemplate)) {
+        perror("mkdtemp");
+        return 1;
+    }
+    std::string dir = dirTemplate;
+    std::string path = dir + "/frames.frames";
+
+    // 写入：4个线程乱序追加，与分帧的编码写入线程相同
+    std::vector<int> order;
+    for (int i = 0; i < kFrames; i++) {
+        order.push_back(i * kFrameStep);
+    }
+    std::shuffle(order.begin(), order.end(), std::mt19937(1));
+    {
+        FrameArchiveWriter writer;
+        check(writer.open(path, FrameArchiveCodec::Raw), "创建Raw归档");
+        std::atomic<size_t> next(0);
+        std::atomic<int> added(0);
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 4; t++) {
+            threads.emplace_back([&]() {
+                for (size_t k = next++; k < order.size(); k = next++) {
+                    added += writer.addFrame(order[k], order[k] * 1000LL, makeFrame(order[k])) ? 1 : 0;
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        check(added == kFrames && writer.getFrameCount() == static_cast<size_t>(kFrames), "追加 40 帧");
+        check(!writer.addFrame(1000, 0, cv::Mat(kHeight, kWidth, CV_16UC1)), "拒绝不支持的像素类型");
+        check(writer.finish(), "写入索引和文件尾");
+    }
+
+    // 读取：按帧号升序，每一帧的数据与写入的相同
+    FrameArchiveReader reader;
+    check(reader.open(path), "打开归档");
+    check(reader.getFrameCount() == static_cast<size_t>(kFrames) && reader.getWidth() == kWidth &&
+          reader.getHeight() == kHeight && reader.getCodec() == FrameArchiveCodec::Raw, "帧数、尺寸和编码");
+
+    int bad = 0;
+    for (int i = 0; i < kFrames; i++) {
+        int frameNumber = i * kFrameStep;
+        cv::Mat expected = makeFrame(frameNumber);
+        size_t size = 0;
+        const uint8_t* payload = reader.getPayload(i, size);
+        cv::Mat frame;
+        const FrameArchiveEntry& entry = reader.getEntry(i);
+        if (entry.frameNumber != static_cast<uint32_t>(frameNumber) || entry.timestampUs != frameNumber * 1000LL ||
+            reader.findFrame(frameNumber) != i || !payload || !sameBytes(payload, size, expected) ||
+            !reader.readFrame(i, frame) || frame.type() != CV_8UC3 || !sameBytes(frame.data, size, expected)) {
+            bad++;
+        }
+    }
+    check(bad == 0, "findFrame、getPayload、readFrame逐帧一致");
+
+    size_t size = 0;
+    cv::Mat frame;
+    check(reader.findFrame(1) == -1 && reader.findFrame((kFrames - 1) * kFrameStep + 1) == -1,
+          "不在归档中的帧号: findFrame返回-1");
+    check(!reader.getPayload(kFrames, size) && size == 0 && !reader.readFrame(kFrames, frame), "越界下标: 没有数据");
+
+    // 解包：每帧一个文件，文件名为原帧号
+    std::string unpackDir = dir + "/unpacked";
+    check(reader.unpack(unpackDir), "解包");
+    int files = 0;
+    int decoded = 0;
+    for (const auto& file : fs::directory_iterator(unpackDir)) {
+        files++;
+        (void)file;
+    }
+    for (int i = 0; i < kFrames; i++) {
+        char name[32];
+        snprintf(name, sizeof(name), "/frame_%06d.jpg", i * kFrameStep);
+        cv::Mat image = cv::imread(unpackDir + name);
+        decoded += (image.cols == kWidth && image.rows == kHeight) ? 1 : 0;
+    }
+    check(files == kFrames && decoded == kFrames, "解包出 40 个按帧号命名的JPEG");
+    reader.close();
+
+    // 索引按8字节对齐
+    std::string original = readFile(path);
+    FrameArchiveFooter footer = footerOf(original);
+    check(footer.indexOffset % 8 == 0 && footer.frameCount == static_cast<uint64_t>(kFrames), "索引偏移按8字节对齐");
+
+    // 损坏的归档不能打开
+    std::string badPath = dir + "/bad.frames";
+    check(opensAfter(original, badPath, [](std::string&) {}), "原样复制的归档可以打开");
+    check(!opensAfter(original, badPath, [](std::string& data) { data.pop_back(); }), "截掉最后一个字节");
+    check(!opensAfter(original, badPath, [](std::string& data) { data.resize(data.size() / 2); }), "截掉后一半");
+    check(!opensAfter(original, badPath, [](std::string& data) { data.resize(sizeof(FrameArchiveHeader)); }),
+          "只有文件头");
+    check(!opensAfter(original, badPath, [](std::string& data) { data[data.size() - sizeof(FrameArchiveFooter)] ^= 1; }),
+          "文件尾标识损坏");
+    check(!opensAfter(original, badPath, [](std::string& data) {
+              setFooter(data, [](FrameArchiveFooter& f) { f.frameCount++; });
+          }), "文件尾帧数与索引长度不符");
+    check(!opensAfter(original, badPath, [](std::string& data) {
+              setFooter(data, [&data](FrameArchiveFooter& f) { f.indexOffset = data.size(); });
+          }), "文件尾索引偏移越界");
+    check(!opensAfter(original, badPath, [&](std::string& data) {
+              // 在索引前插入4个字节，帧数和索引长度仍然相符，只有偏移不对齐
+              data.insert(footer.indexOffset, 4, '\0');
+              setFooter(data, [](FrameArchiveFooter& f) { f.indexOffset += 4; });
+          }), "索引偏移不对齐");
+    check(!opensAfter(original, badPath, [](std::string& data) {
+              setFooter(data, [](FrameArchiveFooter& f) { f.type = CV_16UC1; });
+          }), "不支持的像素类型");
+    check(!opensAfter(original, badPath, [](std::string& data) {
+              setFooter(data, [](FrameArchiveFooter& f) { f.codec = 7; });
+          }), "未知编码");
+    check(!opensAfter(original, badPath, [](std::string& data) {
+              setEntry(data, 5, [](FrameArchiveEntry& e) { e.offset = 0; });
+          }), "索引项偏移落在文件头内");
+    check(!opensAfter(original, badPath, [&](std::string& data) {
+              setEntry(data, 5, [&](FrameArchiveEntry& e) { e.offset = footer.indexOffset - e.size + 1; });
+          }), "索引项数据超出索引偏移");
+    check(!opensAfter(original, badPath, [](std::string& data) {
+              // offset + size回绕到很小的值，相加比较会漏掉
+              setEntry(data, 5, [](FrameArchiveEntry& e) { e.offset = ~0ull - 16; e.size = 100; });
+          }), "索引项偏移加长度溢出");
+
+    // 尺寸被改小时每帧的解压长度不符，readFrame拒绝，不按错误的尺寸复制
+    {
+        std::string data = original;
+        setFooter(data, [](FrameArchiveFooter& f) { f.height = 1; });
+        std::ofstream(badPath, std::ios::binary | std::ios::trunc).write(data.data(), static_cast<std::streamsize>(data.size()));
+        FrameArchiveReader damaged;
+        check(damaged.open(badPath) && !damaged.readFrame(0, frame), "文件尾尺寸与帧长度不符: readFrame失败");
+    }
+
+    fs::remove_all(dir);
+    return g_failures > 0 ? 1 : 0;
+}
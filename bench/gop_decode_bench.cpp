@@ -0,0 +1,224 @@
+#include "gop_decoder.h"
+#include <opencv2/opencv.hpp>
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <algorithm>
+
+namespace {
+
+// 帧内容的64位FNV-1a散列，逐行计算（跳过行尾填充）
+uint64_t hashFrame(const cv::Mat& frame) {
+    uint64_t hash = 1469598103934665603ull;
+    size_t rowBytes = static_cast<size_t>(frame.cols) * frame.elemSize();
+    for (int y = 0; y < frame.rows; y++) {
+        const uint8_t* row = frame.ptr<uint8_t>(y);
+        for (size_t x = 0; x < rowBytes; x++) {
+            hash = (hash ^ row[x]) * 1099511628211ull;
+        }
+    }
+    return hash;
+}
+
+// 一次解码的结果：每个帧号的散列和出现次数
+struct DecodeResult {
+    std::vector<uint64_t> hashes;
+    std::vector<int> counts;
+    double seconds;
+    bool complete;
+};
+
+// 相邻的段分成groupCount组，与FrameExtractor的分组方式相同
+std::vector<std::vector<GopSegment>> group(const std::vector<GopSegment>& segments, size_t groupCount) {
+    groupCount = std::max<size_t>(1, std::min(groupCount, segments.size()));
+    std::vector<std::vector<GopSegment>> groups(groupCount);
+    for (size_t i = 0; i < segments.size(); i++) {
+        groups[i * groupCount / segments.size()].push_back(segments[i]);
+    }
+    return groups;
+}
+
+// 用threads个线程解码groups，线程依次领取一组，与分帧一样用decodeSegments（一个解码器，组内区间之间清空并重新定位）
+DecodeResult decode(const GopDecoder& decoder, const std::vector<std::vector<GopSegment>>& groups, int threads) {
+    DecodeResult result;
+    result.hashes.assign(decoder.getFrameCount(), 0);
+    result.counts.assign(decoder.getFrameCount(), 0);
+    result.complete = true;
+
+    std::mutex mutex;
+    std::atomic<size_t> nextGroup(0);
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> workers;
+    for (int i = 0; i < threads; i++) {
+        workers.emplace_back([&]() {
+            for (size_t g = nextGroup++; g < groups.size(); g = nextGroup++) {
+                bool complete = decoder.decodeSegments(groups[g], [&](int index, cv::Mat& frame) {
+                    uint64_t hash = hashFrame(frame);
+                    std::lock_guard<std::mutex> lock(mutex);
+                    result.hashes[index] = hash;
+                    result.counts[index]++;
+                    return true;
+                });
+                if (!complete) {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    result.complete = false;
+                }
+            }
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
+
+// 与基准逐帧比较：wanted中的帧各出现一次且内容与基准相同，其他帧不出现
+struct Comparison {
+    int missing = 0;
+    int duplicated = 0;
+    int mismatched = 0;
+    int unexpected = 0;
+    bool complete = true;
+
+    bool ok() const {
+        return missing == 0 && duplicated == 0 && mismatched == 0 && unexpected == 0 && complete;
+    }
+};
+
+Comparison compare(const DecodeResult& result, const DecodeResult& baseline, const std::vector<bool>& wanted) {
+    Comparison comparison;
+    comparison.complete = result.complete;
+    for (size_t i = 0; i < wanted.size(); i++) {
+        if (!wanted[i]) {
+            comparison.unexpected += result.counts[i] > 0 ? 1 : 0;
+        } else if (result.counts[i] == 0) {
+            comparison.missing++;
+        } else if (result.counts[i] > 1) {
+            comparison.duplicated++;
+        } else if (result.hashes[i] != baseline.hashes[i]) {
+            comparison.mismatched++;
+        }
+    }
+    return comparison;
+}
+
+void printComparison(const Comparison& comparison) {
+    if (comparison.ok()) {
+        std::cout << "  一致" << std::endl;
+    } else {
+        std::cout << "  缺失 " << comparison.missing << ", 重复 " << comparison.duplicated << ", 不同 "
+                  << comparison.mismatched << ", 多余 " << comparison.unexpected
+                  << (comparison.complete ? "" : ", 区间未解完") << std::endl;
+    }
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::cerr << "用法: " << argv[0] << " 视频文件 [最大解码线程数]" << std::endl;
+        return 1;
+    }
+    std::string path = argv[1];
+    int maxThreads = argc > 2 ? std::atoi(argv[2]) : static_cast<int>(std::thread::hardware_concurrency());
+    // 至少跑一次2线程，单核机器上也要比较并行切分的结果
+    maxThreads = std::max(2, maxThreads);
+
+    GopDecoder decoder;
+    if (!decoder.open(path)) {
+        std::cerr << "无法扫描视频: " << path << std::endl;
+        return 1;
+    }
+    int frameCount = decoder.getFrameCount();
+    std::cout << path << ": " << decoder.getWidth() << "x" << decoder.getHeight() << ", " << frameCount
+              << " 帧, " << decoder.getKeyframeCount() << " 个关键帧" << std::endl;
+
+    // 基准：整个视频作为一段，从头顺序解码。分帧在有libav时顺序模式也走这条路径，
+    // 所以下面的逐帧比较是libav与libav比较，不再与cv::VideoCapture的顺序解码比较
+    DecodeResult serial = decode(decoder, group(decoder.split(1), 1), 1);
+    std::vector<bool> all(frameCount, true);
+    Comparison serialCheck = compare(serial, serial, all);
+    if (!serialCheck.ok()) {
+        std::cerr << "顺序解码不完整: " << serialCheck.missing << " 帧缺失, " << serialCheck.duplicated << " 帧重复"
+                  << std::endl;
+        return 1;
+    }
+
+    // 与OpenCV顺序读帧比较（颜色转换参数可能不同，只报告，不计为失败）
+    {
+        cv::VideoCapture capture(path);
+        cv::Mat frame;
+        int index = 0;
+        int matched = 0;
+        while (index < frameCount && capture.read(frame)) {
+            if (hashFrame(frame) == serial.hashes[index]) {
+                matched++;
+            }
+            index++;
+        }
+        std::cout << "OpenCV顺序解码: " << index << " 帧, 其中 " << matched << " 帧与libav顺序解码一致" << std::endl;
+    }
+
+    int failures = 0;
+    std::cout << std::setw(8) << "线程数" << std::setw(8) << "段数" << std::setw(8) << "组数" << std::setw(10) << "秒"
+              << std::setw(12) << "帧/秒" << std::setw(10) << "加速比" << "  逐帧比较" << std::endl;
+    std::cout << std::setw(8) << 1 << std::setw(8) << 1 << std::setw(8) << 1 << std::setw(10) << std::fixed
+              << std::setprecision(2) << serial.seconds << std::setw(12) << std::setprecision(1)
+              << frameCount / serial.seconds << std::setw(9) << std::setprecision(2) << 1.0 << "x" << "  基准"
+              << std::endl;
+
+    for (int threads = 2; threads <= maxThreads; threads *= 2) {
+        // 切成线程数4倍的段，每两段一组：线程动态领取，组内第二段要清空解码器并重新定位
+        std::vector<GopSegment> segments = decoder.split(threads * 4);
+        std::vector<std::vector<GopSegment>> groups = group(segments, static_cast<size_t>(threads) * 2);
+        DecodeResult parallel = decode(decoder, groups, threads);
+        Comparison comparison = compare(parallel, serial, all);
+
+        std::cout << std::setw(8) << threads << std::setw(8) << segments.size() << std::setw(8) << groups.size()
+                  << std::setw(10) << std::setprecision(2) << parallel.seconds << std::setw(12)
+                  << std::setprecision(1) << frameCount / parallel.seconds << std::setw(9) << std::setprecision(2)
+                  << serial.seconds / parallel.seconds << "x";
+        printComparison(comparison);
+        if (!comparison.ok()) {
+            failures++;
+        }
+    }
+
+    // 只取部分帧：与分帧一样用select()选出GOP，只解码到其中最后一个所需帧；只取关键帧时每个GOP只解码关键帧
+    struct SparsePass {
+        const char* name;
+        std::vector<int> frames;
+    };
+    std::vector<SparsePass> sparsePasses = {{"每7帧", {}}, {"只取关键帧", decoder.getKeyframeIndices()}};
+    for (int i = 0; i < frameCount; i += 7) {
+        sparsePasses[0].frames.push_back(i);
+    }
+    for (const SparsePass& pass : sparsePasses) {
+        std::vector<bool> wanted(frameCount, false);
+        for (int index : pass.frames) {
+            wanted[index] = true;
+        }
+        std::vector<GopSegment> segments = decoder.select(pass.frames);
+        std::vector<std::vector<GopSegment>> groups = group(segments, 8);
+        DecodeResult sparse = decode(decoder, groups, 2);
+        Comparison comparison = compare(sparse, serial, wanted);
+
+        std::cout << pass.name << ": " << pass.frames.size() << " 帧, " << segments.size() << " 段, "
+                  << groups.size() << " 组, 2 个线程, " << std::setprecision(2) << sparse.seconds << " 秒";
+        printComparison(comparison);
+        if (!comparison.ok()) {
+            failures++;
+        }
+    }
+
+    return failures > 0 ? 1 : 0;
+}
@@ -0,0 +1,220 @@
+#include "motion_detector.h"
+#include <opencv2/opencv.hpp>
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdlib>
+
+using ColorConvert::Isa;
+
+namespace {
+
+const int kFps = 30;
+const int64_t kFrameIntervalUs = 1000000 / kFps;
+
+// 合成场景
+enum class Scene {
+    StaticNoise,  // 静止画面加传感器噪声
+    MovingObject,  // 一段时间内有物体移动
+    ExposureStep   // 整体亮度突变（自动曝光）
+};
+
+const int kMotionBegin = 60;  // 物体开始移动的帧
+const int kMotionEnd = 150;   // 物体停止移动的帧
+const int kExposureFrame = 60;  // 亮度突变的帧
+
+// 简单的线性同余随机数，保证每次运行的序列相同
+inline uint32_t nextRandom(uint32_t& seed) {
+    seed = seed * 1664525u + 1013904223u;
+    return seed >> 24;
+}
+
+// 生成第index帧：渐变背景、噪声和场景内容
+void renderFrame(cv::Mat& frame, Scene scene, int index, uint32_t& seed) {
+    int brightness = (scene == Scene::ExposureStep && index >= kExposureFrame) ? 60 : 0;
+
+    // 物体在运动期间每帧移动12像素，之后停在原地
+    int objectSize = frame.rows / 8;
+    int position = std::min(std::max(index, kMotionBegin), kMotionEnd) - kMotionBegin;
+    int objectX = 100 + position * 12 % std::max(1, frame.cols - objectSize - 200);
+    int objectY = frame.rows / 3;
+
+    for (int y = 0; y < frame.rows; y++) {
+        uint8_t* row = frame.ptr<uint8_t>(y);
+        for (int x = 0; x < frame.cols; x++) {
+            int value = 40 + (x + y) * 100 / (frame.cols + frame.rows) + brightness;
+            if (scene == Scene::MovingObject && x >= objectX && x < objectX + objectSize &&
+                y >= objectY && y < objectY + objectSize) {
+                value = 230;
+            }
+            value += static_cast<int>(nextRandom(seed) % 7) - 3;  // ±3噪声
+            uint8_t v = static_cast<uint8_t>(std::max(0, std::min(value, 255)));
+            row[x * 3] = v;
+            row[x * 3 + 1] = v;
+            row[x * 3 + 2] = v;
+        }
+    }
+}
+
+// 回放一个场景，记录进入和退出运动状态的帧
+struct ReplayResult {
+    int startFrame;
+    int stopFrame;
+    int activations;
+
+    ReplayResult() : startFrame(-1), stopFrame(-1), activations(0) {}
+};
+
+ReplayResult replay(Scene scene, int width, int height, int frames, const MotionSettings& settings) {
+    MotionDetector detector;
+    detector.setSettings(settings);
+
+    ReplayResult result;
+    bool wasActive = false;
+    uint32_t seed = 12345;
+    cv::Mat frame(height, width, CV_8UC3);
+    for (int i = 0; i < frames; i++) {
+        renderFrame(frame, scene, i, seed);
+        MotionResult motion = detector.process(frame, (i + 1) * kFrameIntervalUs);
+        if (motion.active && !wasActive) {
+            result.activations++;
+            if (result.startFrame < 0) {
+                result.startFrame = i;
+            }
+        }
+        if (!motion.active && wasActive) {
+            result.stopFrame = i;
+        }
+        wasActive = motion.active;
+    }
+    return result;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    int width = argc > 1 ? std::atoi(argv[1]) : 1920;
+    int height = argc > 2 ? std::atoi(argv[2]) : 1080;
+    int iterations = argc > 3 ? std::atoi(argv[3]) : 200;
+
+    if (width < 256 || height < 256 || iterations <= 0) {
+        std::cerr << "用法: " << argv[0] << " [宽度>=256] [高度>=256] [迭代次数]" << std::endl;
+        return 1;
+    }
+
+    const Isa isas[] = {Isa::Scalar, Isa::SSE41, Isa::AVX2, Isa::NEON};
+    int failures = 0;
+
+    // 1. 各向量化实现的块计数与标量一致
+    std::cout << "块计数一致性:" << std::endl;
+    uint32_t seed = 1;
+    for (int planeWidth : {16, 48, 480}) {
+        int planeHeight = 37;
+        std::vector<uint8_t> previous(planeWidth * planeHeight), current(planeWidth * planeHeight);
+        for (size_t i = 0; i < previous.size(); i++) {
+            previous[i] = static_cast<uint8_t>(nextRandom(seed));
+            current[i] = static_cast<uint8_t>(i % 3 == 0 ? nextRandom(seed) : previous[i]);
+        }
+
+        for (int threshold : {0, 25, 200}) {
+            int expected = MotionDetector::countChangedBlocks(previous.data(), current.data(), planeWidth,
+                                                              planeWidth, planeHeight, threshold, 16, Isa::Scalar);
+            for (Isa isa : isas) {
+                if (!ColorConvert::isIsaSupported(isa) || isa == Isa::Scalar) {
+                    continue;
+                }
+                int count = MotionDetector::countChangedBlocks(previous.data(), current.data(), planeWidth,
+                                                               planeWidth, planeHeight, threshold, 16, isa);
+                if (count != expected) {
+                    std::cout << "  " << ColorConvert::getIsaName(isa) << " 宽度 " << planeWidth << " 阈值 " << threshold
+                              << ": " << count << " != " << expected << std::endl;
+                    failures++;
+                }
+            }
+        }
+    }
+    std::cout << "  " << (failures == 0 ? "一致" : "不一致") << std::endl << std::endl;
+
+    // 2. 回放合成序列，检查迟滞后的开始和停止时机
+    MotionSettings settings;
+    int frames = kMotionEnd + static_cast<int>(settings.stopSeconds * kFps) + 60;
+    int stopFrame = kMotionEnd + static_cast<int>(settings.stopSeconds * kFps);
+
+    std::cout << "合成序列回放 (" << frames << " 帧):" << std::endl;
+
+    ReplayResult staticResult = replay(Scene::StaticNoise, width, height, frames, settings);
+    bool staticOk = staticResult.activations == 0;
+    std::cout << "  静止+噪声: 触发 " << staticResult.activations << " 次 " << (staticOk ? "通过" : "失败") << std::endl;
+
+    ReplayResult movingResult = replay(Scene::MovingObject, width, height, frames, settings);
+    bool movingOk = movingResult.activations == 1 &&
+                    movingResult.startFrame >= kMotionBegin + settings.startFrames - 1 &&
+                    movingResult.startFrame <= kMotionBegin + settings.startFrames + 1 &&
+                    movingResult.stopFrame >= stopFrame - 1 && movingResult.stopFrame <= stopFrame + 2;
+    std::cout << "  移动物体: 第 " << movingResult.startFrame << " 帧开始 (期望约 "
+              << kMotionBegin + settings.startFrames << "), 第 " << movingResult.stopFrame << " 帧停止 (期望约 "
+              << stopFrame << ") " << (movingOk ? "通过" : "失败") << std::endl;
+
+    ReplayResult exposureResult = replay(Scene::ExposureStep, width, height, frames, settings);
+    bool exposureOk = exposureResult.activations == 0;
+    std::cout << "  曝光突变: 触发 " << exposureResult.activations << " 次 " << (exposureOk ? "通过" : "失败") << std::endl;
+
+    failures += (staticOk ? 0 : 1) + (movingOk ? 0 : 1) + (exposureOk ? 0 : 1);
+    std::cout << std::endl;
+
+    // 3. 每帧耗时：整帧为降采样+帧差+块计数，帧差只计块计数内核；两帧交替使每次都有变化
+    std::cout << "每帧耗时 " << width << "x" << height << ", 降采样 " << settings.decimation
+              << ", " << iterations << " 次迭代:" << std::endl;
+    cv::Mat inputs[2] = {cv::Mat(height, width, CV_8UC3), cv::Mat(height, width, CV_8UC3)};
+    renderFrame(inputs[0], Scene::MovingObject, kMotionBegin, seed);
+    renderFrame(inputs[1], Scene::MovingObject, kMotionBegin + 5, seed);
+
+    int planeWidth = (width / settings.decimation + MotionDetector::kBlockSize - 1) /
+                     MotionDetector::kBlockSize * MotionDetector::kBlockSize;
+    int planeHeight = height / settings.decimation;
+    std::vector<uint8_t> planes[2];
+    for (int i = 0; i < 2; i++) {
+        planes[i].assign(static_cast<size_t>(planeWidth) * planeHeight, 0);
+        MotionDetector::decimateLuma(inputs[i], settings.decimation, planes[i].data(), planeWidth);
+    }
+
+    std::cout << "  " << std::left << std::setw(8) << "实现" << std::right
+              << std::setw(12) << "整帧(ms)" << std::setw(12) << "帧差(ms)" << std::endl;
+    for (Isa isa : isas) {
+        MotionDetector detector;
+        if (!detector.setIsa(isa)) {
+            continue;
+        }
+        detector.setSettings(settings);
+        detector.process(inputs[1]);  // 预热并建立参考帧
+
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; i++) {
+            detector.process(inputs[i & 1]);
+        }
+        double frameMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / iterations;
+
+        int blocks = 0;
+        start = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; i++) {
+            blocks += MotionDetector::countChangedBlocks(planes[i & 1].data(), planes[1 - (i & 1)].data(), planeWidth,
+                                                         planeWidth, planeHeight, settings.pixelThreshold,
+                                                         settings.blockChangedPixels, isa);
+        }
+        double kernelMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / iterations;
+
+        std::cout << "  " << std::left << std::setw(8) << ColorConvert::getIsaName(isa) << std::right
+                  << std::fixed << std::setprecision(3) << std::setw(12) << frameMs << std::setw(12) << kernelMs
+                  << (frameMs >= 1.0 ? "  超过1毫秒" : "") << std::endl;
+        (void)blocks;
+    }
+
+    if (failures > 0) {
+        std::cerr << failures << " 项检查失败" << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,166 @@
+#include "output_sink.h"
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <filesystem>
+#include <cstdlib>
+#include <cstdio>
+
+// 输出写入测试：关闭io_uring强制使用后台写入线程，检查写出的文件与写入的内容逐字节相同（包括回写文件头、
+// 覆盖仍在队列中的数据、跳过的空洞、不等待落盘就切换到下一个文件），以及fdatasync按设定的间隔执行、关闭时做一次最终同步
+
+namespace fs = std::filesystem;
+
+namespace {
+
+int g_failures = 0;
+
+void check(bool condition, const std::string& what) {
+    std::cout << (condition ? "通过  " : "失败  ") << what << std::endl;
+    if (!condition) {
+        g_failures++;
+    }
+}
+
+std::string readFile(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    return std::string((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+}
+
+OutputSinkSettings fallbackSettings(double syncIntervalSeconds) {
+    OutputSinkSettings settings;
+    settings.bufferSize = 4096;  // 小缓冲区，一个文件就要提交很多次写入
+    settings.bufferCount = 16;
+    settings.syncIntervalSeconds = syncIntervalSeconds;
+    settings.ioUring = false;
+    return settings;
+}
+
+// 在sink和expected的同一位置写入相同的数据
+bool writeAt(OutputSink& sink, std::string& expected, int64_t& position, const std::string& data) {
+    if (expected.size() < position + data.size()) {
+        expected.resize(position + data.size(), '\0');
+    }
+    expected.replace(static_cast<size_t>(position), data.size(), data);
+    position += static_cast<int64_t>(data.size());
+    return sink.write(reinterpret_cast<const uint8_t*>(data.data()), data.size());
+}
+
+// 按随机长度分块写入，模拟封装器大小不一的写入；返回写入的字节数
+uint64_t writeRandom(OutputSink& sink, std::string& expected, int64_t& position, std::mt19937& rng,
+                     size_t total, bool& ok) {
+    std::uniform_int_distribution<size_t> chunkSize(1, 10000);
+    std::uniform_int_distribution<int> byte(0, 255);
+    uint64_t written = 0;
+    while (written < total) {
+        std::string chunk(std::min(chunkSize(rng), total - written), '\0');
+        for (char& c : chunk) {
+            c = static_cast<char>(byte(rng));
+        }
+        ok = writeAt(sink, expected, position, chunk) && ok;
+        written += chunk.size();
+    }
+    return written;
+}
+
+}  // namespace
+
+int main() {
+    char dirTemplate[] = "/tmp/output_sink_XXXXXX";
+    if (!mkdtemp(dirTemplate)) {
+        perror("mkdtemp");
+        return 1;
+    }
+    std::string dir = dirTemplate;
+    std::mt19937 rng(1);
+
+    // 逐字节一致：两个文件连续写入，第一个文件关闭后不等待落盘就打开第二个
+    {
+        OutputSink sink;
+        check(sink.init(fallbackSettings(0.0)) && !sink.isUsingIoUring(), "关闭io_uring后使用写入线程");
+
+        std::string first = dir + "/first.bin";
+        std::string second = dir + "/second.bin";
+        std::string expectedFirst;
+        std::string expectedSecond;
+        uint64_t bytes = 0;
+        bool ok = sink.open(first);
+        check(ok && !sink.open(second), "上一个文件未关闭时不能打开下一个");
+
+        int64_t position = 0;
+        bytes += writeRandom(sink, expectedFirst, position, rng, 300000, ok);
+        check(sink.tell() == position && sink.size() == static_cast<int64_t>(expectedFirst.size()), "写入位置和文件大小");
+
+        // 回写文件头（如mp4的mdat大小）
+        position = sink.seek(8, SEEK_SET);
+        bytes += 8;
+        ok = position == 8 && writeAt(sink, expectedFirst, position, "HEADER!!") && ok;
+        // 反复回写刚提交的一段：旧数据可能还在写入队列中，必须先写旧数据再写新数据
+        for (int i = 0; i < 200; i++) {
+            position = sink.seek(0, SEEK_END);
+            ok = position == static_cast<int64_t>(expectedFirst.size()) && ok;
+            bytes += writeRandom(sink, expectedFirst, position, rng, 5000, ok);
+            position = sink.seek(-3000, SEEK_END);
+            bytes += writeRandom(sink, expectedFirst, position, rng, 100, ok);
+        }
+        position = sink.seek(0, SEEK_END);
+
+        // 越过文件末尾写入，中间留出空洞
+        position = sink.seek(10000, SEEK_CUR);
+        bytes += writeRandom(sink, expectedFirst, position, rng, 20000, ok);
+        check(ok && sink.close(), "第一个文件写入并关闭");
+        check(!sink.write(reinterpret_cast<const uint8_t*>("x"), 1), "关闭后写入失败");
+
+        position = 0;
+        ok = sink.open(second);
+        bytes += writeRandom(sink, expectedSecond, position, rng, 200000, ok);
+        check(ok && sink.close(), "第二个文件写入并关闭");
+        sink.drain();
+
+        check(readFile(first) == expectedFirst, "第一个文件逐字节一致（含回写的文件头和空洞）");
+        check(readFile(second) == expectedSecond, "第二个文件逐字节一致");
+
+        OutputSinkStats stats = sink.getStats();
+        check(stats.bytesWritten == bytes && stats.errors == 0 && stats.queueDepth == 0, "写入字节数、无错误、队列已清空");
+        check(stats.writes >= bytes / 4096 && stats.maxQueueDepth <= 16, "写入按缓冲区提交，队列深度不超过缓冲区数");
+        // 同步间隔为0时只在关闭时同步
+        check(stats.syncs == 2, "间隔为0: 每个文件只在关闭时同步一次");
+    }
+
+    // 同步节奏：每5毫秒写满一个缓冲区，持续0.6秒，每50毫秒应同步一次
+    {
+        const double interval = 0.05;
+        OutputSink sink;
+        sink.init(fallbackSettings(interval));
+        std::string path = dir + "/paced.bin";
+        std::string expected;
+        int64_t position = 0;
+        bool ok = sink.open(path);
+
+        auto start = std::chrono::steady_clock::now();
+        auto end = start + std::chrono::milliseconds(600);
+        while (std::chrono::steady_clock::now() < end) {
+            writeRandom(sink, expected, position, rng, 4096, ok);
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        ok = sink.close() && ok;
+        sink.drain();
+
+        OutputSinkStats stats = sink.getStats();
+        uint64_t periodic = stats.syncs - 1;  // 去掉关闭时的最终同步
+        uint64_t most = static_cast<uint64_t>(seconds / interval);
+        std::cout << "    " << seconds << " 秒内定期同步 " << periodic << " 次（最多 " << most << " 次）" << std::endl;
+        check(ok && readFile(path) == expected && stats.errors == 0, "定期同步时内容逐字节一致");
+        // 两次同步至少间隔interval；负载高时提交会推迟，下限放宽到三分之一
+        check(periodic <= most && periodic >= most / 3, "fdatasync按间隔执行");
+    }
+
+    fs::remove_all(dir);
+    return g_failures > 0 ? 1 : 0;
+}
@@ -0,0 +1,215 @@
+#include "raw_recorder.h"
+#include "frame_pool.h"
+#include <linux/videodev2.h>
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <filesystem>
+#include <cstdlib>
+#include <cstring>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+const int kFps = 60;
+
+// 写入方式
+struct Mode {
+    const char* name;
+    bool directIo;
+    bool ioUring;
+};
+
+// 帧内容：前16字节为帧序号，其余为由序号决定的图案，回读时据此校验
+void fillFrame(uint8_t* data, size_t size, uint64_t index) {
+    memcpy(data, &index, sizeof(index));
+    memset(data + sizeof(index), 0, 8);
+    uint8_t value = static_cast<uint8_t>(index * 31 + 7);
+    for (size_t i = 16; i < size; i += 64) {
+        data[i] = value++;
+    }
+}
+
+bool checkFrame(const std::vector<uint8_t>& data, uint64_t index) {
+    uint64_t stored = 0;
+    memcpy(&stored, data.data(), sizeof(stored));
+    if (stored != index) {
+        return false;
+    }
+    uint8_t value = static_cast<uint8_t>(index * 31 + 7);
+    for (size_t i = 16; i < data.size(); i += 64) {
+        if (data[i] != value++) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// 回读文件，检查索引、时间戳和抽样帧内容
+bool verify(const std::string& path, uint64_t expectedFrames, size_t frameSize, std::string& error) {
+    RawFileHeader header;
+    std::vector<RawFrameEntry> entries;
+    if (!RawRecorder::readIndex(path, header, entries)) {
+        error = "无法读取索引";
+        return false;
+    }
+    if (header.frameCount != expectedFrames) {
+        error = "帧数 " + std::to_string(header.frameCount) + " != " + std::to_string(expectedFrames);
+        return false;
+    }
+
+    std::ifstream file(path, std::ios::binary);
+    std::vector<uint8_t> data(frameSize);
+    for (size_t i = 0; i < entries.size(); i++) {
+        const RawFrameEntry& entry = entries[i];
+        if (entry.size != frameSize || entry.offset % 4096 != 0 || entry.sequence != i ||
+            entry.timestampUs != static_cast<int64_t>(i) * (1000000 / kFps)) {
+            error = "第 " + std::to_string(i) + " 帧索引错误";
+            return false;
+        }
+        if (i % 7 != 0 && i + 1 != entries.size()) {
+            continue;
+        }
+        file.seekg(static_cast<std::streamoff>(entry.offset));
+        file.read(reinterpret_cast<char*>(data.data()), static_cast<std::streamsize>(data.size()));
+        if (!file || !checkFrame(data, i)) {
+            error = "第 " + std::to_string(i) + " 帧内容错误";
+            return false;
+        }
+    }
+    return true;
+}
+
+// 读取系统中的页缓存大小（MB）
+long cachedMegabytes() {
+    std::ifstream meminfo("/proc/meminfo");
+    std::string key;
+    long value = 0;
+    std::string unit;
+    while (meminfo >> key >> value >> unit) {
+        if (key == "Cached:") {
+            return value / 1024;
+        }
+    }
+    return -1;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    int width = argc > 1 ? std::atoi(argv[1]) : 1920;
+    int height = argc > 2 ? std::atoi(argv[2]) : 1080;
+    int frames = argc > 3 ? std::atoi(argv[3]) : 300;
+    std::vector<std::string> directories;
+    for (int i = 4; i < argc; i++) {
+        directories.push_back(argv[i]);
+    }
+    if (directories.empty()) {
+        directories = {"/dev/shm", "."};
+    }
+
+    if (width < 16 || height < 16 || frames <= 0) {
+        std::cerr << "用法: " << argv[0] << " [宽度] [高度] [帧数] [目录...]" << std::endl;
+        return 1;
+    }
+
+    // YUYV每像素2字节；帧池与设备格式帧总线一样按4096字节对齐
+    size_t frameSize = static_cast<size_t>(width) * height * 2;
+    FramePool pool;
+    if (!pool.init(32, frameSize, 4096)) {
+        std::cerr << "无法分配帧池" << std::endl;
+        return 1;
+    }
+
+    const Mode modes[] = {
+        {"O_DIRECT+io_uring", true, true},
+        {"O_DIRECT+pwrite", true, false},
+        {"缓冲写入", false, false},
+    };
+
+    std::cout << "YUYV " << width << "x" << height << " (" << std::fixed << std::setprecision(2)
+              << frameSize / 1048576.0 << " MB/帧), " << frames << " 帧, 尽快提交" << std::endl;
+    std::cout << "  " << std::left << std::setw(14) << "目录" << std::setw(20) << "请求方式" << std::setw(20) << "实际方式"
+              << std::right << std::setw(10) << "MB/s" << std::setw(8) << "丢帧" << std::setw(12) << "页缓存(MB)"
+              << "  回读" << std::endl;
+
+    int failures = 0;
+    for (const std::string& directory : directories) {
+        fs::path outputDir = fs::path(directory) / "raw_recorder_bench";
+        for (const Mode& mode : modes) {
+            RawRecorder recorder;
+            RawRecorderSettings settings;
+            settings.directIo = mode.directIo;
+            settings.ioUring = mode.ioUring;
+            // 不丢帧地测吞吐：队列大于帧池，写入跟不上时提交方因帧池耗尽而等待，而不是丢帧
+            settings.queueDepth = 40;
+            settings.preallocateBytes = 256ull << 20;
+            recorder.setSettings(settings);
+            if (!recorder.init(outputDir.string()) ||
+                !recorder.startRecording(Resolution(width, height), FrameRate(kFps), V4L2_PIX_FMT_YUYV)) {
+                std::cout << "  " << directory << " " << mode.name << ": 无法开始录制" << std::endl;
+                failures++;
+                continue;
+            }
+
+            long cachedBefore = cachedMegabytes();
+            auto start = std::chrono::steady_clock::now();
+            for (int i = 0; i < frames; i++) {
+                FrameRef frame = pool.acquire();
+                while (!frame) {
+                    std::this_thread::sleep_for(std::chrono::microseconds(100));
+                    frame = pool.acquire();
+                }
+                FrameInfo info;
+                info.width = width;
+                info.height = height;
+                info.type = CV_8UC1;
+                info.step = 0;
+                info.bytesUsed = frameSize;
+                info.pixelFormat = V4L2_PIX_FMT_YUYV;
+                info.timestampUs = static_cast<int64_t>(i) * (1000000 / kFps);
+                info.sequence = static_cast<uint64_t>(i);
+                frame.setInfo(info);
+                fillFrame(frame.data(), frameSize, static_cast<uint64_t>(i));
+                recorder.processFrame(frame);
+            }
+            std::string path = recorder.getCurrentFilePath();
+            bool directIo = recorder.isUsingDirectIo();
+            bool ioUring = recorder.isUsingIoUring();
+            recorder.stopRecording();
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            long cachedGrowth = cachedMegabytes() - cachedBefore;
+
+            RecorderStats stats = recorder.getStats();
+            std::string error;
+            bool ok = stats.dropped == 0 && verify(path, static_cast<uint64_t>(frames), frameSize, error);
+            if (stats.dropped != 0) {
+                error = "丢帧";
+            }
+            failures += ok ? 0 : 1;
+
+            std::string actual = std::string(directIo ? "O_DIRECT" : "缓冲写入") + (ioUring ? "+io_uring" : "");
+            double megabytes = static_cast<double>(recorder.getBytesWritten()) / 1048576.0;
+            std::cout << "  " << std::left << std::setw(14) << directory << std::setw(20) << mode.name
+                      << std::setw(20) << actual << std::right << std::setprecision(1) << std::setw(10)
+                      << megabytes / seconds << std::setw(8) << stats.dropped << std::setw(12) << cachedGrowth
+                      << "  " << (ok ? "通过" : error) << std::endl;
+
+            fs::remove(path);
+        }
+        std::error_code ec;
+        fs::remove(outputDir, ec);
+    }
+
+    if (failures > 0) {
+        std::cerr << failures << " 项检查失败" << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
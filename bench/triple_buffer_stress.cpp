@@ -0,0 +1,145 @@
+#include "triple_buffer.h"
+#include <iostream>
+#include <iomanip>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <algorithm>
+
+namespace {
+
+// 带序号的数据：每个字都由序号导出，读到的值如果混有两次写入的内容，校验就会失败
+struct Payload {
+    static const int kWords = 256;  // 2KB，一次赋值需要多条指令，撕裂时容易暴露
+    uint64_t sequence;
+    uint64_t words[kWords];
+};
+
+inline uint64_t wordFor(uint64_t sequence, int i) {
+    return sequence * 0x9E3779B97F4A7C15ull + static_cast<uint64_t>(i);
+}
+
+void fill(Payload& payload, uint64_t sequence) {
+    payload.sequence = sequence;
+    for (int i = 0; i < Payload::kWords; i++) {
+        payload.words[i] = wordFor(sequence, i);
+    }
+}
+
+bool intact(const Payload& payload) {
+    for (int i = 0; i < Payload::kWords; i++) {
+        if (payload.words[i] != wordFor(payload.sequence, i)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// 忙等待delayNs纳秒（sleep的粒度太粗，模拟不出快慢差别）
+void spin(int64_t delayNs) {
+    if (delayNs <= 0) {
+        return;
+    }
+    auto until = std::chrono::steady_clock::now() + std::chrono::nanoseconds(delayNs);
+    while (std::chrono::steady_clock::now() < until) {
+    }
+}
+
+struct Result {
+    uint64_t written;
+    uint64_t reads;    // update成功的次数
+    uint64_t checks;   // 校验front()的次数（包括两次update之间的重复校验）
+    uint64_t torn;     // 内容不一致
+    uint64_t backward; // 序号倒退或没有前进
+    bool sawLast;      // 生产者结束后消费者取到了最后一次写入
+};
+
+// 生产者每次写入后等待producerNs，消费者每次读取后等待consumerNs，持续seconds秒
+Result run(int64_t producerNs, int64_t consumerNs, double seconds) {
+    TripleBuffer<Payload> buffer;
+    std::atomic<bool> producerDone(false);
+    std::atomic<uint64_t> lastWritten(0);
+    Result result = {};
+
+    std::thread producer([&]() {
+        Payload payload;
+        auto until = std::chrono::steady_clock::now() + std::chrono::duration<double>(seconds);
+        uint64_t sequence = 0;
+        while (std::chrono::steady_clock::now() < until) {
+            fill(payload, ++sequence);
+            buffer.write(payload);
+            spin(producerNs);
+        }
+        lastWritten = sequence;
+        producerDone = true;
+    });
+
+    uint64_t lastRead = 0;
+    for (;;) {
+        bool done = producerDone;
+        if (buffer.update()) {
+            result.reads++;
+            if (buffer.front().sequence <= lastRead) {
+                result.backward++;
+            }
+            lastRead = buffer.front().sequence;
+        }
+
+        // 慢消费者在等待期间反复校验当前值：生产者不能写到消费者正在读的缓冲区
+        auto until = std::chrono::steady_clock::now() + std::chrono::nanoseconds(consumerNs);
+        do {
+            result.checks++;
+            if (lastRead > 0 && (!intact(buffer.front()) || buffer.front().sequence != lastRead)) {
+                result.torn++;
+            }
+        } while (std::chrono::steady_clock::now() < until);
+
+        if (done && !buffer.hasNewValue()) {
+            break;
+        }
+    }
+    producer.join();
+
+    result.written = lastWritten;
+    result.sawLast = lastRead == lastWritten;
+    return result;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    double seconds = argc > 1 ? std::atof(argv[1]) : 2.0;
+    if (seconds <= 0.0) {
+        std::cerr << "用法: " << argv[0] << " [每种场景的秒数]" << std::endl;
+        return 1;
+    }
+
+    struct Scenario {
+        const char* name;
+        int64_t producerNs;
+        int64_t consumerNs;
+    };
+    const Scenario scenarios[] = {
+        {"生产快、消费慢", 0, 200000},
+        {"生产慢、消费快", 200000, 0},
+        {"两边都不等待", 0, 0},
+    };
+
+    int failures = 0;
+    std::cout << std::setw(16) << "场景" << std::setw(12) << "写入" << std::setw(12) << "读取"
+              << std::setw(14) << "校验" << std::setw(8) << "撕裂" << std::setw(8) << "倒退" << "  结果" << std::endl;
+    for (const Scenario& scenario : scenarios) {
+        Result result = run(scenario.producerNs, scenario.consumerNs, seconds);
+        bool ok = result.torn == 0 && result.backward == 0 && result.sawLast && result.reads > 0;
+        std::cout << std::setw(16) << scenario.name << std::setw(12) << result.written << std::setw(12)
+                  << result.reads << std::setw(14) << result.checks << std::setw(8) << result.torn
+                  << std::setw(8) << result.backward << (ok ? "  通过" : "  失败") << std::endl;
+        if (!ok) {
+            failures++;
+        }
+    }
+
+    return failures > 0 ? 1 : 0;
+}
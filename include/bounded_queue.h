@@ -0,0 +1,161 @@
+#pragma once
+
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+#include <cstddef>
+
+// 队列满时的处理策略
+enum class QueuePolicy {
+    Block,       // 阻塞生产者直到有空位
+    DropOldest,  // 丢弃最旧的元素
+    LatestOnly   // 只保留最新的一个元素
+};
+
+// 队列统计
+struct QueueStats {
+    uint64_t pushed;   // 累计入队数
+    uint64_t popped;   // 累计出队数
+    uint64_t dropped;  // 因队列满被丢弃的数量
+    size_t depth;      // 当前深度
+    size_t maxDepth;   // 峰值深度
+
+    QueueStats() : pushed(0), popped(0), dropped(0), depth(0), maxDepth(0) {}
+};
+
+// 有界阻塞队列，满时按策略阻塞或丢弃
+template <typename T>
+class BoundedQueue {
+public:
+    explicit BoundedQueue(size_t capacity, QueuePolicy policy = QueuePolicy::Block)
+        : m_capacity(policy == QueuePolicy::LatestOnly ? 1 : (capacity > 0 ? capacity : 1)),
+          m_policy(policy),
+          m_closed(false) {}
+
+    BoundedQueue(const BoundedQueue&) = delete;
+    BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+    // 入队，队列已关闭时返回false
+    bool push(T value) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+
+        if (m_policy == QueuePolicy::Block) {
+            m_notFull.wait(lock, [this] { return m_closed || m_items.size() < m_capacity; });
+        } else {
+            while (!m_closed && m_items.size() >= m_capacity) {
+                m_items.pop_front();
+                m_stats.dropped++;
+            }
+        }
+
+        if (m_closed) {
+            return false;
+        }
+
+        m_items.push_back(std::move(value));
+        m_stats.pushed++;
+        if (m_items.size() > m_stats.maxDepth) {
+            m_stats.maxDepth = m_items.size();
+        }
+
+        lock.unlock();
+        m_notEmpty.notify_one();
+        return true;
+    }
+
+    // 阻塞出队，队列关闭且为空时返回false
+    bool pop(T& value) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_notEmpty.wait(lock, [this] { return m_closed || !m_items.empty(); });
+
+        if (m_items.empty()) {
+            return false;
+        }
+
+        value = std::move(m_items.front());
+        m_items.pop_front();
+        m_stats.popped++;
+
+        lock.unlock();
+        m_notFull.notify_one();
+        return true;
+    }
+
+    // 非阻塞出队
+    bool tryPop(T& value) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (m_items.empty()) {
+            return false;
+        }
+
+        value = std::move(m_items.front());
+        m_items.pop_front();
+        m_stats.popped++;
+
+        lock.unlock();
+        m_notFull.notify_one();
+        return true;
+    }
+
+    // 关闭队列：不再接受新元素，已有元素仍可出队
+    void close() {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_closed = true;
+        }
+        m_notEmpty.notify_all();
+        m_notFull.notify_all();
+    }
+
+    // 重新打开队列
+    void reopen() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_closed = false;
+    }
+
+    // 清空队列
+    void clear() {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_items.clear();
+        }
+        m_notFull.notify_all();
+    }
+
+    // 是否已关闭
+    bool isClosed() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_closed;
+    }
+
+    // 当前深度
+    size_t size() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_items.size();
+    }
+
+    // 容量
+    size_t capacity() const { return m_capacity; }
+
+    // 策略
+    QueuePolicy policy() const { return m_policy; }
+
+    // 获取统计信息
+    QueueStats getStats() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        QueueStats stats = m_stats;
+        stats.depth = m_items.size();
+        return stats;
+    }
+
+private:
+    const size_t m_capacity;  // 容量
+    const QueuePolicy m_policy;  // 队列满时的策略
+    bool m_closed;  // 是否已关闭
+    std::deque<T> m_items;  // 元素
+    QueueStats m_stats;  // 统计信息
+    mutable std::mutex m_mutex;  // 互斥锁
+    std::condition_variable m_notEmpty;  // 非空条件
+    std::condition_variable m_notFull;  // 非满条件
+};
@@ -2,8 +2,13 @@
 
 #include <string>
 #include <vector>
+#include <memory>
+#include <cstdint>
 #include <linux/videodev2.h>
 
+class DeviceCapabilityCache;
+struct NegotiationPlan;
+
 // 分辨率结构体
 struct Resolution {
     int width;
@@ -27,12 +32,109 @@ struct Resolution {
     }
 };
 
+// 帧率，以分数表示以保留29.97（30000/1001）这类非整数帧率
+struct FrameRate {
+    uint32_t numerator;    // 每秒帧数的分子
+    uint32_t denominator;  // 每秒帧数的分母
+
+    // 允许从整数帧率隐式构造
+    FrameRate(uint32_t num = 0, uint32_t den = 1) : numerator(num), denominator(den ? den : 1) {}
+
+    // 由帧间隔（每帧秒数）构造
+    static FrameRate fromInterval(const v4l2_fract& interval) {
+        return FrameRate(interval.denominator, interval.numerator);
+    }
+
+    double toDouble() const { return static_cast<double>(numerator) / denominator; }
+
+    // 四舍五入的整数帧率
+    int rounded() const { return static_cast<int>((numerator + denominator / 2) / denominator); }
+
+    bool isValid() const { return numerator > 0; }
+
+    // 整数帧率显示为"30"，非整数显示为"29.97"
+    std::string toString() const;
+
+    bool operator==(const FrameRate& other) const {
+        return static_cast<uint64_t>(numerator) * other.denominator ==
+               static_cast<uint64_t>(other.numerator) * denominator;
+    }
+
+    bool operator<(const FrameRate& other) const {
+        return static_cast<uint64_t>(numerator) * other.denominator <
+               static_cast<uint64_t>(other.numerator) * denominator;
+    }
+};
+
+// 帧间隔范围（对应VIDIOC_ENUM_FRAMEINTERVALS的一项）
+struct FrameIntervalRange {
+    uint32_t type;      // V4L2_FRMIVAL_TYPE_DISCRETE/STEPWISE/CONTINUOUS
+    v4l2_fract min;     // 最短帧间隔（最高帧率），离散类型时为唯一值
+    v4l2_fract max;     // 最长帧间隔（最低帧率）
+    v4l2_fract step;    // 步进
+
+    FrameIntervalRange() : type(V4L2_FRMIVAL_TYPE_DISCRETE), min{0, 1}, max{0, 1}, step{0, 1} {}
+};
+
+// 某个帧尺寸下支持的帧间隔
+struct SizeFrameIntervals {
+    uint32_t width;
+    uint32_t height;
+    std::vector<FrameIntervalRange> intervals;
+
+    SizeFrameIntervals() : width(0), height(0) {}
+};
+
+// 帧尺寸范围（对应VIDIOC_ENUM_FRAMESIZES的一项，步进/连续类型只保存范围不展开）
+struct FrameSizeRange {
+    uint32_t type;        // V4L2_FRMSIZE_TYPE_DISCRETE/STEPWISE/CONTINUOUS
+    uint32_t minWidth;
+    uint32_t maxWidth;
+    uint32_t stepWidth;
+    uint32_t minHeight;
+    uint32_t maxHeight;
+    uint32_t stepHeight;
+
+    FrameSizeRange()
+        : type(V4L2_FRMSIZE_TYPE_DISCRETE), minWidth(0), maxWidth(0), stepWidth(1),
+          minHeight(0), maxHeight(0), stepHeight(1) {}
+
+    // 是否包含指定尺寸（考虑步进对齐）
+    bool contains(uint32_t width, uint32_t height) const;
+};
+
+// 单个像素格式的能力
+struct FormatCapability {
+    uint32_t pixelFormat;       // V4L2像素格式（fourcc）
+    std::string description;    // 驱动给出的格式描述
+    std::vector<FrameSizeRange> frameSizes;  // 支持的帧尺寸
+    std::vector<SizeFrameIntervals> frameIntervals;  // 各帧尺寸支持的帧间隔（范围类型只查询候选分辨率）
+
+    FormatCapability() : pixelFormat(0) {}
+
+    // 是否支持指定帧尺寸
+    bool supportsSize(uint32_t width, uint32_t height) const;
+
+    // 指定帧尺寸支持的帧率（从高到低），未查询过该尺寸时返回空
+    std::vector<FrameRate> getFramerates(uint32_t width, uint32_t height) const;
+};
+
 // 摄像头设备信息结构体
 struct CameraDeviceInfo {
     std::string devicePath;      // 设备路径，如 /dev/video0
     std::string deviceName;      // 设备名称
-    std::vector<Resolution> supportedResolutions;  // 支持的分辨率列表
+    std::string busInfo;         // 总线信息，如 usb-0000:00:14.0-1
+    std::string driver;          // 驱动名称
+    uint32_t driverVersion;      // 驱动版本
+    int busSpeedMbps;            // USB总线速度（Mbps），非USB设备为0
+    std::vector<FormatCapability> formats;         // 各像素格式的能力
+    std::vector<Resolution> supportedResolutions;  // 支持的分辨率列表（由formats生成）
     std::vector<int> supportedFramerates;          // 支持的帧率列表
+
+    CameraDeviceInfo() : driverVersion(0), busSpeedMbps(0) {}
+
+    // 能力缓存的键：总线信息、驱动名称和版本、设备名称和节点路径唯一确定一个设备的能力
+    std::string getCacheKey() const;
 };
 
 // 摄像头设备管理类
@@ -44,6 +146,9 @@ public:
     // 扫描系统中的所有摄像头设备
     std::vector<CameraDeviceInfo> scanDevices();
 
+    // 探测单个设备节点（打开、读取能力后关闭），不是视频捕获设备时返回false
+    bool probeDevicePath(const std::string& devicePath, CameraDeviceInfo& deviceInfo);
+
     // 打开指定的摄像头设备
     bool openDevice(const std::string& devicePath);
 
@@ -53,11 +158,24 @@ public:
     // 获取设备支持的分辨率列表
     std::vector<Resolution> getSupportedResolutions();
 
-    // 获取设备支持的帧率列表
-    std::vector<int> getSupportedFramerates(const Resolution& resolution);
+    // 获取指定分辨率支持的帧率（从高到低），pixelFormat为0时合并所有格式
+    // 只查询打开设备时建立的能力表，不会对设备发出任何ioctl
+    std::vector<FrameRate> getSupportedFramerates(const Resolution& resolution, uint32_t pixelFormat = 0) const;
 
-    // 设置分辨率和帧率
-    bool setResolutionAndFramerate(const Resolution& resolution, int framerate);
+    // 为请求的分辨率和帧率选择像素格式（只查能力表，不访问设备）
+    NegotiationPlan planFormat(const Resolution& resolution, const FrameRate& framerate) const;
+
+    // 限定协商只能选择某种像素格式（如直通录制要求MJPEG），0表示不限定
+    void setRequiredPixelFormat(uint32_t pixelFormat) { m_requiredPixelFormat = pixelFormat; }
+
+    // 设置分辨率和帧率，像素格式由协商器根据带宽和处理代价选择
+    bool setResolutionAndFramerate(const Resolution& resolution, const FrameRate& framerate);
+
+    // 获取最近一次setResolutionAndFramerate采用的协商结果
+    const NegotiationPlan& getNegotiationPlan() const { return *m_negotiationPlan; }
+
+    // 获取驱动实际设置的帧率（setResolutionAndFramerate之后有效）
+    const FrameRate& getCurrentFramerate() const { return m_currentFramerate; }
 
     // 获取当前设备文件描述符
     int getDeviceFd() const { return m_fd; }
@@ -65,10 +183,34 @@ public:
     // 获取当前设备信息
     const CameraDeviceInfo& getCurrentDeviceInfo() const { return m_currentDevice; }
 
+    // 获取驱动实际协商的像素格式（setResolutionAndFramerate之后有效）
+    const v4l2_pix_format& getCurrentFormat() const { return m_currentFormat; }
+
+    // 设置能力缓存文件路径（默认 ~/captureVideo/device_caps.cache），空字符串表示不使用缓存
+    void setCapabilityCachePath(const std::string& path);
+
 private:
     int m_fd;  // 设备文件描述符
     CameraDeviceInfo m_currentDevice;  // 当前设备信息
+    v4l2_pix_format m_currentFormat;  // 当前像素格式
+    FrameRate m_currentFramerate;  // 当前帧率
+    std::shared_ptr<DeviceCapabilityCache> m_capabilityCache;  // 设备能力缓存
+    std::unique_ptr<NegotiationPlan> m_negotiationPlan;  // 最近一次的格式协商结果
+    uint32_t m_requiredPixelFormat;  // 限定的像素格式
+
+    // 读取设备标识并从缓存或驱动获取能力，fd已打开
+    bool probeDevice(int fd, const std::string& devicePath, CameraDeviceInfo& deviceInfo);
 
     // 查询设备支持的格式
-    bool queryDeviceFormats(CameraDeviceInfo& deviceInfo);
+    bool queryDeviceFormats(int fd, CameraDeviceInfo& deviceInfo);
+
+    // 查询指定格式和尺寸支持的帧间隔
+    static std::vector<FrameIntervalRange> queryFrameIntervals(int fd, uint32_t pixelFormat,
+                                                               uint32_t width, uint32_t height);
+
+    // 展开帧尺寸范围：离散类型为其本身，步进/连续类型为端点和范围内的常见分辨率
+    static std::vector<Resolution> expandFrameSizes(const FrameSizeRange& range);
+
+    // 根据格式能力生成分辨率列表
+    static void buildResolutionList(CameraDeviceInfo& deviceInfo);
 };
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <opencv2/opencv.hpp>
+#include <cstdint>
+
+// YUV到RGB颜色转换（BT.601有限范围，与OpenCV的YUV2BGR_YUYV等转换一致）
+// 提供标量参考实现以及SSE4.1/AVX2（x86）和NEON（ARM64）手工向量化实现，运行时自动选择
+namespace ColorConvert {
+    // 输入像素格式
+    enum class SourceFormat {
+        YUYV,  // 4:2:2打包，Y0 U Y1 V
+        UYVY,  // 4:2:2打包，U Y0 V Y1
+        NV12   // 4:2:0半平面，Y平面后跟UV交错平面
+    };
+
+    // 输出像素格式
+    enum class TargetFormat {
+        BGR,
+        RGB,
+        RGBA
+    };
+
+    // 指令集
+    enum class Isa {
+        Scalar,
+        SSE41,
+        AVX2,
+        NEON
+    };
+
+    // 当前CPU是否支持指定指令集
+    bool isIsaSupported(Isa isa);
+
+    // 获取当前使用的指令集（默认选择CPU支持的最快实现）
+    Isa getActiveIsa();
+
+    // 强制使用指定指令集（CPU不支持时返回false），用于基准测试和结果对比
+    bool setActiveIsa(Isa isa);
+
+    // 获取指令集名称
+    const char* getIsaName(Isa isa);
+
+    // 获取格式名称
+    const char* getFormatName(SourceFormat format);
+    const char* getFormatName(TargetFormat format);
+
+    // 转换一帧，width需为偶数；NV12的UV平面紧跟在Y平面之后（src + srcStride * height）
+    bool convert(const uint8_t* src, int srcStride, SourceFormat srcFormat,
+                 uint8_t* dst, int dstStride, TargetFormat dstFormat,
+                 int width, int height);
+
+    // Mat版本：YUYV/UYVY为CV_8UC2，NV12为(height*3/2)行的CV_8UC1
+    // dst尺寸和类型匹配时直接写入已有缓冲区，否则重新分配
+    bool convert(const cv::Mat& src, SourceFormat srcFormat, cv::Mat& dst, TargetFormat dstFormat);
+};
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "camera_device.h"
+#include <string>
+#include <map>
+#include <mutex>
+
+// 设备能力缓存：以总线信息+驱动名称+版本+设备名称+节点路径为键，保存各像素格式的帧尺寸范围和帧间隔
+// 缓存以文本形式持久化，重新扫描时键不变的设备无需再次枚举格式
+class DeviceCapabilityCache {
+public:
+    explicit DeviceCapabilityCache(const std::string& filePath);
+    ~DeviceCapabilityCache();
+
+    // 默认缓存文件路径：~/captureVideo/device_caps.cache
+    static std::string getDefaultPath();
+
+    // 查找设备能力，命中时填充deviceInfo.formats
+    bool lookup(CameraDeviceInfo& deviceInfo);
+
+    // 保存设备能力（只更新内存，调用flush写盘）
+    void store(const CameraDeviceInfo& deviceInfo);
+
+    // 删除指定键的缓存项
+    void invalidate(const std::string& key);
+
+    // 将修改写入磁盘（先写临时文件再重命名，避免写到一半的文件被读取）
+    bool flush();
+
+    // 缓存文件路径
+    const std::string& getFilePath() const { return m_filePath; }
+
+private:
+    std::string m_filePath;  // 缓存文件路径
+    std::map<std::string, std::vector<FormatCapability>> m_entries;  // 键到格式能力的映射
+    bool m_loaded;  // 是否已加载
+    bool m_dirty;  // 是否有未写盘的修改
+    std::mutex m_mutex;  // 保护缓存内容
+
+    // 从磁盘加载（首次访问时调用）
+    void load();
+};
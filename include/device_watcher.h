@@ -0,0 +1,97 @@
+#pragma once
+
+#include "camera_device.h"
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <atomic>
+
+// 设备变化事件类型
+enum class DeviceEventType {
+    Added,    // 新的捕获设备可用
+    Removed   // 设备已移除
+};
+
+// 设备变化事件
+struct DeviceEvent {
+    DeviceEventType type;
+    std::string devicePath;   // 设备路径
+    CameraDeviceInfo info;    // 设备信息（Removed事件为移除前的信息）
+
+    DeviceEvent() : type(DeviceEventType::Added) {}
+};
+
+// 设备监视器：用inotify监听设备目录，只探测新增或移除的video节点，以增量事件通知订阅者
+class DeviceWatcher {
+public:
+    // 探测函数：判断节点是否为可用的捕获设备并填充信息
+    typedef std::function<bool(const std::string& devicePath, CameraDeviceInfo& info)> ProbeFunction;
+
+    DeviceWatcher();
+    ~DeviceWatcher();
+
+    DeviceWatcher(const DeviceWatcher&) = delete;
+    DeviceWatcher& operator=(const DeviceWatcher&) = delete;
+
+    // 开始监视目录（默认/dev），立即返回；已有节点在监视线程中探测，每个设备发出Added事件
+    bool start(const std::string& watchDir = "/dev");
+
+    // 停止监视
+    void stop();
+
+    // 是否正在监视
+    bool isRunning() const { return m_running; }
+
+    // 设置事件回调（在监视线程中执行，需自行转交到其他线程）
+    void setEventCallback(std::function<void(const DeviceEvent&)> callback);
+
+    // 替换探测函数（默认使用CameraDevice::probeDevicePath），需在start之前调用
+    // 用于以临时目录中的假节点代替/dev
+    void setProbeFunction(ProbeFunction probe);
+
+    // 获取当前设备列表快照
+    std::vector<CameraDeviceInfo> getDevices() const;
+
+private:
+    std::string m_watchDir;  // 监视的目录
+    int m_inotifyFd;  // inotify描述符
+    int m_epollFd;  // epoll描述符
+    int m_wakeupFd;  // 用于唤醒监视线程的eventfd
+    std::thread m_thread;  // 监视线程
+    std::atomic<bool> m_running;  // 是否正在监视
+
+    mutable std::mutex m_mutex;  // 保护设备表和回调
+    std::map<std::string, CameraDeviceInfo> m_devices;  // 已知设备
+    std::set<std::string> m_pending;  // 已出现但尚未探测成功的节点（等待udev设置权限）
+    std::function<void(const DeviceEvent&)> m_callback;  // 事件回调
+    ProbeFunction m_probe;  // 探测函数
+    CameraDevice m_prober;  // 默认探测使用的设备对象（带能力缓存）
+
+    // 监视线程函数
+    void watchThreadFunc();
+
+    // 处理inotify事件
+    void handleInotifyEvents();
+
+    // 与目录内容对账：探测新节点，移除已消失的节点（启动和inotify队列溢出时使用）
+    void resync();
+
+    // 探测节点，成功则加入设备表并发出Added事件
+    void probeNode(const std::string& devicePath);
+
+    // 移除节点，已知设备发出Removed事件
+    void removeNode(const std::string& devicePath);
+
+    // 发出事件
+    void emitEvent(const DeviceEvent& event);
+
+    // 关闭所有描述符
+    void closeFds();
+
+    // 是否为video节点名
+    static bool isVideoNode(const std::string& name);
+};
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+
+// 分段录制参数
+struct SegmentSettings {
+    int segmentSeconds;        // 每段时长（秒），0表示不按时长分段
+    uint64_t segmentMaxBytes;  // 每段最大字节数，0表示不按大小分段
+    bool fragmented;           // mp4按关键帧分片写入：写入中的文件可读，异常退出只丢失最后一个分片
+
+    SegmentSettings() : segmentSeconds(0), segmentMaxBytes(0), fragmented(true) {}
+
+    // 是否启用分段
+    bool isEnabled() const { return segmentSeconds > 0 || segmentMaxBytes > 0; }
+};
+
+// 编码参数（进程内libav编码使用）
+struct EncoderSettings {
+    std::string codec;       // 编码器名称，如libx264
+    std::string preset;      // x264预设：ultrafast/superfast/veryfast/faster/fast/medium
+    std::string tune;        // x264调优：zerolatency/film等，空表示不设置
+    int bitrateKbps;         // 目标码率（kbps），0表示使用crf
+    int crf;                 // 恒定质量（bitrateKbps为0时有效）
+    int threads;             // 编码线程数，0表示自动
+    int gopSize;             // 关键帧间隔（帧），0表示按帧率取2秒
+    std::string container;   // 封装格式：mp4、mkv或avi
+    bool passthrough;        // 直通录制：直接封装设备输出的MJPEG帧，不解码也不重新编码（mp4改用mkv）
+    SegmentSettings segment; // 分段录制参数
+
+    EncoderSettings()
+        : codec("libx264"),
+          preset("ultrafast"),
+          tune("zerolatency"),
+          bitrateKbps(2000),
+          crf(23),
+          threads(0),
+          gopSize(0),
+          container("mp4"),
+          passthrough(false) {}
+
+    // 输出文件扩展名（带点）
+    std::string getFileExtension() const {
+        if (container == "avi") {
+            return ".avi";
+        }
+        if (container == "mkv" || passthrough) {
+            return ".mkv";
+        }
+        return ".mp4";
+    }
+};
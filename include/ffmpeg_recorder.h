@@ -1,13 +1,22 @@
 #pragma once
 
 #include "camera_device.h"
+#include "video_recorder.h"
+#include "frame_pool.h"
+#include "encoder_settings.h"
 #include <string>
+#include <vector>
+#include <deque>
 #include <thread>
 #include <atomic>
 #include <mutex>
+#include <condition_variable>
 #include <chrono>
+#include <sys/types.h>
+#include <sys/uio.h>
 
-// FFmpeg录制类
+// FFmpeg录制类：ffmpeg运行在独立进程中，崩溃不影响采集
+// 设备模式由ffmpeg自己打开设备；管道模式由采集管线通过标准输入提供帧，不再重复打开设备
 class FFmpegRecorder {
 public:
     FFmpegRecorder();
@@ -16,43 +25,114 @@ public:
     // 初始化录制器
     bool init(const std::string& outputDir);
 
-    // 开始录制
+    // 开始录制（设备模式）
     bool startRecording(const std::string& devicePath, const Resolution& resolution, int framerate, int durationSeconds = 0);
 
-    // 停止录制
+    // 开始录制（管道模式），帧通过processFrame提供
+    // inputPixelFormat为0时输入BGR原始帧，为V4L2_PIX_FMT_MJPEG时输入JPEG压缩帧
+    // streamCopy只用于MJPEG输入：不解码不重新编码，直接封装为mkv
+    bool startPipeRecording(const Resolution& resolution, const FrameRate& framerate, uint32_t inputPixelFormat = 0,
+                            bool streamCopy = false);
+
+    // 停止录制；管道模式先关闭管道让ffmpeg写完文件尾
     void stopRecording();
 
+    // 通知即将停止，不阻塞：管道写满时写入线程最多再等待一段时间，ffmpeg仍不读取则放弃剩余的帧
+    // 取消帧总线订阅（等待订阅线程）之前调用，ffmpeg卡住时订阅线程不会一直阻塞在管道上
+    void requestStop();
+
+    // 管道模式下写入一帧，ffmpeg读取较慢时阻塞调用者（应在帧总线的订阅线程中调用）
+    void processFrame(const FrameRef& frame);
+
+    // 设置采集像素格式（V4L2 fourcc），应与格式协商结果一致；0表示由FFmpeg自行选择
+    void setInputPixelFormat(uint32_t pixelFormat) { m_inputPixelFormat = pixelFormat; }
+
+    // 设置分段录制参数（下次开始录制时生效），ffmpeg只支持按时长分段
+    void setSegmentSettings(const SegmentSettings& segment) { m_segment = segment; }
+
     // 是否正在录制
     bool isRecording() const { return m_isRecording; }
 
-    // 获取当前录制文件路径
-    std::string getCurrentFilePath() const { return m_currentFilePath; }
+    // 获取当前录制文件路径（按时长分段时为本次录制最新的分段文件，还没有分段文件时为输出目录）
+    std::string getCurrentFilePath() const;
 
     // 获取录制时长（秒）
     double getRecordingDuration() const;
 
+    // 获取管道模式统计（queueDepth为仍在管道中未被ffmpeg读取的帧数）
+    RecorderStats getStats() const;
+
 private:
     std::string m_outputDir;  // 输出目录
-    std::string m_currentFilePath;  // 当前录制文件路径
+    std::string m_currentFilePath;  // 当前录制文件路径（按时长分段时为交给ffmpeg的文件名模板）
+    std::string m_segmentStartTime;  // 按时长分段时录制开始的日期时间，用于找出本次录制的分段；不分段时为空
 
     std::atomic<bool> m_isRecording;  // 是否正在录制
     std::chrono::time_point<std::chrono::steady_clock> m_startTime;  // 开始录制时间
 
-    std::thread m_recordingThread;  // 录制线程
-    int m_ffmpegPid;  // FFmpeg进程ID
-
-    // 录制线程函数
-    void recordingThreadFunc(const std::string& devicePath, const Resolution& resolution, int framerate, int durationSeconds);
+    std::thread m_recordingThread;  // 等待FFmpeg进程退出的线程
+    mutable std::mutex m_processMutex;  // 保护进程ID和pidfd
+    std::condition_variable m_processExited;  // 等待线程回收进程后通知
+    pid_t m_ffmpegPid;  // FFmpeg进程ID
+    int m_pidfd;  // FFmpeg进程的pidfd（内核不支持时为-1）
+    uint32_t m_inputPixelFormat;  // 采集像素格式
+    bool m_pipeMode;  // 当前录制是否为管道模式
+    SegmentSettings m_segment;  // 分段录制参数
+
+    // 管道模式
+    struct InFlightFrame {
+        FrameRef frame;      // 管道仍引用该帧的内存，ffmpeg读完前不能归还帧池
+        uint64_t endOffset;  // 该帧在管道字节流中的结束位置
+    };
+
+    std::mutex m_pipeMutex;  // 保护管道写端和在途帧
+    int m_pipeFd;  // 管道写端（ffmpeg的标准输入），非阻塞，写满时与m_stopFd一起等待
+    int m_stopFd;  // 停止通知的eventfd（构造时创建，析构时关闭）
+    uint32_t m_pipePixelFormat;  // 管道输入格式
+    Resolution m_pipeResolution;  // 管道输入分辨率
+    bool m_useVmsplice;  // 是否用vmsplice把帧内存直接挂入管道
+    uint64_t m_bytesWritten;  // 已写入管道的字节数
+    std::deque<InFlightFrame> m_inFlight;  // 仍在管道中的帧
+
+    std::atomic<uint64_t> m_framesQueued;  // 写入管道的帧数
+    std::atomic<uint64_t> m_framesConsumed;  // 已被ffmpeg读取的帧数
+    std::atomic<uint64_t> m_framesDropped;  // 格式不符或写入失败丢弃的帧数
+    std::atomic<size_t> m_inFlightCount;  // 当前在途帧数（供统计读取，不需要持有管道锁）
+    std::atomic<size_t> m_maxInFlight;  // 峰值在途帧数
+    std::atomic<int64_t> m_lastWriteUs;  // 最近一帧写入耗时（含管道满时的等待）
+    std::atomic<int64_t> m_maxWriteUs;  // 最大写入耗时
+
+    // 等待进程退出的线程函数
+    void waitThreadFunc();
 
     // 生成文件名（包含日期时间、分辨率和帧率）
-    std::string generateFileName(const Resolution& resolution, int framerate);
+    std::string generateFileName(const Resolution& resolution, int framerate, const std::string& extension = ".mp4");
+
+    // 构建设备模式的FFmpeg参数
+    std::vector<std::string> buildFFmpegArgs(const std::string& devicePath, const Resolution& resolution, int framerate, const std::string& outputPath, int durationSeconds = 0);
+
+    // 构建管道模式的FFmpeg参数
+    std::vector<std::string> buildPipeArgs(const Resolution& resolution, const FrameRate& framerate, uint32_t inputPixelFormat,
+                                           bool streamCopy, const std::string& outputPath);
+
+    // 添加编码和输出参数
+    void appendOutputArgs(std::vector<std::string>& args, int framerate, const std::string& outputPath);
+
+    // 添加封装参数（分段、分片MP4）和输出文件
+    void appendMuxerArgs(std::vector<std::string>& args, const std::string& outputPath);
+
+    // 用posix_spawn启动FFmpeg，stdinFd为-1时标准输入重定向到/dev/null
+    bool spawnFFmpeg(const std::vector<std::string>& args, int stdinFd);
+
+    // 向FFmpeg进程发送信号（优先通过pidfd，避免进程号被复用）
+    void signalFFmpegProcess(int signal);
 
-    // 构建FFmpeg命令
-    std::string buildFFmpegCommand(const std::string& devicePath, const Resolution& resolution, int framerate, const std::string& outputPath, int durationSeconds = 0);
+    // 把iovec描述的数据全部写入管道；已通知停止且ffmpeg超时仍不读取时返回false，bytesWritten为已写入（挂入）管道的字节数
+    bool writeToPipe(std::vector<struct iovec>& iov, size_t& bytesWritten);
 
-    // 执行系统命令
-    int executeCommand(const std::string& command);
+    // 释放ffmpeg已读取的在途帧
+    void releaseConsumedFrames();
 
-    // 终止FFmpeg进程
-    void terminateFFmpegProcess();
+    // 关闭管道写端，ffmpeg读到EOF后结束录制
+    void closePipe();
 };
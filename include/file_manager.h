@@ -15,6 +15,11 @@ struct VideoFileInfo {
     int framerate;             // 帧率
     size_t fileSize;           // 文件大小（字节）
     double duration;           // 视频时长（秒）
+    int segmentIndex;          // 同一秒内切换分段时的序号（文件名中的.N），没有时为0
+    std::string rendition;     // 副本名称（如proxy），主文件为空
+    std::vector<std::string> renditionFiles;  // 同一次录制的副本文件（只在主文件上填写）
+
+    VideoFileInfo() : framerate(0), fileSize(0), duration(0.0), segmentIndex(0) {}
 };
 
 // 文件管理类
@@ -26,7 +31,7 @@ public:
     // 初始化文件管理器
     bool init(const std::string& baseDir);
     
-    // 获取视频文件列表
+    // 获取视频文件列表，同一次录制的副本文件归入主文件的renditionFiles，没有主文件的副本单独列出
     std::vector<VideoFileInfo> getVideoFileList();
     
     // 删除视频文件
@@ -38,9 +43,12 @@ public:
     // 获取基础目录
     std::string getBaseDir() const { return m_baseDir; }
     
-    // 解析文件名（从文件名中提取日期时间、分辨率和帧率）
+    // 解析文件名（从文件名中提取日期时间、分辨率、帧率、分段序号和副本名称）
     static VideoFileInfo parseFileName(const fs::path& filePath);
 
+    // 两个文件是否为同一次录制的不同副本（帧率和分段序号相同，开始时间相差不超过toleranceSeconds秒）
+    static bool isSameRecording(const VideoFileInfo& a, const VideoFileInfo& b, int toleranceSeconds = 2);
+
 private:
     std::string m_baseDir;  // 基础目录
 };
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "camera_device.h"
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// 单个候选格式的评估结果
+struct FormatCandidate {
+    uint32_t pixelFormat;     // V4L2像素格式
+    FrameRate framerate;      // 该格式在请求分辨率下能达到的帧率
+    double busLoad;           // 占用总线带宽比例（0表示带宽未知或不受限）
+    double cpuLoad;           // 解码和颜色转换预计占用的CPU核心数
+    double cost;              // 综合代价，越小越好
+    bool feasible;            // 是否满足请求的分辨率和帧率
+    std::string reason;       // 评估说明
+
+    FormatCandidate()
+        : pixelFormat(0), busLoad(0.0), cpuLoad(0.0), cost(0.0), feasible(false) {}
+};
+
+// 格式协商结果
+struct NegotiationPlan {
+    bool valid;               // 是否得到可用格式
+    uint32_t pixelFormat;     // 选中的V4L2像素格式
+    Resolution resolution;    // 请求的分辨率
+    FrameRate framerate;      // 采用的帧率（无法满足请求时降为该格式能达到的最高帧率）
+    std::string reason;       // 选择原因
+    std::vector<FormatCandidate> candidates;  // 所有候选的评估，按代价排序
+
+    NegotiationPlan() : valid(false), pixelFormat(0), resolution(0, 0) {}
+};
+
+// 格式协商器：根据总线带宽、解码和颜色转换代价，为请求的分辨率和帧率选择代价最低且能满足要求的像素格式
+class FormatNegotiator {
+public:
+    FormatNegotiator();
+
+    // 制定协商计划，只使用设备能力表，不访问设备
+    NegotiationPlan plan(const CameraDeviceInfo& device, const Resolution& resolution,
+                         const FrameRate& framerate) const;
+
+    // 覆盖总线可用带宽（字节/秒），0表示按设备总线速度自动估算
+    void setBusBandwidth(double bytesPerSecond) { m_busBandwidthOverride = bytesPerSecond; }
+
+    // 设置可用于解码和颜色转换的CPU核心数（默认1，采集线程是单线程）
+    void setCpuBudget(double cores) { m_cpuBudget = cores; }
+
+    // 限定只能选择某种像素格式（如直通录制要求MJPEG），0表示不限定
+    void setRequiredFormat(uint32_t pixelFormat) { m_requiredFormat = pixelFormat; }
+
+    // 从sysfs读取设备所在USB总线的速度（Mbps），非USB设备返回0
+    static int detectUsbSpeed(const std::string& devicePath);
+
+    // 按USB速度估算等时传输可用带宽（字节/秒），0表示不受限
+    static double estimateBusBandwidth(int usbSpeedMbps);
+
+    // 采集路径是否能处理该格式
+    static bool isFormatSupported(uint32_t pixelFormat);
+
+    // 对应的FFmpeg v4l2 -input_format名称，不支持时返回空字符串
+    static std::string getFFmpegInputFormat(uint32_t pixelFormat);
+
+    // 对应的GStreamer video/x-raw format名称（MJPEG不是原始格式），不支持时返回空字符串
+    static std::string getGStreamerFormat(uint32_t pixelFormat);
+
+    // fourcc转字符串，如"YUYV"
+    static std::string fourccToString(uint32_t pixelFormat);
+
+private:
+    double m_busBandwidthOverride;  // 手动指定的总线带宽
+    double m_cpuBudget;  // CPU预算（核心数）
+    uint32_t m_requiredFormat;  // 限定的像素格式
+
+    // 评估单个格式
+    FormatCandidate evaluate(const FormatCapability& format, const Resolution& resolution,
+                             const FrameRate& framerate, double busBandwidth) const;
+};
@@ -0,0 +1,147 @@
+#pragma once
+
+#include "output_sink.h"
+#include <opencv2/opencv.hpp>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <functional>
+#include <cstdint>
+
+// 帧归档中每帧数据的编码
+enum class FrameArchiveCodec : uint32_t {
+    Jpeg = 0,  // JPEG，解包时原样写出为.jpg，不重新编码
+    Lz4 = 1,   // BGR像素LZ4压缩，无损（需要liblz4）
+    Raw = 2    // BGR像素不压缩
+};
+
+// 帧归档文件格式（小端），只追加写入：
+//   [0, 16)              文件头FrameArchiveHeader
+//   [16, indexOffset)    各帧数据，按编码完成的顺序紧密排列，最后补零使indexOffset为8的倍数
+//   [indexOffset, ...)   帧索引，frameCount个定长的FrameArchiveEntry，按帧号升序，第i项即归档中的第i帧
+//   最后48字节            文件尾FrameArchiveFooter
+// 索引和文件尾在完成时写入；异常退出时没有文件尾，帧数据仍在文件中但不能打开
+struct FrameArchiveHeader {
+    char magic[8];     // "VCFARC\0\0"
+    uint32_t version;  // 格式版本
+    uint32_t codec;    // FrameArchiveCodec
+};
+
+// 帧索引项
+struct FrameArchiveEntry {
+    uint64_t offset;       // 帧数据在文件中的偏移
+    uint32_t size;         // 帧数据长度
+    uint32_t frameNumber;  // 原视频中的帧号（解包时的文件名）
+    int64_t timestampUs;   // 相对视频第一帧的时间（微秒）
+    uint32_t rawSize;      // 解压后的长度（Lz4、Raw为BGR像素字节数，Jpeg为0）
+    uint32_t reserved;
+};
+
+// 文件尾
+struct FrameArchiveFooter {
+    char magic[8];         // "VCFIDX\0\0"
+    uint32_t version;      // 格式版本
+    uint32_t entrySize;    // 每个索引项的大小
+    uint32_t width;        // 帧宽度
+    uint32_t height;       // 帧高度
+    uint32_t type;         // OpenCV像素类型（CV_8UC1、CV_8UC3或CV_8UC4）
+    uint32_t codec;        // FrameArchiveCodec（与文件头相同）
+    uint64_t frameCount;   // 帧数
+    uint64_t indexOffset;  // 帧索引的偏移
+};
+
+// 帧归档写入：把分帧结果写进一个文件，代替成千上万个单独的JPEG文件
+// addFrame可以在多个线程中同时调用：编码在调用线程中并行进行，只有追加写入加锁；写入经OutputSink异步落盘
+class FrameArchiveWriter {
+public:
+    FrameArchiveWriter();
+    ~FrameArchiveWriter();
+
+    // 编译时是否支持该编码
+    static bool isCodecAvailable(FrameArchiveCodec codec);
+
+    // 创建归档文件并写入文件头
+    bool open(const std::string& filePath, FrameArchiveCodec codec, int jpegQuality = 95);
+
+    // 编码并追加一帧（BGR图像，所有帧尺寸相同）；写入失败时返回false
+    bool addFrame(int frameNumber, int64_t timestampUs, const cv::Mat& frame);
+
+    // 按帧号排序写入索引和文件尾并关闭文件，等待落盘
+    bool finish();
+
+    // 是否已打开
+    bool isOpen() const { return m_open; }
+
+    // 已追加的帧数
+    size_t getFrameCount() const;
+
+    // 归档文件路径
+    const std::string& getFilePath() const { return m_filePath; }
+
+private:
+    std::string m_filePath;
+    FrameArchiveCodec m_codec;
+    int m_jpegQuality;
+    bool m_open;
+    bool m_failed;  // 有写入失败或帧尺寸不一致
+    int m_width;
+    int m_height;
+    int m_type;
+
+    OutputSink m_sink;
+    mutable std::mutex m_mutex;  // 保护写入位置、索引和m_sink
+    std::vector<FrameArchiveEntry> m_entries;
+
+    // 编码一帧（不加锁）
+    bool encode(const cv::Mat& frame, std::vector<uint8_t>& payload, uint32_t& rawSize) const;
+};
+
+// 帧归档读取：mmap整个文件，按下标O(1)取得任意一帧
+class FrameArchiveReader {
+public:
+    FrameArchiveReader();
+    ~FrameArchiveReader();
+
+    FrameArchiveReader(const FrameArchiveReader&) = delete;
+    FrameArchiveReader& operator=(const FrameArchiveReader&) = delete;
+
+    // 打开并校验归档
+    bool open(const std::string& filePath);
+
+    // 解除映射
+    void close();
+
+    bool isOpen() const { return m_data != nullptr; }
+
+    // 帧数
+    size_t getFrameCount() const { return m_frameCount; }
+
+    int getWidth() const { return m_width; }
+    int getHeight() const { return m_height; }
+    FrameArchiveCodec getCodec() const { return m_codec; }
+
+    // 第i帧（按帧号升序）的索引项
+    const FrameArchiveEntry& getEntry(size_t i) const { return m_entries[i]; }
+
+    // 第i帧的编码数据（指向映射的内存，归档关闭前有效）
+    const uint8_t* getPayload(size_t i, size_t& size) const;
+
+    // 解码第i帧为BGR图像
+    bool readFrame(size_t i, cv::Mat& frame) const;
+
+    // 帧号对应的下标，归档中没有该帧时返回-1
+    int findFrame(int frameNumber) const;
+
+    // 解包到目录，每帧一个frame_%06d.jpg（与直接分帧的目录结构相同）；Jpeg归档直接写出数据，不重新编码
+    bool unpack(const std::string& outputDir, const std::function<void(float)>& progressCallback = nullptr) const;
+
+private:
+    uint8_t* m_data;
+    size_t m_size;
+    const FrameArchiveEntry* m_entries;
+    size_t m_frameCount;
+    int m_width;
+    int m_height;
+    int m_type;
+    FrameArchiveCodec m_codec;
+};
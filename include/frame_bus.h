@@ -0,0 +1,94 @@
+#pragma once
+
+#include "frame_pool.h"
+#include "bounded_queue.h"
+#include <string>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+
+// 订阅者统计
+struct SubscriberStats {
+    int id;                 // 订阅ID
+    std::string name;       // 订阅者名称
+    QueuePolicy policy;     // 队列策略
+    uint64_t delivered;     // 已交付帧数
+    uint64_t dropped;       // 丢弃帧数
+    size_t queueDepth;      // 当前队列深度
+    size_t maxQueueDepth;   // 峰值队列深度
+    double lastLagMs;       // 最近一帧从发布到开始处理的延迟（毫秒）
+    double maxLagMs;        // 最大延迟（毫秒）
+
+    SubscriberStats()
+        : id(-1), policy(QueuePolicy::DropOldest), delivered(0), dropped(0),
+          queueDepth(0), maxQueueDepth(0), lastLagMs(0.0), maxLagMs(0.0) {}
+};
+
+// 帧分发总线：每个订阅者有独立的线程和有界队列，慢消费者不会拖慢发布者
+class FrameBus {
+public:
+    FrameBus();
+    ~FrameBus();
+
+    FrameBus(const FrameBus&) = delete;
+    FrameBus& operator=(const FrameBus&) = delete;
+
+    // 添加订阅者，返回订阅ID；回调在订阅者自己的线程中执行
+    int subscribe(const std::string& name,
+                  std::function<void(const FrameRef&)> callback,
+                  QueuePolicy policy = QueuePolicy::DropOldest,
+                  size_t queueDepth = 4);
+
+    // 移除订阅者，等待其处理完已入队的帧
+    void unsubscribe(int id);
+
+    // 移除所有订阅者
+    void clear();
+
+    // 发布一帧给所有订阅者（Block策略的订阅者队列满时会阻塞发布者）
+    void publish(const FrameRef& frame);
+
+    // 是否有订阅者
+    bool hasSubscribers() const;
+
+    // 获取所有订阅者的统计
+    std::vector<SubscriberStats> getStats() const;
+
+private:
+    // 队列中的帧
+    struct QueuedFrame {
+        FrameRef frame;
+        std::chrono::steady_clock::time_point publishTime;
+    };
+
+    // 订阅者
+    struct Subscriber {
+        int id;
+        std::string name;
+        std::function<void(const FrameRef&)> callback;
+        BoundedQueue<QueuedFrame> queue;
+        std::thread thread;
+        std::atomic<uint64_t> delivered;
+        std::atomic<int64_t> lastLagUs;
+        std::atomic<int64_t> maxLagUs;
+
+        Subscriber(size_t depth, QueuePolicy policy)
+            : id(-1), queue(depth, policy), delivered(0), lastLagUs(0), maxLagUs(0) {}
+    };
+
+    typedef std::vector<std::shared_ptr<Subscriber>> SubscriberList;
+
+    mutable std::mutex m_mutex;  // 保护订阅者列表的替换
+    std::shared_ptr<const SubscriberList> m_subscribers;  // 订阅者列表（写时复制，发布时无需持锁遍历）
+    int m_nextId;  // 下一个订阅ID
+
+    // 订阅者线程函数
+    static void subscriberThreadFunc(Subscriber* subscriber);
+
+    // 停止订阅者线程
+    static void stopSubscriber(const std::shared_ptr<Subscriber>& subscriber);
+};
@@ -1,52 +1,194 @@
 #pragma once
 
+#include "bounded_queue.h"
+#include "gop_decoder.h"
+#include "frame_archive.h"
+#include <opencv2/opencv.hpp>
 #include <string>
 #include <functional>
 #include <thread>
 #include <atomic>
+#include <mutex>
+#include <vector>
+#include <chrono>
+
+// 分帧的解码方式
+enum class ExtractionDecodeMode {
+    Serial,      // 一个解码器从头顺序解码（有libav时与GopParallel共用解码和颜色转换，否则用cv::VideoCapture）
+    GopParallel  // 扫描关键帧后按GOP切分，多个解码器并行解码（需要libav，无法切分时退回顺序解码）
+};
+
+// 分帧的输出方式
+enum class ExtractionOutput {
+    Directory,  // 与视频同名的目录，每帧一个frame_%06d.jpg
+    Archive     // 与视频同名的.frames帧归档，一个文件（见FrameArchiveWriter），可用unpackArchive解包为目录
+};
+
+// 分帧的取帧方式
+enum class ExtractionSampling {
+    All,       // 每一帧
+    Stride,    // 每N帧取一帧
+    Interval,  // 每隔固定时间取一帧
+    Keyframes  // 只取关键帧（需要libav）
+};
+
+// 取哪些帧：取帧方式加时间范围，时间相对视频第一帧
+// 不是取全部帧时通过容器定位跳到所需帧所在的GOP，不含所需帧的GOP不解码（需要libav，否则退回顺序读帧后筛选）
+struct ExtractionSelection {
+    ExtractionSampling sampling;
+    int stride;              // Stride时每几帧取一帧
+    double intervalSeconds;  // Interval时的间隔（秒）
+    double startSeconds;     // 范围起点（秒）
+    double endSeconds;       // 范围终点（秒，包含），小于0为到结尾
+
+    ExtractionSelection()
+        : sampling(ExtractionSampling::All), stride(1), intervalSeconds(1.0), startSeconds(0.0), endSeconds(-1.0) {}
+
+    // 是否取整个视频的每一帧
+    bool isFull() const {
+        return sampling == ExtractionSampling::All && startSeconds <= 0.0 && endSeconds < 0.0;
+    }
+};
+
+// 分帧统计
+struct ExtractionStats {
+    bool gopParallel;       // 实际是否按GOP并行解码
+    int decoders;           // 解码线程数
+    int workers;            // 编码写入线程数
+    int framesDecoded;      // 已解码的帧数
+    int framesWritten;      // 已写入的帧数
+    int framesFailed;       // 编码或写入失败的帧数
+    double elapsedSeconds;  // 从开始到现在（或到结束）的时间
+    double framesPerSecond; // 写入速度
+
+    ExtractionStats()
+        : gopParallel(false), decoders(0), workers(0), framesDecoded(0), framesWritten(0), framesFailed(0),
+          elapsedSeconds(0.0), framesPerSecond(0.0) {}
+};
 
 // 视频分帧类
+// 一个解码线程按顺序读帧并编号，经有界队列交给多个编码写入线程做JPEG编码和写文件
+// 帧号在解码时确定，输出文件名与单线程分帧相同（frame_%06d.jpg），写入顺序不影响结果
+// 按GOP并行解码时解码线程也有多个，各自解码一段以关键帧开始的区间，帧号由GopDecoder按显示时间戳确定
+// 只取部分帧（每N帧、每隔几秒、只取关键帧、时间范围）时借助GopDecoder的关键帧索引定位，跳过的GOP不解码
+// 输出为帧归档时编码写入线程把编码后的帧追加到同一个文件，不再为每帧创建文件
 class FrameExtractor {
 public:
     FrameExtractor();
     ~FrameExtractor();
 
-    // 开始分帧
+    // 开始分帧（在后台线程中进行，立即返回）
     bool startExtraction(const std::string& videoFilePath);
 
-    // 停止分帧
+    // 停止分帧：解码线程不再读帧，队列中尚未编码的帧被丢弃，等待所有线程结束
     void stopExtraction();
 
+    // 等待分帧结束
+    void waitForCompletion();
+
     // 是否正在分帧
     bool isExtracting() const { return m_isExtracting; }
 
-    // 获取进度（0.0-1.0）
+    // 获取进度（0.0-1.0），按已写入的帧数计算
     float getProgress() const { return m_progress; }
 
-    // 设置进度回调
+    // 设置编码写入线程数，0为使用CPU核心数；下次开始分帧时生效
+    void setWorkerCount(int count);
+
+    // 获取下次分帧使用的编码写入线程数
+    int getWorkerCount() const;
+
+    // 设置解码方式；下次开始分帧时生效
+    void setDecodeMode(ExtractionDecodeMode mode) { m_decodeMode = mode; }
+
+    // 获取解码方式
+    ExtractionDecodeMode getDecodeMode() const { return m_decodeMode; }
+
+    // 设置按GOP并行解码时的解码线程数，0为CPU核心数的一半
+    void setDecoderCount(int count);
+
+    // 获取下次分帧使用的解码线程数
+    int getDecoderCount() const;
+
+    // 设置取哪些帧；下次开始分帧时生效。输出文件仍按原视频中的帧号命名
+    void setSelection(const ExtractionSelection& selection) { m_selection = selection; }
+
+    // 获取取帧设置
+    const ExtractionSelection& getSelection() const { return m_selection; }
+
+    // 设置输出方式和归档编码；下次开始分帧时生效
+    void setOutput(ExtractionOutput output, FrameArchiveCodec codec = FrameArchiveCodec::Jpeg);
+
+    // 获取输出方式
+    ExtractionOutput getOutput() const { return m_output; }
+
+    // 获取归档编码
+    FrameArchiveCodec getArchiveCodec() const { return m_archiveCodec; }
+
+    // 把帧归档解包为直接分帧的目录结构；outputDir为空时解包到归档旁边与其同名的目录
+    static bool unpackArchive(const std::string& archivePath, const std::string& outputDir = "",
+                              std::function<void(float)> progressCallback = nullptr);
+
+    // 获取统计
+    ExtractionStats getStats() const;
+
+    // 设置进度回调（在编码写入线程中调用，调用之间互斥）
     void setProgressCallback(std::function<void(float)> callback);
 
     // 设置完成回调
     void setCompletionCallback(std::function<void(const std::string&)> callback);
 
 private:
+    // 解码线程交给编码写入线程的一帧
+    struct FrameTask {
+        int index;            // 帧号
+        int64_t timestampUs;  // 相对第一帧的时间（微秒）
+        cv::Mat frame;        // 解码后的BGR图像
+    };
+
     std::string m_videoFilePath;  // 视频文件路径
-    std::string m_outputDir;      // 输出目录
+    std::string m_outputDir;      // 输出目录（输出为归档时是归档文件路径）
 
     std::atomic<bool> m_isExtracting;  // 是否正在分帧
     std::atomic<float> m_progress;     // 进度
 
-    std::thread m_extractionThread;  // 分帧线程
+    std::thread m_extractionThread;  // 解码线程
+    std::vector<std::thread> m_workers;  // 编码写入线程
+    int m_workerCount;  // 设置的线程数，0为CPU核心数
+    ExtractionDecodeMode m_decodeMode;
+    int m_decoderCount;  // 设置的解码线程数，0为CPU核心数的一半
+    ExtractionSelection m_selection;
+    ExtractionOutput m_output;
+    FrameArchiveCodec m_archiveCodec;
+    FrameArchiveWriter m_archive;  // 输出为归档时使用，编码写入线程共用
+
+    std::atomic<int> m_frameCount;      // 视频总帧数（容器给出的估计值）
+    std::atomic<int> m_framesDecoded;
+    std::atomic<int> m_framesWritten;
+    std::atomic<int> m_framesFailed;
+    std::atomic<int> m_activeWorkers;   // 本次分帧实际使用的线程数
+    std::atomic<int> m_activeDecoders;  // 本次分帧实际使用的解码线程数
+    std::atomic<bool> m_gopParallel;    // 本次分帧是否按GOP并行解码
+    std::chrono::steady_clock::time_point m_startTime;
+    std::chrono::steady_clock::time_point m_endTime;
+    std::atomic<bool> m_finished;  // m_endTime有效
 
+    std::mutex m_callbackMutex;  // 串行化进度回调
     std::function<void(float)> m_progressCallback;  // 进度回调
     std::function<void(const std::string&)> m_completionCallback;  // 完成回调
 
-    // 分帧线程函数（保留但不再使用）
+    // 解码线程函数
     void extractionThreadFunc();
 
-    // 创建输出目录
-    bool createOutputDir();
+    // 没有libav或无法扫描关键帧时用cv::VideoCapture顺序解码，按取帧设置筛选后交给编码写入线程；无法打开视频或不支持该取帧方式时返回false
+    bool decodeSerial(BoundedQueue<FrameTask>& queue);
+
+    // 按GOP区间解码（取全部帧时切分整个视频，顺序解码时整段一个区间，否则只取含所需帧的GOP），多个线程各取一组区间，帧交给编码写入线程
+    void decodeGop(const GopDecoder& decoder, BoundedQueue<FrameTask>& queue);
 
-    // 同步分帧方法
-    void extractFrames();
+    // 编码写入线程函数
+    void workerThreadFunc(BoundedQueue<FrameTask>* queue);
+
+    // 创建输出目录或归档文件
+    bool createOutputDir();
 };
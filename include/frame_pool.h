@@ -0,0 +1,124 @@
+#pragma once
+
+#include <opencv2/opencv.hpp>
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+
+// 帧元数据
+struct FrameInfo {
+    int width;             // 宽度
+    int height;            // 高度
+    int type;              // OpenCV像素类型，如CV_8UC3
+    size_t step;           // 行跨度（字节），压缩帧为0
+    size_t bytesUsed;      // 有效数据长度（压缩帧等非图像数据使用）
+    uint32_t pixelFormat;  // V4L2像素格式（0表示BGR图像）
+    int64_t timestampUs;   // 采集时间戳（微秒）
+    uint64_t sequence;     // 帧序号
+
+    FrameInfo()
+        : width(0), height(0), type(0), step(0), bytesUsed(0),
+          pixelFormat(0), timestampUs(0), sequence(0) {}
+};
+
+// 帧池统计
+struct FramePoolStats {
+    size_t slotCount;    // 缓冲区总数
+    size_t slotSize;     // 每个缓冲区大小（字节）
+    size_t inUse;        // 当前被引用的缓冲区数
+    size_t peakInUse;    // 峰值引用数
+    uint64_t acquired;   // 累计分配次数
+    uint64_t exhausted;  // 池耗尽（分配失败）次数
+
+    FramePoolStats() : slotCount(0), slotSize(0), inUse(0), peakInUse(0), acquired(0), exhausted(0) {}
+};
+
+struct FramePoolCore;
+
+// 帧池中的一个缓冲区
+struct FrameSlot {
+    uint8_t* data;                // 对齐的数据指针
+    size_t capacity;              // 容量（字节）
+    std::atomic<int> refCount;    // 引用计数
+    FrameInfo info;               // 帧元数据
+    FramePoolCore* core;          // 所属的池
+    int index;                    // 在池中的索引
+
+    FrameSlot() : data(nullptr), capacity(0), refCount(0), core(nullptr), index(-1) {}
+};
+
+// 帧缓冲区句柄，拷贝只增加引用计数，最后一个句柄释放时缓冲区归还帧池
+class FrameRef {
+public:
+    FrameRef() : m_slot(nullptr) {}
+    ~FrameRef() { reset(); }
+
+    FrameRef(const FrameRef& other);
+    FrameRef(FrameRef&& other) noexcept;
+    FrameRef& operator=(const FrameRef& other);
+    FrameRef& operator=(FrameRef&& other) noexcept;
+
+    // 是否为空句柄
+    bool empty() const { return m_slot == nullptr; }
+    explicit operator bool() const { return m_slot != nullptr; }
+
+    // 释放引用
+    void reset();
+
+    // 缓冲区数据
+    uint8_t* data() const { return m_slot ? m_slot->data : nullptr; }
+
+    // 缓冲区容量
+    size_t capacity() const { return m_slot ? m_slot->capacity : 0; }
+
+    // 帧元数据
+    const FrameInfo& info() const;
+
+    // 设置帧元数据（仅生产者在发布前调用）
+    void setInfo(const FrameInfo& info);
+
+    // 构造引用该缓冲区的Mat头（不拷贝，句柄存活期间有效），压缩帧为1行bytesUsed列的字节数组
+    cv::Mat mat() const;
+
+    // 当前引用计数
+    int useCount() const { return m_slot ? m_slot->refCount.load() : 0; }
+
+private:
+    friend class FramePool;
+
+    explicit FrameRef(FrameSlot* slot) : m_slot(slot) {}
+
+    FrameSlot* m_slot;  // 引用的缓冲区
+};
+
+// 固定大小的预分配对齐帧缓冲池
+class FramePool {
+public:
+    FramePool();
+    ~FramePool();
+
+    FramePool(const FramePool&) = delete;
+    FramePool& operator=(const FramePool&) = delete;
+
+    // 预分配slotCount个大小为slotSize的缓冲区，已分配出去的旧缓冲区在释放后才回收
+    bool init(size_t slotCount, size_t slotSize, size_t alignment = 64);
+
+    // 释放帧池
+    void release();
+
+    // 取出一个空闲缓冲区，池耗尽时返回空句柄
+    FrameRef acquire();
+
+    // 获取统计信息
+    FramePoolStats getStats() const;
+
+    // 每个缓冲区大小
+    size_t getSlotSize() const;
+
+private:
+    FramePoolCore* m_core;  // 池的共享状态（最后一个缓冲区归还后才销毁）
+    mutable std::mutex m_mutex;  // 保护m_core替换
+};
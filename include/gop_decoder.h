@@ -0,0 +1,91 @@
+#pragma once
+
+#include <opencv2/opencv.hpp>
+#include <string>
+#include <vector>
+#include <functional>
+#include <cstdint>
+
+// 一段以关键帧开始的区间：显示时间戳在[startPts, endPts)内的帧
+struct GopSegment {
+    bool fromStart;    // 从文件开头解码，不定位（第一段）
+    int64_t seekTs;    // 定位目标：区间第一个关键帧的解码时间戳
+    int64_t startPts;  // 区间第一帧的显示时间戳
+    int64_t endPts;    // 下一区间第一帧的显示时间戳（最后一段为INT64_MAX）
+    int firstFrame;    // 区间第一帧的帧号
+    int frameCount;    // 区间帧数
+    std::vector<int> frames;  // 只输出这些帧号（升序），为空时输出区间内所有帧
+    bool keyframesOnly;  // 只解码区间开头的关键帧（frames只有这一帧）
+
+    GopSegment()
+        : fromStart(false), seekTs(0), startPts(0), endPts(0), firstFrame(0), frameCount(0),
+          keyframesOnly(false) {}
+};
+
+// 按GOP并行解码：先扫描容器（只读数据包，不解码）得到每帧的显示时间戳和关键帧位置，
+// 再把视频切成以关键帧开始的区间，每个区间用独立的解封装器和解码器解码，多个区间可以在不同线程中同时解码
+// 帧号按显示时间戳排序确定，与从头顺序解码的编号相同；开放GOP的前导帧由上一区间继续解码得到，输出逐帧一致
+// 需要libav；数据包没有时间戳的容器（如裸H.264流）无法切分，open返回false，调用者应退回顺序解码
+class GopDecoder {
+public:
+    GopDecoder();
+    ~GopDecoder();
+
+    // 编译时是否启用了libav支持
+    static bool isAvailable();
+
+    // 打开视频并扫描关键帧
+    bool open(const std::string& videoFilePath);
+
+    // 帧数（扫描得到的准确值）
+    int getFrameCount() const { return static_cast<int>(m_framePts.size()); }
+
+    // 关键帧数
+    int getKeyframeCount() const { return static_cast<int>(m_keyframes.size()); }
+
+    int getWidth() const { return m_width; }
+    int getHeight() const { return m_height; }
+
+    // 第index帧相对第一帧的时间（秒）
+    double getFrameTime(int index) const;
+
+    // 关键帧的帧号，升序
+    std::vector<int> getKeyframeIndices() const;
+
+    // 把视频切成最多parts个区间，相邻GOP合并使各区间帧数接近；parts为1时是整个视频
+    std::vector<GopSegment> split(int parts) const;
+
+    // 只输出frames（升序帧号）时的区间：每个含有所需帧的GOP一段，从GOP的关键帧解码到其中最后一个所需帧
+    // 不含所需帧的GOP不在结果中，定位时直接跳过、不解码；所需帧全是关键帧时只解码关键帧本身
+    std::vector<GopSegment> select(const std::vector<int>& frames) const;
+
+    // 解码一个区间，每输出一帧调用callback(帧号, BGR图像)，按解码器输出顺序；callback返回false时提前结束
+    // 可以在多个线程中同时调用；区间内的帧全部输出时返回true
+    bool decodeSegment(const GopSegment& segment, const std::function<bool(int, cv::Mat&)>& callback) const;
+
+    // 依次解码多个区间，共用一个解封装器和解码器（区间之间定位并清空解码器），省去每段重新打开文件
+    // 所有区间都完整输出时返回true
+    bool decodeSegments(const std::vector<GopSegment>& segments,
+                        const std::function<bool(int, cv::Mat&)>& callback) const;
+
+private:
+    // 关键帧位置
+    struct Keyframe {
+        int64_t pts;  // 显示时间戳
+        int64_t dts;  // 解码时间戳（定位用）
+    };
+
+    std::string m_videoFilePath;
+    int m_streamIndex;
+    int m_width;
+    int m_height;
+    double m_timeBase;  // 时间戳单位（秒）
+    std::vector<int64_t> m_framePts;   // 所有帧的显示时间戳，升序，下标即帧号
+    std::vector<Keyframe> m_keyframes;  // 按显示时间戳升序
+
+    // 显示时间戳对应的帧号，不在扫描结果中时返回-1
+    int frameIndex(int64_t pts) const;
+
+    // 每个GOP的第一帧帧号和定位时间戳（第一个GOP从第0帧开始，包括第一个关键帧之前的帧）
+    void computeGopStarts(std::vector<int>& starts, std::vector<int64_t>& seeks) const;
+};
@@ -4,13 +4,21 @@
 #include "video_capture.h"
 #include "video_recorder.h"
 #include "ffmpeg_recorder.h"
+#include "libav_recorder.h"
 #include "file_manager.h"
 #include "frame_extractor.h"
+#include "triple_buffer.h"
+#include "device_watcher.h"
+#include "bounded_queue.h"
+#include "motion_detector.h"
+#include "quality_controller.h"
+#include "rendition_recorder.h"
 
 #include <imgui.h>
 #include <vector>
 #include <string>
 #include <memory>
+#include <future>
 
 // OpenGL和GLFW头文件
 #define GLFW_INCLUDE_NONE
@@ -39,8 +47,8 @@ public:
     // 设置视频文件列表
     void setVideoFiles(const std::vector<VideoFileInfo>& files);
 
-    // 更新预览帧
-    void updatePreviewFrame(const cv::Mat& frame);
+    // 更新预览帧（在采集线程调用，无锁发布给渲染线程）
+    void updatePreviewFrame(const FrameRef& frame);
 
 private:
     // 窗口尺寸
@@ -56,14 +64,57 @@ private:
     std::shared_ptr<VideoCapture> m_videoCapture;
     std::shared_ptr<VideoRecorder> m_videoRecorder;
     std::shared_ptr<FFmpegRecorder> m_ffmpegRecorder;
+    std::shared_ptr<LibavRecorder> m_libavRecorder;
+    std::shared_ptr<RenditionRecorder> m_renditionRecorder;
     std::shared_ptr<FileManager> m_fileManager;
     std::shared_ptr<FrameExtractor> m_frameExtractor;
+    std::shared_ptr<DeviceWatcher> m_deviceWatcher;
+    std::shared_ptr<MotionDetector> m_motionDetector;
+
+    // 录制后端
+    enum class RecorderBackend {
+        Libav,          // 进程内libav编码，与预览共用采集
+        OpenCV,         // OpenCV VideoWriter，与预览共用采集
+        FFmpegProcess   // 外部ffmpeg进程，帧通过标准输入管道送入
+    };
 
     // 录制模式
-    bool m_useFFmpeg;  // 是否使用FFmpeg录制
+    RecorderBackend m_recorderBackend;  // 当前录制后端
+    EncoderSettings m_encoderSettings;  // libav编码参数
+    int m_recorderSubscription;  // 录制器在帧总线上的订阅ID
+    bool m_recorderOnNativeBus;  // 录制器订阅的是否为设备格式帧总线（直通录制）
+    bool m_segmentEnabled;  // 是否分段录制
+    int m_segmentMinutes;  // 每段时长（分钟）
+    int m_segmentMaxMB;  // 每段最大大小（MB），0表示不限
+    bool m_preRollEnabled;  // 是否预录
+    int m_preRollSeconds;  // 预录时长（秒）
+    bool m_preRollFailed;  // 预录启动失败（不再每帧重试）
+    bool m_adaptiveQuality;  // 是否按编码负载自动调整画质（只用于libav后端）
+    QualityController m_qualityController;  // 自适应画质控制器
+
+    // 代理副本：录像的同时输出缩小的低码率文件
+    bool m_proxyEnabled;  // 是否同时录制代理副本
+    int m_proxyHeight;  // 代理副本高度
+    int m_proxySubscription;  // 代理副本在帧总线上的订阅ID
+
+    // 移动侦测录制
+    bool m_motionRecordEnabled;  // 是否启用移动侦测录制
+    bool m_recordingByMotion;  // 当前录制是否由移动侦测开始（手动开始的录制不会被自动停止）
+    int m_motionSubscription;  // 移动侦测在帧总线上的订阅ID
+    MotionSettings m_motionSettings;  // 移动侦测参数
+    BoundedQueue<bool> m_motionEvents;  // 侦测线程到渲染线程的运动状态变化
+
+    // 视频分帧
+    bool m_gopParallelExtraction;  // 是否按GOP并行解码
+    ExtractionSelection m_extractSelection;  // 取帧方式和时间范围
+    bool m_extractRangeEnabled;  // 是否只取一段时间
+    bool m_extractToArchive;  // 是否输出为单个帧归档
+    FrameArchiveCodec m_extractArchiveCodec;  // 帧归档编码
 
     // 数据
     std::vector<CameraDeviceInfo> m_cameraDevices;
+    std::future<std::vector<CameraDeviceInfo>> m_deviceScan;  // 后台设备扫描结果
+    BoundedQueue<DeviceEvent> m_deviceEvents;  // 设备监视线程到渲染线程的热插拔事件
     std::vector<VideoFileInfo> m_videoFiles;
     int m_selectedDeviceIndex;
     int m_selectedFileIndex;
@@ -72,8 +123,8 @@ private:
 
     // 预览帧
     GLuint m_previewTextureId;
-    cv::Mat m_previewFrame;
-    bool m_hasNewFrame;
+    TripleBuffer<FrameRef> m_previewFrames;  // 采集线程到渲染线程的最新帧传递
+    cv::Mat m_previewRgb;  // 复用的RGB纹理上传缓冲（仅渲染线程访问）
 
     // 初始化IMGUI
     bool initImGui();
@@ -81,6 +132,15 @@ private:
     // 渲染GUI
     void renderGUI();
 
+    // 在后台线程扫描设备，避免阻塞渲染
+    void startDeviceScan();
+
+    // 检查后台扫描是否完成，完成则更新设备列表
+    void pollDeviceScan();
+
+    // 应用热插拔事件，增量更新设备列表
+    void pollDeviceEvents();
+
     // 渲染设备列表面板
     void renderDeviceListPanel();
 
@@ -99,6 +159,60 @@ private:
     // 更新预览纹理
     void updatePreviewTexture();
 
+    // 按当前后端开始录制
+    bool startRecording();
+
+    // 停止当前后端的录制
+    void stopRecording();
+
+    // 当前后端是否正在录制
+    bool isRecording() const;
+
+    // 开始代理副本录制并订阅帧总线（任何后端的录像都可以附带代理副本）
+    void startProxyRecording();
+
+    // 取消代理副本订阅并停止录制
+    void stopProxyRecording();
+
+    // 开始OpenCV录制并订阅帧总线
+    bool startOpenCVRecording(const Resolution& resolution, int framerate);
+
+    // 开始libav录制并订阅帧总线
+    bool startLibavRecording(const Resolution& resolution, const FrameRate& framerate);
+
+    // 开始FFmpeg管道录制并订阅帧总线
+    bool startFFmpegRecording(const Resolution& resolution, const FrameRate& framerate);
+
+    // 把分段设置应用到所有录制器
+    void applySegmentSettings();
+
+    // 按预录开关和采集状态开始或停止预录（只用于libav后端）
+    void updatePreRoll();
+
+    // 停止预录并取消订阅
+    void stopPreRoll();
+
+    // 从当前编码参数开始自适应画质控制
+    void resetQualityController(const FrameRate& framerate);
+
+    // 按libav录制器的统计调整画质档位
+    void updateAdaptiveQuality();
+
+    // 按开关和采集状态订阅或取消移动侦测
+    void updateMotionDetection();
+
+    // 取消移动侦测订阅
+    void stopMotionDetection();
+
+    // 处理运动状态变化，自动开始或停止录制
+    void pollMotionEvents();
+
+    // 录制器订阅的帧总线
+    FrameBus& getRecorderBus();
+
+    // 取消录制器在帧总线上的订阅
+    void unsubscribeRecorder();
+
     // 清理资源
     void cleanup();
 };
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <sys/uio.h>
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+// 最小的io_uring封装：只支持写入、固定缓冲区写入和fdatasync，直接使用系统调用，不依赖liburing
+// 不是线程安全的，提交和收取都应在同一个线程中进行
+class IoUringQueue {
+public:
+    IoUringQueue();
+    ~IoUringQueue();
+
+    IoUringQueue(const IoUringQueue&) = delete;
+    IoUringQueue& operator=(const IoUringQueue&) = delete;
+
+    // 创建队列，内核不支持或被禁止（如容器的seccomp策略）时返回false
+    bool init(unsigned entries);
+
+    // 释放队列
+    void close();
+
+    // 是否已创建
+    bool isOpen() const { return m_fd >= 0; }
+
+    // 注册固定缓冲区（之后可用queueWriteFixed写入，省去每次写入时的页面映射）；受RLIMIT_MEMLOCK限制，失败时返回false
+    bool registerBuffers(const iovec* buffers, unsigned count);
+
+    // 加入一个写入请求（不立即提交），队列已满时返回false；完成事件的userData原样返回
+    bool queueWrite(int fd, const void* data, unsigned size, uint64_t offset, uint64_t userData);
+
+    // 加入一个使用固定缓冲区bufferIndex的写入请求
+    bool queueWriteFixed(int fd, const void* data, unsigned size, uint64_t offset, unsigned bufferIndex,
+                         uint64_t userData);
+
+    // 加入一个fdatasync请求
+    bool queueDataSync(int fd, uint64_t userData);
+
+    // 一次系统调用提交所有已加入的请求，返回提交的数量，失败时返回-1
+    // 内核暂时没有接受的请求（如EAGAIN、EBUSY）留在队列中，下次submit或等待完成时再提交
+    int submit();
+
+    // 收取完成事件，wait为true且没有已完成的事件时阻塞到至少一个完成；返回收取的数量，失败时返回-1
+    // callback(userData, result)，result为写入的字节数或负的错误码
+    template <typename Callback>
+    int reap(bool wait, Callback callback) {
+        if (wait && !hasCompletions() && !waitCompletion()) {
+            return -1;
+        }
+
+        int count = 0;
+        unsigned head = *m_cqHead;
+        unsigned tail = loadCqTail();
+        while (head != tail) {
+            const io_uring_cqe* cqe = completionAt(head);
+            callback(completionUserData(cqe), completionResult(cqe));
+            head++;
+            count++;
+        }
+        storeCqHead(head);
+        return count;
+    }
+
+private:
+    int m_fd;
+    void* m_sqRing;
+    void* m_cqRing;
+    void* m_sqes;
+    size_t m_sqRingSize;
+    size_t m_cqRingSize;
+    size_t m_sqesSize;
+    unsigned m_entries;
+    unsigned m_queued;  // 已加入、尚未发布给内核的请求数
+    unsigned m_unsubmitted;  // 已发布、内核尚未接受的请求数
+
+    unsigned* m_sqHead;
+    unsigned* m_sqTail;
+    unsigned m_sqMask;
+    unsigned* m_sqArray;
+    unsigned* m_cqHead;
+    unsigned* m_cqTail;
+    unsigned m_cqMask;
+    io_uring_cqe* m_cqes;
+
+    // 取得下一个空闲的提交项并清零，队列已满时返回nullptr
+    io_uring_sqe* nextSqe(uint64_t userData);
+
+    bool hasCompletions() const;
+    bool waitCompletion();
+    unsigned loadCqTail() const;
+    void storeCqHead(unsigned head);
+    const io_uring_cqe* completionAt(unsigned index) const;
+    static uint64_t completionUserData(const io_uring_cqe* cqe);
+    static int completionResult(const io_uring_cqe* cqe);
+};
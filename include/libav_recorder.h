@@ -0,0 +1,142 @@
+#pragma once
+
+#include "video_recorder.h"
+#include "encoder_settings.h"
+#include "quality_controller.h"
+#include "frame_pool.h"
+#include "bounded_queue.h"
+#include "output_sink.h"
+#include <string>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <chrono>
+
+struct LibavEncoder;
+
+// 进程内libav录制器：从采集管线接收帧，用libavcodec编码并用libavformat封装
+// 与预览共用同一次采集和解码，不再另起ffmpeg进程打开设备
+class LibavRecorder {
+public:
+    LibavRecorder();
+    ~LibavRecorder();
+
+    // 编译时是否启用了libav支持
+    static bool isAvailable();
+
+    // 初始化录制器
+    bool init(const std::string& outputDir);
+
+    // 开始录制，帧尺寸需与resolution一致
+    // 预录中调用时忽略参数，沿用预录的编码参数，从缓冲区中最早的关键帧开始写入
+    bool startRecording(const Resolution& resolution, const FrameRate& framerate,
+                        const EncoderSettings& settings = EncoderSettings());
+
+    // 停止录制，编码完队列中剩余的帧并写入文件尾；预录中只关闭文件，继续预录
+    void stopRecording();
+
+    // 开始预录：编码器持续运行，最近seconds秒的数据包保存在内存中，不写文件
+    // maxBytes为缓冲区大小，0表示按码率×时长估算
+    bool startPreRoll(const Resolution& resolution, const FrameRate& framerate,
+                      const EncoderSettings& settings, int seconds, size_t maxBytes = 0);
+
+    // 停止预录（正在录制时同时结束录制）
+    void stopPreRoll();
+
+    // 是否正在预录
+    bool isPreRolling() const { return m_preRolling; }
+
+    // 预录缓冲区中保存的时长（秒）
+    double getPreRollDuration() const;
+
+    // 提交一帧（只增加引用计数），不阻塞调用者；直通录制时提交压缩帧总线上的MJPEG帧，否则提交BGR帧
+    void processFrame(const FrameRef& frame);
+
+    // 切换画质档位（编码线程在下一帧之前应用），直通录制时无效
+    // 码率和crf在运行中生效；预设或分辨率变化时重新打开编码器，正在录制时切换到新分段，预录缓冲区清空
+    void setQualityLevel(const QualityLevel& level);
+
+    // 设置编码队列深度（下次开始录制时生效），队列中的帧占用采集帧池
+    void setQueueDepth(size_t depth) { m_queueDepth = depth > 0 ? depth : 1; }
+
+    // 获取编码队列深度
+    size_t getQueueDepth() const { return m_queueDepth; }
+
+    // 设置文件名标记（下次开始录制时生效），如proxy生成"日期时间_分辨率_帧率.proxy.mp4"，空表示不加
+    void setFileNameTag(const std::string& tag) { m_fileNameTag = tag; }
+
+    // 是否正在录制
+    bool isRecording() const { return m_isRecording; }
+
+    // 获取当前录制文件路径（分段录制时为正在写入的分段）
+    std::string getCurrentFilePath() const;
+
+    // 获取本次录制已产生的分段数
+    int getSegmentCount() const { return m_segmentCount; }
+
+    // 获取录制时长（秒）
+    double getRecordingDuration() const;
+
+    // 获取录制统计
+    RecorderStats getStats() const;
+
+    // 获取文件写入统计（写入延迟、进行中的写入数、等待次数）
+    OutputSinkStats getOutputStats() const { return m_outputSink->getStats(); }
+
+    // 文件写入是否使用io_uring
+    bool isUsingIoUring() const { return m_outputSink->isUsingIoUring(); }
+
+private:
+    std::string m_outputDir;  // 输出目录
+    std::string m_currentFilePath;  // 当前录制文件路径
+    std::string m_fileNameTag;  // 文件名标记（多副本录制时区分副本）
+    mutable std::mutex m_pathMutex;  // 保护m_currentFilePath（编码线程切换分段时更新）
+    std::atomic<int> m_segmentCount;  // 已产生的分段数
+    size_t m_queueDepth;  // 编码队列深度
+    bool m_passthrough;  // 当前录制是否为直通录制
+
+    std::atomic<bool> m_isRecording;  // 是否正在录制
+    std::atomic<bool> m_preRolling;  // 是否正在预录
+    std::chrono::time_point<std::chrono::steady_clock> m_startTime;  // 开始录制时间
+
+    std::unique_ptr<OutputSink> m_outputSink;  // 异步文件写入（缓冲区跨录制和分段复用）
+    std::unique_ptr<LibavEncoder> m_encoder;  // 编码器和封装器状态
+    mutable std::mutex m_encoderMutex;  // 保护m_encoder（预录时开始和停止录制在调用线程中切换输出）
+    std::shared_ptr<BoundedQueue<FrameRef>> m_queue;  // 编码队列
+    mutable std::mutex m_queueMutex;  // 保护m_queue指针的替换
+    std::thread m_encoderThread;  // 编码线程
+
+    QualityLevel m_pendingQuality;  // 待应用的画质档位
+    std::atomic<bool> m_qualityPending;  // 是否有待应用的画质档位
+    std::mutex m_qualityMutex;  // 保护m_pendingQuality
+
+    std::atomic<uint64_t> m_encoded;  // 已编码帧数
+    std::atomic<int64_t> m_lastEncodeUs;  // 最近一帧编码耗时
+    std::atomic<int64_t> m_maxEncodeUs;  // 最大编码耗时
+    std::atomic<int64_t> m_totalEncodeUs;  // 累计编码耗时
+
+    // 编码线程函数
+    void encoderThreadFunc(std::shared_ptr<BoundedQueue<FrameRef>> queue);
+
+    // 直通录制线程函数：按采集时间戳直接封装压缩帧
+    void passthroughThreadFunc(std::shared_ptr<BoundedQueue<FrameRef>> queue);
+
+    // 预录中开始录制：打开文件并写入缓冲区中的数据
+    bool startPreRollOutput();
+
+    // 关闭编码队列，等待编码线程写完并退出，释放编码器
+    void stopEncoderThread();
+
+    // 准备异步文件写入并清零写入统计，返回交给编码器的OutputSink（不可用时为nullptr）
+    OutputSink* attachOutputSink();
+
+    // 编码器切换到新分段后更新当前文件路径
+    void updateSegmentPath();
+
+    // 输出文件扩展名（带点，包含文件名标记）
+    std::string getFileExtension(const EncoderSettings& settings) const;
+
+    // 生成文件名（包含日期时间、分辨率和帧率）
+    std::string generateFileName(const Resolution& resolution, int framerate, const std::string& extension);
+};
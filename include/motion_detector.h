@@ -0,0 +1,112 @@
+#pragma once
+
+#include "frame_pool.h"
+#include "color_convert.h"
+#include <opencv2/opencv.hpp>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <functional>
+#include <cstdint>
+
+// 移动侦测参数
+struct MotionSettings {
+    int decimation;           // 降采样倍数：每decimation×decimation个像素取一个亮度值
+    int pixelThreshold;       // 亮度差超过该值的像素视为变化像素
+    int blockChangedPixels;   // 块（降采样后16x16）内变化像素数超过该值视为变化块
+    int minChangedBlocks;     // 变化块数达到该值视为有运动
+    double maxChangedRatio;   // 变化块比例超过该值视为曝光或光照突变，不算运动
+    int startFrames;          // 连续有运动的帧数达到该值进入运动状态
+    double stopSeconds;       // 无运动持续该时长后退出运动状态
+
+    MotionSettings()
+        : decimation(4),
+          pixelThreshold(25),
+          blockChangedPixels(24),
+          minChangedBlocks(2),
+          maxChangedRatio(0.8),
+          startFrames(3),
+          stopSeconds(5.0) {}
+};
+
+// 单帧侦测结果
+struct MotionResult {
+    int changedBlocks;   // 变化块数
+    int totalBlocks;     // 总块数
+    bool motion;         // 本帧是否有运动
+    bool active;         // 经过迟滞后的运动状态
+    double processMs;    // 处理耗时（毫秒）
+
+    MotionResult() : changedBlocks(0), totalBlocks(0), motion(false), active(false), processMs(0.0) {}
+};
+
+// 移动侦测：在降采样的亮度平面上做帧差，按块统计变化像素
+// 帧差、阈值和块计数使用SSE4.1/AVX2（x86）或NEON（ARM64）向量化实现，1080p每帧远小于1毫秒
+// 运动状态带迟滞：连续startFrames帧有运动才进入，无运动stopSeconds后才退出
+class MotionDetector {
+public:
+    // 块边长（降采样后的像素）
+    static const int kBlockSize = 16;
+
+    MotionDetector();
+
+    MotionDetector(const MotionDetector&) = delete;
+    MotionDetector& operator=(const MotionDetector&) = delete;
+
+    // 设置参数（会重置状态）
+    void setSettings(const MotionSettings& settings);
+
+    // 获取参数
+    MotionSettings getSettings() const;
+
+    // 设置运动状态变化回调（在调用process的线程中执行）
+    void setStateCallback(std::function<void(bool active)> callback);
+
+    // 处理一帧BGR图像，timestampUs为采集时间戳（0表示使用当前时间）
+    MotionResult process(const cv::Mat& bgr, int64_t timestampUs = 0);
+
+    // 处理帧池中的一帧（非BGR帧被忽略）
+    MotionResult process(const FrameRef& frame);
+
+    // 重置状态（下一帧作为参考帧）
+    void reset();
+
+    // 当前运动状态
+    bool isActive() const { return m_active; }
+
+    // 最近一帧的结果
+    MotionResult getLastResult() const;
+
+    // 指定帧差实现的指令集（CPU不支持时返回false），用于基准测试
+    bool setIsa(ColorConvert::Isa isa);
+
+    // 当前使用的指令集
+    ColorConvert::Isa getIsa() const { return m_isa; }
+
+    // 把BGR图像降采样为亮度平面，plane每行stride字节
+    static void decimateLuma(const cv::Mat& bgr, int decimation, uint8_t* plane, int stride);
+
+    // 统计两个亮度平面中的变化块数；width需为kBlockSize的倍数，超出图像的列应填充相同的值
+    static int countChangedBlocks(const uint8_t* previous, const uint8_t* current, int stride,
+                                  int width, int height, int pixelThreshold, int blockChangedPixels,
+                                  ColorConvert::Isa isa);
+
+private:
+    mutable std::mutex m_mutex;  // 保护参数、回调和最近结果
+    MotionSettings m_settings;  // 参数
+    std::function<void(bool)> m_callback;  // 状态变化回调
+    ColorConvert::Isa m_isa;  // 帧差实现的指令集
+
+    std::vector<uint8_t> m_planes[2];  // 前一帧和当前帧的亮度平面
+    int m_current;  // 当前帧平面的索引
+    int m_planeWidth;  // 平面宽度（按块对齐）
+    int m_planeHeight;  // 平面高度
+    int m_sourceWidth;  // 源图像宽度
+    int m_sourceHeight;  // 源图像高度
+    bool m_hasReference;  // 是否已有参考帧
+
+    std::atomic<bool> m_active;  // 运动状态
+    int m_motionFrames;  // 连续有运动的帧数
+    int64_t m_lastMotionUs;  // 最近一次有运动的时间
+    MotionResult m_lastResult;  // 最近一帧的结果
+};
@@ -0,0 +1,198 @@
+#pragma once
+
+#include "io_uring_queue.h"
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <cstdint>
+
+// 输出写入参数
+struct OutputSinkSettings {
+    size_t bufferSize;           // 每个写入缓冲区的大小，封装器的小块写入在其中合并
+    size_t bufferCount;          // 缓冲区数量，全部在写入中时write阻塞（背压）
+    double syncIntervalSeconds;  // 每隔多少秒在后台做一次fdatasync（0为只在关闭时同步）
+    bool ioUring;                // 通过io_uring提交（内核不支持或被禁止时退回后台写入线程）
+
+    OutputSinkSettings()
+        : bufferSize(256 * 1024),
+          bufferCount(16),
+          syncIntervalSeconds(2.0),
+          ioUring(true) {}
+};
+
+// 输出写入统计
+struct OutputSinkStats {
+    uint64_t bytesWritten;  // 已落盘（写入完成）的字节数
+    uint64_t writes;        // 完成的写入数
+    size_t queueDepth;      // 正在写入的缓冲区数
+    size_t maxQueueDepth;   // 峰值
+    double lastWriteMs;     // 最近一次写入从提交到完成的时间
+    double maxWriteMs;      // 最大写入时间
+    uint64_t syncs;         // 完成的fdatasync数
+    double maxSyncMs;       // 最长的fdatasync
+    uint64_t stalls;        // 缓冲区全部在写入中、调用者等待的次数
+    double stallMs;         // 累计等待时间
+    uint64_t errors;        // 写入或同步失败数
+
+    OutputSinkStats()
+        : bytesWritten(0), writes(0), queueDepth(0), maxQueueDepth(0), lastWriteMs(0.0), maxWriteMs(0.0),
+          syncs(0), maxSyncMs(0.0), stalls(0), stallMs(0.0), errors(0) {}
+};
+
+// 异步输出：封装器的写入先拷贝进一组固定的缓冲区，缓冲区写满后批量提交给io_uring（注册为固定缓冲区），
+// 调用者不等待写入完成；SD卡、eMMC上几百毫秒的写入停顿由缓冲区吸收，只有全部缓冲区都在写入中时才阻塞
+// fdatasync定期在后台提交，关闭文件时的最终同步和close也在后台完成，分段切换不等待落盘
+// io_uring不可用时由一个后台写入线程按提交顺序执行pwrite、fdatasync和close；有意不用线程池：
+// 回写文件头会覆盖可能仍在队列中的范围，fdatasync也只应覆盖之前提交的写入，单线程按顺序执行天然满足这两点，
+// 多个线程并发写入则要像io_uring路径一样逐个检查重叠、让同步等待之前的写入。同一时刻只写一个文件，
+// 存储本身是瓶颈，多线程写同一设备也不会更快，缓冲区数量已经吸收了写入停顿
+// 文件按偏移写入，支持封装器回写文件头（如mp4的mdat大小）；一次只写一个文件，open前必须先close上一个
+// 各函数内部加锁，可以在不同线程调用（如预录开始输出在调用线程、之后的写入在编码线程），写入顺序由调用者保证
+class OutputSink {
+public:
+    OutputSink();
+    ~OutputSink();
+
+    // 分配缓冲区并创建io_uring或写入线程
+    bool init(const OutputSinkSettings& settings = OutputSinkSettings());
+
+    // 打开（创建或截断）一个文件，位置为0
+    bool open(const std::string& path);
+
+    // 在当前位置写入，数据被拷贝，返回后调用者可以重用；之前的异步写入失败时返回false
+    bool write(const uint8_t* data, size_t size);
+
+    // 移动写入位置（whence为SEEK_SET、SEEK_CUR或SEEK_END），返回新位置，失败时返回-1
+    int64_t seek(int64_t offset, int whence);
+
+    // 当前写入位置
+    int64_t tell() const { return m_position; }
+
+    // 已写入的文件大小（包括尚未落盘的部分）
+    int64_t size() const { return m_fileSize; }
+
+    // 提交当前未写满的缓冲区
+    void flush();
+
+    // 提交剩余数据，在后台fdatasync并关闭文件，不等待；返回本文件到目前为止是否没有写入错误
+    bool close();
+
+    // 等待所有写入、同步和关闭完成
+    void drain();
+
+    // 是否正在使用io_uring
+    bool isUsingIoUring() const { return m_useRing; }
+
+    // 是否有文件打开
+    bool isOpen() const { return m_file >= 0; }
+
+    // 获取统计
+    OutputSinkStats getStats() const;
+
+    // 清零统计（正在写入的缓冲区数保留）
+    void resetStats();
+
+private:
+    // 写入缓冲区
+    struct Buffer {
+        uint8_t* data;
+        size_t used;       // 已填入的字节数
+        int64_t offset;    // 在文件中的偏移
+        int file;          // 所属文件（m_files下标）
+        bool busy;         // 正在写入
+        std::chrono::steady_clock::time_point start;  // 提交时间
+
+        Buffer() : data(nullptr), used(0), offset(0), file(-1), busy(false) {}
+    };
+
+    // 打开的文件：写入完成、同步完成后才真正关闭
+    struct File {
+        std::string path;
+        int fd;
+        int pending;       // 进行中的写入数
+        bool syncing;      // fdatasync进行中
+        bool closing;      // 已调用close，等待写入完成后做最终同步并关闭
+        bool finalSync;    // 进行中的同步是关闭前的最终同步
+        bool failed;       // 有写入失败
+        std::chrono::steady_clock::time_point syncStart;
+
+        File() : fd(-1), pending(0), syncing(false), closing(false), finalSync(false), failed(false) {}
+    };
+
+    // 写入线程的命令（按提交顺序执行）
+    enum class Command { Write, Sync };
+    struct Task {
+        Command command;
+        int index;  // Write为缓冲区下标，Sync为文件下标
+    };
+
+    OutputSinkSettings m_settings;
+    uint8_t* m_memory;  // 所有缓冲区的一块内存
+    std::vector<Buffer> m_buffers;
+    std::vector<File> m_files;
+    int m_current;  // 正在填写的缓冲区，-1为没有
+    int m_file;  // 当前文件，-1为没有打开
+    int64_t m_position;  // 当前写入位置
+    int64_t m_fileSize;  // 当前文件大小
+    std::chrono::steady_clock::time_point m_lastSync;  // 上次提交同步的时间
+
+    bool m_useRing;
+    bool m_fixedBuffers;  // 缓冲区已注册为io_uring固定缓冲区
+    bool m_reaping;  // 正在处理完成事件
+    IoUringQueue m_ring;
+
+    // 后台写入线程（io_uring不可用时）
+    std::thread m_thread;
+    std::deque<Task> m_tasks;
+    bool m_stopping;
+    std::condition_variable m_taskCondition;   // 有新任务
+    std::condition_variable m_doneCondition;   // 有任务完成
+
+    mutable std::mutex m_mutex;  // 保护缓冲区和文件状态（写入线程和调用者共享）以及统计
+    OutputSinkStats m_stats;
+
+    // 以下私有函数调用时都持有m_mutex
+
+    // 取得一个空闲缓冲区，全部在写入中时等待；返回下标，无法再等待时返回-1
+    int acquireBuffer(std::unique_lock<std::mutex>& lock);
+
+    // 等待任意一个写入或同步完成；io_uring等待失败时返回false
+    bool waitForCompletion(std::unique_lock<std::mutex>& lock);
+
+    // 提交当前缓冲区，到达同步间隔时顺带提交fdatasync
+    void submitCurrent();
+
+    // 提交一个缓冲区的写入
+    void submitWrite(int index);
+
+    // 提交一个文件的fdatasync
+    void submitSync(int file);
+
+    // 写入完成
+    void completeWrite(int index, bool ok);
+
+    // 同步完成；最终同步完成后关闭fd
+    void completeSync(int file, bool ok);
+
+    // 已关闭的文件所有写入完成后提交最终同步
+    void checkClosing(int file);
+
+    // 收取io_uring完成事件；等待失败时返回false
+    bool reap(bool wait);
+
+    // io_uring提交队列已满时腾出位置；无法腾出时返回false
+    bool makeRoom();
+
+    // 是否有进行中的写入、同步或等待关闭的文件
+    bool hasActivity() const;
+
+    // 写入线程函数
+    void threadFunc();
+
+    // [offset, offset+size)是否与同一文件正在写入的缓冲区重叠（封装器回写文件头时要等旧数据写完，避免乱序覆盖）
+    bool overlapsBusy(int file, int64_t offset, size_t size) const;
+};
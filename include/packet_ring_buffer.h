@@ -0,0 +1,76 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <functional>
+#include <cstdint>
+#include <cstddef>
+
+// 环形缓冲区中的一个已编码数据包
+struct RingPacket {
+    const uint8_t* data;  // 数据（指向环形缓冲区内部，下一次push前有效）
+    size_t size;          // 数据长度
+    int64_t pts;          // 显示时间戳（调用者的时间基）
+    int64_t dts;          // 解码时间戳
+    int64_t duration;     // 时长
+    bool keyframe;        // 是否为关键帧
+
+    RingPacket() : data(nullptr), size(0), pts(0), dts(0), duration(0), keyframe(false) {}
+};
+
+// 预录环形缓冲区：在固定大小的内存中保存最近一段时间的已编码数据包
+// 按关键帧建立索引，总是从关键帧开始保存，淘汰时整组（GOP）丢弃，取出的数据可以直接封装而不需要重新编码
+// 内存在构造时一次分配，之后不再增长
+class PacketRingBuffer {
+public:
+    // capacityBytes为数据区大小，window为保留的时长（与时间戳同一时间基，0表示只受容量限制）
+    PacketRingBuffer(size_t capacityBytes, int64_t window);
+
+    PacketRingBuffer(const PacketRingBuffer&) = delete;
+    PacketRingBuffer& operator=(const PacketRingBuffer&) = delete;
+
+    // 写入一个数据包（拷贝数据），空间不足时淘汰最旧的GOP
+    // 缓冲区中还没有关键帧时非关键帧无法解码，直接丢弃并返回false
+    bool push(const uint8_t* data, size_t size, int64_t pts, int64_t dts, int64_t duration, bool keyframe);
+
+    // 从最早保存的关键帧开始按顺序访问所有数据包，visit返回false时停止，返回访问的数量
+    size_t forEach(const std::function<bool(const RingPacket&)>& visit) const;
+
+    // 清空
+    void clear();
+
+    // 数据包数量
+    size_t packetCount() const { return m_packets.size(); }
+
+    // 关键帧数量
+    size_t keyframeCount() const { return m_keyframes.size(); }
+
+    // 已使用的数据字节数
+    size_t bytesUsed() const { return m_bytesUsed; }
+
+    // 数据区容量
+    size_t capacity() const { return m_storage.size(); }
+
+    // 保存的时长（最新与最早数据包的dts之差）
+    int64_t duration() const;
+
+private:
+    struct Entry {
+        size_t offset;  // 在数据区中的偏移
+        RingPacket packet;  // 时间戳和标志（data不使用）
+    };
+
+    std::vector<uint8_t> m_storage;  // 数据区
+    std::deque<Entry> m_packets;  // 按写入顺序保存的数据包
+    std::deque<uint64_t> m_keyframes;  // 关键帧的序号
+    uint64_t m_firstSequence;  // m_packets中第一个数据包的序号
+    size_t m_head;  // 下一个数据包的写入位置
+    size_t m_bytesUsed;  // 已保存的数据字节数（不含回绕时末尾跳过的空间）
+    int64_t m_window;  // 保留的时长
+
+    // 淘汰最旧的一组数据包（到下一个关键帧为止）
+    void dropOldestGop();
+
+    // 数据区从m_head开始是否有size字节可用，必要时回绕到开头
+    bool reserve(size_t size, size_t& offset);
+};
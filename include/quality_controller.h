@@ -0,0 +1,111 @@
+#pragma once
+
+#include "encoder_settings.h"
+#include "video_recorder.h"
+#include "camera_device.h"
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdint>
+
+// 画质档位：编码预设、码率（或crf）和输出分辨率缩放
+struct QualityLevel {
+    std::string preset;  // x264预设
+    int bitrateKbps;     // 目标码率（kbps），0表示使用crf
+    int crf;             // 恒定质量（bitrateKbps为0时有效）
+    double scale;        // 输出分辨率缩放（1.0为原始分辨率）
+
+    QualityLevel() : bitrateKbps(0), crf(23), scale(1.0) {}
+
+    // 描述，如"veryfast 2500kbps 100%"
+    std::string toString() const;
+};
+
+// 每个核心的CPU占用率，读取/proc/stat，两次采样之间的占用
+class CpuLoadMonitor {
+public:
+    // 采样，返回每个核心自上次采样以来的占用率（0~1）；第一次采样或读取失败时返回false
+    bool sample(std::vector<double>& coreLoads);
+
+private:
+    struct CoreTimes {
+        uint64_t busy;
+        uint64_t total;
+    };
+
+    std::vector<CoreTimes> m_last;  // 上次采样的各核心时间
+};
+
+// 自适应画质控制参数
+struct QualityControlSettings {
+    double intervalSeconds;      // 采样间隔
+    double downCooldownSeconds;  // 降档后至少间隔多久才能再次降档
+    double upStableSeconds;      // 持续空闲多久才升档
+    double blockSeconds;         // 升档后很快过载时，该档位被禁止的时长
+    double highLoad;             // 编码负载（编码耗时/帧间隔）或CPU平均占用超过该值视为过载
+    double lowLoad;              // 编码负载和CPU平均占用都低于该值视为有余量
+
+    QualityControlSettings()
+        : intervalSeconds(1.0),
+          downCooldownSeconds(2.0),
+          upStableSeconds(10.0),
+          blockSeconds(60.0),
+          highLoad(0.85),
+          lowLoad(0.6) {}
+};
+
+// 自适应画质控制器：根据编码队列深度、丢帧、编码耗时和各核心CPU占用，在档位表中逐级升降
+// 档位表从基础参数往下先只降码率（不中断编码器），再换更快的预设，最后降分辨率
+// 过载时立即降档（有冷却时间），持续空闲才升档，升档后很快过载的档位暂时禁止，避免来回振荡
+// 每次调整都输出日志；档位的应用由调用者负责（如LibavRecorder::setQualityLevel）
+class QualityController {
+public:
+    QualityController();
+
+    // 设置控制参数
+    void setSettings(const QualityControlSettings& settings) { m_settings = settings; }
+
+    // 按基础编码参数生成档位表，从与基础参数相同的档位开始
+    // queueCapacity为编码队列容量，framerate用于计算帧间隔
+    void reset(const EncoderSettings& base, size_t queueCapacity, const FrameRate& framerate);
+
+    // 定期调用（内部按采样间隔限流），档位变化时返回true
+    bool update(const RecorderStats& stats);
+
+    // 当前档位
+    const QualityLevel& getCurrentLevel() const { return m_levels[m_levelIndex]; }
+
+    // 当前档位序号（0为最低）和档位数
+    int getLevelIndex() const { return m_levelIndex; }
+    int getLevelCount() const { return static_cast<int>(m_levels.size()); }
+
+    // 最近一次调整的说明
+    const std::string& getLastDecision() const { return m_lastDecision; }
+
+    // 由基础编码参数生成从低到高的档位表
+    static std::vector<QualityLevel> buildLadder(const EncoderSettings& base);
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    QualityControlSettings m_settings;  // 控制参数
+    std::vector<QualityLevel> m_levels;  // 档位表（从低到高）
+    std::vector<Clock::time_point> m_blockedUntil;  // 各档位被禁止到的时间
+    int m_levelIndex;  // 当前档位
+    size_t m_queueCapacity;  // 编码队列容量
+    double m_frameIntervalMs;  // 帧间隔（毫秒）
+
+    CpuLoadMonitor m_cpuMonitor;  // CPU占用采样
+    bool m_started;  // 是否已有基准采样
+    Clock::time_point m_lastSample;  // 上次采样时间
+    Clock::time_point m_lastChange;  // 上次调整时间
+    bool m_lastChangeWasUp;  // 上次调整是否为升档
+    double m_stableSeconds;  // 持续有余量的时长
+    uint64_t m_lastDropped;  // 上次采样时的丢帧数
+    uint64_t m_lastEncoded;  // 上次采样时的编码帧数
+    double m_lastTotalEncodeMs;  // 上次采样时的累计编码耗时
+    std::string m_lastDecision;  // 最近一次调整的说明
+
+    // 切换档位并记录原因
+    void changeLevel(int index, const std::string& reason, Clock::time_point now);
+};
@@ -0,0 +1,139 @@
+#pragma once
+
+#include "camera_device.h"
+#include "video_recorder.h"
+#include "frame_pool.h"
+#include "bounded_queue.h"
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <chrono>
+#include <cstdint>
+
+// 原始录制文件格式（小端）：
+//   [0, 4096)            文件头RawFileHeader，其余填0
+//   [dataOffset, ...)    帧数据，每帧从4096字节对齐的位置开始，不足4096的倍数时补齐
+//   [indexOffset, ...)   帧索引，frameCount个RawFrameEntry
+// 文件头和索引在停止录制时写入；异常退出时文件头中的frameCount为0，帧数据仍在文件中
+struct RawFileHeader {
+    char magic[8];          // "VCRAW\0\0\0"
+    uint32_t version;       // 格式版本
+    uint32_t headerSize;    // 文件头区域大小（4096）
+    uint32_t width;         // 宽度
+    uint32_t height;        // 高度
+    uint32_t pixelFormat;   // V4L2像素格式（YUYV、GREY等，按设备输出原样保存）
+    uint32_t framerateNum;  // 帧率分子
+    uint32_t framerateDen;  // 帧率分母
+    uint32_t entrySize;     // 每个索引项的大小
+    uint64_t frameCount;    // 帧数
+    uint64_t dataOffset;    // 第一帧的偏移
+    uint64_t indexOffset;   // 帧索引的偏移
+};
+
+// 帧索引项
+struct RawFrameEntry {
+    uint64_t offset;       // 帧数据在文件中的偏移
+    uint32_t size;         // 帧数据长度（不含补齐）
+    uint32_t reserved;
+    int64_t timestampUs;   // 采集时间戳（微秒）
+    uint64_t sequence;     // 帧序号（跳变表示采集或录制丢帧）
+};
+
+// 原始录制参数
+struct RawRecorderSettings {
+    bool directIo;              // 使用O_DIRECT绕过页缓存（文件系统不支持时退回缓冲写入并主动回收页缓存）
+    bool ioUring;               // 通过io_uring异步提交写入（内核不支持或被禁止时退回pwrite）
+    size_t queueDepth;          // 等待写入的帧数
+    size_t inFlight;            // 同时提交给内核的写入数
+    uint64_t preallocateBytes;  // 每次预分配（fallocate）的文件空间
+
+    RawRecorderSettings()
+        : directIo(true),
+          ioUring(true),
+          queueDepth(32),
+          inFlight(8),
+          preallocateBytes(1ull << 30) {}
+};
+
+struct RawWriter;
+
+// 原始录制：不编码，按设备输出格式（YUYV、GREY等）把每一帧原样写入预分配的文件，附带每帧的时间戳索引
+// 写入使用4096字节对齐的O_DIRECT，通过io_uring同时保持多个写入在进行中，不经过页缓存，不会挤掉系统中其他程序的缓存
+// 设备格式帧总线上的帧本身已按4096字节对齐，直接从帧池缓冲区写出，不再拷贝
+class RawRecorder {
+public:
+    RawRecorder();
+    ~RawRecorder();
+
+    // 初始化录制器
+    bool init(const std::string& outputDir);
+
+    // 设置录制参数（下次开始录制时生效）
+    void setSettings(const RawRecorderSettings& settings) { m_settings = settings; }
+
+    // 获取录制参数
+    const RawRecorderSettings& getSettings() const { return m_settings; }
+
+    // 开始录制，pixelFormat为设备输出的像素格式
+    bool startRecording(const Resolution& resolution, const FrameRate& framerate, uint32_t pixelFormat);
+
+    // 停止录制，写完队列中的帧后写入索引和文件头
+    void stopRecording();
+
+    // 提交一帧（设备格式帧总线上的帧，只增加引用计数），不阻塞调用者
+    void processFrame(const FrameRef& frame);
+
+    // 是否正在录制
+    bool isRecording() const { return m_isRecording; }
+
+    // 获取当前录制文件路径
+    std::string getCurrentFilePath() const;
+
+    // 获取录制时长（秒）
+    double getRecordingDuration() const;
+
+    // 获取录制统计（encoded为已写入的帧数，编码耗时为提交到写入完成的时间）
+    RecorderStats getStats() const;
+
+    // 已写入的字节数
+    uint64_t getBytesWritten() const { return m_bytesWritten; }
+
+    // 本次录制实际使用的写入方式
+    bool isUsingDirectIo() const { return m_usingDirectIo; }
+    bool isUsingIoUring() const { return m_usingIoUring; }
+
+    // 读取原始录制文件的文件头和帧索引
+    static bool readIndex(const std::string& filePath, RawFileHeader& header, std::vector<RawFrameEntry>& entries);
+
+private:
+    std::string m_outputDir;  // 输出目录
+    std::string m_currentFilePath;  // 当前录制文件路径
+    mutable std::mutex m_pathMutex;  // 保护m_currentFilePath
+    RawRecorderSettings m_settings;  // 录制参数
+
+    std::atomic<bool> m_isRecording;  // 是否正在录制
+    std::chrono::time_point<std::chrono::steady_clock> m_startTime;  // 开始录制时间
+
+    std::unique_ptr<RawWriter> m_writer;  // 文件和写入状态（只在写入线程中使用）
+    std::shared_ptr<BoundedQueue<FrameRef>> m_queue;  // 写入队列
+    mutable std::mutex m_queueMutex;  // 保护m_queue指针的替换
+    std::thread m_writerThread;  // 写入线程
+
+    std::atomic<uint64_t> m_written;  // 已写入帧数
+    std::atomic<uint64_t> m_bytesWritten;  // 已写入字节数
+    std::atomic<uint64_t> m_writeErrors;  // 写入失败的帧数
+    std::atomic<int64_t> m_lastWriteUs;  // 最近一帧写入耗时
+    std::atomic<int64_t> m_maxWriteUs;  // 最大写入耗时
+    std::atomic<int64_t> m_totalWriteUs;  // 累计写入耗时
+    std::atomic<bool> m_usingDirectIo;  // 是否使用O_DIRECT
+    std::atomic<bool> m_usingIoUring;  // 是否使用io_uring
+
+    // 写入线程函数
+    void writerThreadFunc(std::shared_ptr<BoundedQueue<FrameRef>> queue);
+
+    // 生成文件名（包含日期时间、分辨率、帧率和像素格式）
+    std::string generateFileName(const Resolution& resolution, int framerate, uint32_t pixelFormat);
+};
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "libav_recorder.h"
+#include "encoder_settings.h"
+#include "frame_pool.h"
+#include "camera_device.h"
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+
+// 附加副本参数
+struct RenditionSettings {
+    std::string name;         // 副本名称，写入文件名（日期时间_分辨率_帧率.名称.扩展名）
+    int height;               // 输出高度，宽度按源画面比例取偶数
+    EncoderSettings encoder;  // 编码参数
+
+    RenditionSettings() : name("proxy"), height(480) {
+        encoder.bitrateKbps = 800;
+    }
+};
+
+// 多副本录制：同一次采集同时输出若干个缩小的副本（如供浏览和拖动的480p低码率代理文件）
+// 每个副本使用独立的libav录制器和编码线程；同一尺寸的副本共用一次缩放，
+// 缩放在调用processFrame的线程（帧总线订阅线程）中进行，结果放在自己的帧池中，编码器只增加引用计数
+class RenditionRecorder {
+public:
+    RenditionRecorder();
+    ~RenditionRecorder();
+
+    // 初始化录制器
+    bool init(const std::string& outputDir);
+
+    // 设置副本列表（下次开始录制时生效）
+    void setRenditions(const std::vector<RenditionSettings>& renditions);
+
+    // 获取副本列表
+    std::vector<RenditionSettings> getRenditions() const;
+
+    // 开始录制所有副本，source为采集分辨率；不小于采集分辨率的副本被跳过，一个副本都没有开始时返回false
+    bool startRecording(const Resolution& source, const FrameRate& framerate);
+
+    // 停止录制，各副本编码完队列中剩余的帧并写入文件尾
+    void stopRecording();
+
+    // 提交一帧BGR图像，按尺寸各缩放一次后交给对应的录制器
+    void processFrame(const FrameRef& frame);
+
+    // 是否正在录制
+    bool isRecording() const { return m_isRecording; }
+
+    // 当前各副本的文件路径
+    std::vector<std::string> getCurrentFilePaths() const;
+
+    // 各副本的录制统计（dropped包含缩放帧池耗尽丢弃的帧）
+    std::vector<RecorderStats> getStats() const;
+
+private:
+    // 同一输出尺寸的副本：共用帧池和一次缩放
+    struct ScaleGroup {
+        Resolution size;  // 输出尺寸
+        FramePool pool;   // 缩放结果的帧池
+        std::vector<std::shared_ptr<LibavRecorder>> recorders;  // 该尺寸的录制器
+        std::atomic<uint64_t> exhausted;  // 帧池耗尽丢弃的帧数
+
+        explicit ScaleGroup(const Resolution& outputSize) : size(outputSize), exhausted(0) {}
+    };
+
+    std::string m_outputDir;  // 输出目录
+    std::vector<RenditionSettings> m_renditions;  // 副本列表
+    std::vector<std::unique_ptr<ScaleGroup>> m_groups;  // 正在录制的副本（按输出尺寸分组）
+    mutable std::mutex m_mutex;  // 保护副本列表和分组（processFrame在订阅线程中调用）
+    std::atomic<bool> m_isRecording;  // 是否正在录制
+};
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <utility>
+
+// 无等待三缓冲：单生产者单消费者的"最新值优先"传递
+// 生产者写入永不阻塞，消费者总是拿到最新一次完整写入的值，中间值会被覆盖
+template <typename T>
+class TripleBuffer {
+public:
+    TripleBuffer() : m_middle(1), m_writeIndex(0), m_readIndex(2) {}
+
+    TripleBuffer(const TripleBuffer&) = delete;
+    TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+    // 生产者：写入新值并发布
+    void write(const T& value) {
+        m_buffers[m_writeIndex] = value;
+        publish();
+    }
+
+    // 生产者：移动写入新值并发布
+    void write(T&& value) {
+        m_buffers[m_writeIndex] = std::move(value);
+        publish();
+    }
+
+    // 消费者：是否有尚未取走的新值
+    bool hasNewValue() const {
+        return (m_middle.load(std::memory_order_relaxed) & kDirtyBit) != 0;
+    }
+
+    // 消费者：如果有新值则切换到最新值，返回是否发生了切换
+    bool update() {
+        if (!hasNewValue()) {
+            return false;
+        }
+
+        // 用已读完的缓冲区换回中间缓冲区
+        uint8_t previous = m_middle.exchange(m_readIndex, std::memory_order_acq_rel);
+        m_readIndex = previous & kIndexMask;
+        return true;
+    }
+
+    // 消费者：当前读取的值（update之间保持不变）
+    const T& front() const { return m_buffers[m_readIndex]; }
+    T& front() { return m_buffers[m_readIndex]; }
+
+private:
+    static constexpr uint8_t kIndexMask = 0x3;
+    static constexpr uint8_t kDirtyBit = 0x4;
+
+    // 将写好的缓冲区与中间缓冲区交换，并标记有新值
+    void publish() {
+        uint8_t previous = m_middle.exchange(m_writeIndex | kDirtyBit, std::memory_order_acq_rel);
+        m_writeIndex = previous & kIndexMask;
+    }
+
+    T m_buffers[3];  // 三个缓冲区
+    alignas(64) std::atomic<uint8_t> m_middle;  // 中间缓冲区索引和新值标记
+    alignas(64) uint8_t m_writeIndex;  // 生产者独占的缓冲区索引
+    alignas(64) uint8_t m_readIndex;  // 消费者独占的缓冲区索引
+};
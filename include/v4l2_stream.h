@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <linux/videodev2.h>
+
+// 出队的V4L2缓冲区（数据指向mmap映射的内存，重新入队前有效）
+struct V4L2Buffer {
+    int index;              // 缓冲区索引
+    const uint8_t* data;    // 映射后的数据指针
+    size_t bytesUsed;       // 有效数据长度
+    uint32_t sequence;      // 驱动帧序号
+    int64_t timestampUs;    // 内核时间戳（微秒）
+
+    V4L2Buffer() : index(-1), data(nullptr), bytesUsed(0), sequence(0), timestampUs(0) {}
+};
+
+// V4L2 mmap流式采集引擎，直接驱动已打开的设备文件描述符
+class V4L2Stream {
+public:
+    V4L2Stream();
+    ~V4L2Stream();
+
+    // 在已打开并设置好格式的设备上申请并映射缓冲区
+    bool open(int fd, int bufferCount = 4);
+
+    // 取消映射并释放缓冲区
+    void close();
+
+    // 所有缓冲区入队并开启视频流
+    bool start();
+
+    // 关闭视频流
+    void stop();
+
+    // 等待内核通知后出队一帧，超时、被中断或出错返回false
+    bool dequeue(V4L2Buffer& buffer, int timeoutMs = 2000);
+
+    // 唤醒阻塞在dequeue中的线程（可从任意线程调用）
+    void interrupt();
+
+    // 最近一次dequeue是否因interrupt返回
+    bool wasInterrupted() const { return m_interrupted; }
+
+    // 最近一次dequeue是否因超时（或没有可出队的帧）返回，此时可以继续等待
+    bool wasTimedOut() const { return m_timedOut; }
+
+    // 将缓冲区重新入队
+    bool requeue(const V4L2Buffer& buffer);
+
+    // 是否已映射缓冲区
+    bool isOpen() const { return !m_buffers.empty(); }
+
+    // 是否正在推流
+    bool isStreaming() const { return m_isStreaming; }
+
+    // 获取映射的缓冲区数量
+    int getBufferCount() const { return static_cast<int>(m_buffers.size()); }
+
+private:
+    // 映射的缓冲区
+    struct MappedBuffer {
+        void* start;
+        size_t length;
+    };
+
+    int m_fd;  // 设备文件描述符（不持有所有权）
+    int m_epollFd;  // 同时等待设备和唤醒事件的epoll
+    int m_wakeupFd;  // 用于中断等待的eventfd
+    bool m_interrupted;  // 最近一次等待是否被中断
+    bool m_timedOut;  // 最近一次等待是否超时
+    std::vector<MappedBuffer> m_buffers;  // 映射的缓冲区列表
+    bool m_isStreaming;  // 是否正在推流
+
+    // 带EINTR重试的ioctl
+    static int xioctl(int fd, unsigned long request, void* arg);
+
+    // 创建epoll和eventfd
+    bool createEventFds();
+
+    // 关闭epoll和eventfd
+    void closeEventFds();
+};
@@ -1,12 +1,26 @@
 #pragma once
 
 #include "camera_device.h"
+#include "v4l2_stream.h"
+#include "frame_pool.h"
+#include "frame_bus.h"
 #include <opencv2/opencv.hpp>
 #include <functional>
 #include <thread>
 #include <mutex>
 #include <atomic>
 
+// 采集时序统计
+struct CaptureStats {
+    uint64_t frameCount;      // 已采集帧数
+    uint64_t droppedFrames;   // 驱动序号跳变推算的丢帧数
+    double meanIntervalMs;    // 平均帧间隔（毫秒）
+    double jitterMs;          // 帧间隔标准差（毫秒）
+    double maxIntervalMs;     // 最大帧间隔（毫秒）
+
+    CaptureStats() : frameCount(0), droppedFrames(0), meanIntervalMs(0.0), jitterMs(0.0), maxIntervalMs(0.0) {}
+};
+
 // 视频采集类
 class VideoCapture {
 public:
@@ -14,7 +28,7 @@ public:
     ~VideoCapture();
 
     // 初始化视频采集
-    bool init(CameraDevice& device, const Resolution& resolution, int framerate);
+    bool init(CameraDevice& device, const Resolution& resolution, const FrameRate& framerate);
     
     // 开始采集
     bool start();
@@ -22,11 +36,30 @@ public:
     // 停止采集
     void stop();
     
-    // 获取当前帧
-    cv::Mat getCurrentFrame();
+    // 获取当前帧（共享帧池缓冲区，不拷贝）
+    FrameRef getCurrentFrame();
     
-    // 设置帧回调函数
-    void setFrameCallback(std::function<void(const cv::Mat&)> callback);
+    // 设置帧回调函数（BGR格式，在采集线程内联执行，只适合极轻量的处理）
+    void setFrameCallback(std::function<void(const FrameRef&)> callback);
+
+    // 获取帧分发总线（BGR格式，每个订阅者在独立线程中处理，不影响采集）
+    FrameBus& getFrameBus() { return m_frameBus; }
+
+    // 获取设备格式帧分发总线：发布设备输出的原样数据（MJPEG为未解码的JPEG，YUYV/GREY等为未转换的图像），
+    // 供直通录制和原始录制使用；帧没有行结构（step为0，数据长度为bytesUsed），仅V4L2 mmap采集路径，有订阅者时才拷贝
+    FrameBus& getNativeFrameBus() { return m_nativeFrameBus; }
+
+    // 设备输出的像素格式（V4L2 fourcc）
+    uint32_t getPixelFormat() const { return m_format.pixelformat; }
+
+    // 设备输出是否为压缩格式（MJPEG/JPEG）
+    bool isCompressedFormat() const;
+
+    // 设置是否解码为BGR（默认开启）；只做直通录制、不需要预览时关闭，省去解码开销
+    void setDecodeEnabled(bool enabled) { m_decodeEnabled = enabled; }
+
+    // 设置原始帧回调函数（设备输出格式，Mat直接引用V4L2缓冲区，仅在回调期间有效）
+    void setRawFrameCallback(std::function<void(const cv::Mat&, uint32_t)> callback);
     
     // 是否正在采集
     bool isCapturing() const { return m_isCapturing; }
@@ -35,23 +68,81 @@ public:
     Resolution getCurrentResolution() const { return m_currentResolution; }
     
     // 获取当前帧率
-    int getCurrentFramerate() const { return m_currentFramerate; }
+    int getCurrentFramerate() const { return m_currentFramerate.rounded(); }
+
+    // 获取当前帧率的分数形式（如30000/1001）
+    const FrameRate& getCurrentFramerateFraction() const { return m_currentFramerate; }
+
+    // 是否使用V4L2 mmap直接采集（否则为GStreamer后备路径）
+    bool isUsingNativeStream() const { return m_useNativeStream; }
+
+    // 获取采集时序统计（帧间隔和抖动）
+    CaptureStats getCaptureStats();
+
+    // 设置帧池缓冲区数量（下次init时生效）
+    void setFramePoolSize(size_t slotCount) { m_framePoolSize = slotCount; }
+
+    // 获取帧池统计
+    FramePoolStats getFramePoolStats() const { return m_framePool.getStats(); }
 
 private:
     CameraDevice* m_device;  // 摄像头设备
     Resolution m_currentResolution;  // 当前分辨率
-    int m_currentFramerate;  // 当前帧率
+    FrameRate m_currentFramerate;  // 当前帧率（驱动实际设置的值）
     
     std::atomic<bool> m_isCapturing;  // 是否正在采集
+    bool m_useNativeStream;  // 是否使用V4L2 mmap采集
+    V4L2Stream m_stream;  // V4L2 mmap流
+    v4l2_pix_format m_format;  // 采集时的像素格式
+
+    FramePool m_framePool;  // BGR帧缓冲池
+    size_t m_framePoolSize;  // 帧池缓冲区数量
+    uint64_t m_frameSequence;  // 帧序号
+    std::atomic<bool> m_decodeEnabled;  // 是否解码为BGR
+
+    FramePool m_nativePool;  // 设备格式帧缓冲池（按驱动给出的最大帧大小、4096字节对齐，第一次发布时分配）
+    size_t m_nativeFrameSize;  // 设备格式帧缓冲区大小
+    uint64_t m_nativeSequence;  // 设备格式帧序号
+
+    std::mutex m_statsMutex;  // 统计互斥锁
+    CaptureStats m_stats;  // 采集时序统计
+    double m_intervalM2;  // 帧间隔方差累加量（Welford算法）
+    int64_t m_lastTimestampUs;  // 上一帧时间戳
+    uint32_t m_lastSequence;  // 上一帧驱动序号
+
     std::thread m_captureThread;  // 采集线程
     std::mutex m_frameMutex;  // 帧互斥锁
-    cv::Mat m_currentFrame;  // 当前帧
+    FrameRef m_currentFrame;  // 当前帧
     
-    std::function<void(const cv::Mat&)> m_frameCallback;  // 帧回调函数
+    FrameBus m_frameBus;  // 帧分发总线
+    FrameBus m_nativeFrameBus;  // 设备格式帧分发总线
+    std::function<void(const FrameRef&)> m_frameCallback;  // 帧回调函数
+    std::function<void(const cv::Mat&, uint32_t)> m_rawFrameCallback;  // 原始帧回调函数
     
     // 采集线程函数
     void captureThreadFunc();
+
+    // V4L2 mmap采集循环
+    void captureWithV4L2();
+
+    // GStreamer后备采集循环
+    void captureWithGStreamer();
+
+    // 将设备输出的原始帧转换为BGR，写入目标Mat已有的缓冲区
+    bool convertToBgr(const cv::Mat& raw, uint32_t pixelFormat, cv::Mat& bgr);
+
+    // 从帧池取出一个缓冲区用于存放BGR帧，池耗尽时返回空句柄
+    FrameRef acquireFrame(int64_t timestampUs);
     
     // 处理采集到的帧
-    void processFrame(const cv::Mat& frame);
+    void processFrame(const FrameRef& frame);
+
+    // 把设备输出的帧拷贝出V4L2缓冲区并发布到设备格式帧总线
+    void publishNativeFrame(const V4L2Buffer& buffer);
+
+    // 重置时序统计
+    void resetStats();
+
+    // 用帧时间戳更新时序统计，hasSequence表示sequence来自驱动
+    void updateStats(int64_t timestampUs, uint32_t sequence, bool hasSequence);
 };
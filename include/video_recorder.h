@@ -1,10 +1,30 @@
 #pragma once
 
 #include "video_capture.h"
+#include "bounded_queue.h"
+#include "encoder_settings.h"
 #include <string>
 #include <opencv2/opencv.hpp>
 #include <mutex>
 #include <atomic>
+#include <thread>
+#include <memory>
+
+// 录制统计
+struct RecorderStats {
+    uint64_t queued;        // 已入队帧数
+    uint64_t encoded;       // 已编码帧数
+    uint64_t dropped;       // 编码队列满被丢弃的帧数
+    size_t queueDepth;      // 当前队列深度
+    size_t maxQueueDepth;   // 峰值队列深度
+    double lastEncodeMs;    // 最近一帧编码耗时（毫秒）
+    double maxEncodeMs;     // 最大编码耗时（毫秒）
+    double totalEncodeMs;   // 累计编码耗时（毫秒），两次采样之差除以编码帧数即平均耗时
+
+    RecorderStats()
+        : queued(0), encoded(0), dropped(0), queueDepth(0), maxQueueDepth(0),
+          lastEncodeMs(0.0), maxEncodeMs(0.0), totalEncodeMs(0.0) {}
+};
 
 // 视频录制类
 class VideoRecorder {
@@ -18,31 +38,77 @@ public:
     // 开始录制
     bool startRecording(const Resolution& resolution, int framerate);
     
-    // 停止录制
+    // 停止录制，等待编码线程写完队列中剩余的帧后关闭文件
     void stopRecording();
     
-    // 处理帧（由VideoCapture回调）
+    // 提交一帧给编码线程（只增加引用计数，不拷贝像素），不会阻塞调用者（Block策略除外）
+    void processFrame(const FrameRef& frame);
+
+    // 提交一帧Mat（会拷贝一份）
     void processFrame(const cv::Mat& frame);
+
+    // 设置编码队列深度和满时的策略（下次开始录制时生效）
+    // 队列中的帧占用采集帧池，深度应小于帧池大小
+    void setQueueDepth(size_t depth, QueuePolicy policy = QueuePolicy::DropOldest);
+
+    // 设置分段录制参数（下次开始录制时生效）
+    // OpenCV写入器不支持分片MP4，fragmented被忽略，只在帧边界关闭旧文件并打开新文件
+    void setSegmentSettings(const SegmentSettings& segment) { m_segment = segment; }
     
     // 是否正在录制
     bool isRecording() const { return m_isRecording; }
     
-    // 获取当前录制文件路径
-    std::string getCurrentFilePath() const { return m_currentFilePath; }
+    // 获取当前录制文件路径（分段录制时为正在写入的分段）
+    std::string getCurrentFilePath() const;
     
     // 获取录制时长（秒）
     double getRecordingDuration() const;
 
+    // 获取录制统计（入队、编码、丢弃的帧数）
+    RecorderStats getStats() const;
+
 private:
+    // 编码队列中的帧：帧池中的帧持有引用，外部Mat持有拷贝
+    struct EncoderItem {
+        FrameRef frame;
+        cv::Mat mat;
+    };
+
     std::string m_outputDir;  // 输出目录
     std::string m_currentFilePath;  // 当前录制文件路径
+    mutable std::mutex m_pathMutex;  // 保护m_currentFilePath（编码线程切换分段时更新）
     
-    cv::VideoWriter m_videoWriter;  // OpenCV视频写入器
-    std::mutex m_writerMutex;  // 写入器互斥锁
+    std::unique_ptr<cv::VideoWriter> m_videoWriter;  // OpenCV视频写入器（只在编码线程中写入）
+    Resolution m_resolution;  // 录制分辨率
+    int m_framerate;  // 录制帧率
+    SegmentSettings m_segment;  // 分段录制参数
     
     std::atomic<bool> m_isRecording;  // 是否正在录制
     std::chrono::time_point<std::chrono::steady_clock> m_startTime;  // 开始录制时间
+
+    size_t m_queueDepth;  // 编码队列深度
+    QueuePolicy m_queuePolicy;  // 编码队列策略
+    std::shared_ptr<BoundedQueue<EncoderItem>> m_queue;  // 编码队列（每次录制新建）
+    mutable std::mutex m_queueMutex;  // 保护m_queue指针的替换
+    std::thread m_encoderThread;  // 编码线程
+
+    std::atomic<uint64_t> m_encoded;  // 已编码帧数
+    std::atomic<int64_t> m_lastEncodeUs;  // 最近一帧编码耗时
+    std::atomic<int64_t> m_maxEncodeUs;  // 最大编码耗时
+    std::atomic<int64_t> m_totalEncodeUs;  // 累计编码耗时
     
+    // 编码线程函数
+    void encoderThreadFunc(std::shared_ptr<BoundedQueue<EncoderItem>> queue);
+
+    // 入队
+    void enqueue(EncoderItem item);
+
+    // 创建写入器，失败返回空指针
+    std::unique_ptr<cv::VideoWriter> openWriter(const std::string& filePath);
+
+    // 关闭当前分段并打开新分段（在编码线程中调用）
+    bool rollSegment();
+
     // 生成文件名（包含日期时间、分辨率和帧率）
     std::string generateFileName(const Resolution& resolution, int framerate);
 };
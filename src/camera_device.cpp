@@ -1,14 +1,51 @@
 #include "camera_device.h"
+#include "device_capability_cache.h"
+#include "format_negotiator.h"
 #include <iostream>
 #include <fcntl.h>
 #include <unistd.h>
 #include <sys/ioctl.h>
 #include <dirent.h>
 #include <string.h>
+#include <cstdio>
 #include <algorithm>
 #include <set>
 
-CameraDevice::CameraDevice() : m_fd(-1) {
+namespace {
+    // 展开帧间隔范围为帧率列表
+    void expandFrameIntervals(const FrameIntervalRange& range, std::vector<FrameRate>& framerates) {
+        FrameRate fastest = FrameRate::fromInterval(range.min);
+        framerates.push_back(fastest);
+        if (range.type == V4L2_FRMIVAL_TYPE_DISCRETE) {
+            return;
+        }
+
+        // 步进/连续范围：加入最低帧率和范围内的常见帧率，驱动设置时会调整到最接近的值
+        static const FrameRate commonFramerates[] = {
+            FrameRate(5), FrameRate(10), FrameRate(15), FrameRate(20), FrameRate(24000, 1001),
+            FrameRate(24), FrameRate(25), FrameRate(30000, 1001), FrameRate(30), FrameRate(50),
+            FrameRate(60000, 1001), FrameRate(60), FrameRate(90), FrameRate(120)
+        };
+
+        FrameRate slowest = FrameRate::fromInterval(range.max);
+        if (slowest.isValid()) {
+            framerates.push_back(slowest);
+        }
+        for (const auto& fps : commonFramerates) {
+            if (!(fastest < fps) && !(fps < slowest)) {
+                framerates.push_back(fps);
+            }
+        }
+    }
+}
+
+CameraDevice::CameraDevice() : m_fd(-1), m_negotiationPlan(new NegotiationPlan()), m_requiredPixelFormat(0) {
+    memset(&m_currentFormat, 0, sizeof(m_currentFormat));
+
+    std::string cachePath = DeviceCapabilityCache::getDefaultPath();
+    if (!cachePath.empty()) {
+        m_capabilityCache = std::make_shared<DeviceCapabilityCache>(cachePath);
+    }
 }
 
 CameraDevice::~CameraDevice() {
@@ -40,26 +77,9 @@ std::vector<CameraDeviceInfo> CameraDevice::scanDevices() {
                 continue;  // 无法打开，跳过
             }
             
-            // 获取设备信息
-            struct v4l2_capability cap;
-            if (ioctl(fd, VIDIOC_QUERYCAP, &cap) < 0) {
-                close(fd);
-                continue;  // 无法获取设备信息，跳过
-            }
-            
-            // 检查是否为视频捕获设备
-            if (!(cap.capabilities & V4L2_CAP_VIDEO_CAPTURE)) {
-                close(fd);
-                continue;  // 不是视频捕获设备，跳过
-            }
-            
-            // 创建设备信息
+            // 获取设备信息和能力（键未变化时直接使用缓存）
             CameraDeviceInfo deviceInfo;
-            deviceInfo.devicePath = devicePath;
-            deviceInfo.deviceName = reinterpret_cast<const char*>(cap.card);
-            
-            // 查询设备支持的格式
-            if (queryDeviceFormats(deviceInfo)) {
+            if (probeDevice(fd, devicePath, deviceInfo)) {
                 devices.push_back(deviceInfo);
             }
             
@@ -68,9 +88,31 @@ std::vector<CameraDeviceInfo> CameraDevice::scanDevices() {
     }
     
     closedir(dir);
+
+    // 把新查询到的设备能力写入缓存文件
+    if (m_capabilityCache) {
+        m_capabilityCache->flush();
+    }
+
     return devices;
 }
 
+bool CameraDevice::probeDevicePath(const std::string& devicePath, CameraDeviceInfo& deviceInfo) {
+    int fd = open(devicePath.c_str(), O_RDWR);
+    if (fd < 0) {
+        return false;
+    }
+
+    bool ok = probeDevice(fd, devicePath, deviceInfo);
+    close(fd);
+
+    if (ok && m_capabilityCache) {
+        m_capabilityCache->flush();
+    }
+
+    return ok;
+}
+
 bool CameraDevice::openDevice(const std::string& devicePath) {
     // 关闭已打开的设备
     closeDevice();
@@ -82,108 +124,90 @@ bool CameraDevice::openDevice(const std::string& devicePath) {
         return false;
     }
     
-    // 获取设备信息
-    struct v4l2_capability cap;
-    if (ioctl(m_fd, VIDIOC_QUERYCAP, &cap) < 0) {
-        std::cerr << "无法获取设备信息" << std::endl;
-        closeDevice();
-        return false;
-    }
-    
-    // 检查是否为视频捕获设备
-    if (!(cap.capabilities & V4L2_CAP_VIDEO_CAPTURE)) {
-        std::cerr << "不是视频捕获设备" << std::endl;
+    // 获取设备信息和支持的格式
+    CameraDeviceInfo deviceInfo;
+    if (!probeDevice(m_fd, devicePath, deviceInfo)) {
+        std::cerr << "不是可用的视频捕获设备: " << devicePath << std::endl;
         closeDevice();
         return false;
     }
-    
+
     // 设置当前设备信息
-    m_currentDevice.devicePath = devicePath;
-    m_currentDevice.deviceName = reinterpret_cast<const char*>(cap.card);
-    
-    // 查询设备支持的格式
-    if (!queryDeviceFormats(m_currentDevice)) {
-        closeDevice();
-        return false;
+    m_currentDevice = deviceInfo;
+
+    if (m_capabilityCache) {
+        m_capabilityCache->flush();
     }
     
     return true;
 }
 
+void CameraDevice::setCapabilityCachePath(const std::string& path) {
+    if (path.empty()) {
+        m_capabilityCache.reset();
+    } else {
+        m_capabilityCache = std::make_shared<DeviceCapabilityCache>(path);
+    }
+}
+
 void CameraDevice::closeDevice() {
     if (m_fd >= 0) {
         close(m_fd);
         m_fd = -1;
     }
+
+    memset(&m_currentFormat, 0, sizeof(m_currentFormat));
+    m_currentFramerate = FrameRate();
+    *m_negotiationPlan = NegotiationPlan();
 }
 
 std::vector<Resolution> CameraDevice::getSupportedResolutions() {
     return m_currentDevice.supportedResolutions;
 }
 
-std::vector<int> CameraDevice::getSupportedFramerates(const Resolution& resolution) {
-    if (m_fd < 0) {
-        return {};
-    }
-    
-    std::vector<int> framerates;
-    
-    // 设置格式
-    struct v4l2_format fmt;
-    memset(&fmt, 0, sizeof(fmt));
-    fmt.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-    fmt.fmt.pix.width = resolution.width;
-    fmt.fmt.pix.height = resolution.height;
-    fmt.fmt.pix.pixelformat = V4L2_PIX_FMT_YUYV;  // 使用常见的YUYV格式
-    fmt.fmt.pix.field = V4L2_FIELD_ANY;
-    
-    if (ioctl(m_fd, VIDIOC_S_FMT, &fmt) < 0) {
-        return {};
-    }
-    
-    // 查询支持的帧率
-    struct v4l2_streamparm parm;
-    memset(&parm, 0, sizeof(parm));
-    parm.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-    
-    if (ioctl(m_fd, VIDIOC_G_PARM, &parm) < 0) {
-        return {};
-    }
-    
-    // 检查是否支持设置帧率
-    if (!(parm.parm.capture.capability & V4L2_CAP_TIMEPERFRAME)) {
-        // 不支持设置帧率，返回默认帧率
-        framerates.push_back(30);
-        return framerates;
-    }
-    
-    // 常见帧率列表
-    std::vector<int> commonFramerates = {15, 30, 60};
-    
-    for (int fps : commonFramerates) {
-        parm.parm.capture.timeperframe.numerator = 1;
-        parm.parm.capture.timeperframe.denominator = fps;
-        
-        // 尝试设置帧率
-        if (ioctl(m_fd, VIDIOC_S_PARM, &parm) >= 0) {
-            // 获取实际设置的帧率
-            int actualFps = parm.parm.capture.timeperframe.denominator / 
-                           parm.parm.capture.timeperframe.numerator;
-            
-            // 添加到列表（避免重复）
-            if (std::find(framerates.begin(), framerates.end(), actualFps) == framerates.end()) {
-                framerates.push_back(actualFps);
-            }
+std::vector<FrameRate> CameraDevice::getSupportedFramerates(const Resolution& resolution, uint32_t pixelFormat) const {
+    std::vector<FrameRate> framerates;
+
+    for (const auto& format : m_currentDevice.formats) {
+        if (pixelFormat != 0 && format.pixelFormat != pixelFormat) {
+            continue;
         }
+
+        auto formatFramerates = format.getFramerates(resolution.width, resolution.height);
+        framerates.insert(framerates.end(), formatFramerates.begin(), formatFramerates.end());
     }
-    
+
+    // 从高到低排序并去重
+    std::sort(framerates.begin(), framerates.end(),
+              [](const FrameRate& a, const FrameRate& b) { return b < a; });
+    framerates.erase(std::unique(framerates.begin(), framerates.end()), framerates.end());
+
     return framerates;
 }
 
-bool CameraDevice::setResolutionAndFramerate(const Resolution& resolution, int framerate) {
+NegotiationPlan CameraDevice::planFormat(const Resolution& resolution, const FrameRate& framerate) const {
+    FormatNegotiator negotiator;
+    negotiator.setRequiredFormat(m_requiredPixelFormat);
+    return negotiator.plan(m_currentDevice, resolution, framerate);
+}
+
+bool CameraDevice::setResolutionAndFramerate(const Resolution& resolution, const FrameRate& framerate) {
     if (m_fd < 0) {
         return false;
     }
+
+    // 根据总线带宽和处理代价选择像素格式，没有可用格式时退回YUYV
+    NegotiationPlan plan = planFormat(resolution, framerate);
+    if (plan.valid) {
+        std::cout << "格式协商: " << plan.reason << std::endl;
+    } else if (m_requiredPixelFormat != 0) {
+        std::cerr << "格式协商失败: " << plan.reason << std::endl;
+        return false;
+    } else {
+        std::cerr << "格式协商失败（" << plan.reason << "），使用YUYV" << std::endl;
+        plan.pixelFormat = V4L2_PIX_FMT_YUYV;
+        plan.framerate = framerate;
+    }
     
     // 设置格式
     struct v4l2_format fmt;
@@ -191,13 +215,17 @@ bool CameraDevice::setResolutionAndFramerate(const Resolution& resolution, int f
     fmt.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
     fmt.fmt.pix.width = resolution.width;
     fmt.fmt.pix.height = resolution.height;
-    fmt.fmt.pix.pixelformat = V4L2_PIX_FMT_YUYV;  // 使用常见的YUYV格式
+    fmt.fmt.pix.pixelformat = plan.pixelFormat;
     fmt.fmt.pix.field = V4L2_FIELD_ANY;
     
     if (ioctl(m_fd, VIDIOC_S_FMT, &fmt) < 0) {
         std::cerr << "无法设置视频格式" << std::endl;
         return false;
     }
+
+    // 保存驱动实际协商的格式（驱动可能调整分辨率和行跨度）
+    m_currentFormat = fmt.fmt.pix;
+    *m_negotiationPlan = plan;
     
     // 设置帧率
     struct v4l2_streamparm parm;
@@ -215,81 +243,271 @@ bool CameraDevice::setResolutionAndFramerate(const Resolution& resolution, int f
         return false;
     }
     
-    parm.parm.capture.timeperframe.numerator = 1;
-    parm.parm.capture.timeperframe.denominator = framerate;
+    // 帧间隔是帧率的倒数（请求的帧率无法满足时使用协商后的帧率）
+    parm.parm.capture.timeperframe.numerator = plan.framerate.denominator;
+    parm.parm.capture.timeperframe.denominator = plan.framerate.numerator;
     
     if (ioctl(m_fd, VIDIOC_S_PARM, &parm) < 0) {
         std::cerr << "无法设置帧率" << std::endl;
         return false;
     }
+
+    // 驱动会把帧率调整到最接近的支持值
+    m_currentFramerate = FrameRate::fromInterval(parm.parm.capture.timeperframe);
+    if (!m_currentFramerate.isValid()) {
+        m_currentFramerate = plan.framerate;
+    }
     
     return true;
 }
 
-bool CameraDevice::queryDeviceFormats(CameraDeviceInfo& deviceInfo) {
-    int fd = -1;
-    
-    // 如果已经打开设备，使用当前文件描述符
-    if (m_fd >= 0 && deviceInfo.devicePath == m_currentDevice.devicePath) {
-        fd = m_fd;
-    } else {
-        // 否则打开设备
-        fd = open(deviceInfo.devicePath.c_str(), O_RDWR);
-        if (fd < 0) {
+bool CameraDevice::probeDevice(int fd, const std::string& devicePath, CameraDeviceInfo& deviceInfo) {
+    // 获取设备信息
+    struct v4l2_capability cap;
+    memset(&cap, 0, sizeof(cap));
+    if (ioctl(fd, VIDIOC_QUERYCAP, &cap) < 0) {
+        return false;
+    }
+
+    // 检查是否为视频捕获设备（同一物理设备的元数据节点只在device_caps中区分）
+    uint32_t caps = (cap.capabilities & V4L2_CAP_DEVICE_CAPS) ? cap.device_caps : cap.capabilities;
+    if (!(caps & V4L2_CAP_VIDEO_CAPTURE)) {
+        return false;
+    }
+
+    deviceInfo.devicePath = devicePath;
+    deviceInfo.deviceName = reinterpret_cast<const char*>(cap.card);
+    deviceInfo.busInfo = reinterpret_cast<const char*>(cap.bus_info);
+    deviceInfo.driver = reinterpret_cast<const char*>(cap.driver);
+    deviceInfo.driverVersion = cap.version;
+    deviceInfo.busSpeedMbps = FormatNegotiator::detectUsbSpeed(devicePath);
+
+    // 优先使用缓存，键变化（换了设备或驱动升级）时重新查询
+    bool cached = m_capabilityCache && m_capabilityCache->lookup(deviceInfo);
+
+    // 键相同但设备实际不同（同名不同固件等）时像素格式通常不同：只枚举格式（不枚举尺寸和帧间隔），
+    // 缓存的格式按顺序都在其中才使用缓存（没有尺寸的格式不进缓存，所以不要求完全相同）
+    if (cached) {
+        struct v4l2_fmtdesc fmtdesc;
+        memset(&fmtdesc, 0, sizeof(fmtdesc));
+        fmtdesc.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        size_t matched = 0;
+        while (matched < deviceInfo.formats.size() && ioctl(fd, VIDIOC_ENUM_FMT, &fmtdesc) >= 0) {
+            if (fmtdesc.pixelformat == deviceInfo.formats[matched].pixelFormat) {
+                matched++;
+            }
+            fmtdesc.index++;
+        }
+        if (matched != deviceInfo.formats.size()) {
+            std::cout << "设备能力缓存与设备不一致，重新查询: " << devicePath << std::endl;
+            m_capabilityCache->invalidate(deviceInfo.getCacheKey());
+            cached = false;
+        }
+    }
+
+    if (!cached) {
+        if (!queryDeviceFormats(fd, deviceInfo)) {
             return false;
         }
+        if (m_capabilityCache) {
+            m_capabilityCache->store(deviceInfo);
+        }
     }
-    
+
+    buildResolutionList(deviceInfo);
+    return !deviceInfo.supportedResolutions.empty();
+}
+
+bool CameraDevice::queryDeviceFormats(int fd, CameraDeviceInfo& deviceInfo) {
     // 查询支持的格式
     struct v4l2_fmtdesc fmtdesc;
     memset(&fmtdesc, 0, sizeof(fmtdesc));
     fmtdesc.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
     
-    std::set<Resolution> resolutions;
+    deviceInfo.formats.clear();
     
     // 遍历所有支持的格式
     while (ioctl(fd, VIDIOC_ENUM_FMT, &fmtdesc) >= 0) {
-        // 查询该格式支持的分辨率
+        FormatCapability format;
+        format.pixelFormat = fmtdesc.pixelformat;
+        format.description = reinterpret_cast<const char*>(fmtdesc.description);
+
+        // 查询该格式支持的分辨率，步进/连续类型只记录范围
         struct v4l2_frmsizeenum frmsize;
         memset(&frmsize, 0, sizeof(frmsize));
         frmsize.pixel_format = fmtdesc.pixelformat;
         frmsize.index = 0;
         
         while (ioctl(fd, VIDIOC_ENUM_FRAMESIZES, &frmsize) >= 0) {
+            FrameSizeRange range;
+            range.type = frmsize.type;
             if (frmsize.type == V4L2_FRMSIZE_TYPE_DISCRETE) {
-                // 离散分辨率
-                Resolution res(frmsize.discrete.width, frmsize.discrete.height);
-                resolutions.insert(res);
-            } else if (frmsize.type == V4L2_FRMSIZE_TYPE_STEPWISE) {
-                // 步进分辨率，添加一些常见分辨率
-                for (uint32_t width = frmsize.stepwise.min_width; 
-                     width <= frmsize.stepwise.max_width; 
-                     width += frmsize.stepwise.step_width) {
-                    for (uint32_t height = frmsize.stepwise.min_height; 
-                         height <= frmsize.stepwise.max_height; 
-                         height += frmsize.stepwise.step_height) {
-                        Resolution res(width, height);
-                        resolutions.insert(res);
-                    }
-                }
+                range.minWidth = range.maxWidth = frmsize.discrete.width;
+                range.minHeight = range.maxHeight = frmsize.discrete.height;
+            } else {
+                range.minWidth = frmsize.stepwise.min_width;
+                range.maxWidth = frmsize.stepwise.max_width;
+                range.stepWidth = std::max<uint32_t>(frmsize.stepwise.step_width, 1);
+                range.minHeight = frmsize.stepwise.min_height;
+                range.maxHeight = frmsize.stepwise.max_height;
+                range.stepHeight = std::max<uint32_t>(frmsize.stepwise.step_height, 1);
+            }
+            format.frameSizes.push_back(range);
+
+            // 步进/连续类型只有一项
+            if (frmsize.type != V4L2_FRMSIZE_TYPE_DISCRETE) {
+                break;
             }
-            
             frmsize.index++;
         }
         
+        // 查询每个候选分辨率支持的帧间隔（只读查询，不改变设备当前格式）
+        for (const auto& range : format.frameSizes) {
+            for (const auto& res : expandFrameSizes(range)) {
+                SizeFrameIntervals sizeIntervals;
+                sizeIntervals.width = res.width;
+                sizeIntervals.height = res.height;
+                sizeIntervals.intervals = queryFrameIntervals(fd, format.pixelFormat, res.width, res.height);
+                if (!sizeIntervals.intervals.empty()) {
+                    format.frameIntervals.push_back(sizeIntervals);
+                }
+            }
+        }
+
+        if (!format.frameSizes.empty()) {
+            deviceInfo.formats.push_back(format);
+        }
         fmtdesc.index++;
     }
     
+    return !deviceInfo.formats.empty();
+}
+
+std::vector<FrameIntervalRange> CameraDevice::queryFrameIntervals(int fd, uint32_t pixelFormat,
+                                                                 uint32_t width, uint32_t height) {
+    std::vector<FrameIntervalRange> intervals;
+
+    struct v4l2_frmivalenum frmival;
+    memset(&frmival, 0, sizeof(frmival));
+    frmival.pixel_format = pixelFormat;
+    frmival.width = width;
+    frmival.height = height;
+
+    while (ioctl(fd, VIDIOC_ENUM_FRAMEINTERVALS, &frmival) >= 0) {
+        FrameIntervalRange range;
+        range.type = frmival.type;
+        if (frmival.type == V4L2_FRMIVAL_TYPE_DISCRETE) {
+            range.min = range.max = frmival.discrete;
+        } else {
+            range.min = frmival.stepwise.min;
+            range.max = frmival.stepwise.max;
+            range.step = frmival.stepwise.step;
+        }
+
+        // 过滤驱动返回的无效分数
+        if (range.min.numerator > 0 && range.min.denominator > 0) {
+            intervals.push_back(range);
+        }
+
+        // 步进/连续类型只有一项
+        if (frmival.type != V4L2_FRMIVAL_TYPE_DISCRETE) {
+            break;
+        }
+        frmival.index++;
+    }
+
+    return intervals;
+}
+
+std::vector<Resolution> CameraDevice::expandFrameSizes(const FrameSizeRange& range) {
+    // 步进/连续范围内只列出常见分辨率和范围端点，避免展开成海量条目
+    static const Resolution commonResolutions[] = {
+        Resolution(160, 120), Resolution(320, 240), Resolution(640, 360),
+        Resolution(640, 480), Resolution(800, 600), Resolution(1024, 768),
+        Resolution(1280, 720), Resolution(1280, 960), Resolution(1280, 1024),
+        Resolution(1600, 1200), Resolution(1920, 1080), Resolution(2560, 1440),
+        Resolution(3840, 2160)
+    };
+
+    std::vector<Resolution> resolutions;
+    resolutions.push_back(Resolution(range.minWidth, range.minHeight));
+    if (range.type == V4L2_FRMSIZE_TYPE_DISCRETE) {
+        return resolutions;
+    }
+
+    for (const auto& res : commonResolutions) {
+        if (range.contains(res.width, res.height)) {
+            resolutions.push_back(res);
+        }
+    }
+    if (range.maxWidth != range.minWidth || range.maxHeight != range.minHeight) {
+        resolutions.push_back(Resolution(range.maxWidth, range.maxHeight));
+    }
+
+    return resolutions;
+}
+
+void CameraDevice::buildResolutionList(CameraDeviceInfo& deviceInfo) {
+    std::set<Resolution> resolutions;
+    for (const auto& format : deviceInfo.formats) {
+        for (const auto& range : format.frameSizes) {
+            for (const auto& res : expandFrameSizes(range)) {
+                resolutions.insert(res);
+            }
+        }
+    }
+
     // 将分辨率集合转换为向量
-    deviceInfo.supportedResolutions.clear();
-    for (const auto& res : resolutions) {
-        deviceInfo.supportedResolutions.push_back(res);
+    deviceInfo.supportedResolutions.assign(resolutions.begin(), resolutions.end());
+}
+
+bool FrameSizeRange::contains(uint32_t width, uint32_t height) const {
+    if (width < minWidth || width > maxWidth || height < minHeight || height > maxHeight) {
+        return false;
     }
-    
-    // 如果不是当前打开的设备，关闭文件描述符
-    if (fd != m_fd) {
-        close(fd);
+    if (type == V4L2_FRMSIZE_TYPE_DISCRETE) {
+        return true;
     }
-    
-    return !deviceInfo.supportedResolutions.empty();
+    return (width - minWidth) % stepWidth == 0 && (height - minHeight) % stepHeight == 0;
+}
+
+bool FormatCapability::supportsSize(uint32_t width, uint32_t height) const {
+    for (const auto& range : frameSizes) {
+        if (range.contains(width, height)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+std::vector<FrameRate> FormatCapability::getFramerates(uint32_t width, uint32_t height) const {
+    std::vector<FrameRate> framerates;
+    for (const auto& sizeIntervals : frameIntervals) {
+        if (sizeIntervals.width == width && sizeIntervals.height == height) {
+            for (const auto& range : sizeIntervals.intervals) {
+                expandFrameIntervals(range, framerates);
+            }
+        }
+    }
+
+    std::sort(framerates.begin(), framerates.end(),
+              [](const FrameRate& a, const FrameRate& b) { return b < a; });
+    framerates.erase(std::unique(framerates.begin(), framerates.end()), framerates.end());
+    return framerates;
+}
+
+std::string FrameRate::toString() const {
+    if (denominator == 1 || numerator % denominator == 0) {
+        return std::to_string(numerator / denominator);
+    }
+
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%.2f", toDouble());
+    return buffer;
+}
+
+std::string CameraDeviceInfo::getCacheKey() const {
+    // 同一USB口换插另一型号的摄像头时总线信息和驱动都不变，加上设备名称区分；
+    // 同一总线上可能有多个捕获节点（如多路输出的设备），加上节点路径区分
+    return driver + "|" + busInfo + "|" + std::to_string(driverVersion) + "|" + deviceName + "|" + devicePath;
 }
@@ -0,0 +1,527 @@
+#include "color_convert.h"
+#include <iostream>
+#include <atomic>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define COLOR_CONVERT_X86 1
+#include <immintrin.h>
+#endif
+
+#if defined(__aarch64__) || defined(__ARM_NEON)
+#define COLOR_CONVERT_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace ColorConvert {
+
+namespace {
+
+// 定点系数（6位小数）：
+// R = 1.164(Y-16) + 1.596(V-128)
+// G = 1.164(Y-16) - 0.391(U-128) - 0.813(V-128)
+// B = 1.164(Y-16) + 2.018(U-128)
+const int kYScale = 74;
+const int kVToR = 102;
+const int kUToG = 25;
+const int kVToG = 52;
+const int kUToB = 129;
+const int kShift = 6;
+
+// 行转换函数：packed格式只用row，NV12用row（Y行）和uvRow
+typedef void (*RowFunc)(const uint8_t* row, const uint8_t* uvRow, uint8_t* dst, int width);
+
+inline uint8_t clampToByte(int value) {
+    return static_cast<uint8_t>(value < 0 ? 0 : (value > 255 ? 255 : value));
+}
+
+// 输出通道数
+template <TargetFormat D>
+constexpr int channelsOf() {
+    return D == TargetFormat::RGBA ? 4 : 3;
+}
+
+// 写出一个像素
+template <TargetFormat D>
+inline void storePixel(uint8_t* dst, int r, int g, int b) {
+    if (D == TargetFormat::BGR) {
+        dst[0] = clampToByte(b);
+        dst[1] = clampToByte(g);
+        dst[2] = clampToByte(r);
+    } else {
+        dst[0] = clampToByte(r);
+        dst[1] = clampToByte(g);
+        dst[2] = clampToByte(b);
+        if (D == TargetFormat::RGBA) {
+            dst[3] = 255;
+        }
+    }
+}
+
+// 读取第x个像素的Y、U、V
+template <SourceFormat S>
+inline void loadPixel(const uint8_t* row, const uint8_t* uvRow, int x, int& y, int& u, int& v) {
+    int pair = x >> 1;
+    if (S == SourceFormat::YUYV) {
+        y = row[x * 2];
+        u = row[pair * 4 + 1];
+        v = row[pair * 4 + 3];
+    } else if (S == SourceFormat::UYVY) {
+        y = row[x * 2 + 1];
+        u = row[pair * 4];
+        v = row[pair * 4 + 2];
+    } else {
+        y = row[x];
+        u = uvRow[pair * 2];
+        v = uvRow[pair * 2 + 1];
+    }
+}
+
+// 标量实现，从第start个像素转换到行尾；也是向量化实现的尾部处理和正确性基准
+template <SourceFormat S, TargetFormat D>
+void convertRowScalarFrom(const uint8_t* row, const uint8_t* uvRow, uint8_t* dst, int start, int width) {
+    const int channels = channelsOf<D>();
+    for (int x = start; x < width; x++) {
+        int y, u, v;
+        loadPixel<S>(row, uvRow, x, y, u, v);
+
+        int c = (y - 16) * kYScale;
+        int d = u - 128;
+        int e = v - 128;
+        const int round = 1 << (kShift - 1);
+
+        int r = (c + kVToR * e + round) >> kShift;
+        int g = (c - kUToG * d - kVToG * e + round) >> kShift;
+        int b = (c + kUToB * d + round) >> kShift;
+        storePixel<D>(dst + x * channels, r, g, b);
+    }
+}
+
+template <SourceFormat S, TargetFormat D>
+void convertRowScalar(const uint8_t* row, const uint8_t* uvRow, uint8_t* dst, int width) {
+    convertRowScalarFrom<S, D>(row, uvRow, dst, 0, width);
+}
+
+#ifdef COLOR_CONVERT_X86
+
+#define TARGET_SSE41 __attribute__((target("sse4.1")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+
+// 读取16个像素：Y为16字节，U和V各为低8字节（每对像素共享一个色度）
+template <SourceFormat S>
+TARGET_SSE41 inline void load16(const uint8_t* row, const uint8_t* uvRow, int x,
+                                __m128i& y, __m128i& u, __m128i& v) {
+    if (S == SourceFormat::NV12) {
+        const __m128i uMask = _mm_setr_epi8(0, 2, 4, 6, 8, 10, 12, 14, -1, -1, -1, -1, -1, -1, -1, -1);
+        const __m128i vMask = _mm_setr_epi8(1, 3, 5, 7, 9, 11, 13, 15, -1, -1, -1, -1, -1, -1, -1, -1);
+        y = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + x));
+        __m128i uv = _mm_loadu_si128(reinterpret_cast<const __m128i*>(uvRow + x));
+        u = _mm_shuffle_epi8(uv, uMask);
+        v = _mm_shuffle_epi8(uv, vMask);
+        return;
+    }
+
+    // YUYV: Y在偶数字节，U在4n+1，V在4n+3；UYVY: Y在奇数字节，U在4n，V在4n+2
+    const bool yuyv = S == SourceFormat::YUYV;
+    const __m128i yMask = yuyv ?
+        _mm_setr_epi8(0, 2, 4, 6, 8, 10, 12, 14, -1, -1, -1, -1, -1, -1, -1, -1) :
+        _mm_setr_epi8(1, 3, 5, 7, 9, 11, 13, 15, -1, -1, -1, -1, -1, -1, -1, -1);
+    const __m128i uMask = yuyv ?
+        _mm_setr_epi8(1, 5, 9, 13, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1) :
+        _mm_setr_epi8(0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+    const __m128i vMask = yuyv ?
+        _mm_setr_epi8(3, 7, 11, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1) :
+        _mm_setr_epi8(2, 6, 10, 14, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+
+    __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + x * 2));
+    __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + x * 2 + 16));
+    y = _mm_unpacklo_epi64(_mm_shuffle_epi8(a, yMask), _mm_shuffle_epi8(b, yMask));
+    u = _mm_unpacklo_epi32(_mm_shuffle_epi8(a, uMask), _mm_shuffle_epi8(b, uMask));
+    v = _mm_unpacklo_epi32(_mm_shuffle_epi8(a, vMask), _mm_shuffle_epi8(b, vMask));
+}
+
+// 计算8个像素的R、G、B（16位，已右移但未饱和到8位）
+TARGET_SSE41 inline void yuvToRgb8(__m128i y16, __m128i d, __m128i e,
+                                   __m128i& r, __m128i& g, __m128i& b) {
+    const __m128i round = _mm_set1_epi16(1 << (kShift - 1));
+    __m128i c = _mm_mullo_epi16(_mm_sub_epi16(y16, _mm_set1_epi16(16)), _mm_set1_epi16(kYScale));
+
+    // 超出16位范围时饱和，结果仍会被限制到0或255，与标量实现一致
+    r = _mm_adds_epi16(c, _mm_mullo_epi16(e, _mm_set1_epi16(kVToR)));
+    g = _mm_subs_epi16(c, _mm_add_epi16(_mm_mullo_epi16(d, _mm_set1_epi16(kUToG)),
+                                        _mm_mullo_epi16(e, _mm_set1_epi16(kVToG))));
+    b = _mm_adds_epi16(c, _mm_mullo_epi16(d, _mm_set1_epi16(kUToB)));
+
+    r = _mm_srai_epi16(_mm_adds_epi16(r, round), kShift);
+    g = _mm_srai_epi16(_mm_adds_epi16(g, round), kShift);
+    b = _mm_srai_epi16(_mm_adds_epi16(b, round), kShift);
+}
+
+// 将16个像素的三个通道写出为BGR/RGB/RGBA
+template <TargetFormat D>
+TARGET_SSE41 inline void store16(uint8_t* dst, __m128i r, __m128i g, __m128i b) {
+    __m128i c0 = D == TargetFormat::BGR ? b : r;
+    __m128i c2 = D == TargetFormat::BGR ? r : b;
+    __m128i c3 = _mm_set1_epi8(static_cast<char>(0xFF));
+
+    // 交错为4字节像素
+    __m128i t0 = _mm_unpacklo_epi8(c0, g);
+    __m128i t1 = _mm_unpackhi_epi8(c0, g);
+    __m128i t2 = _mm_unpacklo_epi8(c2, c3);
+    __m128i t3 = _mm_unpackhi_epi8(c2, c3);
+    __m128i q0 = _mm_unpacklo_epi16(t0, t2);
+    __m128i q1 = _mm_unpackhi_epi16(t0, t2);
+    __m128i q2 = _mm_unpacklo_epi16(t1, t3);
+    __m128i q3 = _mm_unpackhi_epi16(t1, t3);
+
+    if (D == TargetFormat::RGBA) {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), q0);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 16), q1);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 32), q2);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 48), q3);
+        return;
+    }
+
+    // 去掉每个像素的第4字节（每个寄存器剩12字节，高4字节为0），再拼接成3个完整的16字节
+    const __m128i pack3 = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+    q0 = _mm_shuffle_epi8(q0, pack3);
+    q1 = _mm_shuffle_epi8(q1, pack3);
+    q2 = _mm_shuffle_epi8(q2, pack3);
+    q3 = _mm_shuffle_epi8(q3, pack3);
+
+    __m128i out0 = _mm_or_si128(q0, _mm_slli_si128(q1, 12));
+    __m128i out1 = _mm_or_si128(_mm_srli_si128(q1, 4), _mm_slli_si128(q2, 8));
+    __m128i out2 = _mm_or_si128(_mm_srli_si128(q2, 8), _mm_slli_si128(q3, 4));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), out0);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 16), out1);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 32), out2);
+}
+
+template <SourceFormat S, TargetFormat D>
+TARGET_SSE41 void convertRowSse41(const uint8_t* row, const uint8_t* uvRow, uint8_t* dst, int width) {
+    const int channels = channelsOf<D>();
+    const __m128i bias = _mm_set1_epi16(128);
+    int x = 0;
+
+    for (; x + 16 <= width; x += 16) {
+        __m128i y, u, v;
+        load16<S>(row, uvRow, x, y, u, v);
+
+        // 色度扩展到每个像素
+        __m128i d = _mm_sub_epi16(_mm_cvtepu8_epi16(u), bias);
+        __m128i e = _mm_sub_epi16(_mm_cvtepu8_epi16(v), bias);
+        __m128i dLo = _mm_unpacklo_epi16(d, d);
+        __m128i dHi = _mm_unpackhi_epi16(d, d);
+        __m128i eLo = _mm_unpacklo_epi16(e, e);
+        __m128i eHi = _mm_unpackhi_epi16(e, e);
+
+        __m128i rLo, gLo, bLo, rHi, gHi, bHi;
+        yuvToRgb8(_mm_cvtepu8_epi16(y), dLo, eLo, rLo, gLo, bLo);
+        yuvToRgb8(_mm_cvtepu8_epi16(_mm_srli_si128(y, 8)), dHi, eHi, rHi, gHi, bHi);
+
+        store16<D>(dst + x * channels,
+                   _mm_packus_epi16(rLo, rHi),
+                   _mm_packus_epi16(gLo, gHi),
+                   _mm_packus_epi16(bLo, bHi));
+    }
+
+    convertRowScalarFrom<S, D>(row, uvRow, dst, x, width);
+}
+
+// 计算16个像素的R、G、B（16位）
+TARGET_AVX2 inline void yuvToRgb16(__m256i y16, __m256i d, __m256i e,
+                                   __m256i& r, __m256i& g, __m256i& b) {
+    const __m256i round = _mm256_set1_epi16(1 << (kShift - 1));
+    __m256i c = _mm256_mullo_epi16(_mm256_sub_epi16(y16, _mm256_set1_epi16(16)), _mm256_set1_epi16(kYScale));
+
+    r = _mm256_adds_epi16(c, _mm256_mullo_epi16(e, _mm256_set1_epi16(kVToR)));
+    g = _mm256_subs_epi16(c, _mm256_add_epi16(_mm256_mullo_epi16(d, _mm256_set1_epi16(kUToG)),
+                                              _mm256_mullo_epi16(e, _mm256_set1_epi16(kVToG))));
+    b = _mm256_adds_epi16(c, _mm256_mullo_epi16(d, _mm256_set1_epi16(kUToB)));
+
+    r = _mm256_srai_epi16(_mm256_adds_epi16(r, round), kShift);
+    g = _mm256_srai_epi16(_mm256_adds_epi16(g, round), kShift);
+    b = _mm256_srai_epi16(_mm256_adds_epi16(b, round), kShift);
+}
+
+// 将两组16个像素的16位结果饱和打包成32个按顺序排列的8位值
+TARGET_AVX2 inline __m256i packOrdered(__m256i first, __m256i second) {
+    return _mm256_permute4x64_epi64(_mm256_packus_epi16(first, second), 0xD8);
+}
+
+template <SourceFormat S, TargetFormat D>
+TARGET_AVX2 void convertRowAvx2(const uint8_t* row, const uint8_t* uvRow, uint8_t* dst, int width) {
+    const int channels = channelsOf<D>();
+    const __m256i bias = _mm256_set1_epi16(128);
+    int x = 0;
+
+    for (; x + 32 <= width; x += 32) {
+        __m256i r[2], g[2], b[2];
+
+        // 每次16个像素：16位运算一次处理整组
+        for (int half = 0; half < 2; half++) {
+            __m128i y, u, v;
+            load16<S>(row, uvRow, x + half * 16, y, u, v);
+
+            __m256i d = _mm256_sub_epi16(_mm256_cvtepu8_epi16(_mm_unpacklo_epi8(u, u)), bias);
+            __m256i e = _mm256_sub_epi16(_mm256_cvtepu8_epi16(_mm_unpacklo_epi8(v, v)), bias);
+            yuvToRgb16(_mm256_cvtepu8_epi16(y), d, e, r[half], g[half], b[half]);
+        }
+
+        __m256i r8 = packOrdered(r[0], r[1]);
+        __m256i g8 = packOrdered(g[0], g[1]);
+        __m256i b8 = packOrdered(b[0], b[1]);
+
+        store16<D>(dst + x * channels,
+                   _mm256_castsi256_si128(r8), _mm256_castsi256_si128(g8), _mm256_castsi256_si128(b8));
+        store16<D>(dst + (x + 16) * channels,
+                   _mm256_extracti128_si256(r8, 1), _mm256_extracti128_si256(g8, 1), _mm256_extracti128_si256(b8, 1));
+    }
+
+    convertRowScalarFrom<S, D>(row, uvRow, dst, x, width);
+}
+
+#endif  // COLOR_CONVERT_X86
+
+#ifdef COLOR_CONVERT_NEON
+
+// 计算8个像素的R、G、B并饱和到8位（vqrshrun含+32舍入，与标量实现一致）
+inline void yuvToRgbNeon(uint8x8_t y, int16x8_t d, int16x8_t e,
+                         uint8x8_t& r, uint8x8_t& g, uint8x8_t& b) {
+    int16x8_t c = vmulq_n_s16(vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(y)), vdupq_n_s16(16)), kYScale);
+
+    r = vqrshrun_n_s16(vqaddq_s16(c, vmulq_n_s16(e, kVToR)), kShift);
+    g = vqrshrun_n_s16(vqsubq_s16(c, vaddq_s16(vmulq_n_s16(d, kUToG), vmulq_n_s16(e, kVToG))), kShift);
+    b = vqrshrun_n_s16(vqaddq_s16(c, vmulq_n_s16(d, kUToB)), kShift);
+}
+
+template <SourceFormat S, TargetFormat D>
+void convertRowNeon(const uint8_t* row, const uint8_t* uvRow, uint8_t* dst, int width) {
+    const int channels = channelsOf<D>();
+    const int16x8_t bias = vdupq_n_s16(128);
+    int x = 0;
+
+    for (; x + 16 <= width; x += 16) {
+        // 偶数像素和奇数像素各8个，共享同一组色度
+        uint8x8_t yEven, yOdd, u, v;
+        if (S == SourceFormat::YUYV) {
+            uint8x8x4_t packed = vld4_u8(row + x * 2);
+            yEven = packed.val[0];
+            u = packed.val[1];
+            yOdd = packed.val[2];
+            v = packed.val[3];
+        } else if (S == SourceFormat::UYVY) {
+            uint8x8x4_t packed = vld4_u8(row + x * 2);
+            u = packed.val[0];
+            yEven = packed.val[1];
+            v = packed.val[2];
+            yOdd = packed.val[3];
+        } else {
+            uint8x8x2_t luma = vld2_u8(row + x);
+            uint8x8x2_t chroma = vld2_u8(uvRow + x);
+            yEven = luma.val[0];
+            yOdd = luma.val[1];
+            u = chroma.val[0];
+            v = chroma.val[1];
+        }
+
+        int16x8_t d = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(u)), bias);
+        int16x8_t e = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(v)), bias);
+
+        uint8x8_t rEven, gEven, bEven, rOdd, gOdd, bOdd;
+        yuvToRgbNeon(yEven, d, e, rEven, gEven, bEven);
+        yuvToRgbNeon(yOdd, d, e, rOdd, gOdd, bOdd);
+
+        // 偶数和奇数像素交错回原始顺序
+        uint8x8x2_t r = vzip_u8(rEven, rOdd);
+        uint8x8x2_t g = vzip_u8(gEven, gOdd);
+        uint8x8x2_t b = vzip_u8(bEven, bOdd);
+        uint8x16_t r16 = vcombine_u8(r.val[0], r.val[1]);
+        uint8x16_t g16 = vcombine_u8(g.val[0], g.val[1]);
+        uint8x16_t b16 = vcombine_u8(b.val[0], b.val[1]);
+
+        if (D == TargetFormat::RGBA) {
+            uint8x16x4_t out;
+            out.val[0] = r16;
+            out.val[1] = g16;
+            out.val[2] = b16;
+            out.val[3] = vdupq_n_u8(255);
+            vst4q_u8(dst + x * channels, out);
+        } else {
+            uint8x16x3_t out;
+            out.val[0] = D == TargetFormat::BGR ? b16 : r16;
+            out.val[1] = g16;
+            out.val[2] = D == TargetFormat::BGR ? r16 : b16;
+            vst3q_u8(dst + x * channels, out);
+        }
+    }
+
+    convertRowScalarFrom<S, D>(row, uvRow, dst, x, width);
+}
+
+#endif  // COLOR_CONVERT_NEON
+
+// 行转换函数表：[指令集][输入格式][输出格式]
+#define ROW_FUNCS(impl) \
+    { \
+        {impl<SourceFormat::YUYV, TargetFormat::BGR>, impl<SourceFormat::YUYV, TargetFormat::RGB>, impl<SourceFormat::YUYV, TargetFormat::RGBA>}, \
+        {impl<SourceFormat::UYVY, TargetFormat::BGR>, impl<SourceFormat::UYVY, TargetFormat::RGB>, impl<SourceFormat::UYVY, TargetFormat::RGBA>}, \
+        {impl<SourceFormat::NV12, TargetFormat::BGR>, impl<SourceFormat::NV12, TargetFormat::RGB>, impl<SourceFormat::NV12, TargetFormat::RGBA>} \
+    }
+
+const RowFunc kScalarFuncs[3][3] = ROW_FUNCS(convertRowScalar);
+#ifdef COLOR_CONVERT_X86
+const RowFunc kSse41Funcs[3][3] = ROW_FUNCS(convertRowSse41);
+const RowFunc kAvx2Funcs[3][3] = ROW_FUNCS(convertRowAvx2);
+#endif
+#ifdef COLOR_CONVERT_NEON
+const RowFunc kNeonFuncs[3][3] = ROW_FUNCS(convertRowNeon);
+#endif
+
+#undef ROW_FUNCS
+
+// 选择CPU支持的最快实现
+Isa detectBestIsa() {
+    if (isIsaSupported(Isa::NEON)) {
+        return Isa::NEON;
+    }
+    if (isIsaSupported(Isa::AVX2)) {
+        return Isa::AVX2;
+    }
+    if (isIsaSupported(Isa::SSE41)) {
+        return Isa::SSE41;
+    }
+    return Isa::Scalar;
+}
+
+std::atomic<Isa>& activeIsa() {
+    static std::atomic<Isa> isa(detectBestIsa());
+    return isa;
+}
+
+RowFunc selectRowFunc(Isa isa, SourceFormat srcFormat, TargetFormat dstFormat) {
+    int s = static_cast<int>(srcFormat);
+    int d = static_cast<int>(dstFormat);
+
+    switch (isa) {
+#ifdef COLOR_CONVERT_X86
+        case Isa::SSE41:
+            return kSse41Funcs[s][d];
+        case Isa::AVX2:
+            return kAvx2Funcs[s][d];
+#endif
+#ifdef COLOR_CONVERT_NEON
+        case Isa::NEON:
+            return kNeonFuncs[s][d];
+#endif
+        default:
+            return kScalarFuncs[s][d];
+    }
+}
+
+}  // namespace
+
+bool isIsaSupported(Isa isa) {
+    switch (isa) {
+        case Isa::Scalar:
+            return true;
+#ifdef COLOR_CONVERT_X86
+        case Isa::SSE41:
+            return __builtin_cpu_supports("ssse3") && __builtin_cpu_supports("sse4.1");
+        case Isa::AVX2:
+            return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("sse4.1");
+#endif
+#ifdef COLOR_CONVERT_NEON
+        case Isa::NEON:
+            return true;
+#endif
+        default:
+            return false;
+    }
+}
+
+Isa getActiveIsa() {
+    return activeIsa().load(std::memory_order_relaxed);
+}
+
+bool setActiveIsa(Isa isa) {
+    if (!isIsaSupported(isa)) {
+        return false;
+    }
+
+    activeIsa().store(isa, std::memory_order_relaxed);
+    return true;
+}
+
+const char* getIsaName(Isa isa) {
+    switch (isa) {
+        case Isa::Scalar: return "scalar";
+        case Isa::SSE41: return "sse4.1";
+        case Isa::AVX2: return "avx2";
+        case Isa::NEON: return "neon";
+    }
+    return "unknown";
+}
+
+const char* getFormatName(SourceFormat format) {
+    switch (format) {
+        case SourceFormat::YUYV: return "YUYV";
+        case SourceFormat::UYVY: return "UYVY";
+        case SourceFormat::NV12: return "NV12";
+    }
+    return "unknown";
+}
+
+const char* getFormatName(TargetFormat format) {
+    switch (format) {
+        case TargetFormat::BGR: return "BGR";
+        case TargetFormat::RGB: return "RGB";
+        case TargetFormat::RGBA: return "RGBA";
+    }
+    return "unknown";
+}
+
+bool convert(const uint8_t* src, int srcStride, SourceFormat srcFormat,
+             uint8_t* dst, int dstStride, TargetFormat dstFormat,
+             int width, int height) {
+    if (!src || !dst || width <= 0 || height <= 0 || (width & 1) != 0) {
+        return false;
+    }
+
+    RowFunc rowFunc = selectRowFunc(getActiveIsa(), srcFormat, dstFormat);
+    const uint8_t* uvPlane = src + static_cast<size_t>(srcStride) * height;
+
+    for (int y = 0; y < height; y++) {
+        const uint8_t* row = src + static_cast<size_t>(srcStride) * y;
+        const uint8_t* uvRow = srcFormat == SourceFormat::NV12 ?
+                               uvPlane + static_cast<size_t>(srcStride) * (y >> 1) : nullptr;
+        rowFunc(row, uvRow, dst + static_cast<size_t>(dstStride) * y, width);
+    }
+
+    return true;
+}
+
+bool convert(const cv::Mat& src, SourceFormat srcFormat, cv::Mat& dst, TargetFormat dstFormat) {
+    int width, height;
+    if (srcFormat == SourceFormat::NV12) {
+        if (src.type() != CV_8UC1 || src.rows % 3 != 0) {
+            std::cerr << "NV12输入需要(height*3/2)行的单通道Mat" << std::endl;
+            return false;
+        }
+        width = src.cols;
+        height = src.rows * 2 / 3;
+    } else {
+        if (src.type() != CV_8UC2) {
+            std::cerr << "YUYV/UYVY输入需要双通道Mat" << std::endl;
+            return false;
+        }
+        width = src.cols;
+        height = src.rows;
+    }
+
+    dst.create(height, width, dstFormat == TargetFormat::RGBA ? CV_8UC4 : CV_8UC3);
+    return convert(src.data, static_cast<int>(src.step[0]), srcFormat,
+                   dst.data, static_cast<int>(dst.step[0]), dstFormat,
+                   width, height);
+}
+
+}  // namespace ColorConvert
@@ -0,0 +1,245 @@
+#include "device_capability_cache.h"
+#include "utils.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+#include <cstdlib>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+namespace {
+    // 缓存文件格式版本，格式变化时递增，旧文件直接丢弃
+    const int kCacheVersion = 3;
+
+    // 去掉换行，保证每个字段占一行
+    std::string sanitize(const std::string& value) {
+        std::string result = value;
+        for (char& c : result) {
+            if (c == '\n' || c == '\r') {
+                c = ' ';
+            }
+        }
+        return result;
+    }
+
+    // 取行首关键字之后的剩余部分
+    std::string restOfLine(const std::string& line, size_t keywordLength) {
+        if (line.size() <= keywordLength + 1) {
+            return std::string();
+        }
+        return line.substr(keywordLength + 1);
+    }
+}
+
+DeviceCapabilityCache::DeviceCapabilityCache(const std::string& filePath)
+    : m_filePath(filePath),
+      m_loaded(false),
+      m_dirty(false) {
+}
+
+DeviceCapabilityCache::~DeviceCapabilityCache() {
+    flush();
+}
+
+std::string DeviceCapabilityCache::getDefaultPath() {
+    const char* home = getenv("HOME");
+    if (!home) {
+        return std::string();
+    }
+    return (fs::path(home) / "captureVideo" / "device_caps.cache").string();
+}
+
+bool DeviceCapabilityCache::lookup(CameraDeviceInfo& deviceInfo) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    load();
+
+    auto it = m_entries.find(deviceInfo.getCacheKey());
+    if (it == m_entries.end()) {
+        return false;
+    }
+
+    deviceInfo.formats = it->second;
+    return true;
+}
+
+void DeviceCapabilityCache::store(const CameraDeviceInfo& deviceInfo) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    load();
+
+    m_entries[deviceInfo.getCacheKey()] = deviceInfo.formats;
+    m_dirty = true;
+}
+
+void DeviceCapabilityCache::invalidate(const std::string& key) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    load();
+
+    if (m_entries.erase(key) > 0) {
+        m_dirty = true;
+    }
+}
+
+bool DeviceCapabilityCache::flush() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_dirty || m_filePath.empty()) {
+        return true;
+    }
+
+    fs::path parent = fs::path(m_filePath).parent_path();
+    if (!parent.empty() && !Utils::ensureDirectoryExists(parent.string())) {
+        std::cerr << "无法创建缓存目录: " << parent << std::endl;
+        return false;
+    }
+
+    // 临时文件名带进程号，多个进程同时写盘时互不覆盖
+    std::string tempPath = m_filePath + ".tmp." + std::to_string(getpid());
+    {
+        std::ofstream file(tempPath, std::ios::trunc);
+        if (!file.is_open()) {
+            std::cerr << "无法写入设备能力缓存: " << tempPath << std::endl;
+            return false;
+        }
+
+        file << "# captureVideo device capability cache\n";
+        file << "version " << kCacheVersion << "\n";
+
+        for (const auto& entry : m_entries) {
+            file << "device " << sanitize(entry.first) << "\n";
+            for (const auto& format : entry.second) {
+                file << "format " << format.pixelFormat << " " << sanitize(format.description) << "\n";
+                for (const auto& size : format.frameSizes) {
+                    file << "size " << size.type << " "
+                         << size.minWidth << " " << size.maxWidth << " " << size.stepWidth << " "
+                         << size.minHeight << " " << size.maxHeight << " " << size.stepHeight << "\n";
+                }
+                for (const auto& sizeIntervals : format.frameIntervals) {
+                    for (const auto& interval : sizeIntervals.intervals) {
+                        file << "interval " << sizeIntervals.width << " " << sizeIntervals.height << " "
+                             << interval.type << " "
+                             << interval.min.numerator << " " << interval.min.denominator << " "
+                             << interval.max.numerator << " " << interval.max.denominator << " "
+                             << interval.step.numerator << " " << interval.step.denominator << "\n";
+                    }
+                }
+            }
+            file << "end\n";
+        }
+
+        if (!file.good()) {
+            std::cerr << "写入设备能力缓存失败: " << tempPath << std::endl;
+            file.close();
+            unlink(tempPath.c_str());
+            return false;
+        }
+    }
+
+    if (rename(tempPath.c_str(), m_filePath.c_str()) != 0) {
+        std::cerr << "无法替换设备能力缓存: " << m_filePath << std::endl;
+        unlink(tempPath.c_str());
+        return false;
+    }
+
+    m_dirty = false;
+    return true;
+}
+
+void DeviceCapabilityCache::load() {
+    if (m_loaded) {
+        return;
+    }
+    m_loaded = true;
+
+    if (m_filePath.empty()) {
+        return;
+    }
+
+    std::ifstream file(m_filePath);
+    if (!file.is_open()) {
+        return;  // 首次运行，还没有缓存
+    }
+
+    std::map<std::string, std::vector<FormatCapability>> entries;
+    std::string currentKey;
+    std::vector<FormatCapability> currentFormats;
+    bool inDevice = false;
+    bool versionOk = false;
+
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+
+        std::istringstream iss(line);
+        std::string keyword;
+        iss >> keyword;
+
+        if (keyword == "version") {
+            int version = 0;
+            iss >> version;
+            versionOk = (version == kCacheVersion);
+            if (!versionOk) {
+                break;
+            }
+        } else if (keyword == "device" && versionOk) {
+            currentKey = restOfLine(line, keyword.size());
+            currentFormats.clear();
+            inDevice = true;
+        } else if (keyword == "format" && inDevice) {
+            FormatCapability format;
+            iss >> format.pixelFormat;
+            std::getline(iss, format.description);
+            if (!format.description.empty() && format.description[0] == ' ') {
+                format.description.erase(0, 1);
+            }
+            currentFormats.push_back(format);
+        } else if (keyword == "size" && inDevice && !currentFormats.empty()) {
+            FrameSizeRange size;
+            iss >> size.type
+                >> size.minWidth >> size.maxWidth >> size.stepWidth
+                >> size.minHeight >> size.maxHeight >> size.stepHeight;
+            if (iss.fail()) {
+                inDevice = false;  // 损坏的条目整体丢弃
+                continue;
+            }
+            currentFormats.back().frameSizes.push_back(size);
+        } else if (keyword == "interval" && inDevice && !currentFormats.empty()) {
+            uint32_t width = 0;
+            uint32_t height = 0;
+            FrameIntervalRange interval;
+            iss >> width >> height >> interval.type
+                >> interval.min.numerator >> interval.min.denominator
+                >> interval.max.numerator >> interval.max.denominator
+                >> interval.step.numerator >> interval.step.denominator;
+            if (iss.fail()) {
+                inDevice = false;
+                continue;
+            }
+
+            // 同一尺寸的多个间隔连续写出，合并到同一项
+            auto& frameIntervals = currentFormats.back().frameIntervals;
+            if (frameIntervals.empty() || frameIntervals.back().width != width ||
+                frameIntervals.back().height != height) {
+                SizeFrameIntervals sizeIntervals;
+                sizeIntervals.width = width;
+                sizeIntervals.height = height;
+                frameIntervals.push_back(sizeIntervals);
+            }
+            frameIntervals.back().intervals.push_back(interval);
+        } else if (keyword == "end" && inDevice) {
+            if (!currentKey.empty() && !currentFormats.empty()) {
+                entries[currentKey] = currentFormats;
+            }
+            inDevice = false;
+        }
+    }
+
+    if (!versionOk) {
+        std::cout << "设备能力缓存版本不匹配，将重新查询设备" << std::endl;
+        return;
+    }
+
+    m_entries.swap(entries);
+}
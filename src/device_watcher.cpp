@@ -0,0 +1,327 @@
+#include "device_watcher.h"
+#include <iostream>
+#include <cstring>
+#include <cerrno>
+#include <cctype>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+DeviceWatcher::DeviceWatcher()
+    : m_inotifyFd(-1),
+      m_epollFd(-1),
+      m_wakeupFd(-1),
+      m_running(false) {
+    m_probe = [this](const std::string& devicePath, CameraDeviceInfo& info) {
+        return m_prober.probeDevicePath(devicePath, info);
+    };
+}
+
+DeviceWatcher::~DeviceWatcher() {
+    stop();
+}
+
+bool DeviceWatcher::start(const std::string& watchDir) {
+    stop();
+
+    m_watchDir = watchDir;
+
+    m_inotifyFd = inotify_init1(IN_CLOEXEC | IN_NONBLOCK);
+    if (m_inotifyFd < 0) {
+        std::cerr << "无法创建inotify: " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    // 节点创建后udev才设置权限，IN_ATTRIB用于重试之前打不开的节点
+    uint32_t mask = IN_CREATE | IN_DELETE | IN_ATTRIB | IN_MOVED_TO | IN_MOVED_FROM;
+    if (inotify_add_watch(m_inotifyFd, m_watchDir.c_str(), mask) < 0) {
+        std::cerr << "无法监视目录 " << m_watchDir << ": " << strerror(errno) << std::endl;
+        closeFds();
+        return false;
+    }
+
+    m_wakeupFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    m_epollFd = epoll_create1(EPOLL_CLOEXEC);
+    if (m_wakeupFd < 0 || m_epollFd < 0) {
+        std::cerr << "无法创建eventfd/epoll: " << strerror(errno) << std::endl;
+        closeFds();
+        return false;
+    }
+
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.fd = m_inotifyFd;
+    if (epoll_ctl(m_epollFd, EPOLL_CTL_ADD, m_inotifyFd, &event) < 0) {
+        std::cerr << "无法监听inotify: " << strerror(errno) << std::endl;
+        closeFds();
+        return false;
+    }
+
+    event.data.fd = m_wakeupFd;
+    if (epoll_ctl(m_epollFd, EPOLL_CTL_ADD, m_wakeupFd, &event) < 0) {
+        std::cerr << "无法监听eventfd: " << strerror(errno) << std::endl;
+        closeFds();
+        return false;
+    }
+
+    // 已有节点在监视线程中扫描，探测设备可能较慢，不阻塞调用者
+    m_running = true;
+    m_thread = std::thread(&DeviceWatcher::watchThreadFunc, this);
+
+    return true;
+}
+
+void DeviceWatcher::stop() {
+    if (m_running) {
+        m_running = false;
+
+        // 唤醒阻塞在epoll_wait中的监视线程
+        uint64_t value = 1;
+        ssize_t ret = write(m_wakeupFd, &value, sizeof(value));
+        (void)ret;
+
+        if (m_thread.joinable()) {
+            m_thread.join();
+        }
+    }
+
+    closeFds();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_devices.clear();
+    m_pending.clear();
+}
+
+void DeviceWatcher::setEventCallback(std::function<void(const DeviceEvent&)> callback) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_callback = callback;
+}
+
+void DeviceWatcher::setProbeFunction(ProbeFunction probe) {
+    m_probe = probe;
+}
+
+std::vector<CameraDeviceInfo> DeviceWatcher::getDevices() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    std::vector<CameraDeviceInfo> devices;
+    for (const auto& entry : m_devices) {
+        devices.push_back(entry.second);
+    }
+    return devices;
+}
+
+void DeviceWatcher::watchThreadFunc() {
+    // watch已在start中建立，扫描期间新增的节点会留在inotify队列中，不会漏掉
+    resync();
+
+    struct epoll_event events[2];
+
+    while (m_running) {
+        int count = epoll_wait(m_epollFd, events, 2, -1);
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            std::cerr << "设备监视epoll_wait失败: " << strerror(errno) << std::endl;
+            break;
+        }
+
+        for (int i = 0; i < count; i++) {
+            if (events[i].data.fd == m_inotifyFd) {
+                handleInotifyEvents();
+            }
+        }
+    }
+}
+
+void DeviceWatcher::handleInotifyEvents() {
+    // inotify_event按4字节对齐
+    alignas(struct inotify_event) char buffer[4096];
+
+    while (true) {
+        ssize_t length = read(m_inotifyFd, buffer, sizeof(buffer));
+        if (length < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;  // EAGAIN：已读完
+        }
+        if (length == 0) {
+            break;
+        }
+
+        for (char* ptr = buffer; ptr < buffer + length; ) {
+            const struct inotify_event* event = reinterpret_cast<const struct inotify_event*>(ptr);
+            ptr += sizeof(struct inotify_event) + event->len;
+
+            // 事件队列溢出时丢失了部分事件，重新对账
+            if (event->mask & IN_Q_OVERFLOW) {
+                resync();
+                continue;
+            }
+
+            if (event->len == 0 || (event->mask & IN_ISDIR)) {
+                continue;
+            }
+
+            std::string name = event->name;
+            if (!isVideoNode(name)) {
+                continue;
+            }
+
+            std::string devicePath = m_watchDir + "/" + name;
+            if (event->mask & (IN_DELETE | IN_MOVED_FROM)) {
+                removeNode(devicePath);
+            } else if (event->mask & (IN_CREATE | IN_MOVED_TO)) {
+                probeNode(devicePath);
+            } else if (event->mask & IN_ATTRIB) {
+                // 只重试之前探测失败的节点，已知设备的权限变化不需要重新探测
+                bool pending = false;
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    pending = m_pending.count(devicePath) > 0;
+                }
+                if (pending) {
+                    probeNode(devicePath);
+                }
+            }
+        }
+    }
+}
+
+void DeviceWatcher::resync() {
+    std::set<std::string> present;
+
+    DIR* dir = opendir(m_watchDir.c_str());
+    if (!dir) {
+        std::cerr << "无法打开目录: " << m_watchDir << std::endl;
+        return;
+    }
+
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != nullptr) {
+        std::string name = entry->d_name;
+        if (isVideoNode(name)) {
+            present.insert(m_watchDir + "/" + name);
+        }
+    }
+    closedir(dir);
+
+    // 已消失的节点
+    std::vector<std::string> removed;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (const auto& entry : m_devices) {
+            if (present.count(entry.first) == 0) {
+                removed.push_back(entry.first);
+            }
+        }
+        for (auto it = m_pending.begin(); it != m_pending.end(); ) {
+            it = present.count(*it) == 0 ? m_pending.erase(it) : std::next(it);
+        }
+    }
+    for (const auto& devicePath : removed) {
+        removeNode(devicePath);
+    }
+
+    // 新出现的节点
+    for (const auto& devicePath : present) {
+        bool known = false;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            known = m_devices.count(devicePath) > 0;
+        }
+        if (!known) {
+            probeNode(devicePath);
+        }
+    }
+}
+
+void DeviceWatcher::probeNode(const std::string& devicePath) {
+    CameraDeviceInfo info;
+    bool ok = m_probe && m_probe(devicePath, info);
+
+    DeviceEvent event;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!ok) {
+            // 可能是权限尚未就绪，也可能不是捕获节点（如UVC元数据节点），等待IN_ATTRIB重试
+            m_pending.insert(devicePath);
+            return;
+        }
+
+        m_pending.erase(devicePath);
+        m_devices[devicePath] = info;
+    }
+
+    event.type = DeviceEventType::Added;
+    event.devicePath = devicePath;
+    event.info = info;
+    emitEvent(event);
+}
+
+void DeviceWatcher::removeNode(const std::string& devicePath) {
+    DeviceEvent event;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_pending.erase(devicePath);
+
+        auto it = m_devices.find(devicePath);
+        if (it == m_devices.end()) {
+            return;
+        }
+
+        event.info = it->second;
+        m_devices.erase(it);
+    }
+
+    event.type = DeviceEventType::Removed;
+    event.devicePath = devicePath;
+    emitEvent(event);
+}
+
+void DeviceWatcher::emitEvent(const DeviceEvent& event) {
+    std::function<void(const DeviceEvent&)> callback;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        callback = m_callback;
+    }
+
+    if (callback) {
+        callback(event);
+    }
+}
+
+void DeviceWatcher::closeFds() {
+    if (m_epollFd >= 0) {
+        close(m_epollFd);
+        m_epollFd = -1;
+    }
+
+    if (m_wakeupFd >= 0) {
+        close(m_wakeupFd);
+        m_wakeupFd = -1;
+    }
+
+    if (m_inotifyFd >= 0) {
+        close(m_inotifyFd);
+        m_inotifyFd = -1;
+    }
+}
+
+bool DeviceWatcher::isVideoNode(const std::string& name) {
+    // 只匹配videoN，排除video-xxx等其他名称
+    if (name.size() <= 5 || name.compare(0, 5, "video") != 0) {
+        return false;
+    }
+    for (size_t i = 5; i < name.size(); i++) {
+        if (!isdigit(static_cast<unsigned char>(name[i]))) {
+            return false;
+        }
+    }
+    return true;
+}
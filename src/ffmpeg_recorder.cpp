@@ -1,19 +1,110 @@
 #include "ffmpeg_recorder.h"
 #include "utils.h"
+#include "format_negotiator.h"
 #include <iostream>
+#include <fstream>
 #include <filesystem>
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+#include <climits>
+#include <fcntl.h>
+#include <poll.h>
 #include <signal.h>
+#include <spawn.h>
 #include <sys/types.h>
 #include <sys/wait.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <sys/eventfd.h>
 #include <unistd.h>
 
+extern char** environ;
+
 namespace fs = std::filesystem;
 
-FFmpegRecorder::FFmpegRecorder() : m_isRecording(false), m_ffmpegPid(-1) {
+namespace {
+    // 管道关闭后等待ffmpeg写完文件尾的时间
+    const int kStopTimeoutMs = 5000;
+
+    // 按时长分段时文件名开头的日期时间，由ffmpeg在每个分段开始时按strftime展开
+    const std::string kSegmentDateTime = "%Y%m%d_%H%M%S";
+
+    // 获取进程的pidfd，进程退出时可读，且发信号不受进程号复用影响（Linux 5.3+）
+    int pidfdOpen(pid_t pid) {
+#ifdef SYS_pidfd_open
+        return static_cast<int>(syscall(SYS_pidfd_open, pid, 0));
+#else
+        (void)pid;
+        errno = ENOSYS;
+        return -1;
+#endif
+    }
+
+    int pidfdSendSignal(int pidfd, int signal) {
+#ifdef SYS_pidfd_send_signal
+        return static_cast<int>(syscall(SYS_pidfd_send_signal, pidfd, signal, nullptr, 0));
+#else
+        (void)pidfd;
+        (void)signal;
+        errno = ENOSYS;
+        return -1;
+#endif
+    }
+
+    // 管道容量上限（非特权进程不能超过/proc/sys/fs/pipe-max-size）
+    int getPipeMaxSize() {
+        std::ifstream file("/proc/sys/fs/pipe-max-size");
+        int size = 0;
+        if (file >> size) {
+            return size;
+        }
+        return 1024 * 1024;
+    }
+
+    std::string joinArgs(const std::vector<std::string>& args) {
+        std::string command;
+        for (const auto& arg : args) {
+            if (!command.empty()) {
+                command += " ";
+            }
+            command += arg;
+        }
+        return command;
+    }
+}
+
+FFmpegRecorder::FFmpegRecorder()
+    : m_isRecording(false),
+      m_ffmpegPid(-1),
+      m_pidfd(-1),
+      m_inputPixelFormat(0),
+      m_pipeMode(false),
+      m_pipeFd(-1),
+      m_stopFd(-1),
+      m_pipePixelFormat(0),
+      m_pipeResolution(0, 0),
+      m_useVmsplice(true),
+      m_bytesWritten(0),
+      m_framesQueued(0),
+      m_framesConsumed(0),
+      m_framesDropped(0),
+      m_inFlightCount(0),
+      m_maxInFlight(0),
+      m_lastWriteUs(0),
+      m_maxWriteUs(0) {
+    // 停止通知的eventfd与录制器同生命周期，requestStop随时可以写入，不会写到已关闭（或被复用）的描述符
+    m_stopFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (m_stopFd < 0) {
+        std::cerr << "无法创建停止通知: " << strerror(errno) << std::endl;
+    }
 }
 
 FFmpegRecorder::~FFmpegRecorder() {
     stopRecording();
+    if (m_stopFd >= 0) {
+        close(m_stopFd);
+    }
 }
 
 bool FFmpegRecorder::init(const std::string& outputDir) {
@@ -33,38 +124,281 @@ bool FFmpegRecorder::startRecording(const std::string& devicePath, const Resolut
         return true;  // 已经在录制中
     }
 
+    // 回收上一次自行结束的录制
+    stopRecording();
+
     // 生成文件名
+    m_segmentStartTime = m_segment.segmentSeconds > 0 ? Utils::getCurrentDateTimeString() : std::string();
     m_currentFilePath = generateFileName(resolution, framerate);
 
+    // 启动FFmpeg进程
+    std::vector<std::string> args = buildFFmpegArgs(devicePath, resolution, framerate, m_currentFilePath, durationSeconds);
+    std::cout << "执行FFmpeg命令: " << joinArgs(args) << std::endl;
+    if (!spawnFFmpeg(args, -1)) {
+        return false;
+    }
+
     // 记录开始时间
     m_startTime = std::chrono::steady_clock::now();
 
     // 设置录制标志
+    m_pipeMode = false;
     m_isRecording = true;
 
-    // 启动录制线程
-    m_recordingThread = std::thread(&FFmpegRecorder::recordingThreadFunc, this, devicePath, resolution, framerate, durationSeconds);
+    // 启动等待线程
+    m_recordingThread = std::thread(&FFmpegRecorder::waitThreadFunc, this);
+
+    return true;
+}
+
+bool FFmpegRecorder::startPipeRecording(const Resolution& resolution, const FrameRate& framerate, uint32_t inputPixelFormat,
+                                        bool streamCopy) {
+    if (m_isRecording) {
+        return true;  // 已经在录制中
+    }
+
+    // 回收上一次自行结束的录制
+    stopRecording();
+
+    if (inputPixelFormat != 0 && inputPixelFormat != V4L2_PIX_FMT_MJPEG && inputPixelFormat != V4L2_PIX_FMT_JPEG) {
+        std::cerr << "管道模式不支持的输入格式: " << FormatNegotiator::fourccToString(inputPixelFormat) << std::endl;
+        return false;
+    }
+
+    if (streamCopy && inputPixelFormat == 0) {
+        std::cerr << "直通录制需要MJPEG输入" << std::endl;
+        return false;
+    }
+
+    int fds[2];
+    if (pipe2(fds, O_CLOEXEC) < 0) {
+        std::cerr << "无法创建管道: " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    // 管道至少能容纳一帧，减少ffmpeg和写入线程之间的来回切换
+    size_t frameBytes = inputPixelFormat == 0 ?
+                        static_cast<size_t>(resolution.width) * resolution.height * 3 :
+                        static_cast<size_t>(resolution.width) * resolution.height / 4;
+    int pipeSize = static_cast<int>(std::min<size_t>(frameBytes, static_cast<size_t>(getPipeMaxSize())));
+    if (fcntl(fds[1], F_SETPIPE_SZ, pipeSize) < 0) {
+        std::cerr << "无法设置管道容量: " << strerror(errno) << std::endl;
+    }
+
+    // 生成文件名
+    m_segmentStartTime = m_segment.segmentSeconds > 0 ? Utils::getCurrentDateTimeString() : std::string();
+    m_currentFilePath = generateFileName(resolution, framerate.rounded(), streamCopy ? ".mkv" : ".mp4");
+
+    // 启动FFmpeg进程，管道读端作为其标准输入
+    std::vector<std::string> args = buildPipeArgs(resolution, framerate, inputPixelFormat, streamCopy, m_currentFilePath);
+    std::cout << "执行FFmpeg命令: " << joinArgs(args) << std::endl;
+
+    // ffmpeg退出后写管道返回EPIPE，而不是让整个进程收到SIGPIPE
+    signal(SIGPIPE, SIG_IGN);
+
+    bool spawned = spawnFFmpeg(args, fds[0]);
+    close(fds[0]);  // 读端已交给子进程
+    if (!spawned) {
+        close(fds[1]);
+        return false;
+    }
+
+    // 写端非阻塞：管道写满时同时等待停止通知，ffmpeg卡住时停止录制不会被写入线程拖住
+    // （读端是另一个打开的文件描述，ffmpeg仍以阻塞方式读取）
+    if (fcntl(fds[1], F_SETFL, fcntl(fds[1], F_GETFL) | O_NONBLOCK) < 0) {
+        std::cerr << "无法设置管道写端: " << strerror(errno) << std::endl;
+    }
+
+    // 清除上一次录制留下的停止通知
+    uint64_t stale = 0;
+    if (m_stopFd >= 0 && read(m_stopFd, &stale, sizeof(stale)) < 0 && errno != EAGAIN) {
+        std::cerr << "无法清除停止通知: " << strerror(errno) << std::endl;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_pipeMutex);
+        m_pipeFd = fds[1];
+        m_pipePixelFormat = inputPixelFormat;
+        m_pipeResolution = resolution;
+        m_useVmsplice = true;
+        m_bytesWritten = 0;
+        m_inFlight.clear();
+    }
+
+    m_framesQueued = 0;
+    m_framesConsumed = 0;
+    m_framesDropped = 0;
+    m_inFlightCount = 0;
+    m_maxInFlight = 0;
+    m_lastWriteUs = 0;
+    m_maxWriteUs = 0;
+
+    // 记录开始时间
+    m_startTime = std::chrono::steady_clock::now();
+
+    // 设置录制标志
+    m_pipeMode = true;
+    m_isRecording = true;
+
+    // 启动等待线程
+    m_recordingThread = std::thread(&FFmpegRecorder::waitThreadFunc, this);
 
     return true;
 }
 
 void FFmpegRecorder::stopRecording() {
-    if (!m_isRecording) {
+    if (!m_recordingThread.joinable()) {
         return;  // 没有在录制
     }
 
     // 清除录制标志
     m_isRecording = false;
 
-    // 终止FFmpeg进程
-    terminateFFmpegProcess();
+    if (m_pipeMode) {
+        // 先通知写入线程，ffmpeg不再读取时写入线程在超时后放开管道锁
+        requestStop();
+
+        // 关闭管道，ffmpeg读完剩余数据后写入文件尾并退出
+        std::lock_guard<std::mutex> lock(m_pipeMutex);
+        closePipe();
+    } else {
+        // 终止FFmpeg进程（ffmpeg收到SIGTERM后同样会写入文件尾）
+        signalFFmpegProcess(SIGTERM);
+    }
+
+    // 等待线程回收进程后通知，超时则强制终止；有没有pidfd都一样，ffmpeg卡住时停止最多等待kStopTimeoutMs
+    // 进程回收前进程号不会被复用，超时后按进程号发信号也是安全的
+    {
+        std::unique_lock<std::mutex> lock(m_processMutex);
+        bool exited = m_processExited.wait_for(lock, std::chrono::milliseconds(kStopTimeoutMs),
+                                               [this]() { return m_ffmpegPid < 0; });
+        if (!exited) {
+            lock.unlock();
+            std::cerr << "FFmpeg进程未在超时内退出，强制终止" << std::endl;
+            signalFFmpegProcess(SIGKILL);
+        }
+    }
+
+    // 等待线程结束
+    m_recordingThread.join();
+
+    std::lock_guard<std::mutex> lock(m_processMutex);
+    if (m_pidfd >= 0) {
+        close(m_pidfd);
+        m_pidfd = -1;
+    }
+}
+
+void FFmpegRecorder::requestStop() {
+    // eventfd只写不读（开始下一次录制时才清除），通知后一直保持可读，之后每次等待管道都会看到
+    if (m_stopFd >= 0) {
+        uint64_t value = 1;
+        ssize_t ret = write(m_stopFd, &value, sizeof(value));
+        (void)ret;
+    }
+}
+
+void FFmpegRecorder::processFrame(const FrameRef& frame) {
+    if (!m_isRecording || !m_pipeMode || frame.empty()) {
+        return;
+    }
+
+    const FrameInfo& info = frame.info();
+
+    std::lock_guard<std::mutex> lock(m_pipeMutex);
+    if (m_pipeFd < 0) {
+        return;
+    }
+
+    // 管道输入是固定格式和尺寸的字节流，不符的帧只能丢弃
+    if (info.pixelFormat != m_pipePixelFormat ||
+        info.width != m_pipeResolution.width || info.height != m_pipeResolution.height) {
+        m_framesDropped++;
+        return;
+    }
+
+    releaseConsumedFrames();
+
+    // 按行描述帧数据，行跨度等于行宽时合并为一段
+    std::vector<struct iovec> iov;
+    size_t frameBytes = 0;
+    if (m_pipePixelFormat == 0) {
+        size_t rowBytes = static_cast<size_t>(info.width) * 3;
+        if (info.step == rowBytes) {
+            iov.push_back({frame.data(), rowBytes * info.height});
+        } else {
+            for (int y = 0; y < info.height; y++) {
+                iov.push_back({frame.data() + y * info.step, rowBytes});
+            }
+        }
+        frameBytes = rowBytes * info.height;
+    } else {
+        iov.push_back({frame.data(), info.bytesUsed});
+        frameBytes = info.bytesUsed;
+    }
+
+    // vmsplice只把页面挂入管道而不拷贝，帧需保持引用直到ffmpeg读走这些字节
+    bool spliced = m_useVmsplice;
+
+    auto start = std::chrono::steady_clock::now();
+    size_t bytesWritten = 0;
+    bool written = writeToPipe(iov, bytesWritten);
+    int64_t elapsedUs = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start).count();
+
+    if (!written) {
+        // ffmpeg已退出或超时不读取，等待线程会回收进程和在途帧
+        // 已挂入管道的部分页面仍可能被ffmpeg读取，这一帧同样保留到进程被回收，帧池不能提前复用它的内存
+        m_framesDropped++;
+        if (spliced && bytesWritten > 0) {
+            m_bytesWritten += bytesWritten;
+            m_inFlight.push_back({frame, m_bytesWritten});
+            m_inFlightCount = m_inFlight.size();
+        }
+        closePipe();
+        return;
+    }
+
+    m_bytesWritten += frameBytes;
+    m_inFlight.push_back({spliced ? frame : FrameRef(), m_bytesWritten});
+    m_inFlightCount = m_inFlight.size();
+    if (m_inFlight.size() > m_maxInFlight) {
+        m_maxInFlight = m_inFlight.size();
+    }
 
-    // 等待录制线程结束
-    if (m_recordingThread.joinable()) {
-        m_recordingThread.join();
+    m_framesQueued++;
+    m_lastWriteUs = elapsedUs;
+    if (elapsedUs > m_maxWriteUs) {
+        m_maxWriteUs = elapsedUs;
     }
 }
 
+std::string FFmpegRecorder::getCurrentFilePath() const {
+    if (m_segmentStartTime.empty()) {
+        return m_currentFilePath;
+    }
+
+    // 按时长分段时m_currentFilePath只是文件名模板：取输出目录中本次录制开始之后、名称与模板相符的最新分段
+    fs::path pattern(m_currentFilePath);
+    fs::path dir = pattern.parent_path();
+    std::string suffix = pattern.filename().string().substr(kSegmentDateTime.size());
+    size_t dateTimeLength = m_segmentStartTime.size();
+
+    std::string latest;
+    std::error_code ec;
+    for (fs::directory_iterator it(dir, ec), end; !ec && it != end; it.increment(ec)) {
+        std::string name = it->path().filename().string();
+        if (name.size() == dateTimeLength + suffix.size() &&
+            name.compare(dateTimeLength, suffix.size(), suffix) == 0 &&
+            name.compare(0, dateTimeLength, m_segmentStartTime) >= 0 && name > latest) {
+            latest = name;
+        }
+    }
+
+    // 还没有分段文件时返回输出目录
+    return latest.empty() ? dir.string() : (dir / latest).string();
+}
+
 double FFmpegRecorder::getRecordingDuration() const {
     if (!m_isRecording) {
         return 0.0;
@@ -74,38 +408,42 @@ double FFmpegRecorder::getRecordingDuration() const {
     return std::chrono::duration<double>(now - m_startTime).count();
 }
 
-void FFmpegRecorder::recordingThreadFunc(const std::string& devicePath, const Resolution& resolution, int framerate, int durationSeconds) {
-    // 构建FFmpeg命令
-    std::string command = buildFFmpegCommand(devicePath, resolution, framerate, m_currentFilePath, durationSeconds);
-
-    // 执行FFmpeg命令
-    std::cout << "执行FFmpeg命令: " << command << std::endl;
-    m_ffmpegPid = executeCommand(command);
+RecorderStats FFmpegRecorder::getStats() const {
+    RecorderStats stats;
+    stats.queued = m_framesQueued;
+    stats.encoded = m_framesConsumed;
+    stats.dropped = m_framesDropped;
+    stats.queueDepth = m_inFlightCount;
+    stats.maxQueueDepth = m_maxInFlight;
+    stats.lastEncodeMs = m_lastWriteUs / 1000.0;
+    stats.maxEncodeMs = m_maxWriteUs / 1000.0;
+    return stats;
+}
 
-    if (m_ffmpegPid <= 0) {
-        std::cerr << "无法启动FFmpeg进程" << std::endl;
-        m_isRecording = false;
-        return;
+void FFmpegRecorder::waitThreadFunc() {
+    pid_t pid;
+    int pidfd;
+    {
+        std::lock_guard<std::mutex> lock(m_processMutex);
+        pid = m_ffmpegPid;
+        pidfd = m_pidfd;
     }
 
-    std::cout << "FFmpeg进程已启动，PID: " << m_ffmpegPid << std::endl;
+    // pidfd在进程退出时变为可读，不需要轮询waitpid
+    if (pidfd >= 0) {
+        struct pollfd pfd;
+        pfd.fd = pidfd;
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+        while (poll(&pfd, 1, -1) < 0 && errno == EINTR) {
+        }
+    }
 
-    // 等待FFmpeg进程结束或录制被停止
-    int status;
+    int status = 0;
     pid_t result;
-
     do {
-        result = waitpid(m_ffmpegPid, &status, WNOHANG);
-        if (result == 0) {
-            // 进程仍在运行，检查是否应该停止
-            if (!m_isRecording) {
-                terminateFFmpegProcess();
-                waitpid(m_ffmpegPid, &status, 0);  // 等待进程结束
-                break;
-            }
-            std::this_thread::sleep_for(std::chrono::milliseconds(100));
-        }
-    } while (result == 0);
+        result = waitpid(pid, &status, 0);
+    } while (result < 0 && errno == EINTR);
 
     if (result > 0) {
         if (WIFEXITED(status)) {
@@ -113,91 +451,288 @@ void FFmpegRecorder::recordingThreadFunc(const std::string& devicePath, const Re
         } else if (WIFSIGNALED(status)) {
             std::cout << "FFmpeg进程被信号终止，信号: " << WTERMSIG(status) << std::endl;
         }
-    } else if (result < 0) {
+    } else {
         std::cerr << "等待FFmpeg进程时出错: " << strerror(errno) << std::endl;
     }
 
-    m_ffmpegPid = -1;
+    {
+        std::lock_guard<std::mutex> lock(m_processMutex);
+        m_ffmpegPid = -1;
+    }
+    m_processExited.notify_all();
+
+    // 进程已退出，管道不再引用在途帧
+    if (m_pipeMode) {
+        std::lock_guard<std::mutex> lock(m_pipeMutex);
+        closePipe();
+        m_framesConsumed += m_inFlight.size();
+        m_inFlight.clear();
+        m_inFlightCount = 0;
+    }
+
     m_isRecording = false;
 }
 
-std::string FFmpegRecorder::generateFileName(const Resolution& resolution, int framerate) {
-    // 获取当前日期时间
-    std::string dateTime = Utils::getCurrentDateTimeString();
+std::string FFmpegRecorder::generateFileName(const Resolution& resolution, int framerate, const std::string& extension) {
+    // 获取当前日期时间；按时长分段时由ffmpeg在每个分段开始时展开
+    std::string dateTime = m_segment.segmentSeconds > 0 ? kSegmentDateTime : Utils::getCurrentDateTimeString();
 
-    // 生成文件名：日期时间_分辨率_帧率.mp4
+    // 生成文件名：日期时间_分辨率_帧率.扩展名
     std::string fileName = dateTime + "_" +
                           std::to_string(resolution.width) + "x" + std::to_string(resolution.height) +
-                          "_" + std::to_string(framerate) + "fps.mp4";
+                          "_" + std::to_string(framerate) + "fps" + extension;
 
     // 完整路径
     return fs::path(m_outputDir) / fileName;
 }
 
-std::string FFmpegRecorder::buildFFmpegCommand(const std::string& devicePath, const Resolution& resolution, int framerate, const std::string& outputPath, int durationSeconds) {
-    // 构建FFmpeg命令
-    std::string command = "ffmpeg -y";  // 覆盖输出文件
+std::vector<std::string> FFmpegRecorder::buildFFmpegArgs(const std::string& devicePath, const Resolution& resolution, int framerate, const std::string& outputPath, int durationSeconds) {
+    // 构建FFmpeg参数
+    std::vector<std::string> args = {"ffmpeg", "-y", "-nostdin"};  // 覆盖输出文件，不读取标准输入
 
     // 输入设备
-    command += " -f v4l2";  // 使用V4L2
-    command += " -input_format mjpeg";  // 使用MJPEG格式（如果摄像头支持）
-    command += " -video_size " + std::to_string(resolution.width) + "x" + std::to_string(resolution.height);
-    command += " -framerate " + std::to_string(framerate);
+    args.insert(args.end(), {"-f", "v4l2"});  // 使用V4L2
+    // 使用协商得到的格式，与采集路径保持一致
+    std::string inputFormat = FormatNegotiator::getFFmpegInputFormat(m_inputPixelFormat);
+    if (!inputFormat.empty()) {
+        args.insert(args.end(), {"-input_format", inputFormat});
+    }
+    args.insert(args.end(), {"-video_size", std::to_string(resolution.width) + "x" + std::to_string(resolution.height)});
+    args.insert(args.end(), {"-framerate", std::to_string(framerate)});
 
     // 如果指定了录制时间，添加时间限制参数
     if (durationSeconds > 0) {
-        command += " -t " + std::to_string(durationSeconds);
+        args.insert(args.end(), {"-t", std::to_string(durationSeconds)});
     }
 
-    command += " -i " + devicePath;
+    args.insert(args.end(), {"-i", devicePath});
 
+    appendOutputArgs(args, framerate, outputPath);
+    return args;
+}
+
+std::vector<std::string> FFmpegRecorder::buildPipeArgs(const Resolution& resolution, const FrameRate& framerate, uint32_t inputPixelFormat,
+                                                       bool streamCopy, const std::string& outputPath) {
+    std::vector<std::string> args = {"ffmpeg", "-y"};
+
+    // 采集管线可能丢帧，按到达时间打时间戳，输出端再按固定帧率补齐
+    args.insert(args.end(), {"-use_wallclock_as_timestamps", "1"});
+
+    if (inputPixelFormat == 0) {
+        // BGR原始帧
+        args.insert(args.end(), {"-f", "rawvideo", "-pix_fmt", "bgr24"});
+        args.insert(args.end(), {"-video_size", std::to_string(resolution.width) + "x" + std::to_string(resolution.height)});
+    } else {
+        // JPEG压缩帧
+        args.insert(args.end(), {"-f", "mjpeg"});
+    }
+    args.insert(args.end(), {"-framerate", std::to_string(framerate.numerator) + "/" + std::to_string(framerate.denominator)});
+    args.insert(args.end(), {"-i", "pipe:0"});
+
+    if (streamCopy) {
+        // 直通：JPEG帧原样写入mkv，不解码也不重新编码
+        args.insert(args.end(), {"-c:v", "copy"});
+        appendMuxerArgs(args, outputPath);
+        return args;
+    }
+
+    appendOutputArgs(args, framerate.rounded(), outputPath);
+    return args;
+}
+
+void FFmpegRecorder::appendOutputArgs(std::vector<std::string>& args, int framerate, const std::string& outputPath) {
     // 输出选项
-    command += " -c:v libx264";  // 使用H.264编码
-    command += " -preset ultrafast";  // 使用最快的编码预设
-    command += " -tune zerolatency";  // 优化低延迟
-    command += " -pix_fmt yuv420p";  // 使用YUV420P像素格式
-    command += " -r " + std::to_string(framerate);  // 设置输出帧率
-    command += " -b:v 2000k";  // 设置视频比特率
+    args.insert(args.end(), {"-c:v", "libx264"});  // 使用H.264编码
+    args.insert(args.end(), {"-preset", "ultrafast"});  // 使用最快的编码预设
+    args.insert(args.end(), {"-tune", "zerolatency"});  // 优化低延迟
+    args.insert(args.end(), {"-pix_fmt", "yuv420p"});  // 使用YUV420P像素格式
+    args.insert(args.end(), {"-r", std::to_string(framerate)});  // 设置输出帧率
+    args.insert(args.end(), {"-b:v", "2000k"});  // 设置视频比特率
+
+    // 分段录制时在每个分段边界强制关键帧，分段从关键帧开始
+    if (m_segment.segmentSeconds > 0) {
+        args.insert(args.end(), {"-force_key_frames", "expr:gte(t,n_forced*" + std::to_string(m_segment.segmentSeconds) + ")"});
+    }
+
+    appendMuxerArgs(args, outputPath);
+}
+
+void FFmpegRecorder::appendMuxerArgs(std::vector<std::string>& args, const std::string& outputPath) {
+    bool mp4 = fs::path(outputPath).extension() == ".mp4";
+    const char* movflags = "+frag_keyframe+empty_moov+default_base_moof";
+
+    if (m_segment.segmentMaxBytes > 0) {
+        std::cerr << "FFmpeg分段封装器不支持按大小分段，只按时长分段" << std::endl;
+    }
+
+    if (m_segment.segmentSeconds > 0) {
+        // segment封装器按时长在关键帧处切换文件，文件名中的日期时间由strftime展开
+        args.insert(args.end(), {"-f", "segment"});
+        args.insert(args.end(), {"-segment_time", std::to_string(m_segment.segmentSeconds)});
+        args.insert(args.end(), {"-reset_timestamps", "1"});
+        args.insert(args.end(), {"-strftime", "1"});
+        args.insert(args.end(), {"-segment_format", mp4 ? "mp4" : "matroska"});
+        if (mp4 && m_segment.fragmented) {
+            args.insert(args.end(), {"-segment_format_options", std::string("movflags=") + movflags});
+        }
+    } else if (mp4 && m_segment.fragmented) {
+        // 分片MP4：进程被杀死时已写入的片段仍可播放
+        args.insert(args.end(), {"-movflags", movflags});
+    }
 
     // 输出文件
-    command += " \"" + outputPath + "\"";
+    args.push_back(outputPath);
+}
+
+bool FFmpegRecorder::spawnFFmpeg(const std::vector<std::string>& args, int stdinFd) {
+    std::vector<char*> argv;
+    for (const auto& arg : args) {
+        argv.push_back(const_cast<char*>(arg.c_str()));
+    }
+    argv.push_back(nullptr);
+
+    // 标准输入接到管道或/dev/null，错误输出丢弃
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    if (stdinFd >= 0) {
+        posix_spawn_file_actions_adddup2(&actions, stdinFd, STDIN_FILENO);
+    } else {
+        posix_spawn_file_actions_addopen(&actions, STDIN_FILENO, "/dev/null", O_RDONLY, 0);
+    }
+    posix_spawn_file_actions_addopen(&actions, STDERR_FILENO, "/dev/null", O_WRONLY, 0);
 
-    // 添加后台运行和错误重定向
-    command += " 2>/dev/null &";
+    pid_t pid = -1;
+    int ret = posix_spawnp(&pid, argv[0], &actions, nullptr, argv.data(), environ);
+    posix_spawn_file_actions_destroy(&actions);
 
-    return command;
+    if (ret != 0) {
+        std::cerr << "无法启动FFmpeg进程: " << strerror(ret) << std::endl;
+        return false;
+    }
+
+    int pidfd = pidfdOpen(pid);
+    if (pidfd < 0) {
+        std::cerr << "内核不支持pidfd，改用waitpid等待FFmpeg进程" << std::endl;
+    }
+
+    std::lock_guard<std::mutex> lock(m_processMutex);
+    m_ffmpegPid = pid;
+    m_pidfd = pidfd;
+
+    std::cout << "FFmpeg进程已启动，PID: " << pid << std::endl;
+    return true;
 }
 
-int FFmpegRecorder::executeCommand(const std::string& command) {
-    // 执行命令并获取进程ID
-    FILE* pipe = popen((command + " echo $!").c_str(), "r");
-    if (!pipe) {
-        return -1;
+void FFmpegRecorder::signalFFmpegProcess(int signal) {
+    std::lock_guard<std::mutex> lock(m_processMutex);
+
+    if (m_pidfd >= 0) {
+        // 进程已退出时返回ESRCH，不会误伤复用了该进程号的其他进程
+        pidfdSendSignal(m_pidfd, signal);
+    } else if (m_ffmpegPid > 0) {
+        std::cout << "终止FFmpeg进程，PID: " << m_ffmpegPid << std::endl;
+        kill(m_ffmpegPid, signal);
     }
+}
+
+bool FFmpegRecorder::writeToPipe(std::vector<struct iovec>& iov, size_t& bytesWritten) {
+    bytesWritten = 0;
+    size_t index = 0;
+    bool stopping = false;
+    std::chrono::steady_clock::time_point deadline;
+
+    while (index < iov.size()) {
+        int count = static_cast<int>(std::min<size_t>(iov.size() - index, IOV_MAX));
+
+        ssize_t written;
+        if (m_useVmsplice) {
+            written = vmsplice(m_pipeFd, &iov[index], count, SPLICE_F_NONBLOCK);
+            if (written < 0 && (errno == EINVAL || errno == ENOSYS || errno == EPERM)) {
+                // 不支持vmsplice（如被seccomp禁止），退回普通写入
+                std::cerr << "vmsplice不可用，改用普通写入: " << strerror(errno) << std::endl;
+                m_useVmsplice = false;
+                continue;
+            }
+        } else {
+            written = writev(m_pipeFd, &iov[index], count);
+        }
+
+        if (written < 0 && errno == EAGAIN) {
+            // 管道已满：等待ffmpeg读取；通知停止后最多再等kStopTimeoutMs
+            struct pollfd pfds[2];
+            pfds[0].fd = m_pipeFd;
+            pfds[0].events = POLLOUT;
+            pfds[0].revents = 0;
+            pfds[1].fd = stopping ? -1 : m_stopFd;  // 已看到停止通知后只等管道
+            pfds[1].events = POLLIN;
+            pfds[1].revents = 0;
+
+            int timeoutMs = -1;
+            if (stopping) {
+                auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+                    deadline - std::chrono::steady_clock::now()).count();
+                if (left <= 0) {
+                    // 这一帧可能只写入了一部分，ffmpeg会丢弃文件末尾不完整的帧
+                    std::cerr << "FFmpeg超时未读取管道，放弃剩余的帧" << std::endl;
+                    return false;
+                }
+                timeoutMs = static_cast<int>(left);
+            }
 
-    // 读取进程ID
-    char buffer[128];
-    std::string result = "";
-    while (!feof(pipe)) {
-        if (fgets(buffer, 128, pipe) != NULL) {
-            result += buffer;
+            if (poll(pfds, 2, timeoutMs) < 0 && errno != EINTR) {
+                std::cerr << "等待FFmpeg管道失败: " << strerror(errno) << std::endl;
+                return false;
+            }
+            if (!stopping && (pfds[1].revents & POLLIN)) {
+                stopping = true;
+                deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(kStopTimeoutMs);
+            }
+            continue;
+        }
+
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            std::cerr << "写入FFmpeg管道失败: " << strerror(errno) << std::endl;
+            return false;
+        }
+
+        // 跳过已写完的部分
+        bytesWritten += static_cast<size_t>(written);
+        size_t remaining = static_cast<size_t>(written);
+        while (index < iov.size() && remaining >= iov[index].iov_len) {
+            remaining -= iov[index].iov_len;
+            index++;
+        }
+        if (remaining > 0) {
+            iov[index].iov_base = static_cast<uint8_t*>(iov[index].iov_base) + remaining;
+            iov[index].iov_len -= remaining;
         }
     }
 
-    // 关闭管道
-    pclose(pipe);
+    return true;
+}
+
+void FFmpegRecorder::releaseConsumedFrames() {
+    // FIONREAD返回管道中尚未被读取的字节数
+    int pending = 0;
+    if (m_pipeFd < 0 || ioctl(m_pipeFd, FIONREAD, &pending) < 0) {
+        return;
+    }
 
-    // 解析进程ID
-    try {
-        return std::stoi(result);
-    } catch (...) {
-        return -1;
+    uint64_t consumed = m_bytesWritten - static_cast<uint64_t>(pending);
+    while (!m_inFlight.empty() && m_inFlight.front().endOffset <= consumed) {
+        m_inFlight.pop_front();
+        m_framesConsumed++;
     }
+    m_inFlightCount = m_inFlight.size();
 }
 
-void FFmpegRecorder::terminateFFmpegProcess() {
-    if (m_ffmpegPid > 0) {
-        std::cout << "终止FFmpeg进程，PID: " << m_ffmpegPid << std::endl;
-        kill(m_ffmpegPid, SIGTERM);
+void FFmpegRecorder::closePipe() {
+    // 在途帧保留到ffmpeg退出：关闭写端后管道中的页面仍会被读取
+    if (m_pipeFd >= 0) {
+        close(m_pipeFd);
+        m_pipeFd = -1;
     }
 }
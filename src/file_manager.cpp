@@ -3,8 +3,26 @@
 #include <iostream>
 #include <algorithm>
 #include <regex>
+#include <sstream>
+#include <iomanip>
+#include <ctime>
+#include <cstdlib>
 #include <opencv2/opencv.hpp>
 
+namespace {
+    // 把文件名中的日期时间（20230101_120000）转换为时间，无法解析时返回-1
+    std::time_t parseDateTime(const std::string& dateTime) {
+        std::tm tm = {};
+        std::istringstream ss(dateTime);
+        ss >> std::get_time(&tm, "%Y%m%d_%H%M%S");
+        if (ss.fail()) {
+            return -1;
+        }
+        tm.tm_isdst = -1;
+        return std::mktime(&tm);
+    }
+}
+
 FileManager::FileManager() {
 }
 
@@ -55,6 +73,28 @@ std::vector<VideoFileInfo> FileManager::getVideoFileList() {
         std::cerr << "获取视频文件列表时出错: " << e.what() << std::endl;
     }
     
+    // 副本归入同一次录制的主文件（各副本的文件名分别生成，开始时间可能相差一秒）
+    std::vector<VideoFileInfo> grouped;
+    std::vector<VideoFileInfo> renditions;
+    for (auto& fileInfo : videoFiles) {
+        if (fileInfo.rendition.empty()) {
+            grouped.push_back(std::move(fileInfo));
+        } else {
+            renditions.push_back(std::move(fileInfo));
+        }
+    }
+    for (auto& rendition : renditions) {
+        auto primary = std::find_if(grouped.begin(), grouped.end(), [&rendition](const VideoFileInfo& candidate) {
+            return candidate.rendition.empty() && isSameRecording(candidate, rendition);
+        });
+        if (primary != grouped.end()) {
+            primary->renditionFiles.push_back(rendition.filePath);
+        } else {
+            grouped.push_back(std::move(rendition));
+        }
+    }
+    videoFiles.swap(grouped);
+
     // 按日期时间排序（最新的在前）
     std::sort(videoFiles.begin(), videoFiles.end(), 
              [](const VideoFileInfo& a, const VideoFileInfo& b) {
@@ -91,15 +131,17 @@ VideoFileInfo FileManager::parseFileName(const fs::path& filePath) {
     fileInfo.fileName = filePath.filename().string();
     
     // 使用正则表达式解析文件名
-    // 格式：日期时间_分辨率_帧率.mp4
-    // 例如：20230101_120000_1920x1080_30fps.mp4
-    std::regex pattern(R"((\d{8}_\d{6})_(\d+x\d+)_(\d+)fps\..+)");
+    // 格式：日期时间_分辨率_帧率[.分段序号][.副本名称].扩展名
+    // 例如：20230101_120000_1920x1080_30fps.mp4、20230101_120000_854x480_30fps.proxy.mp4
+    std::regex pattern(R"((\d{8}_\d{6})_(\d+x\d+)_(\d+)fps(?:\.(\d+))?(?:\.([A-Za-z]\w*))?\.\w+)");
     std::smatch matches;
     
-    if (std::regex_match(fileInfo.fileName, matches, pattern) && matches.size() == 4) {
+    if (std::regex_match(fileInfo.fileName, matches, pattern) && matches.size() == 6) {
         fileInfo.dateTime = matches[1].str();
         fileInfo.resolution = matches[2].str();
         fileInfo.framerate = std::stoi(matches[3].str());
+        fileInfo.segmentIndex = matches[4].matched ? std::stoi(matches[4].str()) : 0;
+        fileInfo.rendition = matches[5].str();
     } else {
         // 如果无法解析，设置默认值
         fileInfo.dateTime = "未知";
@@ -109,3 +151,16 @@ VideoFileInfo FileManager::parseFileName(const fs::path& filePath) {
     
     return fileInfo;
 }
+
+bool FileManager::isSameRecording(const VideoFileInfo& a, const VideoFileInfo& b, int toleranceSeconds) {
+    if (a.framerate != b.framerate || a.segmentIndex != b.segmentIndex) {
+        return false;
+    }
+
+    std::time_t timeA = parseDateTime(a.dateTime);
+    std::time_t timeB = parseDateTime(b.dateTime);
+    if (timeA < 0 || timeB < 0) {
+        return false;
+    }
+    return std::llabs(static_cast<long long>(timeA - timeB)) <= toleranceSeconds;
+}
@@ -0,0 +1,323 @@
+#include "format_negotiator.h"
+#include <algorithm>
+#include <fstream>
+#include <filesystem>
+#include <sstream>
+#include <iomanip>
+
+namespace fs = std::filesystem;
+
+namespace {
+    // 总线占用上限：等时传输还要和其他设备共享，留出余量
+    const double kMaxBusLoad = 0.9;
+
+    // 总线占用在综合代价中的权重（CPU核心数为单位）；带宽主要作为约束，代价里只起次要作用
+    const double kBusWeight = 0.05;
+
+    // 帧率比较容差，30000/1001和30视为满足
+    const double kFramerateTolerance = 0.995;
+
+    // 每像素在总线上的字节数；MJPEG按常见压缩率估算（1080p约300KB/帧）
+    double getBusBytesPerPixel(uint32_t pixelFormat) {
+        switch (pixelFormat) {
+            case V4L2_PIX_FMT_YUYV:
+            case V4L2_PIX_FMT_UYVY:
+                return 2.0;
+            case V4L2_PIX_FMT_NV12:
+                return 1.5;
+            case V4L2_PIX_FMT_MJPEG:
+            case V4L2_PIX_FMT_JPEG:
+                return 0.15;
+            default:
+                return 2.0;
+        }
+    }
+
+    // 每像素处理耗时（纳秒）：YUV格式为SIMD颜色转换，MJPEG为JPEG解码（直接输出BGR）
+    double getCpuNsPerPixel(uint32_t pixelFormat) {
+        switch (pixelFormat) {
+            case V4L2_PIX_FMT_YUYV:
+            case V4L2_PIX_FMT_UYVY:
+                return 1.0;
+            case V4L2_PIX_FMT_NV12:
+                return 1.0;
+            case V4L2_PIX_FMT_MJPEG:
+            case V4L2_PIX_FMT_JPEG:
+                return 8.0;
+            default:
+                return 1.0;
+        }
+    }
+
+    bool isJpegFormat(uint32_t pixelFormat) {
+        return pixelFormat == V4L2_PIX_FMT_MJPEG || pixelFormat == V4L2_PIX_FMT_JPEG;
+    }
+
+    // MJPEG和JPEG在采集路径上等价
+    bool isSameFormat(uint32_t a, uint32_t b) {
+        return a == b || (isJpegFormat(a) && isJpegFormat(b));
+    }
+
+    std::string formatDouble(double value, int precision) {
+        std::ostringstream oss;
+        oss << std::fixed << std::setprecision(precision) << value;
+        return oss.str();
+    }
+}
+
+FormatNegotiator::FormatNegotiator()
+    : m_busBandwidthOverride(0.0),
+      m_cpuBudget(1.0),
+      m_requiredFormat(0) {
+}
+
+NegotiationPlan FormatNegotiator::plan(const CameraDeviceInfo& device, const Resolution& resolution,
+                                       const FrameRate& framerate) const {
+    NegotiationPlan result;
+    result.resolution = resolution;
+    result.framerate = framerate;
+
+    double busBandwidth = m_busBandwidthOverride > 0.0 ?
+                          m_busBandwidthOverride : estimateBusBandwidth(device.busSpeedMbps);
+
+    for (const auto& format : device.formats) {
+        result.candidates.push_back(evaluate(format, resolution, framerate, busBandwidth));
+    }
+
+    // 满足要求的在前，其次按代价排序
+    std::stable_sort(result.candidates.begin(), result.candidates.end(),
+                     [](const FormatCandidate& a, const FormatCandidate& b) {
+                         if (a.feasible != b.feasible) {
+                             return a.feasible;
+                         }
+                         return a.cost < b.cost;
+                     });
+
+    const FormatCandidate* chosen = nullptr;
+    FormatCandidate stepped;  // 降低帧率后满足要求的候选
+    if (!result.candidates.empty() && result.candidates.front().feasible) {
+        chosen = &result.candidates.front();
+        result.reason = "选择" + fourccToString(chosen->pixelFormat) + "：满足要求的格式中代价最低";
+    } else {
+        // 没有格式能以请求的帧率满足要求时，各格式降到该模式下满足带宽和CPU限制的最高帧率，取帧率最高的（同帧率取代价低的）
+        for (const auto& format : device.formats) {
+            for (const auto& fps : format.getFramerates(resolution.width, resolution.height)) {
+                if (fps.toDouble() >= framerate.toDouble() * kFramerateTolerance) {
+                    continue;  // 不低于请求的帧率已经评估过
+                }
+                FormatCandidate candidate = evaluate(format, resolution, fps, busBandwidth);
+                if (candidate.feasible) {
+                    if (!stepped.feasible || stepped.framerate < candidate.framerate ||
+                        (stepped.framerate == candidate.framerate && candidate.cost < stepped.cost)) {
+                        stepped = candidate;
+                    }
+                    break;  // 帧率从高到低排列，第一个满足的就是该格式的最高帧率
+                }
+            }
+        }
+        if (stepped.feasible) {
+            chosen = &stepped;
+            result.reason = "没有格式能满足" + resolution.toString() + "@" + framerate.toString() +
+                            "fps，降级为" + fourccToString(chosen->pixelFormat) + " " +
+                            chosen->framerate.toString() + "fps（该模式下满足带宽和CPU限制的最高帧率）";
+        }
+    }
+
+    if (!chosen) {
+        // 降低帧率也无法满足时，选择能达到最高帧率的格式，实际帧率可能达不到
+        for (const auto& candidate : result.candidates) {
+            if (!isFormatSupported(candidate.pixelFormat) || !candidate.framerate.isValid()) {
+                continue;
+            }
+            if (!chosen || chosen->framerate < candidate.framerate ||
+                (chosen->framerate == candidate.framerate && candidate.cost < chosen->cost)) {
+                chosen = &candidate;
+            }
+        }
+        if (chosen) {
+            result.reason = "没有格式能满足" + resolution.toString() + "@" + framerate.toString() +
+                            "fps，降低帧率也无法满足限制，选择" + fourccToString(chosen->pixelFormat) + " " +
+                            chosen->framerate.toString() + "fps";
+        }
+    }
+
+    if (!chosen) {
+        result.reason = "设备没有采集路径支持的格式";
+        return result;
+    }
+
+    result.valid = true;
+    result.pixelFormat = chosen->pixelFormat;
+    result.framerate = chosen->framerate;
+    result.reason += "（" + chosen->reason + "）";
+
+    // 附上其他候选被放弃的原因
+    for (const auto& candidate : result.candidates) {
+        if (&candidate != chosen) {
+            result.reason += "；" + fourccToString(candidate.pixelFormat) + "：" + candidate.reason;
+        }
+    }
+
+    return result;
+}
+
+FormatCandidate FormatNegotiator::evaluate(const FormatCapability& format, const Resolution& resolution,
+                                           const FrameRate& framerate, double busBandwidth) const {
+    FormatCandidate candidate;
+    candidate.pixelFormat = format.pixelFormat;
+
+    if (!isFormatSupported(format.pixelFormat)) {
+        candidate.reason = "采集路径不支持该格式";
+        return candidate;
+    }
+
+    if (m_requiredFormat != 0 && !isSameFormat(format.pixelFormat, m_requiredFormat)) {
+        candidate.reason = "要求使用" + fourccToString(m_requiredFormat);
+        return candidate;
+    }
+
+    if (!format.supportsSize(resolution.width, resolution.height)) {
+        candidate.reason = "不支持" + resolution.toString();
+        return candidate;
+    }
+
+    // 取不低于请求值的最低帧率，设备只有更低帧率时取最高的
+    std::vector<FrameRate> framerates = format.getFramerates(resolution.width, resolution.height);
+    if (framerates.empty()) {
+        candidate.framerate = framerate;  // 没有枚举到帧间隔，假定请求的帧率可用
+    } else {
+        candidate.framerate = framerates.front();
+        for (const auto& fps : framerates) {
+            if (fps.toDouble() >= framerate.toDouble() * kFramerateTolerance) {
+                candidate.framerate = fps;
+            }
+        }
+    }
+
+    double pixelsPerSecond = static_cast<double>(resolution.width) * resolution.height *
+                             candidate.framerate.toDouble();
+    double busBytesPerSecond = pixelsPerSecond * getBusBytesPerPixel(format.pixelFormat);
+
+    candidate.busLoad = busBandwidth > 0.0 ? busBytesPerSecond / busBandwidth : 0.0;
+    candidate.cpuLoad = pixelsPerSecond * getCpuNsPerPixel(format.pixelFormat) / 1e9;
+    candidate.cost = candidate.cpuLoad + candidate.busLoad * kBusWeight;
+
+    std::string loads = "CPU约" + formatDouble(candidate.cpuLoad, 2) + "核";
+    if (busBandwidth > 0.0) {
+        loads += "，总线" + formatDouble(busBytesPerSecond / 1e6, 1) + "MB/s（" +
+                 formatDouble(candidate.busLoad * 100.0, 0) + "%）";
+    }
+
+    if (candidate.framerate.toDouble() < framerate.toDouble() * kFramerateTolerance) {
+        candidate.reason = "最高只支持" + candidate.framerate.toString() + "fps，" + loads;
+        return candidate;
+    }
+
+    if (candidate.busLoad > kMaxBusLoad) {
+        candidate.reason = "超出总线带宽，" + loads;
+        return candidate;
+    }
+
+    if (candidate.cpuLoad > m_cpuBudget) {
+        candidate.reason = "超出CPU预算，" + loads;
+        return candidate;
+    }
+
+    candidate.feasible = true;
+    candidate.reason = loads;
+    return candidate;
+}
+
+int FormatNegotiator::detectUsbSpeed(const std::string& devicePath) {
+    // /sys/class/video4linux/videoN/device指向USB接口，向上找到带speed属性的USB设备
+    std::error_code ec;
+    std::string nodeName = fs::path(devicePath).filename().string();
+    fs::path current = fs::canonical(fs::path("/sys/class/video4linux") / nodeName / "device", ec);
+    if (ec) {
+        return 0;
+    }
+
+    while (!current.empty() && current != current.root_path() && current != "/sys/devices") {
+        fs::path speedFile = current / "speed";
+        if (fs::exists(speedFile, ec)) {
+            std::ifstream file(speedFile);
+            double speed = 0.0;
+            if (file >> speed) {
+                return static_cast<int>(speed);
+            }
+            return 0;
+        }
+        current = current.parent_path();
+    }
+
+    return 0;
+}
+
+double FormatNegotiator::estimateBusBandwidth(int usbSpeedMbps) {
+    if (usbSpeedMbps <= 0) {
+        return 0.0;  // 非USB设备（如CSI）不受总线带宽限制
+    }
+    if (usbSpeedMbps <= 12) {
+        return 1023.0 * 1000;  // 全速：每帧最多1023字节等时数据
+    }
+    if (usbSpeedMbps <= 480) {
+        return 3.0 * 1024 * 8000;  // 高速：每微帧最多3x1024字节
+    }
+    // 超高速：理论带宽的六成左右是实际可用的等时带宽
+    return usbSpeedMbps * 1e6 / 8 * 0.6;
+}
+
+bool FormatNegotiator::isFormatSupported(uint32_t pixelFormat) {
+    switch (pixelFormat) {
+        case V4L2_PIX_FMT_YUYV:
+        case V4L2_PIX_FMT_UYVY:
+        case V4L2_PIX_FMT_NV12:
+        case V4L2_PIX_FMT_MJPEG:
+        case V4L2_PIX_FMT_JPEG:
+            return true;
+        default:
+            return false;
+    }
+}
+
+std::string FormatNegotiator::getFFmpegInputFormat(uint32_t pixelFormat) {
+    switch (pixelFormat) {
+        case V4L2_PIX_FMT_YUYV:
+            return "yuyv422";
+        case V4L2_PIX_FMT_UYVY:
+            return "uyvy422";
+        case V4L2_PIX_FMT_NV12:
+            return "nv12";
+        case V4L2_PIX_FMT_MJPEG:
+        case V4L2_PIX_FMT_JPEG:
+            return "mjpeg";
+        default:
+            return "";
+    }
+}
+
+std::string FormatNegotiator::getGStreamerFormat(uint32_t pixelFormat) {
+    switch (pixelFormat) {
+        case V4L2_PIX_FMT_YUYV:
+            return "YUY2";
+        case V4L2_PIX_FMT_UYVY:
+            return "UYVY";
+        case V4L2_PIX_FMT_NV12:
+            return "NV12";
+        case V4L2_PIX_FMT_GREY:
+            return "GRAY8";
+        default:
+            return "";
+    }
+}
+
+std::string FormatNegotiator::fourccToString(uint32_t pixelFormat) {
+    std::string result;
+    for (int i = 0; i < 4; i++) {
+        char c = static_cast<char>((pixelFormat >> (i * 8)) & 0xff);
+        if (c != ' ' && c != '\0') {
+            result += c;
+        }
+    }
+    return result;
+}
@@ -0,0 +1,421 @@
+#include "frame_archive.h"
+#include "utils.h"
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+#include <algorithm>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#ifdef HAVE_LZ4
+#include <lz4.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace {
+    const char kHeaderMagic[8] = {'V', 'C', 'F', 'A', 'R', 'C', 0, 0};
+    const char kFooterMagic[8] = {'V', 'C', 'F', 'I', 'D', 'X', 0, 0};
+    const uint32_t kVersion = 1;
+
+    static_assert(sizeof(FrameArchiveHeader) == 16, "FrameArchiveHeader布局");
+    static_assert(sizeof(FrameArchiveEntry) == 32, "FrameArchiveEntry布局");
+    static_assert(sizeof(FrameArchiveFooter) == 48, "FrameArchiveFooter布局");
+
+    // 帧索引在文件中的对齐（mmap的起始地址按页对齐，文件内偏移对齐即可按FrameArchiveEntry访问）
+    const size_t kIndexAlignment = 8;
+    static_assert(alignof(FrameArchiveEntry) <= kIndexAlignment, "FrameArchiveEntry对齐");
+
+    // Raw和Lz4保存的像素类型：8位1、3或4通道，读取时按文件尾中的类型和尺寸创建图像
+    bool isSupportedType(int type) {
+        return type == CV_8UC1 || type == CV_8UC3 || type == CV_8UC4;
+    }
+
+    // 每个编码线程复用的编码缓冲区
+    thread_local std::vector<uint8_t> t_payload;
+
+    std::string frameFileName(uint32_t frameNumber) {
+        std::stringstream ss;
+        ss << "frame_" << std::setw(6) << std::setfill('0') << frameNumber << ".jpg";
+        return ss.str();
+    }
+}
+
+FrameArchiveWriter::FrameArchiveWriter()
+    : m_codec(FrameArchiveCodec::Jpeg), m_jpegQuality(95), m_open(false), m_failed(false),
+      m_width(0), m_height(0), m_type(0) {
+}
+
+FrameArchiveWriter::~FrameArchiveWriter() {
+    if (m_open) {
+        finish();
+    }
+}
+
+bool FrameArchiveWriter::isCodecAvailable(FrameArchiveCodec codec) {
+#ifdef HAVE_LZ4
+    return true;
+#else
+    return codec != FrameArchiveCodec::Lz4;
+#endif
+}
+
+bool FrameArchiveWriter::open(const std::string& filePath, FrameArchiveCodec codec, int jpegQuality) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_open) {
+        return false;
+    }
+    if (!isCodecAvailable(codec)) {
+        std::cerr << "未启用liblz4，无法使用LZ4编码" << std::endl;
+        return false;
+    }
+
+    // 分帧的写入是大块顺序追加，缓冲区比录制用的大一些
+    OutputSinkSettings settings;
+    settings.bufferSize = 1024 * 1024;
+    settings.bufferCount = 8;
+    if (!m_sink.init(settings) || !m_sink.open(filePath)) {
+        std::cerr << "无法创建帧归档: " << filePath << std::endl;
+        return false;
+    }
+
+    FrameArchiveHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, kHeaderMagic, sizeof(kHeaderMagic));
+    header.version = kVersion;
+    header.codec = static_cast<uint32_t>(codec);
+    if (!m_sink.write(reinterpret_cast<const uint8_t*>(&header), sizeof(header))) {
+        m_sink.close();
+        m_sink.drain();
+        return false;
+    }
+
+    m_filePath = filePath;
+    m_codec = codec;
+    m_jpegQuality = jpegQuality;
+    m_failed = false;
+    m_width = 0;
+    m_height = 0;
+    m_type = 0;
+    m_entries.clear();
+    m_open = true;
+    return true;
+}
+
+bool FrameArchiveWriter::encode(const cv::Mat& frame, std::vector<uint8_t>& payload, uint32_t& rawSize) const {
+    if (m_codec == FrameArchiveCodec::Jpeg) {
+        rawSize = 0;
+        return cv::imencode(".jpg", frame, payload, {cv::IMWRITE_JPEG_QUALITY, m_jpegQuality});
+    }
+
+    // 像素按行紧密排列
+    cv::Mat pixels = frame.isContinuous() ? frame : frame.clone();
+    size_t bytes = pixels.total() * pixels.elemSize();
+    rawSize = static_cast<uint32_t>(bytes);
+
+    if (m_codec == FrameArchiveCodec::Raw) {
+        payload.assign(pixels.data, pixels.data + bytes);
+        return true;
+    }
+
+#ifdef HAVE_LZ4
+    payload.resize(LZ4_compressBound(static_cast<int>(bytes)));
+    int compressed = LZ4_compress_default(reinterpret_cast<const char*>(pixels.data),
+                                          reinterpret_cast<char*>(payload.data()),
+                                          static_cast<int>(bytes), static_cast<int>(payload.size()));
+    if (compressed <= 0) {
+        return false;
+    }
+    payload.resize(compressed);
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool FrameArchiveWriter::addFrame(int frameNumber, int64_t timestampUs, const cv::Mat& frame) {
+    if (!m_open || frame.empty()) {
+        return false;
+    }
+
+    // 编码不加锁，多个线程并行
+    std::vector<uint8_t>& payload = t_payload;
+    uint32_t rawSize = 0;
+    if (!encode(frame, payload, rawSize)) {
+        std::cerr << "无法编码帧 " << frameNumber << std::endl;
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_open || m_failed) {
+        return false;
+    }
+    if (m_codec != FrameArchiveCodec::Jpeg && !isSupportedType(frame.type())) {
+        std::cerr << "帧归档不支持帧 " << frameNumber << " 的像素类型" << std::endl;
+        return false;
+    }
+    if (m_entries.empty()) {
+        m_width = frame.cols;
+        m_height = frame.rows;
+        m_type = frame.type();
+    } else if (frame.cols != m_width || frame.rows != m_height || frame.type() != m_type) {
+        std::cerr << "帧 " << frameNumber << " 的尺寸与归档中的其他帧不同" << std::endl;
+        return false;
+    }
+
+    FrameArchiveEntry entry;
+    memset(&entry, 0, sizeof(entry));
+    entry.offset = static_cast<uint64_t>(m_sink.tell());
+    entry.size = static_cast<uint32_t>(payload.size());
+    entry.frameNumber = static_cast<uint32_t>(frameNumber);
+    entry.timestampUs = timestampUs;
+    entry.rawSize = rawSize;
+    if (!m_sink.write(payload.data(), payload.size())) {
+        std::cerr << "帧归档写入失败: " << m_filePath << std::endl;
+        m_failed = true;
+        return false;
+    }
+    m_entries.push_back(entry);
+    return true;
+}
+
+bool FrameArchiveWriter::finish() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_open) {
+        return false;
+    }
+    m_open = false;
+
+    // 编码线程完成的顺序不固定，索引按帧号排序，读取时第i项即第i帧
+    std::sort(m_entries.begin(), m_entries.end(),
+              [](const FrameArchiveEntry& a, const FrameArchiveEntry& b) { return a.frameNumber < b.frameNumber; });
+
+    FrameArchiveFooter footer;
+    memset(&footer, 0, sizeof(footer));
+    memcpy(footer.magic, kFooterMagic, sizeof(kFooterMagic));
+    footer.version = kVersion;
+    footer.entrySize = sizeof(FrameArchiveEntry);
+    footer.width = static_cast<uint32_t>(m_width);
+    footer.height = static_cast<uint32_t>(m_height);
+    footer.type = static_cast<uint32_t>(m_type);
+    footer.codec = static_cast<uint32_t>(m_codec);
+    footer.frameCount = m_entries.size();
+
+    // 帧数据之后补零到8字节边界，读取时索引直接映射为FrameArchiveEntry数组，其中的uint64_t要求8字节对齐
+    static const uint8_t kPadding[kIndexAlignment] = {};
+    size_t padding = (kIndexAlignment - static_cast<size_t>(m_sink.tell()) % kIndexAlignment) % kIndexAlignment;
+    footer.indexOffset = static_cast<uint64_t>(m_sink.tell()) + padding;
+
+    bool ok = !m_failed;
+    if (ok && padding > 0) {
+        ok = m_sink.write(kPadding, padding);
+    }
+    if (ok && !m_entries.empty()) {
+        ok = m_sink.write(reinterpret_cast<const uint8_t*>(m_entries.data()),
+                          m_entries.size() * sizeof(FrameArchiveEntry));
+    }
+    ok = ok && m_sink.write(reinterpret_cast<const uint8_t*>(&footer), sizeof(footer));
+    ok = m_sink.close() && ok;
+    m_sink.drain();
+    ok = ok && m_sink.getStats().errors == 0;
+
+    if (!ok) {
+        std::cerr << "帧归档写入失败: " << m_filePath << std::endl;
+    }
+    return ok;
+}
+
+size_t FrameArchiveWriter::getFrameCount() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_entries.size();
+}
+
+FrameArchiveReader::FrameArchiveReader()
+    : m_data(nullptr), m_size(0), m_entries(nullptr), m_frameCount(0), m_width(0), m_height(0), m_type(0),
+      m_codec(FrameArchiveCodec::Jpeg) {
+}
+
+FrameArchiveReader::~FrameArchiveReader() {
+    close();
+}
+
+bool FrameArchiveReader::open(const std::string& filePath) {
+    close();
+
+    int fd = ::open(filePath.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        std::cerr << "无法打开帧归档: " << filePath << std::endl;
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 ||
+        static_cast<size_t>(st.st_size) < sizeof(FrameArchiveHeader) + sizeof(FrameArchiveFooter)) {
+        std::cerr << "不是有效的帧归档: " << filePath << std::endl;
+        ::close(fd);
+        return false;
+    }
+
+    size_t size = static_cast<size_t>(st.st_size);
+    void* data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED) {
+        std::cerr << "无法映射帧归档: " << filePath << std::endl;
+        return false;
+    }
+    m_data = static_cast<uint8_t*>(data);
+    m_size = size;
+
+    // 校验文件头、文件尾和索引范围
+    FrameArchiveHeader header;
+    FrameArchiveFooter footer;
+    memcpy(&header, m_data, sizeof(header));
+    memcpy(&footer, m_data + size - sizeof(footer), sizeof(footer));
+    uint64_t indexEnd = size - sizeof(footer);
+    bool ok = memcmp(header.magic, kHeaderMagic, sizeof(kHeaderMagic)) == 0 && header.version == kVersion &&
+              memcmp(footer.magic, kFooterMagic, sizeof(kFooterMagic)) == 0 && footer.version == kVersion &&
+              footer.entrySize == sizeof(FrameArchiveEntry) && footer.codec == header.codec &&
+              footer.codec <= static_cast<uint32_t>(FrameArchiveCodec::Raw) &&
+              footer.indexOffset >= sizeof(header) && footer.indexOffset <= indexEnd &&
+              footer.indexOffset % kIndexAlignment == 0 &&
+              footer.frameCount == (indexEnd - footer.indexOffset) / sizeof(FrameArchiveEntry) &&
+              (indexEnd - footer.indexOffset) % sizeof(FrameArchiveEntry) == 0;
+    if (!ok) {
+        std::cerr << "不是有效的帧归档（或写入未完成）: " << filePath << std::endl;
+        close();
+        return false;
+    }
+
+    // 像素归档按文件尾的类型和尺寸创建图像，先确认是支持的类型，尺寸与每帧的解压长度在readFrame中核对
+    if (footer.codec != static_cast<uint32_t>(FrameArchiveCodec::Jpeg) && footer.frameCount > 0 &&
+        (!isSupportedType(static_cast<int>(footer.type)) || footer.width == 0 || footer.height == 0)) {
+        std::cerr << "帧归档的像素类型或尺寸无效: " << filePath << std::endl;
+        close();
+        return false;
+    }
+
+    m_entries = reinterpret_cast<const FrameArchiveEntry*>(m_data + footer.indexOffset);
+    m_frameCount = footer.frameCount;
+    for (size_t i = 0; i < m_frameCount; i++) {
+        // 分开比较偏移和大小，损坏的索引项不能让offset + size溢出绕过检查
+        if (m_entries[i].offset < sizeof(header) || m_entries[i].offset > footer.indexOffset ||
+            m_entries[i].size > footer.indexOffset - m_entries[i].offset) {
+            std::cerr << "帧归档索引损坏: " << filePath << std::endl;
+            close();
+            return false;
+        }
+    }
+
+    m_width = static_cast<int>(footer.width);
+    m_height = static_cast<int>(footer.height);
+    m_type = static_cast<int>(footer.type);
+    m_codec = static_cast<FrameArchiveCodec>(footer.codec);
+    return true;
+}
+
+void FrameArchiveReader::close() {
+    if (m_data) {
+        munmap(m_data, m_size);
+    }
+    m_data = nullptr;
+    m_size = 0;
+    m_entries = nullptr;
+    m_frameCount = 0;
+}
+
+const uint8_t* FrameArchiveReader::getPayload(size_t i, size_t& size) const {
+    if (i >= m_frameCount) {
+        size = 0;
+        return nullptr;
+    }
+    size = m_entries[i].size;
+    return m_data + m_entries[i].offset;
+}
+
+bool FrameArchiveReader::readFrame(size_t i, cv::Mat& frame) const {
+    size_t size = 0;
+    const uint8_t* payload = getPayload(i, size);
+    if (!payload) {
+        return false;
+    }
+
+    if (m_codec == FrameArchiveCodec::Jpeg) {
+        // imdecode不修改输入，直接包装映射的内存
+        cv::Mat encoded(1, static_cast<int>(size), CV_8UC1, const_cast<uint8_t*>(payload));
+        frame = cv::imdecode(encoded, cv::IMREAD_COLOR);
+        return !frame.empty();
+    }
+
+    // 先用索引中的解压长度核对尺寸，损坏的文件尾不能让create分配超大的图像
+    uint64_t bytes = static_cast<uint64_t>(m_width) * m_height * CV_MAT_CN(m_type);
+    if (!isSupportedType(m_type) || m_entries[i].rawSize != bytes) {
+        return false;
+    }
+    frame.create(m_height, m_width, m_type);
+    if (m_codec == FrameArchiveCodec::Raw) {
+        if (size != bytes) {
+            return false;
+        }
+        memcpy(frame.data, payload, bytes);
+        return true;
+    }
+
+#ifdef HAVE_LZ4
+    int decompressed = LZ4_decompress_safe(reinterpret_cast<const char*>(payload), reinterpret_cast<char*>(frame.data),
+                                           static_cast<int>(size), static_cast<int>(bytes));
+    return decompressed == static_cast<int>(bytes);
+#else
+    std::cerr << "未启用liblz4，无法读取LZ4编码的帧" << std::endl;
+    return false;
+#endif
+}
+
+int FrameArchiveReader::findFrame(int frameNumber) const {
+    const FrameArchiveEntry* end = m_entries + m_frameCount;
+    const FrameArchiveEntry* it = std::lower_bound(m_entries, end, static_cast<uint32_t>(frameNumber),
+        [](const FrameArchiveEntry& entry, uint32_t number) { return entry.frameNumber < number; });
+    if (it == end || it->frameNumber != static_cast<uint32_t>(frameNumber)) {
+        return -1;
+    }
+    return static_cast<int>(it - m_entries);
+}
+
+bool FrameArchiveReader::unpack(const std::string& outputDir, const std::function<void(float)>& progressCallback) const {
+    if (!isOpen()) {
+        return false;
+    }
+    if (!Utils::ensureDirectoryExists(outputDir)) {
+        std::cerr << "无法创建输出目录: " << outputDir << std::endl;
+        return false;
+    }
+
+    bool ok = true;
+    cv::Mat frame;
+    for (size_t i = 0; i < m_frameCount; i++) {
+        std::string framePath = (fs::path(outputDir) / frameFileName(m_entries[i].frameNumber)).string();
+
+        if (m_codec == FrameArchiveCodec::Jpeg) {
+            // JPEG数据原样写出
+            size_t size = 0;
+            const uint8_t* payload = getPayload(i, size);
+            std::ofstream file(framePath, std::ios::binary | std::ios::trunc);
+            file.write(reinterpret_cast<const char*>(payload), static_cast<std::streamsize>(size));
+            if (!file) {
+                std::cerr << "无法写入: " << framePath << std::endl;
+                ok = false;
+            }
+        } else if (!readFrame(i, frame) || !cv::imwrite(framePath, frame)) {
+            std::cerr << "无法解包帧 " << m_entries[i].frameNumber << std::endl;
+            ok = false;
+        }
+
+        if (progressCallback) {
+            progressCallback(static_cast<float>(i + 1) / m_frameCount);
+        }
+    }
+    return ok;
+}
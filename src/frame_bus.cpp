@@ -0,0 +1,151 @@
+#include "frame_bus.h"
+#include <iostream>
+#include <algorithm>
+
+FrameBus::FrameBus()
+    : m_subscribers(std::make_shared<SubscriberList>()),
+      m_nextId(0) {
+}
+
+FrameBus::~FrameBus() {
+    clear();
+}
+
+int FrameBus::subscribe(const std::string& name,
+                        std::function<void(const FrameRef&)> callback,
+                        QueuePolicy policy,
+                        size_t queueDepth) {
+    if (!callback) {
+        return -1;
+    }
+
+    auto subscriber = std::make_shared<Subscriber>(queueDepth, policy);
+    subscriber->name = name;
+    subscriber->callback = callback;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    subscriber->id = m_nextId++;
+    subscriber->thread = std::thread(&FrameBus::subscriberThreadFunc, subscriber.get());
+
+    // 复制一份新列表替换旧列表，正在发布的线程继续使用旧列表
+    auto subscribers = std::make_shared<SubscriberList>(*m_subscribers);
+    subscribers->push_back(subscriber);
+    m_subscribers = subscribers;
+
+    return subscriber->id;
+}
+
+void FrameBus::unsubscribe(int id) {
+    std::shared_ptr<Subscriber> removed;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto subscribers = std::make_shared<SubscriberList>();
+        for (const auto& subscriber : *m_subscribers) {
+            if (subscriber->id == id) {
+                removed = subscriber;
+            } else {
+                subscribers->push_back(subscriber);
+            }
+        }
+        m_subscribers = subscribers;
+    }
+
+    if (removed) {
+        stopSubscriber(removed);
+    }
+}
+
+void FrameBus::clear() {
+    std::shared_ptr<const SubscriberList> subscribers;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        subscribers = m_subscribers;
+        m_subscribers = std::make_shared<SubscriberList>();
+    }
+
+    for (const auto& subscriber : *subscribers) {
+        stopSubscriber(subscriber);
+    }
+}
+
+void FrameBus::publish(const FrameRef& frame) {
+    if (frame.empty()) {
+        return;
+    }
+
+    std::shared_ptr<const SubscriberList> subscribers;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        subscribers = m_subscribers;
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    for (const auto& subscriber : *subscribers) {
+        // 入队只增加帧的引用计数，不拷贝像素数据
+        subscriber->queue.push(QueuedFrame{frame, now});
+    }
+}
+
+bool FrameBus::hasSubscribers() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return !m_subscribers->empty();
+}
+
+std::vector<SubscriberStats> FrameBus::getStats() const {
+    std::shared_ptr<const SubscriberList> subscribers;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        subscribers = m_subscribers;
+    }
+
+    std::vector<SubscriberStats> result;
+    for (const auto& subscriber : *subscribers) {
+        QueueStats queueStats = subscriber->queue.getStats();
+
+        SubscriberStats stats;
+        stats.id = subscriber->id;
+        stats.name = subscriber->name;
+        stats.policy = subscriber->queue.policy();
+        stats.delivered = subscriber->delivered;
+        stats.dropped = queueStats.dropped;
+        stats.queueDepth = queueStats.depth;
+        stats.maxQueueDepth = queueStats.maxDepth;
+        stats.lastLagMs = subscriber->lastLagUs / 1000.0;
+        stats.maxLagMs = subscriber->maxLagUs / 1000.0;
+        result.push_back(stats);
+    }
+
+    return result;
+}
+
+void FrameBus::subscriberThreadFunc(Subscriber* subscriber) {
+    QueuedFrame item;
+    while (subscriber->queue.pop(item)) {
+        // 记录从发布到开始处理的延迟
+        auto lag = std::chrono::steady_clock::now() - item.publishTime;
+        int64_t lagUs = std::chrono::duration_cast<std::chrono::microseconds>(lag).count();
+        subscriber->lastLagUs = lagUs;
+        if (lagUs > subscriber->maxLagUs) {
+            subscriber->maxLagUs = lagUs;
+        }
+
+        try {
+            subscriber->callback(item.frame);
+        } catch (const std::exception& e) {
+            std::cerr << "订阅者 " << subscriber->name << " 处理帧时发生异常: " << e.what() << std::endl;
+        }
+
+        subscriber->delivered++;
+
+        // 尽早归还帧池缓冲区
+        item.frame.reset();
+    }
+}
+
+void FrameBus::stopSubscriber(const std::shared_ptr<Subscriber>& subscriber) {
+    // 关闭队列后线程处理完剩余的帧即退出
+    subscriber->queue.close();
+    if (subscriber->thread.joinable()) {
+        subscriber->thread.join();
+    }
+}
@@ -2,25 +2,77 @@
 #include "utils.h"
 #include <iostream>
 #include <filesystem>
-#include <opencv2/opencv.hpp>
+#include <algorithm>
 #include <iomanip>
 #include <sstream>
 
 namespace fs = std::filesystem;
 
-FrameExtractor::FrameExtractor() : m_isExtracting(false), m_progress(0.0f) {
+namespace {
+    // 按取帧设置逐帧判断是否输出，帧按顺序送入
+    class FrameSelector {
+    public:
+        explicit FrameSelector(const ExtractionSelection& selection)
+            : m_selection(selection), m_firstInRange(-1), m_nextTime(selection.startSeconds) {}
+
+        // 是否已超出时间范围（之后的帧都不需要）
+        bool pastEnd(double time) const {
+            return m_selection.endSeconds >= 0.0 && time > m_selection.endSeconds + kEpsilon;
+        }
+
+        // 第index帧（时间time秒）是否输出
+        bool accept(int index, double time, bool keyframe) {
+            if (time < m_selection.startSeconds - kEpsilon || pastEnd(time)) {
+                return false;
+            }
+            if (m_firstInRange < 0) {
+                m_firstInRange = index;
+            }
+
+            switch (m_selection.sampling) {
+                case ExtractionSampling::Stride:
+                    return (index - m_firstInRange) % std::max(1, m_selection.stride) == 0;
+                case ExtractionSampling::Interval:
+                    // 取时间不早于下一个取帧时刻的第一帧，帧率不均匀时也不会漏取或连取
+                    if (time + kEpsilon < m_nextTime) {
+                        return false;
+                    }
+                    while (m_nextTime <= time + kEpsilon) {
+                        m_nextTime += std::max(m_selection.intervalSeconds, 0.001);
+                    }
+                    return true;
+                case ExtractionSampling::Keyframes:
+                    return keyframe;
+                case ExtractionSampling::All:
+                default:
+                    return true;
+            }
+        }
+
+    private:
+        static constexpr double kEpsilon = 1e-6;  // 时间戳换算成秒的舍入误差
+
+        ExtractionSelection m_selection;
+        int m_firstInRange;  // 范围内第一帧的帧号
+        double m_nextTime;   // Interval：下一个取帧时刻
+    };
+}
+
+FrameExtractor::FrameExtractor()
+    : m_isExtracting(false), m_progress(0.0f), m_workerCount(0), m_decodeMode(ExtractionDecodeMode::Serial),
+      m_decoderCount(0), m_output(ExtractionOutput::Directory), m_archiveCodec(FrameArchiveCodec::Jpeg),
+      m_frameCount(0), m_framesDecoded(0), m_framesWritten(0), m_framesFailed(0),
+      m_activeWorkers(0), m_activeDecoders(0), m_gopParallel(false), m_finished(false) {
 }
 
 FrameExtractor::~FrameExtractor() {
     try {
         // 安全地停止提取过程
-        if (m_isExtracting) {
-            m_isExtracting = false;
+        m_isExtracting = false;
 
-            // 等待线程结束
-            if (m_extractionThread.joinable()) {
-                m_extractionThread.join();
-            }
+        // 等待线程结束（解码线程负责回收编码写入线程）
+        if (m_extractionThread.joinable()) {
+            m_extractionThread.join();
         }
 
         // 清除回调函数
@@ -38,6 +90,11 @@ bool FrameExtractor::startExtraction(const std::string& videoFilePath) {
         return false;  // 已经在分帧中
     }
 
+    // 回收上一次已经结束的分帧线程
+    if (m_extractionThread.joinable()) {
+        m_extractionThread.join();
+    }
+
     // 检查文件是否存在
     if (!fs::exists(videoFilePath)) {
         std::cerr << "视频文件不存在: " << videoFilePath << std::endl;
@@ -47,14 +104,23 @@ bool FrameExtractor::startExtraction(const std::string& videoFilePath) {
     // 设置文件路径
     m_videoFilePath = videoFilePath;
 
-    // 创建输出目录
+    // 创建输出目录或归档文件
     if (!createOutputDir()) {
-        std::cerr << "无法创建输出目录" << std::endl;
+        std::cerr << "无法创建输出: " << m_outputDir << std::endl;
         return false;
     }
 
-    // 重置进度
+    // 重置进度和统计
     m_progress = 0.0f;
+    m_frameCount = 0;
+    m_framesDecoded = 0;
+    m_framesWritten = 0;
+    m_framesFailed = 0;
+    m_activeWorkers = 0;
+    m_activeDecoders = 0;
+    m_gopParallel = false;
+    m_finished = false;
+    m_startTime = std::chrono::steady_clock::now();
 
     // 设置分帧标志
     m_isExtracting = true;
@@ -89,7 +155,76 @@ void FrameExtractor::stopExtraction() {
     }
 }
 
+void FrameExtractor::waitForCompletion() {
+    if (m_extractionThread.joinable()) {
+        m_extractionThread.join();
+    }
+}
+
+void FrameExtractor::setWorkerCount(int count) {
+    m_workerCount = std::max(0, count);
+}
+
+int FrameExtractor::getWorkerCount() const {
+    if (m_workerCount > 0) {
+        return m_workerCount;
+    }
+    return std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+}
+
+void FrameExtractor::setDecoderCount(int count) {
+    m_decoderCount = std::max(0, count);
+}
+
+int FrameExtractor::getDecoderCount() const {
+    if (m_decoderCount > 0) {
+        return m_decoderCount;
+    }
+    return std::max(1, static_cast<int>(std::thread::hardware_concurrency()) / 2);
+}
+
+void FrameExtractor::setOutput(ExtractionOutput output, FrameArchiveCodec codec) {
+    m_output = output;
+    m_archiveCodec = codec;
+}
+
+bool FrameExtractor::unpackArchive(const std::string& archivePath, const std::string& outputDir,
+                                   std::function<void(float)> progressCallback) {
+    FrameArchiveReader reader;
+    if (!reader.open(archivePath)) {
+        return false;
+    }
+
+    // 默认解包到与归档同名的目录，与直接分帧的输出位置相同
+    fs::path dir = outputDir;
+    if (dir.empty()) {
+        fs::path path(archivePath);
+        dir = path.parent_path() / path.stem();
+    }
+
+    std::cout << "解包 " << reader.getFrameCount() << " 帧到: " << dir.string() << std::endl;
+    return reader.unpack(dir.string(), progressCallback);
+}
+
+ExtractionStats FrameExtractor::getStats() const {
+    ExtractionStats stats;
+    stats.gopParallel = m_gopParallel;
+    stats.decoders = m_activeDecoders;
+    stats.workers = m_activeWorkers;
+    stats.framesDecoded = m_framesDecoded;
+    stats.framesWritten = m_framesWritten;
+    stats.framesFailed = m_framesFailed;
+
+    auto end = m_finished ? m_endTime : std::chrono::steady_clock::now();
+    stats.elapsedSeconds = std::chrono::duration<double>(end - m_startTime).count();
+    if (stats.elapsedSeconds > 0.0) {
+        stats.framesPerSecond = stats.framesWritten / stats.elapsedSeconds;
+    }
+    return stats;
+}
+
 void FrameExtractor::setProgressCallback(std::function<void(float)> callback) {
+    std::lock_guard<std::mutex> lock(m_callbackMutex);
     m_progressCallback = callback;
 }
 
@@ -102,6 +237,12 @@ bool FrameExtractor::createOutputDir() {
     fs::path videoPath(m_videoFilePath);
     std::string fileName = videoPath.stem().string();
 
+    // 输出为归档时创建与视频文件同名的.frames文件
+    if (m_output == ExtractionOutput::Archive) {
+        m_outputDir = fs::path(videoPath).parent_path() / (fileName + ".frames");
+        return m_archive.open(m_outputDir, m_archiveCodec);
+    }
+
     // 创建与视频文件同名的子目录
     m_outputDir = fs::path(videoPath).parent_path() / fileName;
 
@@ -109,81 +250,299 @@ bool FrameExtractor::createOutputDir() {
 }
 
 void FrameExtractor::extractionThreadFunc() {
+    // 队列深度为线程数的两倍：每个线程手上一帧、队列里再备一帧，解码线程被阻塞时内存占用有上限
+    // 队列在try外创建，异常退出时编码写入线程仍在使用它，要先关闭并等待线程结束
+    int workerCount = getWorkerCount();
+    BoundedQueue<FrameTask> queue(static_cast<size_t>(workerCount) * 2, QueuePolicy::Block);
+
     try {
-        // 打开视频文件
-        cv::VideoCapture cap(m_videoFilePath);
+        // 编码写入线程先启动，解码确定帧数之后才会有帧入队
+        m_activeWorkers = workerCount;
+        for (int i = 0; i < workerCount; ++i) {
+            m_workers.emplace_back(&FrameExtractor::workerThreadFunc, this, &queue);
+        }
 
-        if (!cap.isOpened()) {
-            std::cerr << "无法打开视频文件: " << m_videoFilePath << std::endl;
+        // 有libav时顺序解码也走GOP解码器（整段作为一个区间），与并行解码的解码和颜色转换完全相同，
+        // 切换解码方式不会改变输出像素；cv::VideoCapture只在没有libav或无法扫描关键帧时使用
+        bool decoded = false;
+        if (GopDecoder::isAvailable()) {
+            GopDecoder decoder;
+            if (decoder.open(m_videoFilePath)) {
+                decodeGop(decoder, queue);
+                decoded = true;
+            } else {
+                std::cout << "无法按GOP切分，退回OpenCV顺序解码" << std::endl;
+            }
+        }
+
+        if (!decoded && !decodeSerial(queue)) {
             m_isExtracting = false;
-            return;
         }
+    } catch (const std::exception& e) {
+        std::cerr << "分帧线程异常: " << e.what() << std::endl;
+        m_isExtracting = false;
+    } catch (...) {
+        std::cerr << "分帧线程未知异常" << std::endl;
+        m_isExtracting = false;
+    }
 
-        // 获取视频信息
-        int frameCount = static_cast<int>(cap.get(cv::CAP_PROP_FRAME_COUNT));
-        int frameWidth = static_cast<int>(cap.get(cv::CAP_PROP_FRAME_WIDTH));
-        int frameHeight = static_cast<int>(cap.get(cv::CAP_PROP_FRAME_HEIGHT));
+    // 关闭队列，编码写入线程处理完剩余的帧（已停止时直接丢弃）后退出
+    queue.close();
+    for (auto& worker : m_workers) {
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+    m_workers.clear();
 
-        // 检查帧数是否有效
-        if (frameCount <= 0) {
-            std::cerr << "无法获取视频帧数" << std::endl;
+    // 所有帧都已追加，写入索引；停止时也写入，已完成的帧仍可读取
+    if (m_archive.isOpen()) {
+        std::cout << "写入帧归档索引: " << m_archive.getFrameCount() << " 帧" << std::endl;
+        if (!m_archive.finish()) {
             m_isExtracting = false;
-            return;
         }
+    }
 
-        std::cout << "视频信息: " << frameWidth << "x" << frameHeight << ", "
-                  << frameCount << " 帧" << std::endl;
+    m_endTime = std::chrono::steady_clock::now();
+    m_finished = true;
 
-        // 分帧循环
-        int currentFrame = 0;
-        cv::Mat frame;
+    if (m_isExtracting) {
+        // 容器给出的帧数只是估计值，正常结束时进度以100%为准
+        m_progress = 1.0f;
 
-        while (m_isExtracting && cap.read(frame)) {
+        // 调用完成回调
+        if (m_completionCallback) {
             try {
-                // 生成帧文件名
-                std::stringstream ss;
-                ss << "frame_" << std::setw(6) << std::setfill('0') << currentFrame << ".jpg";
-                std::string framePath = fs::path(m_outputDir) / ss.str();
+                m_completionCallback(m_outputDir);
+            } catch (const std::exception& e) {
+                std::cerr << "完成回调异常: " << e.what() << std::endl;
+            } catch (...) {
+                std::cerr << "完成回调未知异常" << std::endl;
+            }
+        }
+    }
 
-                // 保存帧
-                cv::imwrite(framePath, frame);
+    // 清除分帧标志
+    m_isExtracting = false;
+}
 
-                // 更新进度
-                currentFrame++;
-                m_progress = static_cast<float>(currentFrame) / frameCount;
+bool FrameExtractor::decodeSerial(BoundedQueue<FrameTask>& queue) {
+    // 打开视频文件
+    cv::VideoCapture cap(m_videoFilePath);
 
-                // 调用进度回调
-                if (m_progressCallback) {
-                    m_progressCallback(m_progress);
-                }
-            } catch (const std::exception& e) {
-                std::cerr << "处理帧 " << currentFrame << " 时发生异常: " << e.what() << std::endl;
-                // 继续处理下一帧
-            } catch (...) {
-                std::cerr << "处理帧 " << currentFrame << " 时发生未知异常" << std::endl;
-                // 继续处理下一帧
+    if (!cap.isOpened()) {
+        std::cerr << "无法打开视频文件: " << m_videoFilePath << std::endl;
+        return false;
+    }
+
+    // 获取视频信息
+    int frameCount = static_cast<int>(cap.get(cv::CAP_PROP_FRAME_COUNT));
+    int frameWidth = static_cast<int>(cap.get(cv::CAP_PROP_FRAME_WIDTH));
+    int frameHeight = static_cast<int>(cap.get(cv::CAP_PROP_FRAME_HEIGHT));
+
+    // 检查帧数是否有效
+    if (frameCount <= 0) {
+        std::cerr << "无法获取视频帧数" << std::endl;
+        return false;
+    }
+    // 没有关键帧信息，只取关键帧无法退回顺序读帧
+    if (m_selection.sampling == ExtractionSampling::Keyframes) {
+        std::cerr << "只取关键帧需要libav" << std::endl;
+        return false;
+    }
+
+    // 只取部分帧时按帧率换算时间，预估输出帧数用于进度
+    double fps = cap.get(cv::CAP_PROP_FPS);
+    if (fps <= 0.0) {
+        fps = 30.0;
+    }
+    if (!m_selection.isFull()) {
+        FrameSelector estimator(m_selection);
+        int selected = 0;
+        for (int i = 0; i < frameCount && !estimator.pastEnd(i / fps); i++) {
+            selected += estimator.accept(i, i / fps, false) ? 1 : 0;
+        }
+        frameCount = selected;
+    }
+    m_frameCount = frameCount;
+    m_activeDecoders = 1;
+
+    std::cout << "视频信息: " << frameWidth << "x" << frameHeight << ", "
+              << frameCount << " 帧, " << m_activeWorkers << " 个编码线程" << std::endl;
+
+    // 解码循环：帧号在这里按读取顺序分配；不需要的帧只grab不转换
+    FrameSelector selector(m_selection);
+    int currentFrame = 0;
+    while (m_isExtracting) {
+        double time = currentFrame / fps;
+        if (selector.pastEnd(time) || !cap.grab()) {
+            break;
+        }
+        int index = currentFrame++;
+        if (!selector.accept(index, time, false)) {
+            continue;
+        }
+
+        // 每帧使用新的Mat，不能复用：上一帧可能还在编码线程中
+        FrameTask task;
+        if (!cap.retrieve(task.frame)) {
+            break;
+        }
+
+        task.index = index;
+        task.timestampUs = static_cast<int64_t>(time * 1000000.0);
+        m_framesDecoded++;
+        if (!queue.push(std::move(task))) {
+            break;
+        }
+    }
+
+    // 关闭视频
+    cap.release();
+    return true;
+}
+
+void FrameExtractor::decodeGop(const GopDecoder& decoder, BoundedQueue<FrameTask>& queue) {
+    bool parallel = m_decodeMode == ExtractionDecodeMode::GopParallel;
+    int decoderCount = parallel ? getDecoderCount() : 1;
+
+    // 取全部帧时并行解码把视频切成线程数4倍的段，顺序解码整段一个区间；只取部分帧时按所需帧选出GOP，跳过的GOP不解码
+    std::vector<GopSegment> segments;
+    int selected = decoder.getFrameCount();
+    if (m_selection.isFull()) {
+        segments = decoder.split(parallel ? decoderCount * 4 : 1);
+    } else {
+        std::vector<int> keyframes = decoder.getKeyframeIndices();
+        FrameSelector selector(m_selection);
+        std::vector<int> frames;
+        for (int i = 0; i < decoder.getFrameCount(); i++) {
+            double time = decoder.getFrameTime(i);
+            if (selector.pastEnd(time)) {
+                break;
+            }
+            if (selector.accept(i, time, std::binary_search(keyframes.begin(), keyframes.end(), i))) {
+                frames.push_back(i);
             }
         }
+        selected = static_cast<int>(frames.size());
+        segments = decoder.select(frames);
+    }
 
-        // 关闭视频
-        cap.release();
+    // 相邻的段分成组，每组由一个线程用同一个解码器依次解码；组数多于线程数，解码快的线程多取几组
+    size_t groupCount = std::min(segments.size(), static_cast<size_t>(decoderCount) * 4);
+    std::vector<std::vector<GopSegment>> groups(groupCount);
+    for (size_t i = 0; i < segments.size(); i++) {
+        groups[i * groupCount / segments.size()].push_back(segments[i]);
+    }
+    decoderCount = std::min(decoderCount, static_cast<int>(groupCount));
+
+    m_frameCount = selected;
+    m_activeDecoders = decoderCount;
+    m_gopParallel = parallel;
+
+    std::cout << "视频信息: " << decoder.getWidth() << "x" << decoder.getHeight() << ", "
+              << decoder.getFrameCount() << " 帧, " << decoder.getKeyframeCount() << " 个关键帧, 取 "
+              << selected << " 帧, " << segments.size() << " 段, " << decoderCount << " 个解码线程, "
+              << m_activeWorkers << " 个编码线程" << std::endl;
+
+    std::atomic<size_t> nextGroup(0);
+    std::atomic<int> incompleteGroups(0);
+    auto decodeFunc = [&]() {
+        for (;;) {
+            size_t i = nextGroup++;
+            if (i >= groups.size() || !m_isExtracting) {
+                break;
+            }
 
-        // 调用完成回调
-        if (m_completionCallback && m_isExtracting) {
+            bool complete = false;
             try {
-                m_completionCallback(m_outputDir);
+                complete = decoder.decodeSegments(groups[i], [&](int index, cv::Mat& frame) {
+                    if (!m_isExtracting) {
+                        return false;
+                    }
+                    FrameTask task;
+                    task.index = index;
+                    task.timestampUs = static_cast<int64_t>(decoder.getFrameTime(index) * 1000000.0);
+                    task.frame = frame;
+                    m_framesDecoded++;
+                    return queue.push(std::move(task));
+                });
             } catch (const std::exception& e) {
-                std::cerr << "完成回调异常: " << e.what() << std::endl;
-            } catch (...) {
-                std::cerr << "完成回调未知异常" << std::endl;
+                std::cerr << "解码区间 " << groups[i].front().firstFrame << " 时发生异常: " << e.what() << std::endl;
+            }
+            if (!complete && m_isExtracting) {
+                incompleteGroups++;
             }
         }
-    } catch (const std::exception& e) {
-        std::cerr << "分帧线程异常: " << e.what() << std::endl;
-    } catch (...) {
-        std::cerr << "分帧线程未知异常" << std::endl;
+    };
+
+    std::vector<std::thread> decoders;
+    for (int i = 0; i < decoderCount; ++i) {
+        decoders.emplace_back(decodeFunc);
+    }
+    for (auto& thread : decoders) {
+        thread.join();
     }
 
-    // 清除分帧标志
-    m_isExtracting = false;
+    if (incompleteGroups > 0) {
+        std::cerr << incompleteGroups << " 组区间解码不完整，部分帧缺失" << std::endl;
+    }
+}
+
+void FrameExtractor::workerThreadFunc(BoundedQueue<FrameTask>* queue) {
+    FrameTask task;
+    while (queue->pop(task)) {
+        // 已停止：把队列取空让解码线程尽快退出，不再编码
+        if (!m_isExtracting) {
+            task.frame.release();
+            continue;
+        }
+
+        try {
+            if (m_archive.isOpen()) {
+                // 编码后追加到归档文件
+                if (m_archive.addFrame(task.index, task.timestampUs, task.frame)) {
+                    m_framesWritten++;
+                } else {
+                    m_framesFailed++;
+                }
+            } else {
+                // 生成帧文件名
+                std::stringstream ss;
+                ss << "frame_" << std::setw(6) << std::setfill('0') << task.index << ".jpg";
+                std::string framePath = fs::path(m_outputDir) / ss.str();
+
+                // 编码并保存帧
+                if (cv::imwrite(framePath, task.frame)) {
+                    m_framesWritten++;
+                } else {
+                    std::cerr << "无法保存帧 " << task.index << ": " << framePath << std::endl;
+                    m_framesFailed++;
+                }
+            }
+        } catch (const std::exception& e) {
+            std::cerr << "处理帧 " << task.index << " 时发生异常: " << e.what() << std::endl;
+            m_framesFailed++;
+            // 继续处理下一帧
+        } catch (...) {
+            std::cerr << "处理帧 " << task.index << " 时发生未知异常" << std::endl;
+            m_framesFailed++;
+            // 继续处理下一帧
+        }
+        task.frame.release();
+
+        // 更新进度：按处理完的帧数（含失败的帧）计算，与写入顺序无关
+        int done = m_framesWritten + m_framesFailed;
+        int frameCount = m_frameCount;
+        float progress = std::min(1.0f, static_cast<float>(done) / std::max(1, frameCount));
+
+        // 调用进度回调
+        std::lock_guard<std::mutex> lock(m_callbackMutex);
+        if (progress > m_progress) {
+            m_progress = progress;
+        }
+        if (m_progressCallback) {
+            m_progressCallback(m_progress);
+        }
+    }
 }
@@ -0,0 +1,216 @@
+#include "frame_pool.h"
+#include <iostream>
+#include <algorithm>
+#include <cstdlib>
+
+// 池的共享状态，由FramePool和所有已分配的缓冲区共同持有
+struct FramePoolCore {
+    std::mutex mutex;                   // 保护空闲列表和统计
+    std::unique_ptr<FrameSlot[]> slots; // 缓冲区数组
+    std::vector<int> freeList;          // 空闲缓冲区索引
+    uint8_t* memory;                    // 整块对齐内存
+    std::atomic<int> liveRefs;          // 持有者数量（FramePool本身 + 已分配的缓冲区）
+    FramePoolStats stats;               // 统计信息
+
+    FramePoolCore() : memory(nullptr), liveRefs(1) {}
+
+    ~FramePoolCore() {
+        free(memory);
+    }
+
+    // 释放一个持有者，最后一个持有者负责销毁
+    void unref() {
+        if (liveRefs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            delete this;
+        }
+    }
+
+    // 缓冲区引用计数归零，归还到空闲列表
+    void recycle(FrameSlot* slot) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            freeList.push_back(slot->index);
+            stats.inUse--;
+        }
+        unref();
+    }
+};
+
+namespace {
+
+void retainSlot(FrameSlot* slot) {
+    if (slot) {
+        slot->refCount.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void releaseSlot(FrameSlot* slot) {
+    if (slot && slot->refCount.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        slot->core->recycle(slot);
+    }
+}
+
+const FrameInfo kEmptyInfo;
+
+}  // namespace
+
+FrameRef::FrameRef(const FrameRef& other) : m_slot(other.m_slot) {
+    retainSlot(m_slot);
+}
+
+FrameRef::FrameRef(FrameRef&& other) noexcept : m_slot(other.m_slot) {
+    other.m_slot = nullptr;
+}
+
+FrameRef& FrameRef::operator=(const FrameRef& other) {
+    if (m_slot != other.m_slot) {
+        retainSlot(other.m_slot);
+        releaseSlot(m_slot);
+        m_slot = other.m_slot;
+    }
+    return *this;
+}
+
+FrameRef& FrameRef::operator=(FrameRef&& other) noexcept {
+    if (this != &other) {
+        releaseSlot(m_slot);
+        m_slot = other.m_slot;
+        other.m_slot = nullptr;
+    }
+    return *this;
+}
+
+void FrameRef::reset() {
+    releaseSlot(m_slot);
+    m_slot = nullptr;
+}
+
+const FrameInfo& FrameRef::info() const {
+    return m_slot ? m_slot->info : kEmptyInfo;
+}
+
+void FrameRef::setInfo(const FrameInfo& info) {
+    if (m_slot) {
+        m_slot->info = info;
+    }
+}
+
+cv::Mat FrameRef::mat() const {
+    if (!m_slot || m_slot->info.width <= 0 || m_slot->info.height <= 0) {
+        return cv::Mat();
+    }
+
+    const FrameInfo& info = m_slot->info;
+    if (info.step == 0) {
+        // 压缩帧没有行结构
+        return cv::Mat(1, static_cast<int>(info.bytesUsed), CV_8UC1, m_slot->data);
+    }
+    return cv::Mat(info.height, info.width, info.type, m_slot->data, info.step);
+}
+
+FramePool::FramePool() : m_core(nullptr) {
+}
+
+FramePool::~FramePool() {
+    release();
+}
+
+bool FramePool::init(size_t slotCount, size_t slotSize, size_t alignment) {
+    release();
+
+    if (slotCount == 0 || slotSize == 0 || alignment == 0 || (alignment & (alignment - 1)) != 0) {
+        std::cerr << "无效的帧池参数" << std::endl;
+        return false;
+    }
+
+    // 每个缓冲区按对齐大小向上取整，保证每个缓冲区起始地址都对齐
+    size_t alignedSize = (slotSize + alignment - 1) & ~(alignment - 1);
+
+    void* memory = nullptr;
+    if (posix_memalign(&memory, std::max(alignment, sizeof(void*)), alignedSize * slotCount) != 0) {
+        std::cerr << "无法分配帧池内存: " << alignedSize * slotCount << " 字节" << std::endl;
+        return false;
+    }
+
+    FramePoolCore* core = new FramePoolCore();
+    core->memory = static_cast<uint8_t*>(memory);
+    core->slots.reset(new FrameSlot[slotCount]);
+    core->freeList.reserve(slotCount);
+
+    // 倒序压入，使acquire优先取低地址缓冲区
+    for (size_t i = 0; i < slotCount; i++) {
+        FrameSlot& slot = core->slots[i];
+        slot.data = core->memory + i * alignedSize;
+        slot.capacity = alignedSize;
+        slot.core = core;
+        slot.index = static_cast<int>(i);
+    }
+    for (size_t i = slotCount; i > 0; i--) {
+        core->freeList.push_back(static_cast<int>(i - 1));
+    }
+
+    core->stats.slotCount = slotCount;
+    core->stats.slotSize = alignedSize;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_core = core;
+    return true;
+}
+
+void FramePool::release() {
+    FramePoolCore* core;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        core = m_core;
+        m_core = nullptr;
+    }
+
+    if (core) {
+        core->unref();
+    }
+}
+
+FrameRef FramePool::acquire() {
+    std::lock_guard<std::mutex> poolLock(m_mutex);
+    if (!m_core) {
+        return FrameRef();
+    }
+
+    FramePoolCore* core = m_core;
+    std::lock_guard<std::mutex> lock(core->mutex);
+
+    if (core->freeList.empty()) {
+        core->stats.exhausted++;
+        return FrameRef();
+    }
+
+    int index = core->freeList.back();
+    core->freeList.pop_back();
+
+    core->stats.acquired++;
+    core->stats.inUse++;
+    core->stats.peakInUse = std::max(core->stats.peakInUse, core->stats.inUse);
+
+    // 每个已分配的缓冲区都持有池的共享状态
+    core->liveRefs.fetch_add(1, std::memory_order_relaxed);
+
+    FrameSlot* slot = &core->slots[index];
+    slot->info = FrameInfo();
+    slot->refCount.store(1, std::memory_order_relaxed);
+    return FrameRef(slot);
+}
+
+FramePoolStats FramePool::getStats() const {
+    std::lock_guard<std::mutex> poolLock(m_mutex);
+    if (!m_core) {
+        return FramePoolStats();
+    }
+
+    std::lock_guard<std::mutex> lock(m_core->mutex);
+    return m_core->stats;
+}
+
+size_t FramePool::getSlotSize() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_core ? m_core->stats.slotSize : 0;
+}
@@ -0,0 +1,430 @@
+#include "gop_decoder.h"
+#include <iostream>
+#include <algorithm>
+#include <limits>
+
+#ifdef HAVE_LIBAV
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+#include <libswscale/swscale.h>
+}
+#endif
+
+#ifdef HAVE_LIBAV
+
+namespace {
+    std::string avErrorString(int error) {
+        char buffer[AV_ERROR_MAX_STRING_SIZE] = {0};
+        av_strerror(error, buffer, sizeof(buffer));
+        return buffer;
+    }
+
+    // 一路解封装和解码，析构时释放
+    struct DecodeContext {
+        AVFormatContext* format;
+        AVCodecContext* codec;
+        AVPacket* packet;
+        AVFrame* frame;
+        SwsContext* sws;
+
+        DecodeContext() : format(nullptr), codec(nullptr), packet(nullptr), frame(nullptr), sws(nullptr) {}
+
+        ~DecodeContext() {
+            if (sws) {
+                sws_freeContext(sws);
+            }
+            av_frame_free(&frame);
+            av_packet_free(&packet);
+            avcodec_free_context(&codec);
+            if (format) {
+                avformat_close_input(&format);
+            }
+        }
+
+        // 打开文件，streamIndex为-1时选择最佳视频流；openDecoder为false时只解封装
+        bool open(const std::string& path, int& streamIndex, bool openDecoder) {
+            int ret = avformat_open_input(&format, path.c_str(), nullptr, nullptr);
+            if (ret < 0) {
+                std::cerr << "无法打开视频文件: " << path << " (" << avErrorString(ret) << ")" << std::endl;
+                return false;
+            }
+            ret = avformat_find_stream_info(format, nullptr);
+            if (ret < 0) {
+                std::cerr << "无法读取视频流信息: " << avErrorString(ret) << std::endl;
+                return false;
+            }
+            if (streamIndex < 0) {
+                streamIndex = av_find_best_stream(format, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
+                if (streamIndex < 0) {
+                    std::cerr << "文件中没有视频流: " << path << std::endl;
+                    return false;
+                }
+            }
+
+            packet = av_packet_alloc();
+            frame = av_frame_alloc();
+            if (!packet || !frame) {
+                return false;
+            }
+            if (!openDecoder) {
+                return true;
+            }
+
+            AVStream* stream = format->streams[streamIndex];
+            const AVCodec* decoder = avcodec_find_decoder(stream->codecpar->codec_id);
+            if (!decoder) {
+                std::cerr << "找不到视频解码器" << std::endl;
+                return false;
+            }
+            codec = avcodec_alloc_context3(decoder);
+            if (!codec || avcodec_parameters_to_context(codec, stream->codecpar) < 0) {
+                std::cerr << "无法创建解码器上下文" << std::endl;
+                return false;
+            }
+            codec->pkt_timebase = stream->time_base;
+            // 并行在区间之间进行，每个解码器只用一个线程
+            codec->thread_count = 1;
+            ret = avcodec_open2(codec, decoder, nullptr);
+            if (ret < 0) {
+                std::cerr << "无法打开视频解码器: " << avErrorString(ret) << std::endl;
+                return false;
+            }
+            return true;
+        }
+    };
+}
+
+#endif
+
+GopDecoder::GopDecoder() : m_streamIndex(-1), m_width(0), m_height(0), m_timeBase(0.0) {
+}
+
+GopDecoder::~GopDecoder() {
+}
+
+bool GopDecoder::isAvailable() {
+#ifdef HAVE_LIBAV
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool GopDecoder::open(const std::string& videoFilePath) {
+    m_videoFilePath = videoFilePath;
+    m_streamIndex = -1;
+    m_framePts.clear();
+    m_keyframes.clear();
+
+#ifdef HAVE_LIBAV
+    DecodeContext context;
+    if (!context.open(videoFilePath, m_streamIndex, false)) {
+        return false;
+    }
+    AVCodecParameters* parameters = context.format->streams[m_streamIndex]->codecpar;
+    m_width = parameters->width;
+    m_height = parameters->height;
+    m_timeBase = av_q2d(context.format->streams[m_streamIndex]->time_base);
+
+    // 只读数据包，不解码：每个数据包是一帧，记录显示时间戳和关键帧位置
+    bool missingPts = false;
+    while (av_read_frame(context.format, context.packet) >= 0) {
+        AVPacket* packet = context.packet;
+        // 编辑列表裁掉的帧解码器不会输出，不计入帧数
+        if (packet->stream_index == m_streamIndex && !(packet->flags & AV_PKT_FLAG_DISCARD)) {
+            if (packet->pts == AV_NOPTS_VALUE) {
+                missingPts = true;
+            } else {
+                m_framePts.push_back(packet->pts);
+                if (packet->flags & AV_PKT_FLAG_KEY) {
+                    int64_t dts = packet->dts != AV_NOPTS_VALUE ? packet->dts : packet->pts;
+                    m_keyframes.push_back({packet->pts, dts});
+                }
+            }
+        }
+        av_packet_unref(packet);
+    }
+
+    if (missingPts) {
+        std::cerr << "视频数据包没有时间戳，无法按GOP切分" << std::endl;
+        m_framePts.clear();
+        m_keyframes.clear();
+        return false;
+    }
+
+    std::sort(m_framePts.begin(), m_framePts.end());
+    if (std::adjacent_find(m_framePts.begin(), m_framePts.end()) != m_framePts.end()) {
+        std::cerr << "视频中有重复的时间戳，无法按GOP切分" << std::endl;
+        m_framePts.clear();
+        m_keyframes.clear();
+        return false;
+    }
+    std::sort(m_keyframes.begin(), m_keyframes.end(),
+              [](const Keyframe& a, const Keyframe& b) { return a.pts < b.pts; });
+
+    if (m_framePts.empty() || m_keyframes.empty()) {
+        std::cerr << "视频中没有关键帧" << std::endl;
+        m_framePts.clear();
+        m_keyframes.clear();
+        return false;
+    }
+    return true;
+#else
+    std::cerr << "未启用libav，无法按GOP并行解码" << std::endl;
+    return false;
+#endif
+}
+
+void GopDecoder::computeGopStarts(std::vector<int>& starts, std::vector<int64_t>& seeks) const {
+    starts.clear();
+    seeks.clear();
+    for (size_t i = 0; i < m_keyframes.size(); i++) {
+        int start = 0;
+        if (i > 0) {
+            start = static_cast<int>(std::lower_bound(m_framePts.begin(), m_framePts.end(), m_keyframes[i].pts) -
+                                     m_framePts.begin());
+        }
+        if (!starts.empty() && start <= starts.back()) {
+            continue;
+        }
+        starts.push_back(start);
+        seeks.push_back(m_keyframes[i].dts);
+    }
+}
+
+double GopDecoder::getFrameTime(int index) const {
+    if (index < 0 || index >= getFrameCount()) {
+        return 0.0;
+    }
+    return (m_framePts[index] - m_framePts.front()) * m_timeBase;
+}
+
+std::vector<int> GopDecoder::getKeyframeIndices() const {
+    std::vector<int> indices;
+    for (const Keyframe& keyframe : m_keyframes) {
+        int index = frameIndex(keyframe.pts);
+        if (index >= 0) {
+            indices.push_back(index);
+        }
+    }
+    return indices;
+}
+
+std::vector<GopSegment> GopDecoder::split(int parts) const {
+    std::vector<GopSegment> segments;
+    if (m_framePts.empty() || m_keyframes.empty()) {
+        return segments;
+    }
+
+    std::vector<int> gopStarts;
+    std::vector<int64_t> gopSeeks;
+    computeGopStarts(gopStarts, gopSeeks);
+
+    // 合并相邻GOP：第k段从第一个不早于总帧数k/parts处的GOP开始
+    int total = getFrameCount();
+    parts = std::max(1, std::min(parts, static_cast<int>(gopStarts.size())));
+    std::vector<size_t> boundaries = {0};
+    for (int k = 1; k < parts; k++) {
+        int target = static_cast<int>(static_cast<int64_t>(total) * k / parts);
+        size_t gop = boundaries.back() + 1;
+        while (gop < gopStarts.size() && gopStarts[gop] < target) {
+            gop++;
+        }
+        if (gop >= gopStarts.size()) {
+            break;
+        }
+        boundaries.push_back(gop);
+    }
+
+    for (size_t i = 0; i < boundaries.size(); i++) {
+        size_t gop = boundaries[i];
+        int nextFrame = i + 1 < boundaries.size() ? gopStarts[boundaries[i + 1]] : total;
+
+        GopSegment segment;
+        segment.fromStart = (gop == 0);
+        segment.seekTs = gopSeeks[gop];
+        segment.firstFrame = gopStarts[gop];
+        segment.frameCount = nextFrame - segment.firstFrame;
+        segment.startPts = m_framePts[segment.firstFrame];
+        segment.endPts = nextFrame < total ? m_framePts[nextFrame] : std::numeric_limits<int64_t>::max();
+        segments.push_back(segment);
+    }
+    return segments;
+}
+
+std::vector<GopSegment> GopDecoder::select(const std::vector<int>& frames) const {
+    std::vector<GopSegment> segments;
+    if (m_framePts.empty() || m_keyframes.empty()) {
+        return segments;
+    }
+
+    std::vector<int> gopStarts;
+    std::vector<int64_t> gopSeeks;
+    computeGopStarts(gopStarts, gopSeeks);
+    std::vector<int> keyframes = getKeyframeIndices();
+
+    int total = getFrameCount();
+    size_t gop = 0;
+    for (size_t i = 0; i < frames.size();) {
+        int frame = frames[i];
+        if (frame < 0 || frame >= total) {
+            i++;
+            continue;
+        }
+        while (gop + 1 < gopStarts.size() && gopStarts[gop + 1] <= frame) {
+            gop++;
+        }
+        int gopEnd = gop + 1 < gopStarts.size() ? gopStarts[gop + 1] : total;
+
+        GopSegment segment;
+        segment.fromStart = (gop == 0);
+        segment.seekTs = gopSeeks[gop];
+        segment.firstFrame = gopStarts[gop];
+        segment.startPts = m_framePts[segment.firstFrame];
+        while (i < frames.size() && frames[i] < gopEnd) {
+            if (frames[i] >= segment.firstFrame) {
+                segment.frames.push_back(frames[i]);
+            }
+            i++;
+        }
+
+        // 只解码到GOP中最后一个所需帧
+        int lastFrame = segment.frames.back();
+        segment.frameCount = lastFrame + 1 - segment.firstFrame;
+        segment.endPts = lastFrame + 1 < total ? m_framePts[lastFrame + 1] : std::numeric_limits<int64_t>::max();
+        segment.keyframesOnly = segment.frames.size() == 1 &&
+                                std::binary_search(keyframes.begin(), keyframes.end(), lastFrame);
+        segments.push_back(segment);
+    }
+    return segments;
+}
+
+int GopDecoder::frameIndex(int64_t pts) const {
+    auto it = std::lower_bound(m_framePts.begin(), m_framePts.end(), pts);
+    if (it == m_framePts.end() || *it != pts) {
+        return -1;
+    }
+    return static_cast<int>(it - m_framePts.begin());
+}
+
+bool GopDecoder::decodeSegment(const GopSegment& segment, const std::function<bool(int, cv::Mat&)>& callback) const {
+    return decodeSegments(std::vector<GopSegment>{segment}, callback);
+}
+
+bool GopDecoder::decodeSegments(const std::vector<GopSegment>& segments,
+                                const std::function<bool(int, cv::Mat&)>& callback) const {
+#ifdef HAVE_LIBAV
+    DecodeContext context;
+    int streamIndex = m_streamIndex;
+    if (!context.open(m_videoFilePath, streamIndex, true)) {
+        return false;
+    }
+
+    AVFrame* frame = context.frame;
+    bool stopped = false;
+    bool allComplete = true;
+
+    for (size_t s = 0; s < segments.size() && !stopped; s++) {
+        const GopSegment& segment = segments[s];
+        int expected = segment.frames.empty() ? segment.frameCount : static_cast<int>(segment.frames.size());
+        int emitted = 0;
+
+        // 定位到区间第一个关键帧（或更早的关键帧，多解出的帧按时间戳丢弃）；上一区间留在解码器中的帧清空
+        if (s > 0) {
+            avcodec_flush_buffers(context.codec);
+        }
+        if (!segment.fromStart || s > 0) {
+            int ret = segment.fromStart
+                ? av_seek_frame(context.format, streamIndex, 0, AVSEEK_FLAG_BACKWARD)
+                : av_seek_frame(context.format, streamIndex, segment.seekTs, AVSEEK_FLAG_BACKWARD);
+            if (ret < 0) {
+                std::cerr << "无法定位到帧 " << segment.firstFrame << ": " << avErrorString(ret) << std::endl;
+                allComplete = false;
+                continue;
+            }
+        }
+
+        // 取出解码器中所有已完成的帧，区间内（且是所需帧）的转换为BGR交给回调
+        auto receiveFrames = [&]() {
+            while (!stopped && emitted < expected && avcodec_receive_frame(context.codec, frame) == 0) {
+                int64_t pts = frame->pts != AV_NOPTS_VALUE ? frame->pts : frame->best_effort_timestamp;
+                int index = (pts >= segment.startPts && pts < segment.endPts) ? frameIndex(pts) : -1;
+                if (index >= 0 && !segment.frames.empty() &&
+                    !std::binary_search(segment.frames.begin(), segment.frames.end(), index)) {
+                    index = -1;
+                }
+                if (index >= 0) {
+                    context.sws = sws_getCachedContext(context.sws, frame->width, frame->height,
+                                                       static_cast<AVPixelFormat>(frame->format),
+                                                       frame->width, frame->height, AV_PIX_FMT_BGR24,
+                                                       SWS_BICUBIC, nullptr, nullptr, nullptr);
+                    if (!context.sws) {
+                        std::cerr << "无法创建颜色转换上下文" << std::endl;
+                        stopped = true;
+                    } else {
+                        // 每帧新分配，回调可以把图像交给其他线程
+                        cv::Mat bgr(frame->height, frame->width, CV_8UC3);
+                        uint8_t* dst[1] = {bgr.data};
+                        int dstStride[1] = {static_cast<int>(bgr.step)};
+                        sws_scale(context.sws, frame->data, frame->linesize, 0, frame->height, dst, dstStride);
+
+                        emitted++;
+                        if (!callback(index, bgr)) {
+                            stopped = true;
+                        }
+                    }
+                }
+                av_frame_unref(frame);
+            }
+        };
+
+        // 定位后从第一个关键帧开始送入解码器；区间内的帧全部输出后不再读取（开放GOP的前导帧在下一个关键帧之后）
+        bool started = false;
+        bool flushed = false;
+        while (!stopped && emitted < expected) {
+            AVPacket* packet = context.packet;
+            if (av_read_frame(context.format, packet) < 0) {
+                break;
+            }
+            if (packet->stream_index != streamIndex || (!started && !(packet->flags & AV_PKT_FLAG_KEY))) {
+                av_packet_unref(packet);
+                continue;
+            }
+            started = true;
+
+            int ret = avcodec_send_packet(context.codec, packet);
+            av_packet_unref(packet);
+            if (ret < 0 && ret != AVERROR(EAGAIN)) {
+                std::cerr << "解码错误: " << avErrorString(ret) << std::endl;
+            }
+
+            // 只要关键帧时不再送入后续数据包，直接取出解码器中的帧
+            if (segment.keyframesOnly) {
+                avcodec_send_packet(context.codec, nullptr);
+                flushed = true;
+                receiveFrames();
+                break;
+            }
+            receiveFrames();
+        }
+
+        // 文件结束：取出解码器中剩余的帧
+        if (!stopped && !flushed && emitted < expected) {
+            avcodec_send_packet(context.codec, nullptr);
+            receiveFrames();
+        }
+
+        if (!stopped && emitted < expected) {
+            std::cerr << "区间 " << segment.firstFrame << "-" << segment.firstFrame + segment.frameCount - 1
+                      << " 只解出 " << emitted << " 帧" << std::endl;
+        }
+        if (emitted < expected) {
+            allComplete = false;
+        }
+    }
+    return allComplete;
+#else
+    return false;
+#endif
+}
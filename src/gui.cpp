@@ -1,6 +1,8 @@
 #include "gui.h"
 #include "utils.h"
+#include "format_negotiator.h"
 #include <iostream>
+#include <algorithm>
 #include <GLFW/glfw3.h>
 #include <imgui.h>
 #include <backends/imgui_impl_glfw.h>
@@ -16,16 +18,45 @@ GUI::GUI()
       m_selectedFileIndex(-1),
       m_selectedResolutionIndex(0),
       m_selectedFramerateIndex(0),
-      m_hasNewFrame(false),
-      m_useFFmpeg(true) {  // 默认使用FFmpeg录制
+      m_recorderBackend(LibavRecorder::isAvailable() ? RecorderBackend::Libav : RecorderBackend::OpenCV),
+      m_recorderSubscription(-1),
+      m_recorderOnNativeBus(false),
+      m_segmentEnabled(false),
+      m_segmentMinutes(10),
+      m_segmentMaxMB(0),
+      m_preRollEnabled(false),
+      m_preRollSeconds(5),
+      m_preRollFailed(false),
+      m_adaptiveQuality(false),
+      m_proxyEnabled(false),
+      m_proxyHeight(480),
+      m_proxySubscription(-1),
+      m_motionRecordEnabled(false),
+      m_recordingByMotion(false),
+      m_motionSubscription(-1),
+      m_motionEvents(16),
+      m_gopParallelExtraction(false),
+      m_extractRangeEnabled(false),
+      m_extractToArchive(false),
+      m_extractArchiveCodec(FrameArchiveCodec::Jpeg),
+      m_deviceEvents(256) {
 
     // 创建模块实例
     m_cameraDevice = std::make_shared<CameraDevice>();
     m_videoCapture = std::make_shared<VideoCapture>();
     m_videoRecorder = std::make_shared<VideoRecorder>();
     m_ffmpegRecorder = std::make_shared<FFmpegRecorder>();
+    m_libavRecorder = std::make_shared<LibavRecorder>();
+    m_renditionRecorder = std::make_shared<RenditionRecorder>();
     m_fileManager = std::make_shared<FileManager>();
     m_frameExtractor = std::make_shared<FrameExtractor>();
+    m_motionDetector = std::make_shared<MotionDetector>();
+
+    // 运动状态变化在侦测线程中发生，转交给渲染线程开始或停止录制
+    m_motionDetector->setStateCallback([this](bool active) {
+        m_motionEvents.push(active);
+    });
+    m_deviceWatcher = std::make_shared<DeviceWatcher>();
 }
 
 GUI::~GUI() {
@@ -87,14 +118,25 @@ bool GUI::init(int width, int height, const std::string& title) {
         return false;
     }
 
-    // 设置视频捕获回调
-    m_videoCapture->setFrameCallback([this](const cv::Mat& frame) {
-        updatePreviewFrame(frame);
+    // 初始化进程内录制器
+    if (!m_libavRecorder->init(m_fileManager->getBaseDir()) ||
+        !m_videoRecorder->init(m_fileManager->getBaseDir()) ||
+        !m_renditionRecorder->init(m_fileManager->getBaseDir())) {
+        std::cerr << "无法初始化录制器" << std::endl;
+        return false;
+    }
 
-        // 如果正在录制，处理帧
-        if (!m_useFFmpeg && m_videoRecorder->isRecording()) {
-            m_videoRecorder->processFrame(frame);
-        }
+    // 监视设备热插拔，事件转交给渲染线程处理
+    m_deviceWatcher->setEventCallback([this](const DeviceEvent& event) {
+        m_deviceEvents.push(event);
+    });
+    if (!m_deviceWatcher->start("/dev")) {
+        std::cerr << "无法启动设备监视，设备列表需手动刷新" << std::endl;
+    }
+
+    // 设置视频捕获回调，预览只做无锁发布，录制等耗时处理通过帧总线在独立线程中进行
+    m_videoCapture->setFrameCallback([this](const FrameRef& frame) {
+        updatePreviewFrame(frame);
     });
 
     return true;
@@ -137,19 +179,23 @@ void GUI::run() {
 }
 
 void GUI::shutdown() {
-    // 停止视频捕获
-    if (m_videoCapture) {
-        m_videoCapture->stop();
+    // 停止设备监视（先于清空事件队列，避免监视线程阻塞在入队上）
+    if (m_deviceWatcher) {
+        m_deviceEvents.close();
+        m_deviceWatcher->stop();
     }
 
-    // 停止视频录制
-    if (m_videoRecorder) {
-        m_videoRecorder->stopRecording();
+    // 停止移动侦测、预录和录制（先于采集停止，队列中的帧写完后再关闭文件）
+    if (m_videoCapture) {
+        stopMotionDetection();
+        m_motionEvents.close();
+        stopPreRoll();
+        stopRecording();
     }
 
-    // 停止FFmpeg录制
-    if (m_ffmpegRecorder) {
-        m_ffmpegRecorder->stopRecording();
+    // 停止视频捕获
+    if (m_videoCapture) {
+        m_videoCapture->stop();
     }
 
     // 停止分帧
@@ -181,6 +227,11 @@ void GUI::shutdown() {
 void GUI::setCameraDevices(const std::vector<CameraDeviceInfo>& devices) {
     m_cameraDevices = devices;
 
+    // 重新扫描后设备可能减少，越界的选择重置
+    if (m_selectedDeviceIndex >= static_cast<int>(m_cameraDevices.size())) {
+        m_selectedDeviceIndex = -1;
+    }
+
     // 如果有设备，默认选择第一个
     if (!m_cameraDevices.empty() && m_selectedDeviceIndex < 0) {
         m_selectedDeviceIndex = 0;
@@ -191,20 +242,13 @@ void GUI::setVideoFiles(const std::vector<VideoFileInfo>& files) {
     m_videoFiles = files;
 }
 
-void GUI::updatePreviewFrame(const cv::Mat& frame) {
+void GUI::updatePreviewFrame(const FrameRef& frame) {
     if (frame.empty()) {
         return;
     }
 
-    // 转换为RGB
-    cv::Mat rgbFrame;
-    cv::cvtColor(frame, rgbFrame, cv::COLOR_BGR2RGB);
-
-    // 保存预览帧
-    {
-        m_previewFrame = rgbFrame.clone();
-        m_hasNewFrame = true;
-    }
+    // 发布最新帧，生产者不阻塞，渲染线程总是取到最新的完整帧
+    m_previewFrames.write(frame);
 }
 
 bool GUI::initImGui() {
@@ -232,7 +276,83 @@ bool GUI::initImGui() {
     return true;
 }
 
+void GUI::startDeviceScan() {
+    if (m_deviceScan.valid()) {
+        return;
+    }
+
+    // 使用独立的CameraDevice实例，不影响当前打开的设备
+    m_deviceScan = std::async(std::launch::async, []() {
+        CameraDevice scanner;
+        return scanner.scanDevices();
+    });
+}
+
+void GUI::pollDeviceScan() {
+    if (!m_deviceScan.valid()) {
+        return;
+    }
+
+    if (m_deviceScan.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+        setCameraDevices(m_deviceScan.get());
+    }
+}
+
+void GUI::pollDeviceEvents() {
+    DeviceEvent event;
+    while (m_deviceEvents.tryPop(event)) {
+        // 记住当前选中的设备路径，列表变化后按路径恢复选择
+        std::string selectedPath;
+        if (m_selectedDeviceIndex >= 0 && m_selectedDeviceIndex < static_cast<int>(m_cameraDevices.size())) {
+            selectedPath = m_cameraDevices[m_selectedDeviceIndex].devicePath;
+        }
+
+        auto it = std::find_if(m_cameraDevices.begin(), m_cameraDevices.end(),
+                               [&event](const CameraDeviceInfo& device) {
+                                   return device.devicePath == event.devicePath;
+                               });
+
+        if (event.type == DeviceEventType::Added) {
+            std::cout << "设备已连接: " << event.info.deviceName << " (" << event.devicePath << ")" << std::endl;
+            if (it != m_cameraDevices.end()) {
+                *it = event.info;
+            } else {
+                m_cameraDevices.push_back(event.info);
+            }
+        } else {
+            std::cout << "设备已移除: " << event.devicePath << std::endl;
+            if (it != m_cameraDevices.end()) {
+                m_cameraDevices.erase(it);
+            }
+
+            // 正在使用的设备被拔出，停止录制和采集并关闭设备
+            if (m_cameraDevice->getCurrentDeviceInfo().devicePath == event.devicePath &&
+                m_cameraDevice->getDeviceFd() >= 0) {
+                stopPreRoll();
+                stopRecording();
+                m_videoCapture->stop();
+                m_cameraDevice->closeDevice();
+            }
+        }
+
+        m_selectedDeviceIndex = -1;
+        for (size_t i = 0; i < m_cameraDevices.size(); i++) {
+            if (m_cameraDevices[i].devicePath == selectedPath) {
+                m_selectedDeviceIndex = static_cast<int>(i);
+                break;
+            }
+        }
+        if (m_selectedDeviceIndex < 0 && !m_cameraDevices.empty() && selectedPath.empty()) {
+            m_selectedDeviceIndex = 0;
+        }
+    }
+}
+
 void GUI::renderGUI() {
+    pollDeviceScan();
+    pollDeviceEvents();
+    pollMotionEvents();
+
     // 设置窗口大小和位置
     ImGui::SetNextWindowPos(ImVec2(0, 0));
     ImGui::SetNextWindowSize(ImVec2(m_width, m_height));
@@ -248,10 +368,10 @@ void GUI::renderGUI() {
     // 菜单栏
     if (ImGui::BeginMenuBar()) {
         if (ImGui::BeginMenu("文件")) {
-            if (ImGui::MenuItem("刷新设备列表")) {
-                // 扫描摄像头设备
-                std::vector<CameraDeviceInfo> devices = m_cameraDevice->scanDevices();
-                setCameraDevices(devices);
+            // 扫描在后台线程进行，完成前菜单项不可用
+            bool scanning = m_deviceScan.valid();
+            if (ImGui::MenuItem(scanning ? "正在扫描设备..." : "刷新设备列表", nullptr, false, !scanning)) {
+                startDeviceScan();
             }
 
             if (ImGui::MenuItem("刷新文件列表")) {
@@ -300,10 +420,9 @@ void GUI::renderGUI() {
 
     ImGui::End();
 
-    // 更新预览纹理
-    if (m_hasNewFrame) {
+    // 有新帧时更新预览纹理
+    if (m_previewFrames.update()) {
         updatePreviewTexture();
-        m_hasNewFrame = false;
     }
 }
 
@@ -317,7 +436,10 @@ void GUI::renderDeviceListPanel() {
             // 设备名称和路径
             std::string label = device.deviceName + " (" + device.devicePath + ")";
 
-            if (ImGui::Selectable(label.c_str(), m_selectedDeviceIndex == i)) {
+            // 采集中切换设备会关闭正在使用的文件描述符，先停止预览
+            bool capturing = m_videoCapture->isCapturing();
+            ImGuiSelectableFlags flags = capturing ? ImGuiSelectableFlags_Disabled : 0;
+            if (ImGui::Selectable(label.c_str(), m_selectedDeviceIndex == i, flags)) {
                 // 选择设备
                 m_selectedDeviceIndex = i;
 
@@ -363,7 +485,7 @@ void GUI::renderPreviewPanel() {
                         // 获取选中的帧率
                         auto framerates = m_cameraDevice->getSupportedFramerates(resolution);
                         if (!framerates.empty() && m_selectedFramerateIndex < framerates.size()) {
-                            int framerate = framerates[m_selectedFramerateIndex];
+                            FrameRate framerate = framerates[m_selectedFramerateIndex];
 
                             // 初始化视频捕获
                             if (m_videoCapture->init(*m_cameraDevice, resolution, framerate)) {
@@ -375,9 +497,42 @@ void GUI::renderPreviewPanel() {
                 }
             } else {
                 if (ImGui::Button("停止预览")) {
+                    // 预录的编码器与当前分辨率绑定，随采集一起停止
+                    stopPreRoll();
+
                     // 停止捕获
                     m_videoCapture->stop();
                 }
+
+                // 显示协商的采集格式，悬停查看选择原因
+                const NegotiationPlan& plan = m_cameraDevice->getNegotiationPlan();
+                ImGui::Text("采集格式: %s %s fps", FormatNegotiator::fourccToString(plan.pixelFormat).c_str(),
+                           m_videoCapture->getCurrentFramerateFraction().toString().c_str());
+                if (ImGui::IsItemHovered()) {
+                    ImGui::SetTooltip("%s", plan.reason.c_str());
+                }
+
+                // 显示实测帧间隔和抖动
+                CaptureStats stats = m_videoCapture->getCaptureStats();
+                ImGui::Text("帧间隔: %.2f ms, 抖动: %.2f ms, 最大: %.2f ms, 丢帧: %llu",
+                           stats.meanIntervalMs, stats.jitterMs, stats.maxIntervalMs,
+                           static_cast<unsigned long long>(stats.droppedFrames));
+
+                // 显示帧池使用情况
+                FramePoolStats poolStats = m_videoCapture->getFramePoolStats();
+                ImGui::Text("帧池: %zu/%zu, 峰值: %zu, 耗尽: %llu",
+                           poolStats.inUse, poolStats.slotCount, poolStats.peakInUse,
+                           static_cast<unsigned long long>(poolStats.exhausted));
+
+                // 显示帧总线订阅者的丢帧和延迟
+                for (const auto& subscriber : m_videoCapture->getFrameBus().getStats()) {
+                    ImGui::Text("%s: 已处理 %llu, 丢弃 %llu, 队列 %zu/%zu, 延迟 %.1f ms",
+                               subscriber.name.c_str(),
+                               static_cast<unsigned long long>(subscriber.delivered),
+                               static_cast<unsigned long long>(subscriber.dropped),
+                               subscriber.queueDepth, subscriber.maxQueueDepth,
+                               subscriber.lastLagMs);
+                }
             }
         }
 
@@ -389,8 +544,8 @@ void GUI::renderPreviewPanel() {
             ImVec2 windowSize = ImGui::GetContentRegionAvail();
 
             // 计算纹理尺寸
-            float textureWidth = m_previewFrame.cols;
-            float textureHeight = m_previewFrame.rows;
+            float textureWidth = m_previewRgb.cols;
+            float textureHeight = m_previewRgb.rows;
 
             // 计算缩放比例
             float scale = std::min(windowSize.x / textureWidth, windowSize.y / textureHeight);
@@ -425,10 +580,18 @@ void GUI::renderRecordControlPanel() {
             auto resolutions = m_cameraDevice->getSupportedResolutions();
 
             if (!resolutions.empty()) {
-                // 创建分辨率选项
-                std::vector<const char*> resolutionItems;
+                // 创建分辨率选项（先生成全部字符串，再取指针，保证指针在Combo期间有效）
+                std::vector<std::string> resolutionStrings;
                 for (const auto& res : resolutions) {
-                    resolutionItems.push_back(res.toString().c_str());
+                    resolutionStrings.push_back(res.toString());
+                }
+                std::vector<const char*> resolutionItems;
+                for (const auto& str : resolutionStrings) {
+                    resolutionItems.push_back(str.c_str());
+                }
+
+                if (m_selectedResolutionIndex >= static_cast<int>(resolutions.size())) {
+                    m_selectedResolutionIndex = 0;
                 }
 
                 // 分辨率下拉框
@@ -451,11 +614,16 @@ void GUI::renderRecordControlPanel() {
                 if (!framerates.empty()) {
                     // 创建帧率选项
                     std::vector<std::string> framerateStrings;
+                    for (const auto& fps : framerates) {
+                        framerateStrings.push_back(fps.toString() + " fps");
+                    }
                     std::vector<const char*> framerateItems;
+                    for (const auto& str : framerateStrings) {
+                        framerateItems.push_back(str.c_str());
+                    }
 
-                    for (int fps : framerates) {
-                        framerateStrings.push_back(std::to_string(fps) + " fps");
-                        framerateItems.push_back(framerateStrings.back().c_str());
+                    if (m_selectedFramerateIndex >= static_cast<int>(framerates.size())) {
+                        m_selectedFramerateIndex = 0;
                     }
 
                     // 帧率下拉框
@@ -465,45 +633,220 @@ void GUI::renderRecordControlPanel() {
             }
         }
 
-        // 录制模式选择
-        ImGui::Checkbox("使用FFmpeg录制", &m_useFFmpeg);
+        // 录制后端选择（录制和预录中不能切换）
+        bool recording = isRecording();
+        bool settingsLocked = recording || m_libavRecorder->isPreRolling();
+        const char* backendItems[] = { "libav进程内编码", "OpenCV", "FFmpeg进程" };
+        int backendIndex = static_cast<int>(m_recorderBackend);
+        if (!settingsLocked && ImGui::Combo("录制后端", &backendIndex, backendItems, 3)) {
+            m_recorderBackend = static_cast<RecorderBackend>(backendIndex);
+        }
+        if (ImGui::IsItemHovered()) {
+            ImGui::SetTooltip("所有后端都与预览共用同一次采集；FFmpeg进程后端通过管道送帧，编码器崩溃不影响采集");
+        }
+        if (m_recorderBackend == RecorderBackend::Libav && !LibavRecorder::isAvailable()) {
+            ImGui::TextColored(ImVec4(1, 0.5f, 0, 1), "未编译libav支持");
+        }
+
+        // MJPEG直通录制：不解码不重新编码，只有设备输出MJPEG时可用
+        bool canPassthrough = m_videoCapture->isCapturing() && m_videoCapture->isCompressedFormat() &&
+                              m_videoCapture->isUsingNativeStream();
+        if (!canPassthrough) {
+            m_encoderSettings.passthrough = false;
+        }
+        if (m_recorderBackend != RecorderBackend::OpenCV && canPassthrough && !settingsLocked) {
+            ImGui::Checkbox("MJPEG直通录制", &m_encoderSettings.passthrough);
+            if (ImGui::IsItemHovered()) {
+                ImGui::SetTooltip("直接把摄像头输出的JPEG帧写入MKV，录制几乎不占CPU");
+            }
+        }
+
+        // libav编码参数
+        if (m_recorderBackend == RecorderBackend::Libav && !settingsLocked && !m_encoderSettings.passthrough) {
+            const char* presetItems[] = { "ultrafast", "superfast", "veryfast", "faster", "fast", "medium" };
+            int presetIndex = 0;
+            for (int i = 0; i < 6; i++) {
+                if (m_encoderSettings.preset == presetItems[i]) {
+                    presetIndex = i;
+                }
+            }
+            if (ImGui::Combo("编码预设", &presetIndex, presetItems, 6)) {
+                m_encoderSettings.preset = presetItems[presetIndex];
+            }
+
+            ImGui::InputInt("码率(kbps)", &m_encoderSettings.bitrateKbps, 500, 2000);
+            m_encoderSettings.bitrateKbps = std::max(0, m_encoderSettings.bitrateKbps);
+
+            ImGui::InputInt("编码线程", &m_encoderSettings.threads);
+            m_encoderSettings.threads = std::max(0, m_encoderSettings.threads);
+
+            bool useMkv = m_encoderSettings.container == "mkv";
+            if (ImGui::Checkbox("MKV封装", &useMkv)) {
+                m_encoderSettings.container = useMkv ? "mkv" : "mp4";
+            }
+
+            ImGui::Checkbox("自适应画质", &m_adaptiveQuality);
+            if (ImGui::IsItemHovered()) {
+                ImGui::SetTooltip("编码跟不上（丢帧、队列积压或CPU占满）时自动降低预设和分辨率，空闲时逐步提高");
+            }
+        }
+
+        // 分段录制：长时间录制按时长或大小切换到新文件，分段之间不丢帧
+        if (!settingsLocked) {
+            ImGui::Checkbox("分段录制", &m_segmentEnabled);
+            if (ImGui::IsItemHovered()) {
+                ImGui::SetTooltip("mp4按关键帧分片写入，程序异常退出时已写入的内容仍可播放");
+            }
+            if (m_segmentEnabled) {
+                ImGui::InputInt("每段分钟", &m_segmentMinutes);
+                m_segmentMinutes = std::max(0, m_segmentMinutes);
+                if (m_recorderBackend != RecorderBackend::FFmpegProcess) {
+                    ImGui::InputInt("每段最大MB", &m_segmentMaxMB, 100, 1000);
+                    m_segmentMaxMB = std::max(0, m_segmentMaxMB);
+                }
+            }
+        } else if (recording && m_segmentEnabled && m_recorderBackend == RecorderBackend::Libav) {
+            ImGui::Text("当前分段: %d", m_libavRecorder->getSegmentCount());
+        }
+
+        // 代理副本：同一次采集同时编码一个缩小的低码率文件，供浏览和拖动
+        if (LibavRecorder::isAvailable() && !recording) {
+            ImGui::Checkbox("同时录制代理文件", &m_proxyEnabled);
+            if (ImGui::IsItemHovered()) {
+                ImGui::SetTooltip("与录像共用同一次采集，另起编码线程输出低码率的小尺寸文件，文件名带.proxy");
+            }
+            if (m_proxyEnabled) {
+                const char* heightItems[] = { "360p", "480p", "720p" };
+                const int heights[] = { 360, 480, 720 };
+                int heightIndex = 1;
+                for (int i = 0; i < 3; i++) {
+                    if (m_proxyHeight == heights[i]) {
+                        heightIndex = i;
+                    }
+                }
+                if (ImGui::Combo("代理分辨率", &heightIndex, heightItems, 3)) {
+                    m_proxyHeight = heights[heightIndex];
+                }
+            }
+        } else if (recording && m_renditionRecorder->isRecording()) {
+            for (const RecorderStats& stats : m_renditionRecorder->getStats()) {
+                ImGui::Text("代理: 编码 %llu, 丢弃 %llu, 编码耗时 %.1f ms",
+                           static_cast<unsigned long long>(stats.encoded),
+                           static_cast<unsigned long long>(stats.dropped), stats.lastEncodeMs);
+            }
+        }
+
+        // 预录：持续编码并在内存中保留最近几秒，开始录像时从这几秒之前开始写入
+        if (m_recorderBackend == RecorderBackend::Libav && LibavRecorder::isAvailable() && !recording) {
+            if (ImGui::Checkbox("预录", &m_preRollEnabled)) {
+                m_preRollFailed = false;
+            }
+            if (ImGui::IsItemHovered()) {
+                ImGui::SetTooltip("开始录像时包含按下按钮之前的画面，修改录制参数前需先关闭预录");
+            }
+            if (m_preRollEnabled) {
+                if (ImGui::InputInt("预录秒数", &m_preRollSeconds) && m_libavRecorder->isPreRolling()) {
+                    stopPreRoll();  // 时长变化时按新的时长重新开始
+                }
+                m_preRollSeconds = std::max(1, std::min(m_preRollSeconds, 60));
+            }
+        }
+        updatePreRoll();
+        if (m_libavRecorder->isPreRolling() && !recording) {
+            ImGui::Text("预录缓冲: %.1f 秒", m_libavRecorder->getPreRollDuration());
+        }
+
+        updateAdaptiveQuality();
+        if (m_adaptiveQuality && m_recorderBackend == RecorderBackend::Libav && !m_encoderSettings.passthrough &&
+            settingsLocked) {
+            ImGui::Text("画质档位: %d/%d (%s)", m_qualityController.getLevelIndex() + 1,
+                       m_qualityController.getLevelCount(),
+                       m_qualityController.getCurrentLevel().toString().c_str());
+            if (!m_qualityController.getLastDecision().empty()) {
+                ImGui::TextWrapped("最近调整: %s", m_qualityController.getLastDecision().c_str());
+            }
+        }
+
+        // 移动侦测录制：有运动时自动开始，静止一段时间后自动停止
+        ImGui::Checkbox("移动侦测录制", &m_motionRecordEnabled);
         if (ImGui::IsItemHovered()) {
-            ImGui::SetTooltip("使用FFmpeg录制可以获得更好的视频质量和兼容性");
+            ImGui::SetTooltip("在降采样的亮度图上做帧差，连续几帧有运动时开始录像；配合预录可以包含触发前的画面");
         }
+        if (m_motionRecordEnabled) {
+            bool changed = ImGui::SliderInt("灵敏度阈值", &m_motionSettings.pixelThreshold, 5, 80);
+            int stopSeconds = static_cast<int>(m_motionSettings.stopSeconds);
+            changed |= ImGui::InputInt("静止停止(秒)", &stopSeconds);
+            m_motionSettings.stopSeconds = std::max(1, stopSeconds);
+            if (changed) {
+                m_motionDetector->setSettings(m_motionSettings);
+            }
+
+            MotionResult motion = m_motionDetector->getLastResult();
+            ImGui::Text("变化块: %d/%d, %s, 耗时 %.2f ms", motion.changedBlocks, motion.totalBlocks,
+                       motion.active ? "运动中" : "静止", motion.processMs);
+        }
+        updateMotionDetection();
 
         // 录制控制按钮
         if (m_videoCapture->isCapturing()) {
-            bool isRecording = m_useFFmpeg ? m_ffmpegRecorder->isRecording() : m_videoRecorder->isRecording();
-
-            if (!isRecording) {
+            if (!recording) {
                 if (ImGui::Button("开始录像")) {
-                    // 获取当前分辨率和帧率
-                    Resolution resolution = m_videoCapture->getCurrentResolution();
-                    int framerate = m_videoCapture->getCurrentFramerate();
-
-                    if (m_useFFmpeg) {
-                        // 使用FFmpeg录制
-                        std::string devicePath = m_cameraDevice->getCurrentDeviceInfo().devicePath;
-                        m_ffmpegRecorder->startRecording(devicePath, resolution, framerate);
-                    } else {
-                        // 使用OpenCV录制
-                        m_videoRecorder->startRecording(resolution, framerate);
-                    }
+                    startRecording();
                 }
             } else {
                 // 显示录制时长
-                double duration = m_useFFmpeg ?
-                                 m_ffmpegRecorder->getRecordingDuration() :
-                                 m_videoRecorder->getRecordingDuration();
+                double duration = 0.0;
+                switch (m_recorderBackend) {
+                    case RecorderBackend::Libav:
+                        duration = m_libavRecorder->getRecordingDuration();
+                        break;
+                    case RecorderBackend::OpenCV:
+                        duration = m_videoRecorder->getRecordingDuration();
+                        break;
+                    case RecorderBackend::FFmpegProcess:
+                        duration = m_ffmpegRecorder->getRecordingDuration();
+                        break;
+                }
                 ImGui::Text("录制时长: %s", Utils::formatTime(duration).c_str());
 
+                // 显示编码队列状态，编码跟不上时可以看到丢帧
+                {
+                    RecorderStats stats;
+                    switch (m_recorderBackend) {
+                        case RecorderBackend::Libav:
+                            stats = m_libavRecorder->getStats();
+                            break;
+                        case RecorderBackend::OpenCV:
+                            stats = m_videoRecorder->getStats();
+                            break;
+                        case RecorderBackend::FFmpegProcess:
+                            stats = m_ffmpegRecorder->getStats();
+                            break;
+                    }
+                    ImGui::Text("编码: %llu, 丢弃: %llu, 队列: %zu/%zu, 编码耗时: %.1f ms (最大 %.1f ms)",
+                               static_cast<unsigned long long>(stats.encoded),
+                               static_cast<unsigned long long>(stats.dropped),
+                               stats.queueDepth, stats.maxQueueDepth,
+                               stats.lastEncodeMs, stats.maxEncodeMs);
+                }
+
+                // 文件写入在后台进行，存储卡写入停顿时可以看到进行中的写入堆积和编码线程等待
+                if (m_recorderBackend == RecorderBackend::Libav) {
+                    OutputSinkStats output = m_libavRecorder->getOutputStats();
+                    ImGui::Text("写入(%s): 进行中 %zu (峰值 %zu), 延迟 %.1f ms (最大 %.1f ms), 同步最长 %.1f ms",
+                               m_libavRecorder->isUsingIoUring() ? "io_uring" : "线程",
+                               output.queueDepth, output.maxQueueDepth,
+                               output.lastWriteMs, output.maxWriteMs, output.maxSyncMs);
+                    if (output.stalls > 0 || output.errors > 0) {
+                        ImGui::TextColored(ImVec4(1, 0.5f, 0, 1), "写入缓冲区用尽 %llu 次 (共等待 %.0f ms), 写入错误 %llu",
+                                           static_cast<unsigned long long>(output.stalls), output.stallMs,
+                                           static_cast<unsigned long long>(output.errors));
+                    }
+                }
+
                 if (ImGui::Button("停止录像")) {
                     // 停止录制
-                    if (m_useFFmpeg) {
-                        m_ffmpegRecorder->stopRecording();
-                    } else {
-                        m_videoRecorder->stopRecording();
-                    }
+                    stopRecording();
 
                     // 刷新文件列表
                     std::vector<VideoFileInfo> videoFiles = m_fileManager->getVideoFileList();
@@ -529,6 +872,9 @@ void GUI::renderFileListPanel() {
             std::string label = file.fileName + "\n" +
                               "大小: " + Utils::formatFileSize(file.fileSize) + ", " +
                               "时长: " + Utils::formatTime(file.duration);
+            if (!file.renditionFiles.empty()) {
+                label += ", 副本: " + std::to_string(file.renditionFiles.size());
+            }
 
             if (ImGui::Selectable(label.c_str(), m_selectedFileIndex == i)) {
                 m_selectedFileIndex = i;
@@ -537,7 +883,10 @@ void GUI::renderFileListPanel() {
             // 右键菜单
             if (ImGui::BeginPopupContextItem()) {
                 if (ImGui::MenuItem("删除")) {
-                    // 删除文件
+                    // 删除文件（连同同一次录制的副本）
+                    for (const auto& renditionFile : file.renditionFiles) {
+                        m_fileManager->deleteVideoFile(renditionFile);
+                    }
                     if (m_fileManager->deleteVideoFile(file.filePath)) {
                         // 刷新文件列表
                         std::vector<VideoFileInfo> videoFiles = m_fileManager->getVideoFileList();
@@ -560,7 +909,7 @@ void GUI::renderFileListPanel() {
 
 void GUI::renderFrameExtractionPanel() {
     if (ImGui::CollapsingHeader("视频分帧", ImGuiTreeNodeFlags_DefaultOpen)) {
-        ImGui::BeginChild("FrameExtractionChild", ImVec2(0, 100), true);
+        ImGui::BeginChild("FrameExtractionChild", ImVec2(0, 230), true);
 
         if (m_selectedFileIndex >= 0 && m_selectedFileIndex < m_videoFiles.size()) {
             const auto& file = m_videoFiles[m_selectedFileIndex];
@@ -568,7 +917,73 @@ void GUI::renderFrameExtractionPanel() {
             ImGui::Text("选中文件: %s", file.fileName.c_str());
 
             if (!m_frameExtractor->isExtracting()) {
+                if (GopDecoder::isAvailable()) {
+                    ImGui::Checkbox("按GOP并行解码", &m_gopParallelExtraction);
+                    if (ImGui::IsItemHovered()) {
+                        ImGui::SetTooltip("扫描关键帧后把视频切成多段，用多个解码器同时解码，适合长的H.264录像");
+                    }
+                }
+
+                // 取帧方式：只取关键帧需要libav的关键帧索引
+                const char* samplingItems[] = {"全部帧", "每N帧", "每隔几秒", "只取关键帧"};
+                int samplingIndex = static_cast<int>(m_extractSelection.sampling);
+                if (ImGui::Combo("取帧方式", &samplingIndex, samplingItems, GopDecoder::isAvailable() ? 4 : 3)) {
+                    m_extractSelection.sampling = static_cast<ExtractionSampling>(samplingIndex);
+                }
+                if (m_extractSelection.sampling == ExtractionSampling::Stride) {
+                    ImGui::InputInt("每几帧", &m_extractSelection.stride);
+                    m_extractSelection.stride = std::max(1, m_extractSelection.stride);
+                } else if (m_extractSelection.sampling == ExtractionSampling::Interval) {
+                    ImGui::InputDouble("间隔(秒)", &m_extractSelection.intervalSeconds, 0.5, 5.0, "%.2f");
+                    m_extractSelection.intervalSeconds = std::max(0.01, m_extractSelection.intervalSeconds);
+                }
+
+                ImGui::Checkbox("只取一段时间", &m_extractRangeEnabled);
+                if (m_extractRangeEnabled) {
+                    ImGui::InputDouble("开始(秒)", &m_extractSelection.startSeconds, 1.0, 10.0, "%.1f");
+                    ImGui::InputDouble("结束(秒)", &m_extractSelection.endSeconds, 1.0, 10.0, "%.1f");
+                    if (ImGui::IsItemHovered()) {
+                        ImGui::SetTooltip("-1 表示取到视频结尾");
+                    }
+                    // 结束时间默认-1（到结尾）；填了结束时间时不早于开始时间，减到负数时回到-1
+                    m_extractSelection.startSeconds = std::max(0.0, m_extractSelection.startSeconds);
+                    if (m_extractSelection.endSeconds < 0.0) {
+                        m_extractSelection.endSeconds = -1.0;
+                    } else {
+                        m_extractSelection.endSeconds = std::max(m_extractSelection.startSeconds,
+                                                                 m_extractSelection.endSeconds);
+                    }
+                }
+
+                // 输出为单个.frames文件，代替每帧一个JPEG文件；LZ4需要liblz4
+                ImGui::Checkbox("打包为单个文件", &m_extractToArchive);
+                if (ImGui::IsItemHovered()) {
+                    ImGui::SetTooltip("所有帧写入一个.frames帧归档，可用 extract --unpack 解包为目录");
+                }
+                if (m_extractToArchive) {
+                    const char* codecItems[] = {"JPEG", "LZ4（无损）", "不压缩"};
+                    int codecIndex = static_cast<int>(m_extractArchiveCodec);
+                    if (ImGui::Combo("帧编码", &codecIndex, codecItems, 3)) {
+                        FrameArchiveCodec codec = static_cast<FrameArchiveCodec>(codecIndex);
+                        if (FrameArchiveWriter::isCodecAvailable(codec)) {
+                            m_extractArchiveCodec = codec;
+                        }
+                    }
+                }
+
                 if (ImGui::Button("开始分帧")) {
+                    m_frameExtractor->setDecodeMode(m_gopParallelExtraction ? ExtractionDecodeMode::GopParallel
+                                                                            : ExtractionDecodeMode::Serial);
+                    ExtractionSelection selection = m_extractSelection;
+                    if (!m_extractRangeEnabled) {
+                        selection.startSeconds = 0.0;
+                        selection.endSeconds = -1.0;
+                    }
+                    m_frameExtractor->setSelection(selection);
+                    m_frameExtractor->setOutput(m_extractToArchive ? ExtractionOutput::Archive
+                                                                   : ExtractionOutput::Directory,
+                                                m_extractArchiveCodec);
+
                     // 创建一个新线程来执行分帧，避免阻塞GUI
                     std::thread([this, filePath = file.filePath]() {
                         // 设置进度回调
@@ -591,6 +1006,10 @@ void GUI::renderFrameExtractionPanel() {
                 ImGui::ProgressBar(progress, ImVec2(-1, 0),
                                  (std::to_string(static_cast<int>(progress * 100)) + "%").c_str());
 
+                ExtractionStats stats = m_frameExtractor->getStats();
+                ImGui::Text("%d 帧, %.1f 帧/秒 (%d 个%s解码线程, %d 个编码线程)", stats.framesWritten,
+                            stats.framesPerSecond, stats.decoders, stats.gopParallel ? "GOP" : "", stats.workers);
+
                 if (ImGui::Button("停止分帧")) {
                     // 停止分帧
                     m_frameExtractor->stopExtraction();
@@ -605,15 +1024,326 @@ void GUI::renderFrameExtractionPanel() {
 }
 
 void GUI::updatePreviewTexture() {
-    if (m_previewFrame.empty()) {
+    const FrameRef& frame = m_previewFrames.front();
+    if (frame.empty()) {
         return;
     }
 
+    // 转换为RGB，尺寸不变时复用上一帧的缓冲区
+    cv::cvtColor(frame.mat(), m_previewRgb, cv::COLOR_BGR2RGB);
+
     // 绑定纹理
     glBindTexture(GL_TEXTURE_2D, m_previewTextureId);
 
     // 上传纹理数据
     glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB,
-                m_previewFrame.cols, m_previewFrame.rows, 0,
-                GL_RGB, GL_UNSIGNED_BYTE, m_previewFrame.data);
+                m_previewRgb.cols, m_previewRgb.rows, 0,
+                GL_RGB, GL_UNSIGNED_BYTE, m_previewRgb.data);
+}
+
+bool GUI::startRecording() {
+    bool started = false;
+
+    if (m_recorderBackend == RecorderBackend::Libav && m_libavRecorder->isPreRolling()) {
+        // 预录中订阅已存在，录制器先写入缓冲区中的数据再继续
+        started = m_libavRecorder->startRecording(m_videoCapture->getCurrentResolution(),
+                                                  m_videoCapture->getCurrentFramerateFraction(), m_encoderSettings);
+    } else {
+        // 录制器自行结束（如ffmpeg进程退出）时订阅仍在，先取消
+        unsubscribeRecorder();
+
+        // 获取当前分辨率和帧率
+        Resolution resolution = m_videoCapture->getCurrentResolution();
+        int framerate = m_videoCapture->getCurrentFramerate();
+
+        applySegmentSettings();
+
+        switch (m_recorderBackend) {
+            case RecorderBackend::Libav:
+                started = startLibavRecording(resolution, m_videoCapture->getCurrentFramerateFraction());
+                break;
+            case RecorderBackend::OpenCV:
+                started = startOpenCVRecording(resolution, framerate);
+                break;
+            case RecorderBackend::FFmpegProcess:
+                started = startFFmpegRecording(resolution, m_videoCapture->getCurrentFramerateFraction());
+                break;
+        }
+    }
+
+    // 代理副本失败不影响主录像
+    if (started) {
+        startProxyRecording();
+    }
+    return started;
+}
+
+void GUI::stopRecording() {
+    m_recordingByMotion = false;
+
+    // 先取消订阅，再停止录制器（录制器会写完已入队的帧后关闭文件）
+    // 预录中保留订阅，录制器关闭文件后继续预录
+    // 取消订阅要等订阅线程处理完队列，ffmpeg卡住时写管道会一直阻塞，先通知ffmpeg录制器限时放弃
+    m_ffmpegRecorder->requestStop();
+    if (!m_libavRecorder->isPreRolling()) {
+        unsubscribeRecorder();
+    }
+
+    m_libavRecorder->stopRecording();
+    m_videoRecorder->stopRecording();
+    m_ffmpegRecorder->stopRecording();
+    stopProxyRecording();
+}
+
+bool GUI::isRecording() const {
+    switch (m_recorderBackend) {
+        case RecorderBackend::Libav:
+            return m_libavRecorder->isRecording();
+        case RecorderBackend::OpenCV:
+            return m_videoRecorder->isRecording();
+        case RecorderBackend::FFmpegProcess:
+            return m_ffmpegRecorder->isRecording();
+    }
+
+    return false;
+}
+
+void GUI::startProxyRecording() {
+    // 主录像自行结束后上次的代理副本可能还在
+    stopProxyRecording();
+
+    if (!m_proxyEnabled || !LibavRecorder::isAvailable()) {
+        return;
+    }
+
+    RenditionSettings proxy;
+    proxy.height = m_proxyHeight;
+    proxy.encoder.container = m_encoderSettings.container;
+    proxy.encoder.segment = m_encoderSettings.segment;
+    m_renditionRecorder->setRenditions(std::vector<RenditionSettings>{proxy});
+    if (!m_renditionRecorder->startRecording(m_videoCapture->getCurrentResolution(),
+                                             m_videoCapture->getCurrentFramerateFraction())) {
+        std::cerr << "无法开始代理副本录制" << std::endl;
+        return;
+    }
+
+    // 缩放在订阅线程中进行，编码在各副本自己的线程中进行
+    auto recorder = m_renditionRecorder;
+    m_proxySubscription = m_videoCapture->getFrameBus().subscribe(
+        "代理副本",
+        [recorder](const FrameRef& frame) {
+            recorder->processFrame(frame);
+        },
+        QueuePolicy::DropOldest, 2);
+}
+
+void GUI::stopProxyRecording() {
+    if (m_proxySubscription >= 0) {
+        m_videoCapture->getFrameBus().unsubscribe(m_proxySubscription);
+        m_proxySubscription = -1;
+    }
+    m_renditionRecorder->stopRecording();
+}
+
+bool GUI::startOpenCVRecording(const Resolution& resolution, int framerate) {
+    if (!m_videoRecorder->startRecording(resolution, framerate)) {
+        return false;
+    }
+
+    // 订阅回调只把帧引用转交给录制器的编码队列，编码在录制器自己的线程中进行
+    auto recorder = m_videoRecorder;
+    m_recorderSubscription = m_videoCapture->getFrameBus().subscribe(
+        "录像",
+        [recorder](const FrameRef& frame) {
+            recorder->processFrame(frame);
+        },
+        QueuePolicy::DropOldest, 2);
+
+    return true;
+}
+
+bool GUI::startLibavRecording(const Resolution& resolution, const FrameRate& framerate) {
+    if (!m_libavRecorder->startRecording(resolution, framerate, m_encoderSettings)) {
+        return false;
+    }
+    resetQualityController(framerate);
+
+    // 与预览共用采集管线中的同一帧，不再重复打开设备和解码；直通录制订阅未解码的压缩帧
+    auto recorder = m_libavRecorder;
+    m_recorderOnNativeBus = m_encoderSettings.passthrough;
+    m_recorderSubscription = getRecorderBus().subscribe(
+        "libav录像",
+        [recorder](const FrameRef& frame) {
+            recorder->processFrame(frame);
+        },
+        QueuePolicy::DropOldest, 2);
+
+    return true;
+}
+
+bool GUI::startFFmpegRecording(const Resolution& resolution, const FrameRate& framerate) {
+    bool passthrough = m_encoderSettings.passthrough;
+    uint32_t inputFormat = passthrough ? m_videoCapture->getPixelFormat() : 0;
+    if (!m_ffmpegRecorder->startPipeRecording(resolution, framerate, inputFormat, passthrough)) {
+        return false;
+    }
+
+    // 帧通过管道送入ffmpeg进程，写入在订阅线程中阻塞，管道满时由总线队列丢弃旧帧
+    auto recorder = m_ffmpegRecorder;
+    m_recorderOnNativeBus = passthrough;
+    m_recorderSubscription = getRecorderBus().subscribe(
+        "FFmpeg录像",
+        [recorder](const FrameRef& frame) {
+            recorder->processFrame(frame);
+        },
+        QueuePolicy::DropOldest, 2);
+
+    return true;
+}
+
+void GUI::applySegmentSettings() {
+    // 分段参数对所有后端生效
+    SegmentSettings segment;
+    if (m_segmentEnabled) {
+        segment.segmentSeconds = m_segmentMinutes * 60;
+        segment.segmentMaxBytes = static_cast<uint64_t>(m_segmentMaxMB) * 1024 * 1024;
+    }
+    m_encoderSettings.segment = segment;
+    m_videoRecorder->setSegmentSettings(segment);
+    m_ffmpegRecorder->setSegmentSettings(segment);
+}
+
+void GUI::updatePreRoll() {
+    bool wanted = m_preRollEnabled && m_recorderBackend == RecorderBackend::Libav &&
+                  LibavRecorder::isAvailable() && m_videoCapture->isCapturing();
+    if (!wanted) {
+        m_preRollFailed = false;
+        if (m_libavRecorder->isPreRolling() && !m_libavRecorder->isRecording()) {
+            stopPreRoll();
+        }
+        return;
+    }
+
+    // 失败后不在每一帧重试，重新勾选时再试
+    if (m_libavRecorder->isPreRolling() || m_preRollFailed || isRecording()) {
+        return;
+    }
+
+    unsubscribeRecorder();
+    applySegmentSettings();
+    if (!m_libavRecorder->startPreRoll(m_videoCapture->getCurrentResolution(),
+                                       m_videoCapture->getCurrentFramerateFraction(),
+                                       m_encoderSettings, m_preRollSeconds)) {
+        m_preRollFailed = true;
+        return;
+    }
+    resetQualityController(m_videoCapture->getCurrentFramerateFraction());
+
+    // 预录期间一直订阅，开始和停止录像不改变订阅
+    auto recorder = m_libavRecorder;
+    m_recorderOnNativeBus = m_encoderSettings.passthrough;
+    m_recorderSubscription = getRecorderBus().subscribe(
+        "libav预录",
+        [recorder](const FrameRef& frame) {
+            recorder->processFrame(frame);
+        },
+        QueuePolicy::DropOldest, 2);
+}
+
+void GUI::stopPreRoll() {
+    if (!m_libavRecorder->isPreRolling()) {
+        return;
+    }
+
+    unsubscribeRecorder();
+    m_libavRecorder->stopPreRoll();
+}
+
+void GUI::resetQualityController(const FrameRate& framerate) {
+    // 每次录制（或预录）都从用户选择的参数开始
+    m_qualityController.reset(m_encoderSettings, m_libavRecorder->getQueueDepth(), framerate);
+}
+
+void GUI::updateAdaptiveQuality() {
+    if (!m_adaptiveQuality || m_recorderBackend != RecorderBackend::Libav || m_encoderSettings.passthrough) {
+        return;
+    }
+    // 预录中尚未录像时不调整：切换预设或分辨率要重建编码器，会清空预录缓冲区
+    if (!m_libavRecorder->isRecording()) {
+        return;
+    }
+
+    // 控制器内部按采样间隔限流，每帧调用即可
+    if (m_qualityController.update(m_libavRecorder->getStats())) {
+        m_libavRecorder->setQualityLevel(m_qualityController.getCurrentLevel());
+    }
+}
+
+void GUI::updateMotionDetection() {
+    bool wanted = m_motionRecordEnabled && m_videoCapture->isCapturing();
+    if (!wanted) {
+        stopMotionDetection();
+        return;
+    }
+
+    if (m_motionSubscription >= 0) {
+        return;
+    }
+
+    // 只需要最新的一帧，侦测跟不上时跳过旧帧
+    m_motionDetector->setSettings(m_motionSettings);
+    m_motionDetector->reset();
+    auto detector = m_motionDetector;
+    m_motionSubscription = m_videoCapture->getFrameBus().subscribe(
+        "移动侦测",
+        [detector](const FrameRef& frame) {
+            detector->process(frame);
+        },
+        QueuePolicy::LatestOnly, 1);
+}
+
+void GUI::stopMotionDetection() {
+    if (m_motionSubscription < 0) {
+        return;
+    }
+
+    m_videoCapture->getFrameBus().unsubscribe(m_motionSubscription);
+    m_motionSubscription = -1;
+    m_motionDetector->reset();
+    m_recordingByMotion = false;
+}
+
+void GUI::pollMotionEvents() {
+    bool active = false;
+    while (m_motionEvents.tryPop(active)) {
+        if (m_motionSubscription < 0 || !m_videoCapture->isCapturing()) {
+            continue;  // 侦测已关闭，丢弃残留的事件
+        }
+
+        if (active) {
+            // 手动开始的录制不受影响
+            if (!isRecording() && startRecording()) {
+                m_recordingByMotion = true;
+                std::cout << "检测到运动，开始录像" << std::endl;
+            }
+        } else if (m_recordingByMotion && isRecording()) {
+            std::cout << "画面静止，停止录像" << std::endl;
+            stopRecording();
+
+            // 刷新文件列表
+            std::vector<VideoFileInfo> videoFiles = m_fileManager->getVideoFileList();
+            setVideoFiles(videoFiles);
+        }
+    }
+}
+
+void GUI::unsubscribeRecorder() {
+    if (m_recorderSubscription >= 0) {
+        getRecorderBus().unsubscribe(m_recorderSubscription);
+        m_recorderSubscription = -1;
+    }
+}
+
+FrameBus& GUI::getRecorderBus() {
+    return m_recorderOnNativeBus ? m_videoCapture->getNativeFrameBus() : m_videoCapture->getFrameBus();
 }
@@ -0,0 +1,219 @@
+#include "io_uring_queue.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+IoUringQueue::IoUringQueue()
+    : m_fd(-1), m_sqRing(MAP_FAILED), m_cqRing(MAP_FAILED), m_sqes(MAP_FAILED),
+      m_sqRingSize(0), m_cqRingSize(0), m_sqesSize(0), m_entries(0), m_queued(0), m_unsubmitted(0),
+      m_sqHead(nullptr), m_sqTail(nullptr), m_sqMask(0), m_sqArray(nullptr),
+      m_cqHead(nullptr), m_cqTail(nullptr), m_cqMask(0), m_cqes(nullptr) {
+}
+
+IoUringQueue::~IoUringQueue() {
+    close();
+}
+
+bool IoUringQueue::init(unsigned entries) {
+    close();
+
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    m_fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+    if (m_fd < 0) {
+        return false;
+    }
+
+    m_sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    m_cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    bool singleMmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (singleMmap) {
+        m_sqRingSize = m_cqRingSize = std::max(m_sqRingSize, m_cqRingSize);
+    }
+
+    m_sqRing = mmap(nullptr, m_sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                    m_fd, IORING_OFF_SQ_RING);
+    if (m_sqRing == MAP_FAILED) {
+        close();
+        return false;
+    }
+    if (singleMmap) {
+        m_cqRing = m_sqRing;
+    } else {
+        m_cqRing = mmap(nullptr, m_cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                        m_fd, IORING_OFF_CQ_RING);
+        if (m_cqRing == MAP_FAILED) {
+            close();
+            return false;
+        }
+    }
+    m_sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+    m_sqes = mmap(nullptr, m_sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                  m_fd, IORING_OFF_SQES);
+    if (m_sqes == MAP_FAILED) {
+        close();
+        return false;
+    }
+
+    uint8_t* sq = static_cast<uint8_t*>(m_sqRing);
+    m_sqHead = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    m_sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    m_sqMask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    m_sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+
+    uint8_t* cq = static_cast<uint8_t*>(m_cqRing);
+    m_cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    m_cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    m_cqMask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    m_cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+
+    m_entries = params.sq_entries;
+    m_queued = 0;
+    m_unsubmitted = 0;
+    return true;
+}
+
+void IoUringQueue::close() {
+    if (m_sqes != MAP_FAILED) {
+        munmap(m_sqes, m_sqesSize);
+        m_sqes = MAP_FAILED;
+    }
+    if (m_cqRing != MAP_FAILED && m_cqRing != m_sqRing) {
+        munmap(m_cqRing, m_cqRingSize);
+    }
+    m_cqRing = MAP_FAILED;
+    if (m_sqRing != MAP_FAILED) {
+        munmap(m_sqRing, m_sqRingSize);
+        m_sqRing = MAP_FAILED;
+    }
+    if (m_fd >= 0) {
+        ::close(m_fd);
+        m_fd = -1;
+    }
+    m_queued = 0;
+    m_unsubmitted = 0;
+}
+
+bool IoUringQueue::registerBuffers(const iovec* buffers, unsigned count) {
+    return syscall(__NR_io_uring_register, m_fd, IORING_REGISTER_BUFFERS, buffers, count) == 0;
+}
+
+io_uring_sqe* IoUringQueue::nextSqe(uint64_t userData) {
+    unsigned tail = *m_sqTail + m_queued;
+    unsigned head = __atomic_load_n(m_sqHead, __ATOMIC_ACQUIRE);
+    if (tail - head >= m_entries) {
+        return nullptr;
+    }
+
+    unsigned index = tail & m_sqMask;
+    io_uring_sqe* sqe = static_cast<io_uring_sqe*>(m_sqes) + index;
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->user_data = userData;
+    m_sqArray[index] = index;
+    m_queued++;
+    return sqe;
+}
+
+bool IoUringQueue::queueWrite(int fd, const void* data, unsigned size, uint64_t offset, uint64_t userData) {
+    io_uring_sqe* sqe = nextSqe(userData);
+    if (!sqe) {
+        return false;
+    }
+    sqe->opcode = IORING_OP_WRITE;
+    sqe->fd = fd;
+    sqe->addr = reinterpret_cast<uint64_t>(data);
+    sqe->len = size;
+    sqe->off = offset;
+    return true;
+}
+
+bool IoUringQueue::queueWriteFixed(int fd, const void* data, unsigned size, uint64_t offset, unsigned bufferIndex,
+                                   uint64_t userData) {
+    io_uring_sqe* sqe = nextSqe(userData);
+    if (!sqe) {
+        return false;
+    }
+    sqe->opcode = IORING_OP_WRITE_FIXED;
+    sqe->fd = fd;
+    sqe->addr = reinterpret_cast<uint64_t>(data);
+    sqe->len = size;
+    sqe->off = offset;
+    sqe->buf_index = static_cast<uint16_t>(bufferIndex);
+    return true;
+}
+
+bool IoUringQueue::queueDataSync(int fd, uint64_t userData) {
+    io_uring_sqe* sqe = nextSqe(userData);
+    if (!sqe) {
+        return false;
+    }
+    sqe->opcode = IORING_OP_FSYNC;
+    sqe->fd = fd;
+    sqe->fsync_flags = IORING_FSYNC_DATASYNC;
+    return true;
+}
+
+int IoUringQueue::submit() {
+    if (m_queued > 0) {
+        __atomic_store_n(m_sqTail, *m_sqTail + m_queued, __ATOMIC_RELEASE);
+        m_unsubmitted += m_queued;
+        m_queued = 0;
+    }
+    if (m_unsubmitted == 0) {
+        return 0;
+    }
+
+    for (;;) {
+        long ret = syscall(__NR_io_uring_enter, m_fd, m_unsubmitted, 0, 0, nullptr, 0);
+        if (ret >= 0) {
+            m_unsubmitted -= static_cast<unsigned>(ret);
+            return static_cast<int>(ret);
+        }
+        if (errno != EINTR) {
+            return -1;
+        }
+    }
+}
+
+bool IoUringQueue::hasCompletions() const {
+    return *m_cqHead != loadCqTail();
+}
+
+bool IoUringQueue::waitCompletion() {
+    // 顺带提交之前没有被接受的请求，否则可能永远等不到它们完成
+    submit();
+    for (;;) {
+        long ret = syscall(__NR_io_uring_enter, m_fd, m_unsubmitted, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+        if (ret >= 0) {
+            m_unsubmitted -= static_cast<unsigned>(ret);
+            return true;
+        }
+        if (errno != EINTR) {
+            return false;
+        }
+    }
+}
+
+unsigned IoUringQueue::loadCqTail() const {
+    return __atomic_load_n(m_cqTail, __ATOMIC_ACQUIRE);
+}
+
+void IoUringQueue::storeCqHead(unsigned head) {
+    __atomic_store_n(m_cqHead, head, __ATOMIC_RELEASE);
+}
+
+const io_uring_cqe* IoUringQueue::completionAt(unsigned index) const {
+    return &m_cqes[index & m_cqMask];
+}
+
+uint64_t IoUringQueue::completionUserData(const io_uring_cqe* cqe) {
+    return cqe->user_data;
+}
+
+int IoUringQueue::completionResult(const io_uring_cqe* cqe) {
+    return cqe->res;
+}
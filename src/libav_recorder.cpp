@@ -0,0 +1,1099 @@
+#include "libav_recorder.h"
+#include "packet_ring_buffer.h"
+#include "utils.h"
+#include <iostream>
+#include <filesystem>
+#include <cmath>
+#include <functional>
+
+#ifdef HAVE_LIBAV
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+#include <libavutil/opt.h>
+#include <libavutil/imgutils.h>
+#include <libavutil/buffer.h>
+#include <libswscale/swscale.h>
+}
+#endif
+
+namespace fs = std::filesystem;
+
+#ifdef HAVE_LIBAV
+
+namespace {
+    // 封装器到OutputSink之间的AVIO缓冲区，写满后一次交给OutputSink
+    const int kAvioBufferSize = 64 * 1024;
+
+    std::string avErrorString(int error) {
+        char buffer[AV_ERROR_MAX_STRING_SIZE] = {0};
+        av_strerror(error, buffer, sizeof(buffer));
+        return buffer;
+    }
+
+    // AVIO回调：写入和定位都交给OutputSink，封装器不再直接做阻塞的文件系统调用
+#if LIBAVFORMAT_VERSION_MAJOR >= 61
+    int writeOutput(void* opaque, const uint8_t* data, int size) {
+#else
+    int writeOutput(void* opaque, uint8_t* data, int size) {
+#endif
+        return static_cast<OutputSink*>(opaque)->write(data, static_cast<size_t>(size)) ? size : AVERROR(EIO);
+    }
+
+    int64_t seekOutput(void* opaque, int64_t offset, int whence) {
+        OutputSink* sink = static_cast<OutputSink*>(opaque);
+        if (whence & AVSEEK_SIZE) {
+            return sink->size();
+        }
+        int64_t position = sink->seek(offset, whence & ~AVSEEK_FORCE);
+        return position < 0 ? AVERROR(EINVAL) : position;
+    }
+}
+
+// 编码器和封装器状态：编码器跨分段保持，分段只更换封装器，分段边界不丢帧
+// 预录时编码器在没有封装器的情况下持续运行，数据包保存在环形缓冲区中
+struct LibavEncoder {
+    AVFormatContext* formatContext;  // 当前分段的封装器
+    AVStream* stream;
+    AVCodecContext* codecContext;    // 编码器（直通录制时为空）
+    AVFrame* frame;
+    AVPacket* packet;
+    SwsContext* swsContext;
+    int width;         // 输入帧尺寸
+    int height;
+    int outputWidth;   // 编码尺寸（自适应画质降分辨率时小于输入尺寸）
+    int outputHeight;
+    bool passthrough;
+    FrameRate framerate;
+    EncoderSettings settings;
+    AVRational sourceTimeBase;  // 送入封装器前数据包的时间基
+
+    std::function<std::string(int, int)> nextSegmentPath;  // 按编码尺寸生成下一个分段的文件路径
+    std::string currentPath;  // 当前分段路径
+    int segmentCount;  // 已打开的分段数
+
+    int64_t segmentStartDts;  // 当前分段第一个数据包的dts（sourceTimeBase）
+    int64_t lastDts;  // 当前分段最后写入的dts（封装器时间基）
+    bool rollPending;  // 已达到分段条件，等待下一个关键帧
+    bool forceKeyframe;  // 下一帧强制编码为关键帧
+
+    std::unique_ptr<PacketRingBuffer> preRoll;  // 预录缓冲区（不预录时为空）
+    bool outputOpen;  // 是否在写文件（预录时开始录制前为false）
+
+    OutputSink* sink;  // 异步文件写入（属于录制器），为空时由libavformat直接写文件
+
+    LibavEncoder()
+        : formatContext(nullptr), stream(nullptr), codecContext(nullptr), frame(nullptr),
+          packet(nullptr), swsContext(nullptr), width(0), height(0), outputWidth(0), outputHeight(0),
+          passthrough(false),
+          sourceTimeBase(AVRational{1, 1000000}), segmentCount(0), segmentStartDts(AV_NOPTS_VALUE),
+          lastDts(AV_NOPTS_VALUE), rollPending(false), forceKeyframe(false), outputOpen(false),
+          sink(nullptr) {}
+
+    ~LibavEncoder() {
+        close();
+    }
+
+    // 打开编码器和第一个分段
+    bool open(const std::string& path, int frameWidth, int frameHeight,
+              const FrameRate& rate, const EncoderSettings& encoderSettings) {
+        if (!openEncoder(frameWidth, frameHeight, rate, encoderSettings) || !openMuxer(path)) {
+            return false;
+        }
+        outputOpen = true;
+        return true;
+    }
+
+    // 只打开编码器，数据包由preRoll保存，startOutput之后才写文件
+    bool openEncoder(int frameWidth, int frameHeight, const FrameRate& rate, const EncoderSettings& encoderSettings) {
+        width = frameWidth;
+        height = frameHeight;
+        outputWidth = frameWidth;
+        outputHeight = frameHeight;
+        framerate = rate;
+        settings = encoderSettings;
+        passthrough = settings.passthrough;
+
+        packet = av_packet_alloc();
+        if (!packet) {
+            return false;
+        }
+
+        if (passthrough) {
+            // 直通录制不需要编码器，时间基为微秒（采集时间戳）
+            sourceTimeBase = AVRational{1, 1000000};
+            return true;
+        }
+
+        return openCodec();
+    }
+
+    bool openCodec() {
+        const AVCodec* codec = avcodec_find_encoder_by_name(settings.codec.c_str());
+        if (!codec) {
+            std::cerr << "找不到编码器: " << settings.codec << std::endl;
+            return false;
+        }
+
+        codecContext = avcodec_alloc_context3(codec);
+        if (!codecContext) {
+            std::cerr << "无法创建编码器上下文" << std::endl;
+            return false;
+        }
+
+        codecContext->width = outputWidth;
+        codecContext->height = outputHeight;
+        codecContext->pix_fmt = AV_PIX_FMT_YUV420P;
+        codecContext->time_base = AVRational{static_cast<int>(framerate.denominator),
+                                             static_cast<int>(framerate.numerator)};
+        codecContext->framerate = AVRational{static_cast<int>(framerate.numerator),
+                                             static_cast<int>(framerate.denominator)};
+        codecContext->gop_size = settings.gopSize > 0 ? settings.gopSize : std::max(1, framerate.rounded() * 2);
+        codecContext->thread_count = settings.threads;
+        if (settings.bitrateKbps > 0) {
+            codecContext->bit_rate = static_cast<int64_t>(settings.bitrateKbps) * 1000;
+        }
+
+        // 所有分段使用同一种封装格式，编码器打开前按它决定是否输出全局头
+        std::string sampleName = "output" + settings.getFileExtension();
+        const AVOutputFormat* outputFormat = av_guess_format(nullptr, sampleName.c_str(), nullptr);
+        if (outputFormat && (outputFormat->flags & AVFMT_GLOBALHEADER)) {
+            codecContext->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+        }
+
+        // x264私有参数
+        if (!settings.preset.empty()) {
+            av_opt_set(codecContext->priv_data, "preset", settings.preset.c_str(), 0);
+        }
+        if (!settings.tune.empty()) {
+            av_opt_set(codecContext->priv_data, "tune", settings.tune.c_str(), 0);
+        }
+        if (settings.bitrateKbps <= 0) {
+            av_opt_set_int(codecContext->priv_data, "crf", settings.crf, 0);
+        }
+        // 分段时强制的关键帧必须是IDR，新分段才能独立解码
+        av_opt_set_int(codecContext->priv_data, "forced-idr", 1, 0);
+
+        int ret = avcodec_open2(codecContext, codec, nullptr);
+        if (ret < 0) {
+            std::cerr << "无法打开编码器: " << avErrorString(ret) << std::endl;
+            return false;
+        }
+        sourceTimeBase = codecContext->time_base;
+
+        frame = av_frame_alloc();
+        if (!frame) {
+            return false;
+        }
+        frame->format = AV_PIX_FMT_YUV420P;
+        frame->width = outputWidth;
+        frame->height = outputHeight;
+        if (av_frame_get_buffer(frame, 0) < 0) {
+            std::cerr << "无法分配编码帧" << std::endl;
+            return false;
+        }
+
+        swsContext = sws_getContext(width, height, AV_PIX_FMT_BGR24,
+                                    outputWidth, outputHeight, AV_PIX_FMT_YUV420P,
+                                    SWS_BILINEAR, nullptr, nullptr, nullptr);
+        return swsContext != nullptr;
+    }
+
+    // 切换画质档位：码率和crf由x264在下一帧重新配置，编码器不中断
+    // 预设和分辨率不能在运行中修改：冲刷并重新打开编码器，之后的数据写入新分段
+    // 预录尚未开始写文件时不重建：重建要清空预录缓冲区，触发前的画面会丢失
+    bool applyQuality(const QualityLevel& level) {
+        if (passthrough || !codecContext) {
+            return false;  // 直通录制没有编码器
+        }
+
+        int scaledWidth = std::max(2, static_cast<int>(width * level.scale)) & ~1;
+        int scaledHeight = std::max(2, static_cast<int>(height * level.scale)) & ~1;
+        bool rebuild = level.preset != settings.preset || scaledWidth != outputWidth || scaledHeight != outputHeight;
+        if (rebuild && preRoll && !outputOpen) {
+            std::cerr << "预录中不切换编码预设或分辨率: " << level.toString() << std::endl;
+            return false;
+        }
+
+        settings.preset = level.preset;
+        settings.bitrateKbps = level.bitrateKbps;
+        settings.crf = level.crf;
+
+        if (!rebuild) {
+            if (settings.bitrateKbps > 0) {
+                codecContext->bit_rate = static_cast<int64_t>(settings.bitrateKbps) * 1000;
+            } else {
+                av_opt_set_double(codecContext->priv_data, "crf", settings.crf, 0);
+            }
+            return true;
+        }
+
+        // 冲刷旧编码器，剩余的数据包写入当前分段
+        sendFrame(nullptr);
+        bool reopenOutput = outputOpen && formatContext;
+        closeMuxer();
+        freeCodec();
+
+        // 新编码器的参数集不同，旧数据包不能与之后的数据包写入同一个文件
+        if (preRoll) {
+            preRoll->clear();
+        }
+
+        outputWidth = scaledWidth;
+        outputHeight = scaledHeight;
+        if (!openCodec()) {
+            std::cerr << "无法以新画质重新打开编码器: " << level.toString() << std::endl;
+            return false;
+        }
+
+        if (reopenOutput) {
+            std::string path = nextSegmentPath ? nextSegmentPath(outputWidth, outputHeight) : std::string();
+            if (path.empty() || !openMuxer(path)) {
+                // 与分段切换失败相同：到下一个关键帧再重试
+                std::cerr << "无法打开新的分段: " << path << std::endl;
+                freeMuxer();
+                rollPending = true;
+            }
+        }
+        return true;
+    }
+
+    // 打开一个分段的封装器并写入文件头
+    bool openMuxer(const std::string& path) {
+        int ret = avformat_alloc_output_context2(&formatContext, nullptr, nullptr, path.c_str());
+        if (ret < 0 || !formatContext) {
+            std::cerr << "无法创建封装器: " << avErrorString(ret) << std::endl;
+            return false;
+        }
+
+        stream = avformat_new_stream(formatContext, nullptr);
+        if (!stream) {
+            std::cerr << "无法创建输出流" << std::endl;
+            return false;
+        }
+
+        if (passthrough) {
+            stream->codecpar->codec_type = AVMEDIA_TYPE_VIDEO;
+            stream->codecpar->codec_id = AV_CODEC_ID_MJPEG;
+            stream->codecpar->width = width;
+            stream->codecpar->height = height;
+            stream->codecpar->format = AV_PIX_FMT_YUVJ422P;
+        } else {
+            ret = avcodec_parameters_from_context(stream->codecpar, codecContext);
+            if (ret < 0) {
+                std::cerr << "无法设置流参数: " << avErrorString(ret) << std::endl;
+                return false;
+            }
+        }
+        stream->time_base = sourceTimeBase;
+        stream->avg_frame_rate = AVRational{static_cast<int>(framerate.numerator),
+                                            static_cast<int>(framerate.denominator)};
+        stream->r_frame_rate = stream->avg_frame_rate;
+
+        if (!(formatContext->oformat->flags & AVFMT_NOFILE)) {
+            if (sink) {
+                if (!openSinkOutput(path)) {
+                    return false;
+                }
+            } else {
+                ret = avio_open(&formatContext->pb, path.c_str(), AVIO_FLAG_WRITE);
+                if (ret < 0) {
+                    std::cerr << "无法创建输出文件: " << avErrorString(ret) << std::endl;
+                    return false;
+                }
+            }
+        }
+
+        // 分片mp4：moov在文件头，每个关键帧开始一个新分片，写入中的文件可以直接播放
+        AVDictionary* options = nullptr;
+        if (settings.segment.fragmented && std::string(formatContext->oformat->name) == "mp4") {
+            av_dict_set(&options, "movflags", "frag_keyframe+empty_moov+default_base_moof", 0);
+        }
+        ret = avformat_write_header(formatContext, &options);
+        av_dict_free(&options);
+        if (ret < 0) {
+            std::cerr << "无法写入文件头: " << avErrorString(ret) << std::endl;
+            return false;
+        }
+
+        currentPath = path;
+        segmentCount++;
+        segmentStartDts = AV_NOPTS_VALUE;
+        lastDts = AV_NOPTS_VALUE;
+        return true;
+    }
+
+    // 通过OutputSink写文件：封装器的写入只拷贝进缓冲区，实际写入、fdatasync和关闭都在后台进行
+    bool openSinkOutput(const std::string& path) {
+        if (!sink->open(path)) {
+            return false;
+        }
+        unsigned char* buffer = static_cast<unsigned char*>(av_malloc(kAvioBufferSize));
+        if (buffer) {
+            formatContext->pb = avio_alloc_context(buffer, kAvioBufferSize, 1, sink, nullptr, writeOutput, seekOutput);
+        }
+        if (!formatContext->pb) {
+            std::cerr << "无法创建输出上下文" << std::endl;
+            av_free(buffer);
+            sink->close();
+            return false;
+        }
+        return true;
+    }
+
+    // 写入文件尾并关闭当前分段
+    void closeMuxer() {
+        if (!formatContext) {
+            return;
+        }
+        av_write_trailer(formatContext);
+        freeMuxer();
+    }
+
+    void freeMuxer() {
+        if (formatContext) {
+            if (!(formatContext->oformat->flags & AVFMT_NOFILE) && formatContext->pb) {
+                if (sink) {
+                    // 自定义的输出上下文由调用者释放；文件在后台同步后关闭，不等待落盘
+                    avio_flush(formatContext->pb);
+                    av_freep(&formatContext->pb->buffer);
+                    avio_context_free(&formatContext->pb);
+                    sink->close();
+                } else {
+                    avio_closep(&formatContext->pb);
+                }
+            }
+            avformat_free_context(formatContext);
+            formatContext = nullptr;
+        }
+        stream = nullptr;
+    }
+
+    // 把数据包写入当前分段，达到分段条件后在下一个关键帧处切换到新文件
+    bool writePacket(AVPacket* output) {
+        const SegmentSettings& segment = settings.segment;
+        if (segment.isEnabled() && formatContext && !rollPending && segmentStartDts != AV_NOPTS_VALUE) {
+            double seconds = (output->dts - segmentStartDts) * av_q2d(sourceTimeBase);
+            int64_t bytes = formatContext->pb ? avio_tell(formatContext->pb) : 0;
+            if ((segment.segmentSeconds > 0 && seconds >= segment.segmentSeconds) ||
+                (segment.segmentMaxBytes > 0 && static_cast<uint64_t>(bytes) >= segment.segmentMaxBytes)) {
+                rollPending = true;
+                forceKeyframe = true;
+            }
+        }
+
+        if (rollPending && (output->flags & AV_PKT_FLAG_KEY)) {
+            rollPending = false;
+            closeMuxer();
+            std::string path = nextSegmentPath ? nextSegmentPath(outputWidth, outputHeight) : std::string();
+            if (path.empty() || !openMuxer(path)) {
+                // 丢弃到下一个关键帧再重试
+                std::cerr << "无法打开新的分段: " << path << std::endl;
+                freeMuxer();
+                rollPending = true;
+            }
+        }
+
+        if (!formatContext) {
+            return false;
+        }
+
+        // 每个分段的时间戳从0开始
+        if (segmentStartDts == AV_NOPTS_VALUE) {
+            segmentStartDts = output->dts;
+        }
+        output->pts -= segmentStartDts;
+        output->dts -= segmentStartDts;
+        av_packet_rescale_ts(output, sourceTimeBase, stream->time_base);
+
+        // 换算后保持严格递增（如mkv为毫秒，间隔过近的帧会得到相同的时间戳）
+        if (lastDts != AV_NOPTS_VALUE && output->dts <= lastDts) {
+            int64_t shift = lastDts + 1 - output->dts;
+            output->dts += shift;
+            output->pts += shift;
+        }
+        lastDts = output->dts;
+        output->stream_index = stream->index;
+
+        int ret = av_interleaved_write_frame(formatContext, output);
+        if (ret < 0) {
+            std::cerr << "写入数据包失败: " << avErrorString(ret) << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    // 直接写入一个压缩帧，数据包引用帧池缓冲区，不拷贝
+    bool writeCompressed(const FrameRef& compressed, int64_t ptsUs) {
+        FrameRef* holder = new FrameRef(compressed);
+        AVBufferRef* buffer = av_buffer_create(compressed.data(), static_cast<int>(compressed.info().bytesUsed),
+                                               releaseFrameRef, holder, AV_BUFFER_FLAG_READONLY);
+        if (!buffer) {
+            delete holder;
+            return false;
+        }
+
+        packet->buf = buffer;
+        packet->data = compressed.data();
+        packet->size = static_cast<int>(compressed.info().bytesUsed);
+        packet->flags |= AV_PKT_FLAG_KEY;  // 每个JPEG帧都可独立解码
+        packet->pts = ptsUs;
+        packet->dts = ptsUs;
+        packet->duration = 0;
+
+        // 写入后数据包引用转移给封装器，最后一个引用释放时帧归还帧池（预录缓冲区保存的是拷贝）
+        bool written = handlePacket(packet);
+        av_packet_unref(packet);
+        return written;
+    }
+
+    static void releaseFrameRef(void* opaque, uint8_t* data) {
+        (void)data;
+        delete static_cast<FrameRef*>(opaque);
+    }
+
+    // 编码一帧BGR图像
+    bool encode(const cv::Mat& bgr, int64_t pts) {
+        if (bgr.cols != width || bgr.rows != height || bgr.type() != CV_8UC3) {
+            return false;
+        }
+
+        // 编码器可能仍引用上一帧的缓冲区
+        if (av_frame_make_writable(frame) < 0) {
+            return false;
+        }
+
+        const uint8_t* srcData[1] = { bgr.data };
+        int srcStride[1] = { static_cast<int>(bgr.step) };
+        sws_scale(swsContext, srcData, srcStride, 0, height, frame->data, frame->linesize);
+
+        frame->pts = pts;
+        frame->pict_type = forceKeyframe ? AV_PICTURE_TYPE_I : AV_PICTURE_TYPE_NONE;
+        forceKeyframe = false;
+        return sendFrame(frame);
+    }
+
+    // 冲刷编码器并写入文件尾
+    void finish() {
+        if (codecContext) {
+            sendFrame(nullptr);
+        }
+        stopOutput();
+    }
+
+    // 新的数据包：先存入预录缓冲区，正在写文件时再写入当前分段
+    bool handlePacket(AVPacket* output) {
+        if (preRoll) {
+            preRoll->push(output->data, static_cast<size_t>(output->size), output->pts, output->dts,
+                          output->duration, (output->flags & AV_PKT_FLAG_KEY) != 0);
+        }
+        if (!outputOpen) {
+            return true;
+        }
+        return writePacket(output);
+    }
+
+    // 预录中开始写文件：打开第一个分段，从缓冲区中最早的关键帧开始写入，之后的数据包直接写入
+    bool startOutput(const std::string& path, size_t& flushed) {
+        flushed = 0;
+        segmentCount = 0;
+        rollPending = false;
+        if (!openMuxer(path)) {
+            freeMuxer();
+            return false;
+        }
+        outputOpen = true;
+
+        if (preRoll) {
+            // 数据包指向缓冲区内部，不是引用计数的，封装器需要时会自行拷贝
+            bool ok = true;
+            flushed = preRoll->forEach([this, &ok](const RingPacket& buffered) {
+                packet->data = const_cast<uint8_t*>(buffered.data);
+                packet->size = static_cast<int>(buffered.size);
+                packet->pts = buffered.pts;
+                packet->dts = buffered.dts;
+                packet->duration = buffered.duration;
+                packet->flags = buffered.keyframe ? AV_PKT_FLAG_KEY : 0;
+                ok = writePacket(packet);
+                av_packet_unref(packet);
+                return ok;
+            });
+            if (!ok) {
+                std::cerr << "写入预录数据失败" << std::endl;
+            }
+        }
+        return true;
+    }
+
+    // 写入文件尾，编码器（预录时）继续运行
+    void stopOutput() {
+        closeMuxer();
+        outputOpen = false;
+        rollPending = false;
+    }
+
+    bool sendFrame(AVFrame* input) {
+        int ret = avcodec_send_frame(codecContext, input);
+        if (ret < 0) {
+            std::cerr << "编码失败: " << avErrorString(ret) << std::endl;
+            return false;
+        }
+
+        while ((ret = avcodec_receive_packet(codecContext, packet)) >= 0) {
+            bool written = handlePacket(packet);
+            av_packet_unref(packet);
+            if (!written) {
+                return false;
+            }
+        }
+
+        return ret == AVERROR(EAGAIN) || ret == AVERROR_EOF;
+    }
+
+    void freeCodec() {
+        if (swsContext) {
+            sws_freeContext(swsContext);
+            swsContext = nullptr;
+        }
+        if (frame) {
+            av_frame_free(&frame);
+        }
+        if (codecContext) {
+            avcodec_free_context(&codecContext);
+        }
+    }
+
+    void close() {
+        freeCodec();
+        if (packet) {
+            av_packet_free(&packet);
+        }
+        freeMuxer();
+    }
+};
+
+#else
+
+// 未启用libav时的占位定义
+struct LibavEncoder {
+};
+
+#endif
+
+LibavRecorder::LibavRecorder()
+    : m_segmentCount(0),
+      m_queueDepth(8),
+      m_passthrough(false),
+      m_isRecording(false),
+      m_preRolling(false),
+      m_qualityPending(false),
+      m_encoded(0),
+      m_lastEncodeUs(0),
+      m_maxEncodeUs(0),
+      m_totalEncodeUs(0) {
+    m_outputSink.reset(new OutputSink());
+}
+
+LibavRecorder::~LibavRecorder() {
+    stopPreRoll();
+    stopRecording();
+}
+
+bool LibavRecorder::isAvailable() {
+#ifdef HAVE_LIBAV
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool LibavRecorder::init(const std::string& outputDir) {
+    m_outputDir = outputDir;
+
+    // 确保输出目录存在
+    if (!Utils::ensureDirectoryExists(m_outputDir)) {
+        std::cerr << "无法创建输出目录: " << m_outputDir << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+bool LibavRecorder::startRecording(const Resolution& resolution, const FrameRate& framerate,
+                                   const EncoderSettings& settings) {
+    if (m_isRecording) {
+        return true;  // 已经在录制中
+    }
+
+#ifdef HAVE_LIBAV
+    // 预录中：沿用预录的编码参数，先写入缓冲区中的数据
+    if (m_preRolling) {
+        return startPreRollOutput();
+    }
+
+    if (!framerate.isValid()) {
+        std::cerr << "无效的帧率" << std::endl;
+        return false;
+    }
+
+    // 生成文件名
+    std::string extension = getFileExtension(settings);
+    std::string filePath = generateFileName(resolution, framerate.rounded(), extension);
+    {
+        std::lock_guard<std::mutex> lock(m_pathMutex);
+        m_currentFilePath = filePath;
+    }
+
+    if (settings.passthrough && settings.container == "mp4") {
+        std::cout << "直通录制不支持mp4封装MJPEG，改用mkv" << std::endl;
+    }
+
+    // 打开编码器和输出文件（编码线程启动前完成，失败时直接返回）
+    std::unique_ptr<LibavEncoder> encoder(new LibavEncoder());
+    encoder->nextSegmentPath = [this, framerate, extension](int outputWidth, int outputHeight) {
+        // 文件名中的分辨率是编码尺寸，自适应画质降分辨率后与采集分辨率不同
+        return generateFileName(Resolution(outputWidth, outputHeight), framerate.rounded(), extension);
+    };
+    encoder->sink = attachOutputSink();
+    if (!encoder->open(filePath, resolution.width, resolution.height, framerate, settings)) {
+        std::cerr << "无法开始libav录制: " << filePath << std::endl;
+        return false;
+    }
+    m_encoder = std::move(encoder);
+    m_passthrough = settings.passthrough;
+    m_segmentCount = 1;
+
+    // 每次录制使用新的队列，统计从零开始
+    auto queue = std::make_shared<BoundedQueue<FrameRef>>(m_queueDepth, QueuePolicy::DropOldest);
+    {
+        std::lock_guard<std::mutex> lock(m_queueMutex);
+        m_queue = queue;
+    }
+    m_encoded = 0;
+    m_lastEncodeUs = 0;
+    m_maxEncodeUs = 0;
+    m_totalEncodeUs = 0;
+    m_qualityPending = false;
+
+    m_encoderThread = std::thread(&LibavRecorder::encoderThreadFunc, this, queue);
+
+    // 记录开始时间
+    m_startTime = std::chrono::steady_clock::now();
+
+    // 设置录制标志
+    m_isRecording = true;
+
+    if (m_passthrough) {
+        std::cout << "libav直通录制: " << filePath << " (MJPEG)" << std::endl;
+    } else {
+        std::cout << "libav录制: " << filePath << " (" << settings.codec << ", "
+                  << settings.preset << ", " << settings.bitrateKbps << "kbps)" << std::endl;
+    }
+    return true;
+#else
+    std::cerr << "未编译libav支持，无法使用进程内编码" << std::endl;
+    return false;
+#endif
+}
+
+void LibavRecorder::stopRecording() {
+    if (!m_isRecording) {
+        return;  // 没有在录制
+    }
+
+#ifdef HAVE_LIBAV
+    // 预录中：只关闭文件，编码器继续运行并填充缓冲区
+    if (m_preRolling) {
+        {
+            std::lock_guard<std::mutex> lock(m_encoderMutex);
+            m_encoder->stopOutput();
+            m_isRecording = false;
+        }
+        std::cout << "录制结束，继续预录" << std::endl;
+        return;
+    }
+#endif
+
+    // 清除录制标志，不再接受新帧
+    m_isRecording = false;
+
+    stopEncoderThread();
+
+    RecorderStats stats = getStats();
+    std::cout << "录制结束: 编码 " << stats.encoded << " 帧, 丢弃 " << stats.dropped
+              << " 帧, 峰值队列 " << stats.maxQueueDepth << std::endl;
+}
+
+bool LibavRecorder::startPreRoll(const Resolution& resolution, const FrameRate& framerate,
+                                 const EncoderSettings& settings, int seconds, size_t maxBytes) {
+    if (m_preRolling) {
+        return true;  // 已经在预录中
+    }
+
+    if (m_isRecording) {
+        std::cerr << "正在录制，无法开始预录" << std::endl;
+        return false;
+    }
+
+#ifdef HAVE_LIBAV
+    if (!framerate.isValid() || seconds <= 0) {
+        std::cerr << "无效的预录参数" << std::endl;
+        return false;
+    }
+
+    std::unique_ptr<LibavEncoder> encoder(new LibavEncoder());
+    std::string extension = getFileExtension(settings);
+    encoder->nextSegmentPath = [this, framerate, extension](int outputWidth, int outputHeight) {
+        // 文件名中的分辨率是编码尺寸，自适应画质降分辨率后与采集分辨率不同
+        return generateFileName(Resolution(outputWidth, outputHeight), framerate.rounded(), extension);
+    };
+    encoder->sink = attachOutputSink();
+    if (!encoder->openEncoder(resolution.width, resolution.height, framerate, settings)) {
+        std::cerr << "无法开始libav预录" << std::endl;
+        return false;
+    }
+
+    // 缓冲区大小按码率×时长估算，多留一个GOP和关键帧码率波动的余量；内存在此一次分配
+    if (maxBytes == 0) {
+        double bytesPerSecond;
+        if (settings.passthrough) {
+            bytesPerSecond = resolution.width * resolution.height / 4.0 * framerate.toDouble();  // 典型JPEG帧
+        } else if (settings.bitrateKbps > 0) {
+            bytesPerSecond = settings.bitrateKbps * 1000.0 / 8.0;
+        } else {
+            bytesPerSecond = resolution.width * resolution.height * framerate.toDouble() / 100.0;  // crf模式的粗略估计
+        }
+        double gopSeconds = settings.passthrough ? 0.0 :
+                            (settings.gopSize > 0 ? settings.gopSize / framerate.toDouble() : 2.0);
+        maxBytes = static_cast<size_t>(bytesPerSecond * (seconds + gopSeconds) * 1.5);
+    }
+    int64_t window = av_rescale_q(seconds, AVRational{1, 1}, encoder->sourceTimeBase);
+    encoder->preRoll.reset(new PacketRingBuffer(maxBytes, window));
+
+    m_encoder = std::move(encoder);
+    m_passthrough = settings.passthrough;
+    m_segmentCount = 0;
+
+    auto queue = std::make_shared<BoundedQueue<FrameRef>>(m_queueDepth, QueuePolicy::DropOldest);
+    {
+        std::lock_guard<std::mutex> lock(m_queueMutex);
+        m_queue = queue;
+    }
+    m_encoded = 0;
+    m_lastEncodeUs = 0;
+    m_maxEncodeUs = 0;
+    m_totalEncodeUs = 0;
+    m_qualityPending = false;
+
+    m_encoderThread = std::thread(&LibavRecorder::encoderThreadFunc, this, queue);
+    m_preRolling = true;
+
+    std::cout << "libav预录: " << seconds << " 秒, 缓冲区 " << maxBytes / 1024 << " KB" << std::endl;
+    return true;
+#else
+    (void)resolution;
+    (void)framerate;
+    (void)settings;
+    (void)seconds;
+    (void)maxBytes;
+    std::cerr << "未编译libav支持，无法预录" << std::endl;
+    return false;
+#endif
+}
+
+void LibavRecorder::stopPreRoll() {
+    if (!m_preRolling) {
+        return;  // 没有在预录
+    }
+
+    // 正在录制时编码线程冲刷编码器并写入文件尾
+    m_preRolling = false;
+    m_isRecording = false;
+
+    stopEncoderThread();
+    std::cout << "预录结束" << std::endl;
+}
+
+double LibavRecorder::getPreRollDuration() const {
+#ifdef HAVE_LIBAV
+    if (!m_preRolling) {
+        return 0.0;
+    }
+
+    std::lock_guard<std::mutex> lock(m_encoderMutex);
+    if (!m_encoder || !m_encoder->preRoll) {
+        return 0.0;
+    }
+    return m_encoder->preRoll->duration() * av_q2d(m_encoder->sourceTimeBase);
+#else
+    return 0.0;
+#endif
+}
+
+bool LibavRecorder::startPreRollOutput() {
+#ifdef HAVE_LIBAV
+    std::lock_guard<std::mutex> lock(m_encoderMutex);
+
+    std::string filePath = m_encoder->nextSegmentPath(m_encoder->outputWidth, m_encoder->outputHeight);
+    double bufferedSeconds = m_encoder->preRoll->duration() * av_q2d(m_encoder->sourceTimeBase);
+    size_t flushed = 0;
+    if (!m_encoder->startOutput(filePath, flushed)) {
+        std::cerr << "无法开始libav录制: " << filePath << std::endl;
+        return false;
+    }
+
+    {
+        std::lock_guard<std::mutex> pathLock(m_pathMutex);
+        m_currentFilePath = filePath;
+    }
+    m_segmentCount = m_encoder->segmentCount;
+    m_startTime = std::chrono::steady_clock::now();
+    m_isRecording = true;
+
+    std::cout << "libav录制: " << filePath << " (预录 " << bufferedSeconds << " 秒, "
+              << flushed << " 个数据包)" << std::endl;
+    return true;
+#else
+    return false;
+#endif
+}
+
+void LibavRecorder::stopEncoderThread() {
+    // 关闭队列，编码线程编码完剩余的帧、冲刷编码器并写入文件尾后退出
+    std::shared_ptr<BoundedQueue<FrameRef>> queue;
+    {
+        std::lock_guard<std::mutex> lock(m_queueMutex);
+        queue = m_queue;
+    }
+    if (queue) {
+        queue->close();
+    }
+    if (m_encoderThread.joinable()) {
+        m_encoderThread.join();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_encoderMutex);
+        m_encoder.reset();
+    }
+
+    // 等待最后一个分段在后台同步并关闭，停止录制返回时文件已经落盘
+    m_outputSink->drain();
+}
+
+OutputSink* LibavRecorder::attachOutputSink() {
+    // 缓冲区在第一次录制时分配，之后复用；分配失败时由libavformat直接写文件
+    if (!m_outputSink->init()) {
+        return nullptr;
+    }
+    m_outputSink->resetStats();
+    return m_outputSink.get();
+}
+
+void LibavRecorder::setQualityLevel(const QualityLevel& level) {
+    {
+        std::lock_guard<std::mutex> lock(m_qualityMutex);
+        m_pendingQuality = level;
+    }
+    m_qualityPending = true;
+}
+
+void LibavRecorder::processFrame(const FrameRef& frame) {
+    if ((!m_isRecording && !m_preRolling) || frame.empty()) {
+        return;  // 没有在录制或预录
+    }
+
+    std::shared_ptr<BoundedQueue<FrameRef>> queue;
+    {
+        std::lock_guard<std::mutex> lock(m_queueMutex);
+        queue = m_queue;
+    }
+    if (queue) {
+        queue->push(frame);
+    }
+}
+
+double LibavRecorder::getRecordingDuration() const {
+    if (!m_isRecording) {
+        return 0.0;
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    return std::chrono::duration<double>(now - m_startTime).count();
+}
+
+RecorderStats LibavRecorder::getStats() const {
+    RecorderStats stats;
+
+    std::shared_ptr<BoundedQueue<FrameRef>> queue;
+    {
+        std::lock_guard<std::mutex> lock(m_queueMutex);
+        queue = m_queue;
+    }
+    if (queue) {
+        QueueStats queueStats = queue->getStats();
+        stats.queued = queueStats.pushed;
+        stats.dropped = queueStats.dropped;
+        stats.queueDepth = queueStats.depth;
+        stats.maxQueueDepth = queueStats.maxDepth;
+    }
+
+    stats.encoded = m_encoded;
+    stats.lastEncodeMs = m_lastEncodeUs / 1000.0;
+    stats.maxEncodeMs = m_maxEncodeUs / 1000.0;
+    stats.totalEncodeMs = m_totalEncodeUs / 1000.0;
+    return stats;
+}
+
+void LibavRecorder::encoderThreadFunc(std::shared_ptr<BoundedQueue<FrameRef>> queue) {
+#ifdef HAVE_LIBAV
+    if (m_passthrough) {
+        passthroughThreadFunc(queue);
+        return;
+    }
+
+    AVRational timeBase = m_encoder->codecContext->time_base;
+    int64_t firstTimestampUs = -1;
+    int64_t lastPts = -1;
+
+    FrameRef frame;
+    while (queue->pop(frame)) {
+        // 按采集时间戳计算pts，丢帧在文件中表现为时间间隔而不是画面加速
+        int64_t timestampUs = frame.info().timestampUs;
+        int64_t pts = lastPts + 1;
+        if (timestampUs > 0) {
+            if (firstTimestampUs < 0) {
+                firstTimestampUs = timestampUs;
+            }
+            double seconds = (timestampUs - firstTimestampUs) / 1e6;
+            pts = std::max(lastPts + 1, static_cast<int64_t>(std::llround(seconds * timeBase.den / timeBase.num)));
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        {
+            // 预录时开始和停止录制在调用线程中切换输出
+            std::lock_guard<std::mutex> lock(m_encoderMutex);
+            if (m_qualityPending.exchange(false)) {
+                QualityLevel level;
+                {
+                    std::lock_guard<std::mutex> qualityLock(m_qualityMutex);
+                    level = m_pendingQuality;
+                }
+                m_encoder->applyQuality(level);
+            }
+            if (frame.info().pixelFormat == 0 && m_encoder->encode(frame.mat(), pts)) {
+                lastPts = pts;
+                m_encoded++;
+            }
+            updateSegmentPath();
+        }
+        int64_t encodeUs = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start).count();
+
+        m_lastEncodeUs = encodeUs;
+        m_totalEncodeUs += encodeUs;
+        if (encodeUs > m_maxEncodeUs) {
+            m_maxEncodeUs = encodeUs;
+        }
+
+        // 尽早归还帧池缓冲区
+        frame.reset();
+    }
+
+    std::lock_guard<std::mutex> lock(m_encoderMutex);
+    m_encoder->finish();
+#else
+    (void)queue;
+#endif
+}
+
+void LibavRecorder::passthroughThreadFunc(std::shared_ptr<BoundedQueue<FrameRef>> queue) {
+#ifdef HAVE_LIBAV
+    int64_t firstTimestampUs = -1;
+
+    FrameRef frame;
+    while (queue->pop(frame)) {
+        const FrameInfo& info = frame.info();
+        if (info.pixelFormat != V4L2_PIX_FMT_MJPEG && info.pixelFormat != V4L2_PIX_FMT_JPEG) {
+            frame.reset();
+            continue;  // 直通录制只接受压缩帧
+        }
+
+        // 直接使用驱动时间戳（微秒），丢帧在文件中表现为时间间隔
+        if (firstTimestampUs < 0) {
+            firstTimestampUs = info.timestampUs;
+        }
+        int64_t ptsUs = std::max<int64_t>(0, info.timestampUs - firstTimestampUs);
+
+        auto start = std::chrono::steady_clock::now();
+        {
+            std::lock_guard<std::mutex> lock(m_encoderMutex);
+            if (m_encoder->writeCompressed(frame, ptsUs)) {
+                m_encoded++;
+            }
+            updateSegmentPath();
+        }
+        int64_t writeUs = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start).count();
+
+        m_lastEncodeUs = writeUs;
+        m_totalEncodeUs += writeUs;
+        if (writeUs > m_maxEncodeUs) {
+            m_maxEncodeUs = writeUs;
+        }
+
+        frame.reset();
+    }
+
+    std::lock_guard<std::mutex> lock(m_encoderMutex);
+    m_encoder->finish();
+#else
+    (void)queue;
+#endif
+}
+
+std::string LibavRecorder::getCurrentFilePath() const {
+    std::lock_guard<std::mutex> lock(m_pathMutex);
+    return m_currentFilePath;
+}
+
+void LibavRecorder::updateSegmentPath() {
+#ifdef HAVE_LIBAV
+    if (m_encoder->segmentCount == m_segmentCount) {
+        return;
+    }
+
+    m_segmentCount = m_encoder->segmentCount;
+    {
+        std::lock_guard<std::mutex> lock(m_pathMutex);
+        m_currentFilePath = m_encoder->currentPath;
+    }
+    std::cout << "切换到分段 " << m_segmentCount << ": " << m_encoder->currentPath << std::endl;
+#endif
+}
+
+std::string LibavRecorder::getFileExtension(const EncoderSettings& settings) const {
+    if (m_fileNameTag.empty()) {
+        return settings.getFileExtension();
+    }
+    return "." + m_fileNameTag + settings.getFileExtension();
+}
+
+std::string LibavRecorder::generateFileName(const Resolution& resolution, int framerate, const std::string& extension) {
+    // 获取当前日期时间
+    std::string dateTime = Utils::getCurrentDateTimeString();
+
+    // 生成文件名：日期时间_分辨率_帧率.扩展名
+    std::string baseName = dateTime + "_" +
+                          std::to_string(resolution.width) + "x" + std::to_string(resolution.height) +
+                          "_" + std::to_string(framerate) + "fps";
+
+    // 同一秒内切换分段时加序号（日期时间_分辨率_帧率.N.扩展名，FileManager仍能解析）
+    fs::path filePath = fs::path(m_outputDir) / (baseName + extension);
+    for (int index = 1; fs::exists(filePath); index++) {
+        filePath = fs::path(m_outputDir) / (baseName + "." + std::to_string(index) + extension);
+    }
+
+    // 完整路径
+    return filePath;
+}
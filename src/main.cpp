@@ -2,10 +2,13 @@
 #include "video_capture.h"
 #include "video_recorder.h"
 #include "ffmpeg_recorder.h"
+#include "libav_recorder.h"
+#include "raw_recorder.h"
 #include "file_manager.h"
 #include "frame_extractor.h"
 #include "gui.h"
 #include "utils.h"
+#include "format_negotiator.h"
 
 #include <iostream>
 #include <memory>
@@ -13,6 +16,8 @@
 #include <filesystem>
 #include <vector>
 #include <algorithm>
+#include <iomanip>
+#include <thread>
 
 namespace fs = std::filesystem;
 
@@ -32,8 +37,23 @@ void showHelp(const char* programName) {
     std::cout << "    --height=H     设置高度为H（默认为480）" << std::endl;
     std::cout << "    --fps=F        设置帧率为F（默认为30）" << std::endl;
     std::cout << "    --time=T       录制T秒后停止（默认为10）" << std::endl;
+    std::cout << "    --passthrough  MJPEG直通录制，不解码不重新编码，输出MKV" << std::endl;
+    std::cout << "    --segment=S    每S秒切换到新文件（分段录制）" << std::endl;
+    std::cout << "    --raw[=FOURCC] 无损原始录制，按设备输出格式（默认YUYV，可选GREY等）逐帧写入.raw文件" << std::endl;
     std::cout << "  extract          从视频文件中提取帧" << std::endl;
     std::cout << "    --file=PATH    指定视频文件路径" << std::endl;
+    std::cout << "    --workers=N    使用N个JPEG编码写入线程（默认为CPU核心数）" << std::endl;
+    std::cout << "    --gop          按GOP切分，多个解码器并行解码（需要libav）" << std::endl;
+    std::cout << "    --decoders=N   按GOP并行解码时使用N个解码线程（默认为CPU核心数的一半）" << std::endl;
+    std::cout << "    --every=N      每N帧取一帧" << std::endl;
+    std::cout << "    --interval=S   每隔S秒取一帧" << std::endl;
+    std::cout << "    --keyframes    只取关键帧（需要libav）" << std::endl;
+    std::cout << "    --start=S      从第S秒开始" << std::endl;
+    std::cout << "    --end=S        到第S秒结束" << std::endl;
+    std::cout << "    --archive[=C]  输出为单个.frames帧归档，不再每帧一个文件；C为jpeg（默认）、lz4或raw" << std::endl;
+    std::cout << "    --unpack=PATH  把.frames帧归档解包为每帧一个JPEG的目录" << std::endl;
+    std::cout << "    --out=DIR      解包的目标目录（默认为与归档同名的目录）" << std::endl;
+    std::cout << "    --bench        依次用1、2、4…N个线程分帧，报告每种线程数的帧/秒" << std::endl;
 }
 
 // 解析命令行参数
@@ -60,6 +80,190 @@ std::string getArgValue(const std::vector<std::string>& args, const std::string&
     return defaultValue;
 }
 
+// MJPEG直通录制：设备输出的JPEG帧直接写入MKV，不做任何解码和编码
+int recordPassthrough(CameraDevice& cameraDevice, const std::string& devicePath, const Resolution& resolution,
+                      int fps, int recordTime, const SegmentSettings& segment, const std::string& videoDir) {
+    // 只允许协商出MJPEG
+    cameraDevice.setRequiredPixelFormat(V4L2_PIX_FMT_MJPEG);
+    if (!cameraDevice.openDevice(devicePath)) {
+        std::cerr << "无法打开设备: " << devicePath << std::endl;
+        return 1;
+    }
+
+    // 不需要预览，关闭解码
+    VideoCapture capture;
+    capture.setDecodeEnabled(false);
+    if (!capture.init(cameraDevice, resolution, fps) || !capture.isCompressedFormat()) {
+        std::cerr << "设备不支持以MJPEG输出 " << resolution.toString() << std::endl;
+        return 1;
+    }
+    if (!capture.start() || !capture.isUsingNativeStream()) {
+        std::cerr << "直通录制需要V4L2 mmap采集" << std::endl;
+        return 1;
+    }
+
+    Resolution actualResolution = capture.getCurrentResolution();
+    FrameRate framerate = capture.getCurrentFramerateFraction();
+
+    // 优先进程内封装，未编译libav时交给ffmpeg进程做流拷贝
+    std::shared_ptr<LibavRecorder> libavRecorder;
+    std::shared_ptr<FFmpegRecorder> ffmpegRecorder;
+    std::function<void(const FrameRef&)> sink;
+    std::string filePath;
+
+    if (LibavRecorder::isAvailable()) {
+        libavRecorder = std::make_shared<LibavRecorder>();
+        EncoderSettings settings;
+        settings.passthrough = true;
+        settings.segment = segment;
+        if (!libavRecorder->init(videoDir) || !libavRecorder->startRecording(actualResolution, framerate, settings)) {
+            std::cerr << "无法开始直通录制" << std::endl;
+            return 1;
+        }
+        sink = [libavRecorder](const FrameRef& frame) { libavRecorder->processFrame(frame); };
+    } else {
+        ffmpegRecorder = std::make_shared<FFmpegRecorder>();
+        ffmpegRecorder->setSegmentSettings(segment);
+        if (!ffmpegRecorder->init(videoDir) ||
+            !ffmpegRecorder->startPipeRecording(actualResolution, framerate, capture.getPixelFormat(), true)) {
+            std::cerr << "无法开始直通录制" << std::endl;
+            return 1;
+        }
+        sink = [ffmpegRecorder](const FrameRef& frame) { ffmpegRecorder->processFrame(frame); };
+    }
+
+    int subscription = capture.getNativeFrameBus().subscribe("直通录制", sink, QueuePolicy::DropOldest, 8);
+
+    // 录制指定时间
+    std::cout << "直通录制 " << recordTime << " 秒..." << std::endl;
+    for (int i = 0; i < recordTime; ++i) {
+        std::cout << "已录制 " << (i + 1) << "/" << recordTime << " 秒\r" << std::flush;
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+    }
+    std::cout << std::endl;
+
+    // 停止录制
+    std::cout << "停止录制..." << std::endl;
+    capture.getNativeFrameBus().unsubscribe(subscription);
+    capture.stop();
+    if (libavRecorder) {
+        libavRecorder->stopRecording();
+        filePath = libavRecorder->getCurrentFilePath();
+    } else {
+        ffmpegRecorder->stopRecording();
+        filePath = ffmpegRecorder->getCurrentFilePath();
+    }
+    cameraDevice.closeDevice();
+
+    std::cout << "录制完成，文件保存至: " << filePath << std::endl;
+    return 0;
+}
+
+// 原始录制：设备输出的YUYV、GREY等未压缩帧原样写入预分配的文件，不解码也不编码
+int recordRaw(CameraDevice& cameraDevice, const std::string& devicePath, const Resolution& resolution,
+              int fps, int recordTime, const std::string& fourcc, const std::string& videoDir) {
+    if (fourcc.size() != 4) {
+        std::cerr << "无效的像素格式: " << fourcc << std::endl;
+        return 1;
+    }
+    uint32_t pixelFormat = v4l2_fourcc(fourcc[0], fourcc[1], fourcc[2], fourcc[3]);
+
+    // 只允许协商出指定的格式
+    cameraDevice.setRequiredPixelFormat(pixelFormat);
+    if (!cameraDevice.openDevice(devicePath)) {
+        std::cerr << "无法打开设备: " << devicePath << std::endl;
+        return 1;
+    }
+
+    // 不需要预览，关闭解码；帧池加大到能容纳写入队列和进行中的写入
+    VideoCapture capture;
+    capture.setDecodeEnabled(false);
+    capture.setFramePoolSize(64);
+    if (!capture.init(cameraDevice, resolution, fps) || capture.getPixelFormat() != pixelFormat) {
+        std::cerr << "设备不支持以" << fourcc << "输出 " << resolution.toString() << std::endl;
+        return 1;
+    }
+    if (!capture.start() || !capture.isUsingNativeStream()) {
+        std::cerr << "原始录制需要V4L2 mmap采集" << std::endl;
+        return 1;
+    }
+
+    auto rawRecorder = std::make_shared<RawRecorder>();
+    if (!rawRecorder->init(videoDir) ||
+        !rawRecorder->startRecording(capture.getCurrentResolution(), capture.getCurrentFramerateFraction(), pixelFormat)) {
+        std::cerr << "无法开始原始录制" << std::endl;
+        return 1;
+    }
+
+    // 写入队列在录制器内部，订阅线程只做引用计数
+    int subscription = capture.getNativeFrameBus().subscribe(
+        "原始录制", [rawRecorder](const FrameRef& frame) { rawRecorder->processFrame(frame); },
+        QueuePolicy::DropOldest, 8);
+
+    // 录制指定时间
+    std::cout << "原始录制 " << recordTime << " 秒..." << std::endl;
+    for (int i = 0; i < recordTime; ++i) {
+        std::cout << "已录制 " << (i + 1) << "/" << recordTime << " 秒, "
+                  << Utils::formatFileSize(rawRecorder->getBytesWritten()) << "\r" << std::flush;
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+    }
+    std::cout << std::endl;
+
+    // 停止录制
+    std::cout << "停止录制..." << std::endl;
+    capture.getNativeFrameBus().unsubscribe(subscription);
+    capture.stop();
+    rawRecorder->stopRecording();
+    cameraDevice.closeDevice();
+
+    std::cout << "录制完成，文件保存至: " << rawRecorder->getCurrentFilePath() << std::endl;
+    return 0;
+}
+
+// 分帧基准：依次用1、2、4…maxWorkers个编码写入线程完整分帧一次，报告帧/秒；解码方式和解码线程数固定
+int extractBenchmark(const std::string& filePath, int maxWorkers, ExtractionDecodeMode mode, int decoders,
+                     const ExtractionSelection& selection, ExtractionOutput output, FrameArchiveCodec codec) {
+    std::vector<int> workerCounts;
+    for (int workers = 1; workers < maxWorkers; workers *= 2) {
+        workerCounts.push_back(workers);
+    }
+    workerCounts.push_back(maxWorkers);
+
+    std::cout << "分帧基准: " << filePath << std::endl;
+    std::cout << std::setw(8) << "线程数" << std::setw(10) << "帧数" << std::setw(10) << "秒"
+              << std::setw(12) << "帧/秒" << std::setw(10) << "加速比" << std::endl;
+
+    double baseline = 0.0;
+    for (int workers : workerCounts) {
+        FrameExtractor extractor;
+        extractor.setWorkerCount(workers);
+        extractor.setDecodeMode(mode);
+        extractor.setDecoderCount(decoders);
+        extractor.setSelection(selection);
+        extractor.setOutput(output, codec);
+        if (!extractor.startExtraction(filePath)) {
+            std::cerr << "无法开始帧提取" << std::endl;
+            return 1;
+        }
+        extractor.waitForCompletion();
+
+        ExtractionStats stats = extractor.getStats();
+        if (stats.framesWritten == 0) {
+            std::cerr << "没有提取到任何帧" << std::endl;
+            return 1;
+        }
+        if (baseline <= 0.0) {
+            baseline = stats.framesPerSecond;
+        }
+        std::cout << std::setw(8) << workers << std::setw(10) << stats.framesWritten
+                  << std::setw(10) << std::fixed << std::setprecision(2) << stats.elapsedSeconds
+                  << std::setw(12) << std::setprecision(1) << stats.framesPerSecond
+                  << std::setw(9) << std::setprecision(2) << stats.framesPerSecond / baseline << "x"
+                  << std::endl;
+    }
+    return 0;
+}
+
 int main(int argc, char** argv) {
     // 解析命令行参数
     std::vector<std::string> args = parseArgs(argc, argv);
@@ -148,6 +352,9 @@ int main(int argc, char** argv) {
             int fps = std::stoi(getArgValue(args, "--fps=", "30"));
             int recordTime = std::stoi(getArgValue(args, "--time=", "10"));
 
+            SegmentSettings segment;
+            segment.segmentSeconds = std::stoi(getArgValue(args, "--segment=", "0"));
+
             // 扫描设备
             std::vector<CameraDeviceInfo> devices = cameraDevice->scanDevices();
             if (devices.empty()) {
@@ -164,6 +371,14 @@ int main(int argc, char** argv) {
             std::string devicePath = devices[deviceIndex].devicePath;
             std::cout << "使用设备: " << devices[deviceIndex].deviceName << " (" << devicePath << ")" << std::endl;
 
+            if (hasArg(args, "--passthrough")) {
+                return recordPassthrough(*cameraDevice, devicePath, Resolution(width, height), fps, recordTime, segment, videoDir);
+            }
+            if (hasArg(args, "--raw") || !getArgValue(args, "--raw=").empty()) {
+                return recordRaw(*cameraDevice, devicePath, Resolution(width, height), fps, recordTime,
+                                 getArgValue(args, "--raw=", "YUYV"), videoDir);
+            }
+
             // 初始化FFmpeg录制器
             auto ffmpegRecorder = std::make_shared<FFmpegRecorder>();
 
@@ -171,11 +386,23 @@ int main(int argc, char** argv) {
                 std::cerr << "无法初始化FFmpeg录制器" << std::endl;
                 return 1;
             }
+            ffmpegRecorder->setSegmentSettings(segment);
 
             // 设置分辨率和帧率
             Resolution resolution(width, height);
             std::cout << "设置分辨率: " << resolution.toString() << ", 帧率: " << fps << std::endl;
 
+            // 根据设备能力协商采集格式
+            if (cameraDevice->openDevice(devicePath)) {
+                NegotiationPlan plan = cameraDevice->planFormat(resolution, fps);
+                if (plan.valid) {
+                    std::cout << "格式协商: " << plan.reason << std::endl;
+                    ffmpegRecorder->setInputPixelFormat(plan.pixelFormat);
+                    fps = plan.framerate.rounded();
+                }
+                cameraDevice->closeDevice();
+            }
+
             // 开始录制
             std::cout << "开始录制..." << std::endl;
             if (!ffmpegRecorder->startRecording(devicePath, resolution, fps, recordTime)) {
@@ -202,6 +429,17 @@ int main(int argc, char** argv) {
         // 提取帧
         if (hasArg(args, "extract")) {
             try {
+                // 解包帧归档
+                std::string archivePath = getArgValue(args, "--unpack=");
+                if (!archivePath.empty()) {
+                    bool ok = FrameExtractor::unpackArchive(archivePath, getArgValue(args, "--out="), [](float progress) {
+                        int percent = static_cast<int>(progress * 100);
+                        std::cout << "解包进度: " << percent << "%\r" << std::flush;
+                    });
+                    std::cout << std::endl << (ok ? "解包完成" : "解包失败") << std::endl;
+                    return ok ? 0 : 1;
+                }
+
                 std::string filePath = getArgValue(args, "--file=");
                 if (filePath.empty()) {
                     std::cerr << "请指定视频文件路径，例如: --file=/path/to/video.mp4" << std::endl;
@@ -214,8 +452,63 @@ int main(int argc, char** argv) {
                     return 1;
                 }
 
+                int workers = std::stoi(getArgValue(args, "--workers=", "0"));
+                int decoders = std::stoi(getArgValue(args, "--decoders=", "0"));
+                ExtractionDecodeMode mode = hasArg(args, "--gop")
+                    ? ExtractionDecodeMode::GopParallel : ExtractionDecodeMode::Serial;
+
+                // 取帧方式和时间范围
+                ExtractionSelection selection;
+                if (hasArg(args, "--keyframes")) {
+                    selection.sampling = ExtractionSampling::Keyframes;
+                } else if (!getArgValue(args, "--interval=").empty()) {
+                    selection.sampling = ExtractionSampling::Interval;
+                    selection.intervalSeconds = std::stod(getArgValue(args, "--interval="));
+                } else if (!getArgValue(args, "--every=").empty()) {
+                    selection.sampling = ExtractionSampling::Stride;
+                    selection.stride = std::stoi(getArgValue(args, "--every="));
+                }
+                selection.startSeconds = std::stod(getArgValue(args, "--start=", "0"));
+                selection.endSeconds = std::stod(getArgValue(args, "--end=", "-1"));
+                if (selection.stride <= 0 || selection.intervalSeconds <= 0.0 ||
+                    (selection.endSeconds >= 0.0 && selection.endSeconds < selection.startSeconds)) {
+                    std::cerr << "取帧参数无效" << std::endl;
+                    return 1;
+                }
+
+                // 输出方式
+                ExtractionOutput output = ExtractionOutput::Directory;
+                FrameArchiveCodec codec = FrameArchiveCodec::Jpeg;
+                std::string codecName = getArgValue(args, "--archive=");
+                if (hasArg(args, "--archive") || !codecName.empty()) {
+                    output = ExtractionOutput::Archive;
+                    if (codecName == "lz4") {
+                        codec = FrameArchiveCodec::Lz4;
+                    } else if (codecName == "raw") {
+                        codec = FrameArchiveCodec::Raw;
+                    } else if (!codecName.empty() && codecName != "jpeg") {
+                        std::cerr << "不支持的归档编码: " << codecName << std::endl;
+                        return 1;
+                    }
+                    if (!FrameArchiveWriter::isCodecAvailable(codec)) {
+                        std::cerr << "未启用liblz4，无法使用LZ4编码" << std::endl;
+                        return 1;
+                    }
+                }
+
+                if (hasArg(args, "--bench")) {
+                    int maxWorkers = workers > 0
+                        ? workers : std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+                    return extractBenchmark(filePath, maxWorkers, mode, decoders, selection, output, codec);
+                }
+
                 // 初始化帧提取器
                 auto frameExtractor = std::make_shared<FrameExtractor>();
+                frameExtractor->setWorkerCount(workers);
+                frameExtractor->setDecodeMode(mode);
+                frameExtractor->setDecoderCount(decoders);
+                frameExtractor->setSelection(selection);
+                frameExtractor->setOutput(output, codec);
 
                 // 设置进度回调
                 frameExtractor->setProgressCallback([](float progress) {
@@ -235,14 +528,30 @@ int main(int argc, char** argv) {
                     return 1;
                 }
 
-                // 不需要等待，因为startExtraction现在是同步的
+                // 分帧在后台线程中进行，等待结束
+                frameExtractor->waitForCompletion();
+
+                ExtractionStats stats = frameExtractor->getStats();
+                std::cout << "共 " << stats.framesWritten << " 帧，" << stats.decoders
+                          << (stats.gopParallel ? " 个GOP解码线程，" : " 个解码线程，")
+                          << stats.workers << " 个编码线程，用时 "
+                          << std::fixed << std::setprecision(2) << stats.elapsedSeconds << " 秒，"
+                          << std::setprecision(1) << stats.framesPerSecond << " 帧/秒" << std::endl;
+                // 有帧保存失败或一帧都没有写出（如没有libav时只取关键帧）时返回非零，脚本可以据此判断
+                bool failed = stats.framesFailed > 0 || stats.framesWritten == 0;
+                if (stats.framesFailed > 0) {
+                    std::cerr << stats.framesFailed << " 帧保存失败" << std::endl;
+                }
+                if (stats.framesWritten == 0) {
+                    std::cerr << "没有写出任何帧" << std::endl;
+                }
 
                 // 清理资源
                 std::cout << "清理资源..." << std::endl;
                 frameExtractor = nullptr;
-                std::cout << "帧提取完成" << std::endl;
+                std::cout << (failed ? "帧提取失败" : "帧提取完成") << std::endl;
 
-                return 0;
+                return failed ? 1 : 0;
             } catch (const std::exception& e) {
                 std::cerr << "帧提取过程中发生异常: " << e.what() << std::endl;
                 return 1;
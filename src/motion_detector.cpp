@@ -0,0 +1,318 @@
+#include "motion_detector.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define MOTION_DETECTOR_X86 1
+#include <immintrin.h>
+#endif
+
+#if defined(__aarch64__) || defined(__ARM_NEON)
+#define MOTION_DETECTOR_NEON 1
+#include <arm_neon.h>
+#endif
+
+using ColorConvert::Isa;
+
+namespace {
+
+// 行函数：把一行中每个块的变化像素数累加到counts，每块kBlockSize（16）个像素
+typedef void (*RowFunc)(const uint8_t* previous, const uint8_t* current, int blocks, uint8_t threshold, uint16_t* counts);
+
+// 标量实现，也是向量化实现的正确性基准
+void countRowScalar(const uint8_t* previous, const uint8_t* current, int blocks, uint8_t threshold, uint16_t* counts) {
+    for (int block = 0; block < blocks; block++) {
+        int changed = 0;
+        for (int i = 0; i < 16; i++) {
+            int diff = std::abs(previous[block * 16 + i] - current[block * 16 + i]);
+            changed += diff > threshold ? 1 : 0;
+        }
+        counts[block] += static_cast<uint16_t>(changed);
+    }
+}
+
+#ifdef MOTION_DETECTOR_X86
+
+#define TARGET_SSE41 __attribute__((target("sse4.1")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+
+// 16个像素的变化掩码：|a-b| > threshold的字节为0xFF
+TARGET_SSE41 inline __m128i changedMask16(__m128i a, __m128i b, __m128i threshold) {
+    // 无符号饱和减法两个方向取或得到绝对差，再减阈值，非零即超过阈值
+    __m128i diff = _mm_or_si128(_mm_subs_epu8(a, b), _mm_subs_epu8(b, a));
+    __m128i over = _mm_subs_epu8(diff, threshold);
+    return _mm_xor_si128(_mm_cmpeq_epi8(over, _mm_setzero_si128()), _mm_set1_epi8(-1));
+}
+
+TARGET_SSE41 void countRowSse41(const uint8_t* previous, const uint8_t* current, int blocks, uint8_t threshold, uint16_t* counts) {
+    const __m128i t = _mm_set1_epi8(static_cast<char>(threshold));
+    for (int block = 0; block < blocks; block++) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(previous + block * 16));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(current + block * 16));
+        int mask = _mm_movemask_epi8(changedMask16(a, b, t));
+        counts[block] += static_cast<uint16_t>(__builtin_popcount(static_cast<unsigned>(mask)));
+    }
+}
+
+TARGET_AVX2 void countRowAvx2(const uint8_t* previous, const uint8_t* current, int blocks, uint8_t threshold, uint16_t* counts) {
+    const __m256i t = _mm256_set1_epi8(static_cast<char>(threshold));
+    const __m256i ones = _mm256_set1_epi8(-1);
+
+    // 每次处理两个块，掩码低16位属于第一个块，高16位属于第二个块
+    int block = 0;
+    for (; block + 2 <= blocks; block += 2) {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(previous + block * 16));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(current + block * 16));
+        __m256i diff = _mm256_or_si256(_mm256_subs_epu8(a, b), _mm256_subs_epu8(b, a));
+        __m256i over = _mm256_subs_epu8(diff, t);
+        __m256i changed = _mm256_xor_si256(_mm256_cmpeq_epi8(over, _mm256_setzero_si256()), ones);
+        unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(changed));
+        counts[block] += static_cast<uint16_t>(__builtin_popcount(mask & 0xFFFF));
+        counts[block + 1] += static_cast<uint16_t>(__builtin_popcount(mask >> 16));
+    }
+
+    // 剩余的一个块
+    if (block < blocks) {
+        countRowSse41(previous + block * 16, current + block * 16, blocks - block, threshold, counts + block);
+    }
+}
+
+#endif  // MOTION_DETECTOR_X86
+
+#ifdef MOTION_DETECTOR_NEON
+
+void countRowNeon(const uint8_t* previous, const uint8_t* current, int blocks, uint8_t threshold, uint16_t* counts) {
+    const uint8x16_t t = vdupq_n_u8(threshold);
+    for (int block = 0; block < blocks; block++) {
+        uint8x16_t a = vld1q_u8(previous + block * 16);
+        uint8x16_t b = vld1q_u8(current + block * 16);
+        // 超过阈值的字节为0xFF，右移7位得到1，再两两相加求和
+        uint8x16_t changed = vshrq_n_u8(vcgtq_u8(vabdq_u8(a, b), t), 7);
+        uint64x2_t sum = vpaddlq_u32(vpaddlq_u16(vpaddlq_u8(changed)));
+        counts[block] += static_cast<uint16_t>(vgetq_lane_u64(sum, 0) + vgetq_lane_u64(sum, 1));
+    }
+}
+
+#endif  // MOTION_DETECTOR_NEON
+
+RowFunc selectRowFunc(Isa isa) {
+    switch (isa) {
+#ifdef MOTION_DETECTOR_X86
+        case Isa::SSE41:
+            return countRowSse41;
+        case Isa::AVX2:
+            return countRowAvx2;
+#endif
+#ifdef MOTION_DETECTOR_NEON
+        case Isa::NEON:
+            return countRowNeon;
+#endif
+        default:
+            return countRowScalar;
+    }
+}
+
+int64_t nowUs() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+}  // namespace
+
+MotionDetector::MotionDetector()
+    : m_isa(ColorConvert::getActiveIsa()),
+      m_current(0),
+      m_planeWidth(0),
+      m_planeHeight(0),
+      m_sourceWidth(0),
+      m_sourceHeight(0),
+      m_hasReference(false),
+      m_active(false),
+      m_motionFrames(0),
+      m_lastMotionUs(0) {
+}
+
+void MotionDetector::setSettings(const MotionSettings& settings) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_settings = settings;
+    m_settings.decimation = std::max(1, m_settings.decimation);
+    m_settings.pixelThreshold = std::max(0, std::min(m_settings.pixelThreshold, 254));
+    m_settings.startFrames = std::max(1, m_settings.startFrames);
+
+    // 降采样倍数可能变化，重新分配平面
+    m_sourceWidth = 0;
+    m_sourceHeight = 0;
+    m_hasReference = false;
+    m_motionFrames = 0;
+}
+
+MotionSettings MotionDetector::getSettings() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_settings;
+}
+
+void MotionDetector::setStateCallback(std::function<void(bool active)> callback) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_callback = callback;
+}
+
+bool MotionDetector::setIsa(Isa isa) {
+    if (!ColorConvert::isIsaSupported(isa)) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_isa = isa;
+    return true;
+}
+
+void MotionDetector::reset() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_hasReference = false;
+    m_motionFrames = 0;
+    m_active = false;
+    m_lastResult = MotionResult();
+}
+
+MotionResult MotionDetector::getLastResult() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_lastResult;
+}
+
+MotionResult MotionDetector::process(const FrameRef& frame) {
+    if (frame.empty() || frame.info().type != CV_8UC3 || frame.info().pixelFormat != 0) {
+        return getLastResult();  // 只处理BGR帧
+    }
+    return process(frame.mat(), frame.info().timestampUs);
+}
+
+MotionResult MotionDetector::process(const cv::Mat& bgr, int64_t timestampUs) {
+    auto start = std::chrono::steady_clock::now();
+    if (timestampUs <= 0) {
+        timestampUs = nowUs();
+    }
+
+    MotionResult result;
+    bool changed = false;
+    bool active = false;
+    std::function<void(bool)> callback;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (bgr.empty() || bgr.type() != CV_8UC3) {
+            return m_lastResult;
+        }
+
+        // 分辨率变化时重新分配平面，超出图像的列保持为0，两帧相同不会计为变化
+        int decimation = m_settings.decimation;
+        if (bgr.cols != m_sourceWidth || bgr.rows != m_sourceHeight) {
+            m_sourceWidth = bgr.cols;
+            m_sourceHeight = bgr.rows;
+            int width = std::max(1, bgr.cols / decimation);
+            m_planeWidth = (width + kBlockSize - 1) / kBlockSize * kBlockSize;
+            m_planeHeight = std::max(1, bgr.rows / decimation);
+            for (auto& plane : m_planes) {
+                plane.assign(static_cast<size_t>(m_planeWidth) * m_planeHeight, 0);
+            }
+            m_hasReference = false;
+        }
+
+        decimateLuma(bgr, decimation, m_planes[m_current].data(), m_planeWidth);
+
+        int blocksX = m_planeWidth / kBlockSize;
+        int blocksY = (m_planeHeight + kBlockSize - 1) / kBlockSize;
+        result.totalBlocks = blocksX * blocksY;
+
+        if (m_hasReference) {
+            result.changedBlocks = countChangedBlocks(m_planes[1 - m_current].data(), m_planes[m_current].data(),
+                                                      m_planeWidth, m_planeWidth, m_planeHeight,
+                                                      m_settings.pixelThreshold, m_settings.blockChangedPixels, m_isa);
+            result.motion = result.changedBlocks >= m_settings.minChangedBlocks &&
+                            result.changedBlocks <= m_settings.maxChangedRatio * result.totalBlocks;
+        }
+        m_hasReference = true;
+        m_current = 1 - m_current;
+
+        // 迟滞：连续几帧有运动才进入，持续无运动一段时间才退出
+        if (result.motion) {
+            m_motionFrames++;
+            m_lastMotionUs = timestampUs;
+        } else {
+            m_motionFrames = 0;
+        }
+
+        if (!m_active && m_motionFrames >= m_settings.startFrames) {
+            m_active = true;
+            changed = true;
+        } else if (m_active && !result.motion &&
+                   timestampUs - m_lastMotionUs >= static_cast<int64_t>(m_settings.stopSeconds * 1e6)) {
+            m_active = false;
+            changed = true;
+        }
+
+        active = m_active;
+        result.active = active;
+        result.processMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        m_lastResult = result;
+        callback = m_callback;
+    }
+
+    if (changed && callback) {
+        callback(active);
+    }
+
+    return result;
+}
+
+void MotionDetector::decimateLuma(const cv::Mat& bgr, int decimation, uint8_t* plane, int stride) {
+    int width = bgr.cols / decimation;
+    int height = bgr.rows / decimation;
+    int offset = decimation / 2;
+
+    // 每个块取中心一个像素，BT.601亮度系数（8位定点）
+    for (int y = 0; y < height; y++) {
+        const uint8_t* src = bgr.ptr<uint8_t>(y * decimation + offset) + offset * 3;
+        uint8_t* dst = plane + static_cast<size_t>(y) * stride;
+        int step = decimation * 3;
+        for (int x = 0; x < width; x++) {
+            const uint8_t* p = src + x * step;
+            dst[x] = static_cast<uint8_t>((29 * p[0] + 150 * p[1] + 77 * p[2] + 128) >> 8);
+        }
+    }
+}
+
+int MotionDetector::countChangedBlocks(const uint8_t* previous, const uint8_t* current, int stride,
+                                       int width, int height, int pixelThreshold, int blockChangedPixels,
+                                       Isa isa) {
+    RowFunc rowFunc = selectRowFunc(isa);
+    uint8_t threshold = static_cast<uint8_t>(std::max(0, std::min(pixelThreshold, 254)));
+    int blocksX = width / kBlockSize;
+
+    // 一行块的计数，块最多16x16个像素，uint16_t不会溢出
+    uint16_t stackCounts[256];
+    std::vector<uint16_t> heapCounts;
+    uint16_t* counts = stackCounts;
+    if (blocksX > 256) {
+        heapCounts.resize(blocksX);
+        counts = heapCounts.data();
+    }
+
+    int changedBlocks = 0;
+    for (int blockY = 0; blockY * kBlockSize < height; blockY++) {
+        memset(counts, 0, sizeof(uint16_t) * blocksX);
+
+        int rowEnd = std::min(height, (blockY + 1) * kBlockSize);
+        for (int y = blockY * kBlockSize; y < rowEnd; y++) {
+            size_t rowOffset = static_cast<size_t>(y) * stride;
+            rowFunc(previous + rowOffset, current + rowOffset, blocksX, threshold, counts);
+        }
+
+        for (int blockX = 0; blockX < blocksX; blockX++) {
+            if (counts[blockX] > blockChangedPixels) {
+                changedBlocks++;
+            }
+        }
+    }
+
+    return changedBlocks;
+}
@@ -0,0 +1,540 @@
+#include "output_sink.h"
+#include <iostream>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <cstdlib>
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+    // 完成事件的userData：高32位为类型，低32位为缓冲区或文件下标
+    const uint64_t kWriteTag = 0;
+    const uint64_t kSyncTag = 1;
+
+    inline uint64_t makeUserData(uint64_t tag, int index) {
+        return (tag << 32) | static_cast<uint32_t>(index);
+    }
+
+    double elapsedMs(std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // 写满整个范围，被信号中断或部分写入时继续
+    bool pwriteAll(int fd, const uint8_t* data, size_t size, int64_t offset) {
+        while (size > 0) {
+            ssize_t ret = pwrite(fd, data, size, static_cast<off_t>(offset));
+            if (ret < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return false;
+            }
+            data += ret;
+            size -= static_cast<size_t>(ret);
+            offset += ret;
+        }
+        return true;
+    }
+}
+
+OutputSink::OutputSink()
+    : m_memory(nullptr),
+      m_current(-1),
+      m_file(-1),
+      m_position(0),
+      m_fileSize(0),
+      m_useRing(false),
+      m_fixedBuffers(false),
+      m_reaping(false),
+      m_stopping(false) {
+}
+
+OutputSink::~OutputSink() {
+    if (m_file >= 0) {
+        close();
+    }
+    drain();
+
+    if (m_thread.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopping = true;
+        }
+        m_taskCondition.notify_all();
+        m_thread.join();
+    }
+    m_ring.close();
+    free(m_memory);
+}
+
+bool OutputSink::init(const OutputSinkSettings& settings) {
+    if (m_memory) {
+        return true;  // 已经初始化
+    }
+
+    m_settings = settings;
+    m_settings.bufferSize = std::max<size_t>(4096, (settings.bufferSize + 4095) & ~static_cast<size_t>(4095));
+    m_settings.bufferCount = std::max<size_t>(2, settings.bufferCount);
+
+    // 所有缓冲区在一块页对齐的内存中，注册为固定缓冲区时内核只需映射一次
+    void* memory = nullptr;
+    if (posix_memalign(&memory, 4096, m_settings.bufferSize * m_settings.bufferCount) != 0) {
+        std::cerr << "无法分配输出缓冲区" << std::endl;
+        return false;
+    }
+    m_memory = static_cast<uint8_t*>(memory);
+    m_buffers.resize(m_settings.bufferCount);
+    for (size_t i = 0; i < m_buffers.size(); i++) {
+        m_buffers[i].data = m_memory + i * m_settings.bufferSize;
+    }
+
+    // 每个缓冲区最多一个写入，另为各文件的同步留出同样多的位置
+    m_useRing = m_settings.ioUring && m_ring.init(static_cast<unsigned>(m_settings.bufferCount * 2));
+    if (m_useRing) {
+        std::vector<iovec> iovecs(m_buffers.size());
+        for (size_t i = 0; i < m_buffers.size(); i++) {
+            iovecs[i].iov_base = m_buffers[i].data;
+            iovecs[i].iov_len = m_settings.bufferSize;
+        }
+        // 注册受RLIMIT_MEMLOCK限制，失败时使用普通写入
+        m_fixedBuffers = m_ring.registerBuffers(iovecs.data(), static_cast<unsigned>(iovecs.size()));
+    } else {
+        m_thread = std::thread(&OutputSink::threadFunc, this);
+    }
+
+    m_lastSync = std::chrono::steady_clock::now();
+    return true;
+}
+
+bool OutputSink::open(const std::string& path) {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (!m_memory || m_file >= 0) {
+        return false;
+    }
+
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        std::cerr << "无法创建输出文件: " << path << " (" << strerror(errno) << ")" << std::endl;
+        return false;
+    }
+
+    // 复用已完全关闭的文件位置
+    int index = -1;
+    for (size_t i = 0; i < m_files.size(); i++) {
+        if (m_files[i].fd < 0) {
+            index = static_cast<int>(i);
+            break;
+        }
+    }
+    if (index < 0) {
+        m_files.push_back(File());
+        index = static_cast<int>(m_files.size()) - 1;
+    }
+
+    m_files[index] = File();
+    m_files[index].path = path;
+    m_files[index].fd = fd;
+    m_file = index;
+    m_position = 0;
+    m_fileSize = 0;
+    m_lastSync = std::chrono::steady_clock::now();
+    return true;
+}
+
+bool OutputSink::write(const uint8_t* data, size_t size) {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (m_file < 0 || m_files[m_file].failed) {
+        return false;
+    }
+
+    while (size > 0) {
+        if (m_current < 0) {
+            m_current = acquireBuffer(lock);
+            if (m_current < 0) {
+                return false;
+            }
+            Buffer& buffer = m_buffers[m_current];
+            buffer.used = 0;
+            buffer.offset = m_position;
+            buffer.file = m_file;
+        }
+
+        // 封装器的小块写入合并到缓冲区中，写满才提交
+        Buffer& buffer = m_buffers[m_current];
+        size_t chunk = std::min(size, m_settings.bufferSize - buffer.used);
+        memcpy(buffer.data + buffer.used, data, chunk);
+        buffer.used += chunk;
+        m_position += static_cast<int64_t>(chunk);
+        data += chunk;
+        size -= chunk;
+
+        if (buffer.used == m_settings.bufferSize) {
+            submitCurrent();
+        }
+    }
+
+    m_fileSize = std::max(m_fileSize, m_position);
+    return true;
+}
+
+int64_t OutputSink::seek(int64_t offset, int whence) {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (m_file < 0) {
+        return -1;
+    }
+
+    int64_t target;
+    switch (whence) {
+        case SEEK_SET:
+            target = offset;
+            break;
+        case SEEK_CUR:
+            target = m_position + offset;
+            break;
+        case SEEK_END:
+            target = m_fileSize + offset;
+            break;
+        default:
+            return -1;
+    }
+    if (target < 0) {
+        return -1;
+    }
+
+    // 缓冲区对应文件中连续的一段，位置改变前先提交
+    if (target != m_position && m_current >= 0) {
+        submitCurrent();
+    }
+    m_position = target;
+    return m_position;
+}
+
+void OutputSink::flush() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (m_current >= 0) {
+        submitCurrent();
+    }
+}
+
+bool OutputSink::close() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (m_file < 0) {
+        return false;
+    }
+
+    if (m_current >= 0) {
+        submitCurrent();
+    }
+
+    // 最终同步和关闭在剩余的写入完成后进行，调用者不等待
+    int file = m_file;
+    m_file = -1;
+    m_position = 0;
+    m_fileSize = 0;
+    m_files[file].closing = true;
+    bool ok = !m_files[file].failed;
+    checkClosing(file);
+    if (m_useRing) {
+        reap(false);
+    }
+    return ok;
+}
+
+void OutputSink::drain() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (m_current >= 0) {
+        submitCurrent();
+    }
+    while (hasActivity()) {
+        if (!waitForCompletion(lock)) {
+            break;
+        }
+    }
+}
+
+OutputSinkStats OutputSink::getStats() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stats;
+}
+
+void OutputSink::resetStats() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    size_t depth = m_stats.queueDepth;
+    m_stats = OutputSinkStats();
+    m_stats.queueDepth = depth;
+    m_stats.maxQueueDepth = depth;
+}
+
+int OutputSink::acquireBuffer(std::unique_lock<std::mutex>& lock) {
+    std::chrono::steady_clock::time_point start;
+    bool stalled = false;
+    for (;;) {
+        for (size_t i = 0; i < m_buffers.size(); i++) {
+            if (!m_buffers[i].busy) {
+                if (stalled) {
+                    m_stats.stallMs += elapsedMs(start);
+                }
+                return static_cast<int>(i);
+            }
+        }
+
+        // 全部缓冲区都在写入中：存储跟不上，只能等待
+        if (!stalled) {
+            stalled = true;
+            start = std::chrono::steady_clock::now();
+            m_stats.stalls++;
+        }
+        if (!waitForCompletion(lock)) {
+            return -1;
+        }
+    }
+}
+
+bool OutputSink::waitForCompletion(std::unique_lock<std::mutex>& lock) {
+    if (m_useRing) {
+        return reap(true);
+    }
+    m_doneCondition.wait(lock);
+    return true;
+}
+
+void OutputSink::submitCurrent() {
+    int index = m_current;
+    m_current = -1;
+    if (m_buffers[index].used == 0) {
+        return;
+    }
+    submitWrite(index);
+
+    // 定期在后台同步，避免关闭时一次落盘大量数据
+    if (m_settings.syncIntervalSeconds > 0 && m_file >= 0 && !m_files[m_file].syncing) {
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - m_lastSync).count();
+        if (seconds >= m_settings.syncIntervalSeconds) {
+            submitSync(m_file);
+        }
+    }
+
+    if (m_useRing) {
+        reap(false);
+    }
+}
+
+void OutputSink::submitWrite(int index) {
+    Buffer& buffer = m_buffers[index];
+
+    // io_uring的请求之间没有顺序，覆盖仍在写入的范围时先等它完成
+    while (m_useRing && overlapsBusy(buffer.file, buffer.offset, buffer.used)) {
+        if (!reap(true)) {
+            break;
+        }
+    }
+
+    File& file = m_files[buffer.file];
+    buffer.busy = true;
+    buffer.start = std::chrono::steady_clock::now();
+    file.pending++;
+    m_stats.queueDepth++;
+    m_stats.maxQueueDepth = std::max(m_stats.maxQueueDepth, m_stats.queueDepth);
+
+    if (!m_useRing) {
+        // 写入线程按提交顺序执行，回写文件头不会与之前的写入乱序
+        m_tasks.push_back(Task{Command::Write, index});
+        m_taskCondition.notify_one();
+        return;
+    }
+
+    uint64_t userData = makeUserData(kWriteTag, index);
+    bool queued;
+    for (;;) {
+        queued = m_fixedBuffers
+            ? m_ring.queueWriteFixed(file.fd, buffer.data, static_cast<unsigned>(buffer.used),
+                                     static_cast<uint64_t>(buffer.offset), static_cast<unsigned>(index), userData)
+            : m_ring.queueWrite(file.fd, buffer.data, static_cast<unsigned>(buffer.used),
+                                static_cast<uint64_t>(buffer.offset), userData);
+        if (queued || !makeRoom()) {
+            break;
+        }
+    }
+    if (!queued) {
+        completeWrite(index, false);
+        return;
+    }
+    // 内核暂时没有接受时留在队列中，等待完成时再提交
+    m_ring.submit();
+}
+
+void OutputSink::submitSync(int file) {
+    File& entry = m_files[file];
+    entry.syncing = true;
+    entry.finalSync = entry.closing;
+    entry.syncStart = std::chrono::steady_clock::now();
+    m_lastSync = entry.syncStart;
+
+    if (!m_useRing) {
+        m_tasks.push_back(Task{Command::Sync, file});
+        m_taskCondition.notify_one();
+        return;
+    }
+
+    // 不加IOSQE_IO_DRAIN：同步只覆盖已完成的写入，但不会让之后的写入排队等待落盘
+    bool queued;
+    for (;;) {
+        queued = m_ring.queueDataSync(m_files[file].fd, makeUserData(kSyncTag, file));
+        if (queued || !makeRoom()) {
+            break;
+        }
+    }
+    if (!queued) {
+        completeSync(file, false);
+        return;
+    }
+    m_ring.submit();
+}
+
+void OutputSink::completeWrite(int index, bool ok) {
+    Buffer& buffer = m_buffers[index];
+    File& file = m_files[buffer.file];
+    double ms = elapsedMs(buffer.start);
+
+    if (ok) {
+        m_stats.bytesWritten += buffer.used;
+        m_stats.writes++;
+        m_stats.lastWriteMs = ms;
+        m_stats.maxWriteMs = std::max(m_stats.maxWriteMs, ms);
+    } else {
+        if (!file.failed) {
+            std::cerr << "写入输出文件失败: " << file.path << std::endl;
+        }
+        file.failed = true;
+        m_stats.errors++;
+    }
+
+    m_stats.queueDepth--;
+    file.pending--;
+    buffer.busy = false;
+    int fileIndex = buffer.file;
+    buffer.file = -1;
+    checkClosing(fileIndex);
+}
+
+void OutputSink::completeSync(int file, bool ok) {
+    File& entry = m_files[file];
+    entry.syncing = false;
+
+    if (ok) {
+        m_stats.syncs++;
+        m_stats.maxSyncMs = std::max(m_stats.maxSyncMs, elapsedMs(entry.syncStart));
+    } else {
+        std::cerr << "同步输出文件失败: " << entry.path << std::endl;
+        entry.failed = true;
+        m_stats.errors++;
+    }
+
+    if (entry.finalSync) {
+        ::close(entry.fd);
+        entry = File();
+        return;
+    }
+    checkClosing(file);
+}
+
+void OutputSink::checkClosing(int file) {
+    File& entry = m_files[file];
+    if (entry.closing && entry.fd >= 0 && entry.pending == 0 && !entry.syncing) {
+        submitSync(file);
+    }
+}
+
+bool OutputSink::makeRoom() {
+    // 提交队列只保存内核尚未接受的请求，提交后就有空位
+    if (m_ring.submit() > 0) {
+        return true;
+    }
+    // 在完成事件的回调中（如写入完成后提交最终同步）不能再次收取
+    if (m_reaping) {
+        return false;
+    }
+    return reap(true);
+}
+
+bool OutputSink::reap(bool wait) {
+    if (m_reaping) {
+        return true;
+    }
+    m_reaping = true;
+    int count = m_ring.reap(wait, [this](uint64_t userData, int result) {
+        int index = static_cast<int>(userData & 0xffffffffu);
+        if ((userData >> 32) == kSyncTag) {
+            completeSync(index, result == 0);
+        } else {
+            completeWrite(index, result >= 0 && static_cast<size_t>(result) == m_buffers[index].used);
+        }
+    });
+    m_reaping = false;
+    if (count < 0) {
+        std::cerr << "io_uring等待失败: " << strerror(errno) << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool OutputSink::hasActivity() const {
+    for (const Buffer& buffer : m_buffers) {
+        if (buffer.busy) {
+            return true;
+        }
+    }
+    for (const File& file : m_files) {
+        if (file.syncing || (file.closing && file.fd >= 0)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool OutputSink::overlapsBusy(int file, int64_t offset, size_t size) const {
+    for (const Buffer& buffer : m_buffers) {
+        if (buffer.busy && buffer.file == file && buffer.offset < offset + static_cast<int64_t>(size) &&
+            offset < buffer.offset + static_cast<int64_t>(buffer.used)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void OutputSink::threadFunc() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    for (;;) {
+        m_taskCondition.wait(lock, [this]() { return m_stopping || !m_tasks.empty(); });
+        if (m_tasks.empty()) {
+            break;  // 已停止且没有剩余任务
+        }
+
+        Task task = m_tasks.front();
+        m_tasks.pop_front();
+
+        // 系统调用期间不持有锁，调用者可以继续填写其他缓冲区
+        if (task.command == Command::Write) {
+            const Buffer& buffer = m_buffers[task.index];
+            int fd = m_files[buffer.file].fd;
+            const uint8_t* data = buffer.data;
+            size_t size = buffer.used;
+            int64_t offset = buffer.offset;
+
+            lock.unlock();
+            bool ok = pwriteAll(fd, data, size, offset);
+            lock.lock();
+            completeWrite(task.index, ok);
+        } else {
+            int fd = m_files[task.index].fd;
+
+            lock.unlock();
+            bool ok = fdatasync(fd) == 0;
+            lock.lock();
+            completeSync(task.index, ok);
+        }
+        m_doneCondition.notify_all();
+    }
+}
@@ -0,0 +1,137 @@
+#include "packet_ring_buffer.h"
+#include <cstring>
+
+PacketRingBuffer::PacketRingBuffer(size_t capacityBytes, int64_t window)
+    : m_storage(capacityBytes),
+      m_firstSequence(0),
+      m_head(0),
+      m_bytesUsed(0),
+      m_window(window) {
+}
+
+bool PacketRingBuffer::push(const uint8_t* data, size_t size, int64_t pts, int64_t dts, int64_t duration, bool keyframe) {
+    if (size == 0 || size > m_storage.size()) {
+        // 单个数据包超过容量时已保存的GOP也不再连续，全部丢弃
+        if (size > 0) {
+            clear();
+        }
+        return false;
+    }
+
+    // 每组数据包必须从关键帧开始
+    if (!keyframe && m_keyframes.empty()) {
+        return false;
+    }
+
+    size_t offset = 0;
+    while (!reserve(size, offset)) {
+        dropOldestGop();
+        if (!keyframe && m_keyframes.empty()) {
+            return false;  // 当前GOP已被淘汰，之后的非关键帧无法解码
+        }
+    }
+
+    memcpy(m_storage.data() + offset, data, size);
+    m_head = offset + size;
+    m_bytesUsed += size;
+
+    Entry entry;
+    entry.offset = offset;
+    entry.packet.size = size;
+    entry.packet.pts = pts;
+    entry.packet.dts = dts;
+    entry.packet.duration = duration;
+    entry.packet.keyframe = keyframe;
+    if (keyframe) {
+        m_keyframes.push_back(m_firstSequence + m_packets.size());
+    }
+    m_packets.push_back(entry);
+
+    // 按时长淘汰：保留在window之前最近的关键帧，从它开始播放至少有window的内容
+    while (m_window > 0 && m_keyframes.size() >= 2) {
+        const Entry& second = m_packets[m_keyframes[1] - m_firstSequence];
+        if (dts - second.packet.dts < m_window) {
+            break;
+        }
+        dropOldestGop();
+    }
+
+    return true;
+}
+
+size_t PacketRingBuffer::forEach(const std::function<bool(const RingPacket&)>& visit) const {
+    size_t count = 0;
+    for (const Entry& entry : m_packets) {
+        RingPacket packet = entry.packet;
+        packet.data = m_storage.data() + entry.offset;
+        count++;
+        if (!visit(packet)) {
+            break;
+        }
+    }
+    return count;
+}
+
+void PacketRingBuffer::clear() {
+    m_firstSequence += m_packets.size();
+    m_packets.clear();
+    m_keyframes.clear();
+    m_head = 0;
+    m_bytesUsed = 0;
+}
+
+int64_t PacketRingBuffer::duration() const {
+    if (m_packets.empty()) {
+        return 0;
+    }
+    return m_packets.back().packet.dts - m_packets.front().packet.dts;
+}
+
+void PacketRingBuffer::dropOldestGop() {
+    if (m_packets.empty()) {
+        return;
+    }
+
+    // 去掉第一个关键帧，再去掉到下一个关键帧之前的所有数据包
+    if (!m_keyframes.empty() && m_keyframes.front() == m_firstSequence) {
+        m_keyframes.pop_front();
+    }
+    uint64_t end = m_keyframes.empty() ? m_firstSequence + m_packets.size() : m_keyframes.front();
+    while (m_firstSequence < end) {
+        m_bytesUsed -= m_packets.front().packet.size;
+        m_packets.pop_front();
+        m_firstSequence++;
+    }
+
+    if (m_packets.empty()) {
+        m_head = 0;
+    }
+}
+
+bool PacketRingBuffer::reserve(size_t size, size_t& offset) {
+    if (m_packets.empty()) {
+        offset = 0;
+        return size <= m_storage.size();
+    }
+
+    size_t tail = m_packets.front().offset;
+    if (m_head > tail) {
+        // 未回绕：先用末尾的空间，不够时回绕到开头（末尾剩余的空间跳过）
+        if (size <= m_storage.size() - m_head) {
+            offset = m_head;
+            return true;
+        }
+        if (size <= tail) {
+            offset = 0;
+            return true;
+        }
+        return false;
+    }
+
+    // 已回绕：可用空间在写入位置和最旧数据包之间
+    if (size <= tail - m_head) {
+        offset = m_head;
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,289 @@
+#include "quality_controller.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+
+namespace {
+    // x264预设从快到慢
+    const char* const kPresets[] = {"ultrafast", "superfast", "veryfast", "faster", "fast", "medium"};
+    const int kPresetCount = sizeof(kPresets) / sizeof(kPresets[0]);
+
+    // 比基础预设最多慢几档
+    const int kMaxSlowerPresets = 2;
+
+    // 最低预设下依次使用的分辨率缩放（码率按比例降低）
+    const double kScales[] = {0.75, 0.5};
+
+    // 基础预设下依次降低的码率比例，或crf模式下依次增加的crf（只改码率，编码器不中断）
+    const double kBitrateSteps[] = {0.8, 0.6};
+    const int kCrfSteps[] = {2, 4};
+    const int kBitrateStepCount = sizeof(kBitrateSteps) / sizeof(kBitrateSteps[0]);
+
+    // 低于该比例视为空闲：单个核心占满时不升档
+    const double kCoreBusy = 0.9;
+
+    // 队列占用超过该比例视为过载，低于空闲比例视为有余量
+    const double kQueueHigh = 0.5;
+    const double kQueueLow = 0.25;
+}
+
+std::string QualityLevel::toString() const {
+    std::ostringstream ss;
+    ss << preset << " ";
+    if (bitrateKbps > 0) {
+        ss << bitrateKbps << "kbps";
+    } else {
+        ss << "crf " << crf;
+    }
+    ss << " " << static_cast<int>(scale * 100 + 0.5) << "%";
+    return ss.str();
+}
+
+bool CpuLoadMonitor::sample(std::vector<double>& coreLoads) {
+    std::ifstream file("/proc/stat");
+    if (!file.is_open()) {
+        return false;
+    }
+
+    // cpuN user nice system idle iowait irq softirq steal ...
+    std::vector<CoreTimes> current;
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line.compare(0, 3, "cpu") != 0) {
+            break;  // cpu行在文件开头
+        }
+        if (line.size() < 4 || line[3] < '0' || line[3] > '9') {
+            continue;  // 跳过汇总行
+        }
+
+        std::istringstream fields(line.substr(line.find(' ')));
+        uint64_t values[8] = {0};
+        for (int i = 0; i < 8 && (fields >> values[i]); i++) {
+        }
+        uint64_t idle = values[3] + values[4];
+        uint64_t total = 0;
+        for (uint64_t value : values) {
+            total += value;
+        }
+        current.push_back(CoreTimes{total - idle, total});
+    }
+
+    bool valid = !current.empty() && current.size() == m_last.size();
+    if (valid) {
+        coreLoads.resize(current.size());
+        for (size_t i = 0; i < current.size(); i++) {
+            uint64_t total = current[i].total - m_last[i].total;
+            uint64_t busy = current[i].busy - m_last[i].busy;
+            coreLoads[i] = total > 0 ? std::min(1.0, static_cast<double>(busy) / total) : 0.0;
+        }
+    }
+    m_last.swap(current);
+    return valid;
+}
+
+QualityController::QualityController()
+    : m_levelIndex(0),
+      m_queueCapacity(1),
+      m_frameIntervalMs(1000.0 / 30),
+      m_started(false),
+      m_lastChangeWasUp(false),
+      m_stableSeconds(0.0),
+      m_lastDropped(0),
+      m_lastEncoded(0),
+      m_lastTotalEncodeMs(0.0) {
+    m_levels = buildLadder(EncoderSettings());
+    m_blockedUntil.assign(m_levels.size(), Clock::time_point());
+}
+
+std::vector<QualityLevel> QualityController::buildLadder(const EncoderSettings& base) {
+    QualityLevel baseLevel;
+    baseLevel.preset = base.preset;
+    baseLevel.bitrateKbps = base.bitrateKbps;
+    baseLevel.crf = base.crf;
+
+    int baseIndex = -1;
+    for (int i = 0; i < kPresetCount; i++) {
+        if (base.preset == kPresets[i]) {
+            baseIndex = i;
+        }
+    }
+
+    // 基础预设、原始分辨率下只降码率的档位（从低到高），与基础档位之间切换不重建编码器、不产生新分段
+    std::vector<QualityLevel> bitrateLevels;
+    for (int i = kBitrateStepCount - 1; i >= 0; i--) {
+        QualityLevel level = baseLevel;
+        if (level.bitrateKbps > 0) {
+            level.bitrateKbps = std::max(100, static_cast<int>(base.bitrateKbps * kBitrateSteps[i]));
+        } else {
+            level.crf = std::min(51, base.crf + kCrfSteps[i]);
+        }
+        bitrateLevels.push_back(level);
+    }
+
+    // 比基础预设快的档位沿用最低码率
+    const QualityLevel& lowestBitrate = bitrateLevels.front();
+
+    // 从最低档开始：最快预设下先降分辨率
+    std::vector<QualityLevel> ladder;
+    QualityLevel cheapest = lowestBitrate;
+    if (baseIndex >= 0) {
+        cheapest.preset = kPresets[0];
+    }
+    for (int i = static_cast<int>(sizeof(kScales) / sizeof(kScales[0])) - 1; i >= 0; i--) {
+        QualityLevel level = cheapest;
+        level.scale = kScales[i];
+        if (level.bitrateKbps > 0) {
+            level.bitrateKbps = std::max(100, static_cast<int>(cheapest.bitrateKbps * kScales[i]));
+        }
+        ladder.push_back(level);
+    }
+
+    if (baseIndex < 0) {
+        // 未知预设只调分辨率和码率
+        ladder.insert(ladder.end(), bitrateLevels.begin(), bitrateLevels.end());
+        ladder.push_back(baseLevel);
+        return ladder;
+    }
+
+    // 最快预设到基础预设之前，然后是基础预设的降码率档位和基础档位，再往上最多慢kMaxSlowerPresets档
+    for (int i = 0; i < baseIndex; i++) {
+        QualityLevel level = lowestBitrate;
+        level.preset = kPresets[i];
+        ladder.push_back(level);
+    }
+    ladder.insert(ladder.end(), bitrateLevels.begin(), bitrateLevels.end());
+    ladder.push_back(baseLevel);
+
+    int last = std::min(kPresetCount - 1, baseIndex + kMaxSlowerPresets);
+    for (int i = baseIndex + 1; i <= last; i++) {
+        QualityLevel level = baseLevel;
+        level.preset = kPresets[i];
+        ladder.push_back(level);
+    }
+    return ladder;
+}
+
+void QualityController::reset(const EncoderSettings& base, size_t queueCapacity, const FrameRate& framerate) {
+    m_levels = buildLadder(base);
+    m_blockedUntil.assign(m_levels.size(), Clock::time_point());
+    m_queueCapacity = std::max<size_t>(1, queueCapacity);
+    m_frameIntervalMs = framerate.isValid() ? 1000.0 / framerate.toDouble() : 1000.0 / 30;
+
+    // 从与基础参数相同的档位开始
+    m_levelIndex = 0;
+    for (size_t i = 0; i < m_levels.size(); i++) {
+        if (m_levels[i].preset == base.preset && m_levels[i].scale == 1.0 &&
+            m_levels[i].bitrateKbps == base.bitrateKbps && m_levels[i].crf == base.crf) {
+            m_levelIndex = static_cast<int>(i);
+            break;
+        }
+    }
+
+    m_started = false;
+    m_lastChangeWasUp = false;
+    m_stableSeconds = 0.0;
+    m_lastDecision.clear();
+}
+
+bool QualityController::update(const RecorderStats& stats) {
+    Clock::time_point now = Clock::now();
+    std::vector<double> coreLoads;
+
+    // 第一次调用只建立基准
+    if (!m_started) {
+        m_cpuMonitor.sample(coreLoads);
+        m_started = true;
+        m_lastSample = now;
+        m_lastChange = now;
+        m_lastDropped = stats.dropped;
+        m_lastEncoded = stats.encoded;
+        m_lastTotalEncodeMs = stats.totalEncodeMs;
+        return false;
+    }
+
+    double elapsed = std::chrono::duration<double>(now - m_lastSample).count();
+    if (elapsed < m_settings.intervalSeconds) {
+        return false;
+    }
+    m_lastSample = now;
+
+    // 本次采样间隔内的变化（录制重新开始时统计清零）
+    uint64_t dropped = stats.dropped >= m_lastDropped ? stats.dropped - m_lastDropped : stats.dropped;
+    uint64_t encoded = stats.encoded >= m_lastEncoded ? stats.encoded - m_lastEncoded : stats.encoded;
+    double encodeMs = stats.totalEncodeMs >= m_lastTotalEncodeMs ?
+                      stats.totalEncodeMs - m_lastTotalEncodeMs : stats.totalEncodeMs;
+    m_lastDropped = stats.dropped;
+    m_lastEncoded = stats.encoded;
+    m_lastTotalEncodeMs = stats.totalEncodeMs;
+
+    double encodeLoad = encoded > 0 ? encodeMs / encoded / m_frameIntervalMs : 0.0;
+    double queueFill = static_cast<double>(stats.queueDepth) / m_queueCapacity;
+
+    double cpuAverage = 0.0;
+    double cpuMax = 0.0;
+    if (m_cpuMonitor.sample(coreLoads)) {
+        for (double load : coreLoads) {
+            cpuAverage += load;
+            cpuMax = std::max(cpuMax, load);
+        }
+        cpuAverage /= coreLoads.size();
+    }
+
+    bool overloaded = dropped > 0 || queueFill >= kQueueHigh || encodeLoad > m_settings.highLoad ||
+                      cpuAverage > m_settings.highLoad;
+    bool underloaded = dropped == 0 && queueFill <= kQueueLow && encodeLoad < m_settings.lowLoad &&
+                       cpuAverage < m_settings.lowLoad && cpuMax < kCoreBusy;
+
+    std::ostringstream reason;
+    reason << std::fixed << std::setprecision(2) << "丢帧 " << dropped
+           << ", 队列 " << stats.queueDepth << "/" << m_queueCapacity
+           << ", 编码负载 " << encodeLoad
+           << ", CPU 平均 " << cpuAverage << " 最高 " << cpuMax;
+
+    double sinceChange = std::chrono::duration<double>(now - m_lastChange).count();
+
+    if (overloaded) {
+        m_stableSeconds = 0.0;
+        if (m_levelIndex == 0 || sinceChange < m_settings.downCooldownSeconds) {
+            return false;
+        }
+
+        // 刚升上来就过载：该档位暂时禁止，避免反复升降
+        if (m_lastChangeWasUp && sinceChange < m_settings.upStableSeconds) {
+            m_blockedUntil[m_levelIndex] = now + std::chrono::duration_cast<Clock::duration>(
+                std::chrono::duration<double>(m_settings.blockSeconds));
+        }
+        changeLevel(m_levelIndex - 1, reason.str(), now);
+        m_lastChangeWasUp = false;
+        return true;
+    }
+
+    if (!underloaded) {
+        m_stableSeconds = 0.0;
+        return false;
+    }
+
+    m_stableSeconds += elapsed;
+    int next = m_levelIndex + 1;
+    if (m_stableSeconds < m_settings.upStableSeconds || next >= getLevelCount() || now < m_blockedUntil[next]) {
+        return false;
+    }
+
+    m_stableSeconds = 0.0;
+    changeLevel(next, reason.str(), now);
+    m_lastChangeWasUp = true;
+    return true;
+}
+
+void QualityController::changeLevel(int index, const std::string& reason, Clock::time_point now) {
+    std::ostringstream decision;
+    decision << "档位 " << m_levelIndex << " -> " << index
+             << " (" << m_levels[index].toString() << "): " << reason;
+
+    m_levelIndex = index;
+    m_lastChange = now;
+    m_lastDecision = decision.str();
+    std::cout << "画质调整: " << m_lastDecision << std::endl;
+}
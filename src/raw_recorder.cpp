@@ -0,0 +1,591 @@
+#include "raw_recorder.h"
+#include "io_uring_queue.h"
+#include "format_negotiator.h"
+#include "utils.h"
+#include <iostream>
+#include <filesystem>
+#include <cstring>
+#include <cerrno>
+#include <cstdlib>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+namespace {
+    // O_DIRECT要求的对齐（偏移、长度和内存地址）
+    const size_t kBlockSize = 4096;
+
+    const char kMagic[8] = {'V', 'C', 'R', 'A', 'W', 0, 0, 0};
+    const uint32_t kVersion = 1;
+
+    // 缓冲写入时每写满该大小回写一次并丢弃已落盘的页缓存
+    const uint64_t kWritebackWindow = 8ull << 20;
+
+    inline uint64_t alignUp(uint64_t value) {
+        return (value + kBlockSize - 1) & ~static_cast<uint64_t>(kBlockSize - 1);
+    }
+
+    // 对齐的缓冲区
+    struct AlignedBuffer {
+        uint8_t* data;
+        size_t size;
+
+        AlignedBuffer() : data(nullptr), size(0) {}
+        ~AlignedBuffer() { free(data); }
+
+        AlignedBuffer(const AlignedBuffer&) = delete;
+        AlignedBuffer& operator=(const AlignedBuffer&) = delete;
+
+        // 保证至少有size字节（内容不保留）
+        bool reserve(size_t required) {
+            if (size >= required) {
+                return true;
+            }
+            free(data);
+            data = nullptr;
+            size = 0;
+            void* memory = nullptr;
+            if (posix_memalign(&memory, kBlockSize, required) != 0) {
+                return false;
+            }
+            data = static_cast<uint8_t*>(memory);
+            size = required;
+            return true;
+        }
+    };
+
+    // 写满整个范围，被信号中断或部分写入时继续
+    bool pwriteAll(int fd, const uint8_t* data, size_t size, uint64_t offset) {
+        while (size > 0) {
+            ssize_t ret = pwrite(fd, data, size, static_cast<off_t>(offset));
+            if (ret < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return false;
+            }
+            data += ret;
+            size -= static_cast<size_t>(ret);
+            offset += static_cast<uint64_t>(ret);
+        }
+        return true;
+    }
+}
+
+// 文件和写入状态，只在写入线程中使用（打开和最后的关闭在调用线程中）
+struct RawWriter {
+    // 一个进行中的写入
+    struct Pending {
+        FrameRef frame;        // 写入完成前帧池缓冲区不能归还
+        AlignedBuffer bounce;  // 帧数据未对齐时的拷贝
+        size_t size;           // 写入长度
+        std::chrono::steady_clock::time_point start;  // 提交时间
+        bool busy;
+
+        Pending() : size(0), busy(false) {}
+    };
+
+    int fd;
+    bool directIo;
+    bool useRing;
+    IoUringQueue ring;
+    std::vector<Pending> pending;  // 写入槽（io_uring时才使用多个）
+    size_t inFlight;  // 进行中的写入数
+
+    RawFileHeader header;
+    std::vector<RawFrameEntry> entries;  // 帧索引
+    uint64_t nextOffset;  // 下一帧的偏移
+    uint64_t allocated;  // 已预分配的文件大小
+    uint64_t preallocateBytes;  // 每次预分配的大小
+    uint64_t writebackStart;  // 缓冲写入时尚未回写的起始位置
+    uint64_t evictStart;  // 缓冲写入时尚未丢弃页缓存的起始位置
+
+    // 每个写入完成时调用：是否成功、字节数、耗时（微秒）
+    std::function<void(bool, size_t, int64_t)> onComplete;
+
+    RawWriter()
+        : fd(-1), directIo(false), useRing(false), inFlight(0), nextOffset(kBlockSize), allocated(0),
+          preallocateBytes(0), writebackStart(kBlockSize), evictStart(kBlockSize) {
+        memset(&header, 0, sizeof(header));
+    }
+
+    ~RawWriter() {
+        if (fd >= 0) {
+            ::close(fd);
+        }
+    }
+
+    bool open(const std::string& path, const RawRecorderSettings& settings) {
+        // 优先O_DIRECT，文件系统不支持时（EINVAL）退回缓冲写入
+        directIo = false;
+        if (settings.directIo) {
+            fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT | O_CLOEXEC, 0644);
+            directIo = fd >= 0;
+        }
+        if (fd < 0) {
+            fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        }
+        if (fd < 0) {
+            std::cerr << "无法创建原始录制文件: " << path << " (" << strerror(errno) << ")" << std::endl;
+            return false;
+        }
+
+        // 缓冲写入本身很快，瓶颈在页缓存；io_uring只用于O_DIRECT，使多个写入同时在设备上进行
+        size_t slots = std::max<size_t>(1, settings.inFlight);
+        useRing = directIo && settings.ioUring && slots > 1 && ring.init(static_cast<unsigned>(slots));
+        pending = std::vector<Pending>(useRing ? slots : 1);
+
+        preallocateBytes = alignUp(std::max<uint64_t>(settings.preallocateBytes, kBlockSize));
+        if (!grow(preallocateBytes)) {
+            return false;
+        }
+
+        // 先写入帧数为0的文件头，异常退出时文件仍可识别
+        return writeHeader();
+    }
+
+    // 预分配到至少size字节，之后的写入不需要分配块、不改变文件大小
+    bool grow(uint64_t size) {
+        while (allocated < size) {
+            int ret = fallocate(fd, 0, static_cast<off_t>(allocated), static_cast<off_t>(preallocateBytes));
+            if (ret != 0 && errno != EOPNOTSUPP && errno != ENOSYS) {
+                std::cerr << "无法预分配文件空间: " << strerror(errno) << std::endl;
+                return false;
+            }
+            allocated += preallocateBytes;
+        }
+        return true;
+    }
+
+    bool canSubmit() const {
+        return inFlight < pending.size() || !useRing;
+    }
+
+    // 写入一帧；io_uring时只提交，完成由reap处理
+    void submit(const FrameRef& frame) {
+        const FrameInfo& info = frame.info();
+        size_t size = info.bytesUsed;
+        size_t length = directIo ? alignUp(size) : size;
+        if (size == 0 || !grow(nextOffset + alignUp(size))) {
+            onComplete(false, 0, 0);
+            return;
+        }
+
+        Pending* slot = &pending[0];
+        size_t slotIndex = 0;
+        for (size_t i = 0; i < pending.size(); i++) {
+            if (!pending[i].busy) {
+                slot = &pending[i];
+                slotIndex = i;
+                break;
+            }
+        }
+
+        // 帧池缓冲区已对齐且容量包含补齐部分时直接写出，否则拷贝到对齐的缓冲区
+        const uint8_t* data = frame.data();
+        if (directIo && (reinterpret_cast<uintptr_t>(data) % kBlockSize != 0 || frame.capacity() < length)) {
+            if (!slot->bounce.reserve(length)) {
+                onComplete(false, 0, 0);
+                return;
+            }
+            memcpy(slot->bounce.data, data, size);
+            memset(slot->bounce.data + size, 0, length - size);
+            data = slot->bounce.data;
+        }
+
+        RawFrameEntry entry;
+        entry.offset = nextOffset;
+        entry.size = static_cast<uint32_t>(size);
+        entry.reserved = 0;
+        entry.timestampUs = info.timestampUs;
+        entry.sequence = info.sequence;
+        entries.push_back(entry);
+        nextOffset += alignUp(size);
+
+        auto start = std::chrono::steady_clock::now();
+        if (useRing) {
+            slot->frame = frame;
+            slot->size = length;
+            slot->start = start;
+            if (ring.queueWrite(fd, data, static_cast<unsigned>(length), entry.offset, slotIndex)) {
+                // 内核暂时没有接受时留在队列中，等待完成时再提交
+                ring.submit();
+                slot->busy = true;
+                inFlight++;
+                return;
+            }
+            slot->frame.reset();
+        }
+
+        bool ok = pwriteAll(fd, data, length, entry.offset);
+        int64_t us = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start).count();
+        onComplete(ok, ok ? length : 0, us);
+
+        if (!directIo) {
+            writeback(false);
+        }
+    }
+
+    // 收取完成的写入，wait为true时至少等到一个完成
+    void reap(bool wait) {
+        if (!useRing || inFlight == 0) {
+            return;
+        }
+
+        int count = ring.reap(wait, [this](uint64_t userData, int result) {
+            Pending& slot = pending[static_cast<size_t>(userData)];
+            int64_t us = std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - slot.start).count();
+            bool ok = result >= 0 && static_cast<size_t>(result) == slot.size;
+            if (result < 0) {
+                std::cerr << "原始录制写入失败: " << strerror(-result) << std::endl;
+            }
+            onComplete(ok, ok ? slot.size : 0, us);
+            slot.frame.reset();
+            slot.busy = false;
+            inFlight--;
+        });
+        if (count < 0) {
+            // 无法再等待完成事件，放弃进行中的写入
+            std::cerr << "io_uring等待失败: " << strerror(errno) << std::endl;
+            for (Pending& slot : pending) {
+                if (slot.busy) {
+                    onComplete(false, 0, 0);
+                    slot.frame.reset();
+                    slot.busy = false;
+                }
+            }
+            inFlight = 0;
+            useRing = false;
+        }
+    }
+
+    // 缓冲写入时按窗口回写：启动刚写完的窗口的回写，等待上一个窗口落盘后丢弃它的页缓存
+    // 这样录制占用的页缓存始终只有两个窗口，不会挤掉系统中其他程序的缓存
+    void writeback(bool final) {
+        uint64_t end = nextOffset;
+        if (!final && end - writebackStart < kWritebackWindow) {
+            return;
+        }
+
+        if (end > writebackStart) {
+            sync_file_range(fd, static_cast<off_t>(writebackStart), static_cast<off_t>(end - writebackStart),
+                            SYNC_FILE_RANGE_WRITE);
+        }
+        uint64_t evictEnd = final ? end : writebackStart;
+        if (evictEnd > evictStart) {
+            sync_file_range(fd, static_cast<off_t>(evictStart), static_cast<off_t>(evictEnd - evictStart),
+                            SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER);
+            posix_fadvise(fd, static_cast<off_t>(evictStart), static_cast<off_t>(evictEnd - evictStart),
+                          POSIX_FADV_DONTNEED);
+            evictStart = evictEnd;
+        }
+        writebackStart = end;
+    }
+
+    // 写入文件头（占第一个4096字节）
+    bool writeHeader() {
+        AlignedBuffer block;
+        if (!block.reserve(kBlockSize)) {
+            return false;
+        }
+        memset(block.data, 0, kBlockSize);
+        memcpy(block.data, &header, sizeof(header));
+        return pwriteAll(fd, block.data, kBlockSize, 0);
+    }
+
+    // 等待所有写入完成，写入索引和文件头，截去预分配的多余空间
+    bool finish() {
+        while (inFlight > 0) {
+            reap(true);
+        }
+
+        header.frameCount = entries.size();
+        header.indexOffset = nextOffset;
+
+        size_t indexBytes = entries.size() * sizeof(RawFrameEntry);
+        bool ok = true;
+        if (!entries.empty()) {
+            AlignedBuffer index;
+            size_t length = alignUp(indexBytes);
+            ok = index.reserve(length);
+            if (ok) {
+                memset(index.data, 0, length);
+                memcpy(index.data, entries.data(), indexBytes);
+                ok = pwriteAll(fd, index.data, directIo ? length : indexBytes, header.indexOffset);
+            }
+        }
+        ok = ok && writeHeader();
+        if (!ok) {
+            std::cerr << "写入原始录制索引失败: " << strerror(errno) << std::endl;
+        }
+
+        if (ftruncate(fd, static_cast<off_t>(header.indexOffset + indexBytes)) != 0) {
+            std::cerr << "无法截断原始录制文件: " << strerror(errno) << std::endl;
+        }
+        if (!directIo) {
+            writeback(true);
+        }
+        fdatasync(fd);
+        ::close(fd);
+        fd = -1;
+        return ok;
+    }
+};
+
+RawRecorder::RawRecorder()
+    : m_isRecording(false),
+      m_written(0),
+      m_bytesWritten(0),
+      m_writeErrors(0),
+      m_lastWriteUs(0),
+      m_maxWriteUs(0),
+      m_totalWriteUs(0),
+      m_usingDirectIo(false),
+      m_usingIoUring(false) {
+}
+
+RawRecorder::~RawRecorder() {
+    stopRecording();
+}
+
+bool RawRecorder::init(const std::string& outputDir) {
+    m_outputDir = outputDir;
+
+    // 确保输出目录存在
+    if (!Utils::ensureDirectoryExists(m_outputDir)) {
+        std::cerr << "无法创建输出目录: " << m_outputDir << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+bool RawRecorder::startRecording(const Resolution& resolution, const FrameRate& framerate, uint32_t pixelFormat) {
+    if (m_isRecording) {
+        return true;  // 已经在录制中
+    }
+
+    std::string filePath = generateFileName(resolution, framerate.rounded(), pixelFormat);
+
+    std::unique_ptr<RawWriter> writer(new RawWriter());
+    RawFileHeader& header = writer->header;
+    memcpy(header.magic, kMagic, sizeof(header.magic));
+    header.version = kVersion;
+    header.headerSize = kBlockSize;
+    header.width = resolution.width;
+    header.height = resolution.height;
+    header.pixelFormat = pixelFormat;
+    header.framerateNum = framerate.numerator;
+    header.framerateDen = framerate.denominator;
+    header.entrySize = sizeof(RawFrameEntry);
+    header.dataOffset = kBlockSize;
+
+    if (!writer->open(filePath, m_settings)) {
+        return false;
+    }
+    writer->onComplete = [this](bool ok, size_t bytes, int64_t us) {
+        if (!ok) {
+            m_writeErrors++;
+            return;
+        }
+        m_written++;
+        m_bytesWritten += bytes;
+        m_lastWriteUs = us;
+        m_totalWriteUs += us;
+        if (us > m_maxWriteUs) {
+            m_maxWriteUs = us;
+        }
+    };
+
+    m_usingDirectIo = writer->directIo;
+    m_usingIoUring = writer->useRing;
+    m_writer = std::move(writer);
+    {
+        std::lock_guard<std::mutex> lock(m_pathMutex);
+        m_currentFilePath = filePath;
+    }
+
+    // 每次录制使用新的队列，统计从零开始
+    auto queue = std::make_shared<BoundedQueue<FrameRef>>(m_settings.queueDepth, QueuePolicy::DropOldest);
+    {
+        std::lock_guard<std::mutex> lock(m_queueMutex);
+        m_queue = queue;
+    }
+    m_written = 0;
+    m_bytesWritten = 0;
+    m_writeErrors = 0;
+    m_lastWriteUs = 0;
+    m_maxWriteUs = 0;
+    m_totalWriteUs = 0;
+
+    m_writerThread = std::thread(&RawRecorder::writerThreadFunc, this, queue);
+
+    // 记录开始时间
+    m_startTime = std::chrono::steady_clock::now();
+
+    // 设置录制标志
+    m_isRecording = true;
+
+    std::cout << "原始录制: " << filePath << " (" << FormatNegotiator::fourccToString(pixelFormat) << ", "
+              << (m_usingDirectIo ? "O_DIRECT" : "缓冲写入") << (m_usingIoUring ? " + io_uring" : "") << ")" << std::endl;
+    return true;
+}
+
+void RawRecorder::stopRecording() {
+    if (!m_isRecording) {
+        return;  // 没有在录制
+    }
+
+    // 清除录制标志，不再接受新帧
+    m_isRecording = false;
+
+    // 关闭队列，写入线程写完剩余的帧、写入索引后退出
+    std::shared_ptr<BoundedQueue<FrameRef>> queue;
+    {
+        std::lock_guard<std::mutex> lock(m_queueMutex);
+        queue = m_queue;
+    }
+    if (queue) {
+        queue->close();
+    }
+    if (m_writerThread.joinable()) {
+        m_writerThread.join();
+    }
+    m_writer.reset();
+
+    RecorderStats stats = getStats();
+    std::cout << "原始录制结束: 写入 " << stats.encoded << " 帧 (" << Utils::formatFileSize(m_bytesWritten)
+              << "), 丢弃 " << stats.dropped << " 帧, 峰值队列 " << stats.maxQueueDepth << std::endl;
+}
+
+void RawRecorder::processFrame(const FrameRef& frame) {
+    if (!m_isRecording || frame.empty()) {
+        return;  // 没有在录制
+    }
+
+    std::shared_ptr<BoundedQueue<FrameRef>> queue;
+    {
+        std::lock_guard<std::mutex> lock(m_queueMutex);
+        queue = m_queue;
+    }
+    if (queue) {
+        queue->push(frame);
+    }
+}
+
+std::string RawRecorder::getCurrentFilePath() const {
+    std::lock_guard<std::mutex> lock(m_pathMutex);
+    return m_currentFilePath;
+}
+
+double RawRecorder::getRecordingDuration() const {
+    if (!m_isRecording) {
+        return 0.0;
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    return std::chrono::duration<double>(now - m_startTime).count();
+}
+
+RecorderStats RawRecorder::getStats() const {
+    RecorderStats stats;
+
+    std::shared_ptr<BoundedQueue<FrameRef>> queue;
+    {
+        std::lock_guard<std::mutex> lock(m_queueMutex);
+        queue = m_queue;
+    }
+    if (queue) {
+        QueueStats queueStats = queue->getStats();
+        stats.queued = queueStats.pushed;
+        stats.dropped = queueStats.dropped;
+        stats.queueDepth = queueStats.depth;
+        stats.maxQueueDepth = queueStats.maxDepth;
+    }
+
+    // 写入失败的帧同样丢失
+    stats.dropped += m_writeErrors;
+    stats.encoded = m_written;
+    stats.lastEncodeMs = m_lastWriteUs / 1000.0;
+    stats.maxEncodeMs = m_maxWriteUs / 1000.0;
+    stats.totalEncodeMs = m_totalWriteUs / 1000.0;
+    return stats;
+}
+
+void RawRecorder::writerThreadFunc(std::shared_ptr<BoundedQueue<FrameRef>> queue) {
+    RawWriter* writer = m_writer.get();
+
+    FrameRef frame;
+    for (;;) {
+        if (writer->canSubmit()) {
+            // 没有进行中的写入时阻塞等待新帧，否则只取已到达的帧，转而等待写入完成
+            bool got;
+            if (writer->inFlight == 0) {
+                got = queue->pop(frame);
+                if (!got) {
+                    break;  // 队列已关闭且写完
+                }
+            } else {
+                got = queue->tryPop(frame);
+            }
+            if (got) {
+                writer->submit(frame);
+                frame.reset();
+                writer->reap(false);
+                continue;
+            }
+        }
+
+        // 写入槽已满或暂时没有新帧：等待至少一个写入完成
+        writer->reap(true);
+    }
+
+    writer->finish();
+}
+
+bool RawRecorder::readIndex(const std::string& filePath, RawFileHeader& header, std::vector<RawFrameEntry>& entries) {
+    int fd = ::open(filePath.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        std::cerr << "无法打开原始录制文件: " << filePath << std::endl;
+        return false;
+    }
+
+    bool ok = pread(fd, &header, sizeof(header), 0) == static_cast<ssize_t>(sizeof(header)) &&
+              memcmp(header.magic, kMagic, sizeof(kMagic)) == 0 && header.version == kVersion &&
+              header.entrySize == sizeof(RawFrameEntry);
+    if (!ok) {
+        std::cerr << "不是有效的原始录制文件: " << filePath << std::endl;
+    } else {
+        entries.resize(header.frameCount);
+        size_t bytes = entries.size() * sizeof(RawFrameEntry);
+        ok = bytes == 0 || pread(fd, entries.data(), bytes, static_cast<off_t>(header.indexOffset)) ==
+                           static_cast<ssize_t>(bytes);
+        if (!ok) {
+            std::cerr << "原始录制文件索引不完整: " << filePath << std::endl;
+        }
+    }
+
+    ::close(fd);
+    return ok;
+}
+
+std::string RawRecorder::generateFileName(const Resolution& resolution, int framerate, uint32_t pixelFormat) {
+    // 获取当前日期时间
+    std::string dateTime = Utils::getCurrentDateTimeString();
+
+    // 生成文件名：日期时间_分辨率_帧率.像素格式.raw
+    std::string baseName = dateTime + "_" +
+                          std::to_string(resolution.width) + "x" + std::to_string(resolution.height) +
+                          "_" + std::to_string(framerate) + "fps." + FormatNegotiator::fourccToString(pixelFormat);
+
+    fs::path filePath = fs::path(m_outputDir) / (baseName + ".raw");
+    for (int index = 1; fs::exists(filePath); index++) {
+        filePath = fs::path(m_outputDir) / (baseName + "." + std::to_string(index) + ".raw");
+    }
+
+    // 完整路径
+    return filePath;
+}
@@ -0,0 +1,193 @@
+#include "rendition_recorder.h"
+#include "utils.h"
+#include <iostream>
+#include <algorithm>
+
+RenditionRecorder::RenditionRecorder()
+    : m_isRecording(false) {
+    m_renditions.push_back(RenditionSettings());
+}
+
+RenditionRecorder::~RenditionRecorder() {
+    stopRecording();
+}
+
+bool RenditionRecorder::init(const std::string& outputDir) {
+    m_outputDir = outputDir;
+
+    // 确保输出目录存在
+    if (!Utils::ensureDirectoryExists(m_outputDir)) {
+        std::cerr << "无法创建输出目录: " << m_outputDir << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+void RenditionRecorder::setRenditions(const std::vector<RenditionSettings>& renditions) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_renditions = renditions;
+}
+
+std::vector<RenditionSettings> RenditionRecorder::getRenditions() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_renditions;
+}
+
+bool RenditionRecorder::startRecording(const Resolution& source, const FrameRate& framerate) {
+    if (m_isRecording) {
+        return true;  // 已经在录制中
+    }
+
+    if (!LibavRecorder::isAvailable()) {
+        std::cerr << "未编译libav支持，无法录制副本" << std::endl;
+        return false;
+    }
+
+    if (source.width <= 0 || source.height <= 0) {
+        std::cerr << "无效的采集分辨率" << std::endl;
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_groups.clear();
+
+    for (const RenditionSettings& rendition : m_renditions) {
+        if (rendition.height <= 0 || rendition.height >= source.height) {
+            std::cout << "副本 " << rendition.name << " 不小于采集分辨率，跳过" << std::endl;
+            continue;
+        }
+        if (rendition.encoder.passthrough) {
+            std::cerr << "副本 " << rendition.name << " 需要重新编码，不支持直通录制" << std::endl;
+            continue;
+        }
+
+        // 宽度按源画面比例，编码器要求偶数尺寸
+        int height = rendition.height & ~1;
+        int width = static_cast<int>(static_cast<int64_t>(source.width) * height / source.height);
+        Resolution size(std::max(2, width & ~1), height);
+
+        // 相同尺寸的副本放在同一组，共用一次缩放
+        ScaleGroup* group = nullptr;
+        for (auto& existing : m_groups) {
+            if (existing->size == size) {
+                group = existing.get();
+            }
+        }
+
+        auto recorder = std::make_shared<LibavRecorder>();
+        recorder->setFileNameTag(rendition.name);
+        if (!recorder->init(m_outputDir) || !recorder->startRecording(size, framerate, rendition.encoder)) {
+            std::cerr << "无法开始副本录制: " << rendition.name << std::endl;
+            continue;
+        }
+
+        if (!group) {
+            std::unique_ptr<ScaleGroup> created(new ScaleGroup(size));
+            m_groups.push_back(std::move(created));
+            group = m_groups.back().get();
+        }
+        group->recorders.push_back(recorder);
+    }
+
+    // 帧池大小：每个录制器的编码队列都可能持有缓冲区，再加正在缩放的一帧
+    for (auto& group : m_groups) {
+        size_t slots = 1;
+        for (const auto& recorder : group->recorders) {
+            slots += recorder->getQueueDepth() + 1;
+        }
+        size_t slotSize = static_cast<size_t>(group->size.width) * group->size.height * 3;
+        if (!group->pool.init(slots, slotSize)) {
+            std::cerr << "无法分配副本帧池" << std::endl;
+            for (const auto& recorder : group->recorders) {
+                recorder->stopRecording();
+            }
+            group->recorders.clear();
+        }
+    }
+    m_groups.erase(std::remove_if(m_groups.begin(), m_groups.end(),
+                                  [](const std::unique_ptr<ScaleGroup>& group) { return group->recorders.empty(); }),
+                   m_groups.end());
+
+    if (m_groups.empty()) {
+        return false;
+    }
+
+    m_isRecording = true;
+    return true;
+}
+
+void RenditionRecorder::stopRecording() {
+    if (!m_isRecording) {
+        return;  // 没有在录制
+    }
+
+    // 先清除标志，processFrame不再缩放新帧
+    m_isRecording = false;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto& group : m_groups) {
+        for (const auto& recorder : group->recorders) {
+            recorder->stopRecording();
+        }
+    }
+    m_groups.clear();
+}
+
+void RenditionRecorder::processFrame(const FrameRef& frame) {
+    if (!m_isRecording || frame.empty() || frame.info().pixelFormat != 0) {
+        return;  // 没有在录制或不是BGR帧
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    cv::Mat source = frame.mat();
+
+    for (auto& group : m_groups) {
+        FrameRef scaled = group->pool.acquire();
+        if (!scaled) {
+            // 编码器跟不上，缓冲区都在编码队列中
+            group->exhausted++;
+            continue;
+        }
+
+        FrameInfo info = frame.info();
+        info.width = group->size.width;
+        info.height = group->size.height;
+        info.type = CV_8UC3;
+        info.step = static_cast<size_t>(info.width) * 3;
+        info.bytesUsed = info.step * info.height;
+        scaled.setInfo(info);
+
+        // 直接缩放到帧池缓冲区中，缩小用INTER_AREA避免混叠
+        cv::Mat destination = scaled.mat();
+        cv::resize(source, destination, destination.size(), 0, 0, cv::INTER_AREA);
+
+        for (const auto& recorder : group->recorders) {
+            recorder->processFrame(scaled);
+        }
+    }
+}
+
+std::vector<std::string> RenditionRecorder::getCurrentFilePaths() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::vector<std::string> paths;
+    for (const auto& group : m_groups) {
+        for (const auto& recorder : group->recorders) {
+            paths.push_back(recorder->getCurrentFilePath());
+        }
+    }
+    return paths;
+}
+
+std::vector<RecorderStats> RenditionRecorder::getStats() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::vector<RecorderStats> stats;
+    for (const auto& group : m_groups) {
+        for (const auto& recorder : group->recorders) {
+            RecorderStats recorderStats = recorder->getStats();
+            recorderStats.dropped += group->exhausted;
+            stats.push_back(recorderStats);
+        }
+    }
+    return stats;
+}
@@ -0,0 +1,318 @@
+#include "v4l2_stream.h"
+#include <iostream>
+#include <cerrno>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+V4L2Stream::V4L2Stream()
+    : m_fd(-1),
+      m_epollFd(-1),
+      m_wakeupFd(-1),
+      m_interrupted(false),
+      m_timedOut(false),
+      m_isStreaming(false) {
+}
+
+V4L2Stream::~V4L2Stream() {
+    close();
+}
+
+int V4L2Stream::xioctl(int fd, unsigned long request, void* arg) {
+    int result;
+    do {
+        result = ioctl(fd, request, arg);
+    } while (result < 0 && errno == EINTR);
+    return result;
+}
+
+bool V4L2Stream::createEventFds() {
+    m_wakeupFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (m_wakeupFd < 0) {
+        std::cerr << "无法创建eventfd: " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    m_epollFd = epoll_create1(EPOLL_CLOEXEC);
+    if (m_epollFd < 0) {
+        std::cerr << "无法创建epoll: " << strerror(errno) << std::endl;
+        closeEventFds();
+        return false;
+    }
+
+    // 设备可读表示有缓冲区可出队
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN | EPOLLPRI;
+    event.data.fd = m_fd;
+    if (epoll_ctl(m_epollFd, EPOLL_CTL_ADD, m_fd, &event) < 0) {
+        std::cerr << "无法监听设备: " << strerror(errno) << std::endl;
+        closeEventFds();
+        return false;
+    }
+
+    event.events = EPOLLIN;
+    event.data.fd = m_wakeupFd;
+    if (epoll_ctl(m_epollFd, EPOLL_CTL_ADD, m_wakeupFd, &event) < 0) {
+        std::cerr << "无法监听eventfd: " << strerror(errno) << std::endl;
+        closeEventFds();
+        return false;
+    }
+
+    return true;
+}
+
+void V4L2Stream::closeEventFds() {
+    if (m_epollFd >= 0) {
+        ::close(m_epollFd);
+        m_epollFd = -1;
+    }
+
+    if (m_wakeupFd >= 0) {
+        ::close(m_wakeupFd);
+        m_wakeupFd = -1;
+    }
+}
+
+bool V4L2Stream::open(int fd, int bufferCount) {
+    close();
+
+    if (fd < 0 || bufferCount <= 0) {
+        return false;
+    }
+
+    // 检查设备是否支持流式IO
+    struct v4l2_capability cap;
+    memset(&cap, 0, sizeof(cap));
+    if (xioctl(fd, VIDIOC_QUERYCAP, &cap) < 0) {
+        std::cerr << "无法获取设备信息: " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    uint32_t caps = (cap.capabilities & V4L2_CAP_DEVICE_CAPS) ? cap.device_caps : cap.capabilities;
+    if (!(caps & V4L2_CAP_STREAMING)) {
+        std::cerr << "设备不支持流式IO" << std::endl;
+        return false;
+    }
+
+    // 申请mmap缓冲区
+    struct v4l2_requestbuffers req;
+    memset(&req, 0, sizeof(req));
+    req.count = bufferCount;
+    req.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    req.memory = V4L2_MEMORY_MMAP;
+
+    if (xioctl(fd, VIDIOC_REQBUFS, &req) < 0) {
+        std::cerr << "无法申请V4L2缓冲区: " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    if (req.count < 2) {
+        std::cerr << "V4L2缓冲区数量不足: " << req.count << std::endl;
+        req.count = 0;
+        xioctl(fd, VIDIOC_REQBUFS, &req);
+        return false;
+    }
+
+    m_fd = fd;
+
+    if (!createEventFds()) {
+        close();
+        return false;
+    }
+
+    // 查询并映射每个缓冲区
+    for (uint32_t i = 0; i < req.count; i++) {
+        struct v4l2_buffer buf;
+        memset(&buf, 0, sizeof(buf));
+        buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        buf.memory = V4L2_MEMORY_MMAP;
+        buf.index = i;
+
+        if (xioctl(m_fd, VIDIOC_QUERYBUF, &buf) < 0) {
+            std::cerr << "无法查询V4L2缓冲区: " << strerror(errno) << std::endl;
+            close();
+            return false;
+        }
+
+        void* start = mmap(nullptr, buf.length, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, buf.m.offset);
+        if (start == MAP_FAILED) {
+            std::cerr << "无法映射V4L2缓冲区: " << strerror(errno) << std::endl;
+            close();
+            return false;
+        }
+
+        m_buffers.push_back({start, buf.length});
+    }
+
+    return true;
+}
+
+void V4L2Stream::close() {
+    stop();
+
+    // 取消映射
+    for (auto& buffer : m_buffers) {
+        munmap(buffer.start, buffer.length);
+    }
+
+    closeEventFds();
+
+    // 释放驱动中的缓冲区（REQBUFS成功后即使映射失败也需要释放）
+    if (m_fd >= 0) {
+        struct v4l2_requestbuffers req;
+        memset(&req, 0, sizeof(req));
+        req.count = 0;
+        req.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        req.memory = V4L2_MEMORY_MMAP;
+        xioctl(m_fd, VIDIOC_REQBUFS, &req);
+    }
+
+    m_buffers.clear();
+    m_fd = -1;
+}
+
+bool V4L2Stream::start() {
+    if (m_isStreaming) {
+        return true;
+    }
+
+    if (m_buffers.empty()) {
+        return false;
+    }
+
+    // 所有缓冲区入队
+    for (size_t i = 0; i < m_buffers.size(); i++) {
+        struct v4l2_buffer buf;
+        memset(&buf, 0, sizeof(buf));
+        buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        buf.memory = V4L2_MEMORY_MMAP;
+        buf.index = i;
+
+        if (xioctl(m_fd, VIDIOC_QBUF, &buf) < 0) {
+            std::cerr << "无法将V4L2缓冲区入队: " << strerror(errno) << std::endl;
+            return false;
+        }
+    }
+
+    // 清除上一次残留的唤醒事件
+    uint64_t value;
+    while (read(m_wakeupFd, &value, sizeof(value)) > 0) {
+    }
+
+    // 开启视频流
+    enum v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    if (xioctl(m_fd, VIDIOC_STREAMON, &type) < 0) {
+        std::cerr << "无法开启视频流: " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    m_isStreaming = true;
+    return true;
+}
+
+void V4L2Stream::stop() {
+    if (!m_isStreaming) {
+        return;
+    }
+
+    // STREAMOFF会隐式地将所有缓冲区出队
+    enum v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    if (xioctl(m_fd, VIDIOC_STREAMOFF, &type) < 0) {
+        std::cerr << "无法关闭视频流: " << strerror(errno) << std::endl;
+    }
+
+    m_isStreaming = false;
+}
+
+bool V4L2Stream::dequeue(V4L2Buffer& buffer, int timeoutMs) {
+    if (!m_isStreaming) {
+        return false;
+    }
+
+    m_interrupted = false;
+    m_timedOut = false;
+
+    // 等待内核通知有帧可出队，或被interrupt唤醒
+    struct epoll_event events[2];
+    int count;
+    do {
+        count = epoll_wait(m_epollFd, events, 2, timeoutMs);
+    } while (count < 0 && errno == EINTR);
+
+    if (count < 0) {
+        std::cerr << "等待视频帧时出错: " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    if (count == 0) {
+        m_timedOut = true;
+        return false;
+    }
+
+    for (int i = 0; i < count; i++) {
+        if (events[i].data.fd == m_wakeupFd) {
+            m_interrupted = true;
+            return false;
+        }
+    }
+
+    // 出队
+    struct v4l2_buffer buf;
+    memset(&buf, 0, sizeof(buf));
+    buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    buf.memory = V4L2_MEMORY_MMAP;
+
+    if (xioctl(m_fd, VIDIOC_DQBUF, &buf) < 0) {
+        if (errno == EAGAIN) {
+            // 被唤醒但还没有完成的帧，与超时一样可以继续等待
+            m_timedOut = true;
+        } else {
+            std::cerr << "无法将V4L2缓冲区出队: " << strerror(errno) << std::endl;
+        }
+        return false;
+    }
+
+    if (buf.index >= m_buffers.size()) {
+        return false;
+    }
+
+    buffer.index = buf.index;
+    buffer.data = static_cast<const uint8_t*>(m_buffers[buf.index].start);
+    buffer.bytesUsed = buf.bytesused;
+    buffer.sequence = buf.sequence;
+    buffer.timestampUs = static_cast<int64_t>(buf.timestamp.tv_sec) * 1000000 + buf.timestamp.tv_usec;
+
+    return true;
+}
+
+void V4L2Stream::interrupt() {
+    if (m_wakeupFd >= 0) {
+        uint64_t value = 1;
+        if (write(m_wakeupFd, &value, sizeof(value)) < 0 && errno != EAGAIN) {
+            std::cerr << "无法唤醒采集线程: " << strerror(errno) << std::endl;
+        }
+    }
+}
+
+bool V4L2Stream::requeue(const V4L2Buffer& buffer) {
+    if (!m_isStreaming || buffer.index < 0) {
+        return false;
+    }
+
+    struct v4l2_buffer buf;
+    memset(&buf, 0, sizeof(buf));
+    buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    buf.memory = V4L2_MEMORY_MMAP;
+    buf.index = buffer.index;
+
+    if (xioctl(m_fd, VIDIOC_QBUF, &buf) < 0) {
+        std::cerr << "无法将V4L2缓冲区重新入队: " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    return true;
+}
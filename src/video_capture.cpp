@@ -1,19 +1,45 @@
 #include "video_capture.h"
+#include "color_convert.h"
+#include "format_negotiator.h"
 #include <iostream>
 #include <chrono>
+#include <string.h>
+#include <cmath>
+#include <algorithm>
+
+namespace {
+
+// 连续这么久收不到帧才认为设备已失效；单次超时可能只是曝光切换或USB带宽抖动
+const int kMaxStallMs = 10000;
+// V4L2每次等待帧的超时
+const int kDequeueTimeoutMs = 2000;
+// GStreamer每次拉取帧的超时，也是stop()等待采集线程退出的上限
+const int kGStreamerReadTimeoutMs = 500;
+
+}  // namespace
 
 VideoCapture::VideoCapture()
     : m_device(nullptr),
       m_currentResolution(0, 0),
       m_currentFramerate(0),
-      m_isCapturing(false) {
+      m_isCapturing(false),
+      m_useNativeStream(false),
+      m_framePoolSize(16),
+      m_frameSequence(0),
+      m_decodeEnabled(true),
+      m_nativeFrameSize(0),
+      m_nativeSequence(0),
+      m_intervalM2(0.0),
+      m_lastTimestampUs(0),
+      m_lastSequence(0) {
+    memset(&m_format, 0, sizeof(m_format));
 }
 
 VideoCapture::~VideoCapture() {
     stop();
 }
 
-bool VideoCapture::init(CameraDevice& device, const Resolution& resolution, int framerate) {
+bool VideoCapture::init(CameraDevice& device, const Resolution& resolution, const FrameRate& framerate) {
     // 停止当前采集
     stop();
 
@@ -26,9 +52,29 @@ bool VideoCapture::init(CameraDevice& device, const Resolution& resolution, int
         return false;
     }
 
-    // 保存当前设置
-    m_currentResolution = resolution;
-    m_currentFramerate = framerate;
+    // 保存当前设置（以驱动实际协商的分辨率为准）
+    m_format = m_device->getCurrentFormat();
+    if (m_format.width > 0 && m_format.height > 0) {
+        m_currentResolution = Resolution(m_format.width, m_format.height);
+    } else {
+        m_currentResolution = resolution;
+    }
+    m_currentFramerate = m_device->getCurrentFramerate().isValid() ? m_device->getCurrentFramerate() : framerate;
+
+    // 按BGR帧大小预分配帧池，仍被持有的旧帧在释放后随旧池一起回收
+    size_t frameSize = static_cast<size_t>(m_currentResolution.width) * m_currentResolution.height * 3;
+    if (!m_framePool.init(m_framePoolSize, frameSize)) {
+        std::cerr << "无法初始化帧池" << std::endl;
+        return false;
+    }
+
+    // 设备格式帧另用一个帧池，供直通录制和原始录制持有未转换的帧；只有订阅者时才用到，第一次发布时再分配
+    if (m_format.sizeimage > 0) {
+        m_nativeFrameSize = m_format.sizeimage;
+    } else {
+        m_nativeFrameSize = isCompressedFormat() ? frameSize / 2 : static_cast<size_t>(m_format.bytesperline) * m_format.height;
+    }
+    m_nativePool.release();
 
     return true;
 }
@@ -43,6 +89,17 @@ bool VideoCapture::start() {
         return false;
     }
 
+    // 优先直接驱动V4L2 mmap缓冲区，失败时回退到GStreamer
+    m_useNativeStream = m_stream.open(m_device->getDeviceFd()) && m_stream.start();
+    if (!m_useNativeStream) {
+        m_stream.close();
+        std::cerr << "V4L2 mmap采集不可用，回退到GStreamer" << std::endl;
+    }
+
+    resetStats();
+    m_frameSequence = 0;
+    m_nativeSequence = 0;
+
     // 设置采集标志
     m_isCapturing = true;
 
@@ -60,34 +117,205 @@ void VideoCapture::stop() {
     // 清除采集标志
     m_isCapturing = false;
 
+    // 唤醒阻塞在等待帧上的采集线程，使其立即退出
+    m_stream.interrupt();
+
     // 等待采集线程结束
     if (m_captureThread.joinable()) {
         m_captureThread.join();
     }
+
+    // 关闭视频流并释放映射的缓冲区
+    m_stream.close();
+
+    // 归还当前帧占用的缓冲区
+    std::lock_guard<std::mutex> lock(m_frameMutex);
+    m_currentFrame.reset();
 }
 
-cv::Mat VideoCapture::getCurrentFrame() {
+FrameRef VideoCapture::getCurrentFrame() {
     std::lock_guard<std::mutex> lock(m_frameMutex);
-    return m_currentFrame.clone();
+    return m_currentFrame;
 }
 
-void VideoCapture::setFrameCallback(std::function<void(const cv::Mat&)> callback) {
+void VideoCapture::setFrameCallback(std::function<void(const FrameRef&)> callback) {
     m_frameCallback = callback;
 }
 
+void VideoCapture::setRawFrameCallback(std::function<void(const cv::Mat&, uint32_t)> callback) {
+    m_rawFrameCallback = callback;
+}
+
+bool VideoCapture::isCompressedFormat() const {
+    return m_format.pixelformat == V4L2_PIX_FMT_MJPEG || m_format.pixelformat == V4L2_PIX_FMT_JPEG;
+}
+
 void VideoCapture::captureThreadFunc() {
+    if (m_useNativeStream) {
+        captureWithV4L2();
+    } else {
+        captureWithGStreamer();
+    }
+}
+
+void VideoCapture::captureWithV4L2() {
+    std::cout << "使用V4L2 mmap采集: " << m_currentResolution.toString()
+              << ", 缓冲区数量: " << m_stream.getBufferCount() << std::endl;
+
+    uint32_t pixelFormat = m_format.pixelformat;
+    int bytesPerLine = m_format.bytesperline;
+
+    // 采集循环
+    int timeouts = 0;
+    while (m_isCapturing) {
+        // 阻塞等待内核通知，帧一到达立即出队
+        V4L2Buffer buffer;
+        if (!m_stream.dequeue(buffer, kDequeueTimeoutMs)) {
+            if (!m_isCapturing || m_stream.wasInterrupted()) {
+                break;
+            }
+            if (m_stream.wasTimedOut()) {
+                // 超时不结束采集，连续超时达到上限才认为设备已失效
+                timeouts++;
+                if (timeouts * kDequeueTimeoutMs < kMaxStallMs) {
+                    std::cerr << "等待视频帧超时（连续第" << timeouts << "次），继续等待" << std::endl;
+                    continue;
+                }
+                std::cerr << "连续" << kMaxStallMs / 1000 << "秒没有收到视频帧，停止采集" << std::endl;
+                break;
+            }
+            std::cerr << "无法读取帧" << std::endl;
+            break;
+        }
+        timeouts = 0;
+
+        updateStats(buffer.timestampUs, buffer.sequence, true);
+
+        // 直接引用mmap缓冲区构造Mat头，不拷贝数据
+        uint8_t* data = const_cast<uint8_t*>(buffer.data);
+        cv::Mat raw;
+        switch (pixelFormat) {
+            case V4L2_PIX_FMT_YUYV:
+            case V4L2_PIX_FMT_UYVY:
+                if (buffer.bytesUsed >= static_cast<size_t>(bytesPerLine) * m_format.height) {
+                    raw = cv::Mat(m_format.height, m_format.width, CV_8UC2, data, bytesPerLine);
+                }
+                break;
+            case V4L2_PIX_FMT_GREY:
+                if (buffer.bytesUsed >= static_cast<size_t>(bytesPerLine) * m_format.height) {
+                    raw = cv::Mat(m_format.height, m_format.width, CV_8UC1, data, bytesPerLine);
+                }
+                break;
+            case V4L2_PIX_FMT_NV12:
+                // Y平面后紧跟UV交错平面，共height*3/2行
+                if (buffer.bytesUsed >= static_cast<size_t>(bytesPerLine) * m_format.height * 3 / 2) {
+                    raw = cv::Mat(m_format.height * 3 / 2, m_format.width, CV_8UC1, data, bytesPerLine);
+                }
+                break;
+            case V4L2_PIX_FMT_MJPEG:
+            case V4L2_PIX_FMT_JPEG:
+                if (buffer.bytesUsed > 0) {
+                    raw = cv::Mat(1, static_cast<int>(buffer.bytesUsed), CV_8UC1, data);
+                }
+                break;
+            default:
+                break;
+        }
+
+        if (!raw.empty()) {
+            // 原始帧回调
+            if (m_rawFrameCallback) {
+                m_rawFrameCallback(raw, pixelFormat);
+            }
+
+            // 直通录制和原始录制需要设备输出的原样数据
+            if (m_nativeFrameBus.hasSubscribers()) {
+                publishNativeFrame(buffer);
+            }
+
+            // 直接转换到帧池缓冲区中，这是BGR帧唯一的一次写入
+            if (m_decodeEnabled) {
+                FrameRef frame = acquireFrame(buffer.timestampUs);
+                if (frame) {
+                    cv::Mat bgr = frame.mat();
+                    if (convertToBgr(raw, pixelFormat, bgr)) {
+                        processFrame(frame);
+                    }
+                }
+            }
+        }
+
+        // 缓冲区交还给驱动，之后raw不再有效
+        m_stream.requeue(buffer);
+    }
+
+    m_stream.stop();
+}
+
+bool VideoCapture::convertToBgr(const cv::Mat& raw, uint32_t pixelFormat, cv::Mat& bgr) {
+    try {
+        switch (pixelFormat) {
+            case V4L2_PIX_FMT_YUYV:
+                return ColorConvert::convert(raw, ColorConvert::SourceFormat::YUYV, bgr, ColorConvert::TargetFormat::BGR);
+            case V4L2_PIX_FMT_UYVY:
+                return ColorConvert::convert(raw, ColorConvert::SourceFormat::UYVY, bgr, ColorConvert::TargetFormat::BGR);
+            case V4L2_PIX_FMT_NV12:
+                return ColorConvert::convert(raw, ColorConvert::SourceFormat::NV12, bgr, ColorConvert::TargetFormat::BGR);
+            case V4L2_PIX_FMT_GREY:
+                cv::cvtColor(raw, bgr, cv::COLOR_GRAY2BGR);
+                return true;
+            case V4L2_PIX_FMT_MJPEG:
+            case V4L2_PIX_FMT_JPEG: {
+                // 尺寸一致时直接解码到目标缓冲区，否则OpenCV会重新分配
+                uint8_t* target = bgr.data;
+                cv::Mat decoded = cv::imdecode(raw, cv::IMREAD_COLOR, &bgr);
+                if (decoded.empty() || decoded.rows != bgr.rows || decoded.cols != bgr.cols) {
+                    return false;
+                }
+                if (decoded.data != target) {
+                    cv::Mat header(bgr.rows, bgr.cols, CV_8UC3, target, bgr.step);
+                    decoded.copyTo(header);
+                }
+                return true;
+            }
+            default:
+                return false;
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "帧格式转换失败: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+void VideoCapture::captureWithGStreamer() {
     // 构建GStreamer管道字符串
     std::string devicePath = m_device->getCurrentDeviceInfo().devicePath;
-    std::string gstPipeline = "v4l2src device=" + devicePath +
-                             " ! video/x-raw,width=" + std::to_string(m_currentResolution.width) +
-                             ",height=" + std::to_string(m_currentResolution.height) +
-                             ",framerate=" + std::to_string(m_currentFramerate) + "/1" +
-                             " ! videoconvert ! appsink";
+    // 与协商的像素格式保持一致，MJPEG需要先解码
+    bool isJpeg = m_format.pixelformat == V4L2_PIX_FMT_MJPEG || m_format.pixelformat == V4L2_PIX_FMT_JPEG;
+    std::string caps = std::string(isJpeg ? "image/jpeg" : "video/x-raw") +
+                       ",width=" + std::to_string(m_currentResolution.width) +
+                       ",height=" + std::to_string(m_currentResolution.height) +
+                       ",framerate=" + std::to_string(m_currentFramerate.numerator) + "/" +
+                       std::to_string(m_currentFramerate.denominator);
+    // 原始格式要指定format，否则v4l2src可以自行选择另一种像素格式，协商结果被忽略
+    std::string gstFormat = FormatNegotiator::getGStreamerFormat(m_format.pixelformat);
+    if (!isJpeg && !gstFormat.empty()) {
+        caps += ",format=" + gstFormat;
+    }
+    std::string gstPipeline = "v4l2src device=" + devicePath + " ! " + caps +
+                             (isJpeg ? " ! jpegdec" : "") +
+                             " ! videoconvert ! appsink max-buffers=2 drop=true sync=false";
 
     std::cout << "使用GStreamer管道: " << gstPipeline << std::endl;
 
     // 打开OpenCV视频捕获，使用GStreamer后端
+    // 拉取帧设置超时，read最多阻塞kGStreamerReadTimeoutMs，stop()清除采集标志后线程能及时退出
+#if CV_VERSION_MAJOR > 4 || (CV_VERSION_MAJOR == 4 && CV_VERSION_MINOR >= 8)
+    cv::VideoCapture cap(gstPipeline, cv::CAP_GSTREAMER, {cv::CAP_PROP_READ_TIMEOUT_MSEC, kGStreamerReadTimeoutMs});
+#else
+    // 旧版OpenCV的GStreamer后端不支持读取超时，read会一直阻塞到下一帧
     cv::VideoCapture cap(gstPipeline, cv::CAP_GSTREAMER);
+#endif
 
     if (!cap.isOpened()) {
         std::cerr << "无法打开摄像头，GStreamer管道: " << gstPipeline << std::endl;
@@ -97,32 +325,42 @@ void VideoCapture::captureThreadFunc() {
 
     // 不需要再设置分辨率和帧率，因为已经在GStreamer管道中指定了
 
-    // 计算帧间隔（毫秒）
-    int frameInterval = 1000 / m_currentFramerate;
-
-    // 采集循环
+    // 采集循环：read会阻塞到下一帧到达或超时，由设备控制节奏，不再额外休眠
+    uint32_t sequence = 0;
+    auto lastFrameTime = std::chrono::steady_clock::now();
     while (m_isCapturing) {
-        auto startTime = std::chrono::steady_clock::now();
-
-        // 捕获帧
+        // 捕获帧；读取超时时回到循环开头检查采集标志
         cv::Mat frame;
+        auto readStart = std::chrono::steady_clock::now();
         if (!cap.read(frame)) {
-            std::cerr << "无法读取帧" << std::endl;
-            break;
+            auto now = std::chrono::steady_clock::now();
+            auto readMs = std::chrono::duration_cast<std::chrono::milliseconds>(now - readStart).count();
+            auto stalledMs = std::chrono::duration_cast<std::chrono::milliseconds>(now - lastFrameTime).count();
+            if (readMs < kGStreamerReadTimeoutMs / 2) {
+                // 没等到超时就失败，是管道出错或流结束，继续读取只会空转
+                std::cerr << "无法读取帧" << std::endl;
+                break;
+            }
+            if (stalledMs >= kMaxStallMs) {
+                std::cerr << "连续" << kMaxStallMs / 1000 << "秒没有收到视频帧，停止采集" << std::endl;
+                break;
+            }
+            continue;
         }
 
-        if (!frame.empty()) {
-            // 处理帧
-            processFrame(frame);
-        }
-
-        // 计算剩余时间
-        auto endTime = std::chrono::steady_clock::now();
-        auto elapsedMs = std::chrono::duration_cast<std::chrono::milliseconds>(endTime - startTime).count();
+        auto now = std::chrono::steady_clock::now();
+        lastFrameTime = now;
+        int64_t timestampUs = std::chrono::duration_cast<std::chrono::microseconds>(now.time_since_epoch()).count();
+        updateStats(timestampUs, sequence++, false);
 
-        // 等待，保持帧率
-        if (elapsedMs < frameInterval) {
-            std::this_thread::sleep_for(std::chrono::milliseconds(frameInterval - elapsedMs));
+        if (!frame.empty()) {
+            // 拷贝到帧池缓冲区后处理
+            FrameRef pooled = acquireFrame(timestampUs);
+            if (pooled && frame.rows == m_currentResolution.height && frame.cols == m_currentResolution.width) {
+                cv::Mat target = pooled.mat();
+                frame.copyTo(target);
+                processFrame(pooled);
+            }
         }
     }
 
@@ -130,15 +368,104 @@ void VideoCapture::captureThreadFunc() {
     cap.release();
 }
 
-void VideoCapture::processFrame(const cv::Mat& frame) {
-    // 更新当前帧
+FrameRef VideoCapture::acquireFrame(int64_t timestampUs) {
+    FrameRef frame = m_framePool.acquire();
+    if (!frame) {
+        // 所有缓冲区仍被消费者持有，丢弃该帧（计入帧池耗尽次数）
+        return frame;
+    }
+
+    FrameInfo info;
+    info.width = m_currentResolution.width;
+    info.height = m_currentResolution.height;
+    info.type = CV_8UC3;
+    info.step = static_cast<size_t>(info.width) * 3;
+    info.bytesUsed = info.step * info.height;
+    info.timestampUs = timestampUs;
+    info.sequence = m_frameSequence++;
+    frame.setInfo(info);
+
+    return frame;
+}
+
+void VideoCapture::processFrame(const FrameRef& frame) {
+    // 更新当前帧（只增加引用计数）
     {
         std::lock_guard<std::mutex> lock(m_frameMutex);
-        m_currentFrame = frame.clone();
+        m_currentFrame = frame;
     }
 
     // 调用回调函数
     if (m_frameCallback) {
         m_frameCallback(frame);
     }
+
+    // 分发给总线上的订阅者
+    m_frameBus.publish(frame);
+}
+
+void VideoCapture::publishNativeFrame(const V4L2Buffer& buffer) {
+    // V4L2缓冲区要尽快交还驱动，不能被录制器长时间持有，因此拷贝一次
+    // 缓冲区按4096字节对齐并向上取整，原始录制可以直接用O_DIRECT写出而不再拷贝
+    if (m_nativePool.getSlotSize() == 0 && !m_nativePool.init(m_framePoolSize, m_nativeFrameSize, 4096)) {
+        std::cerr << "无法初始化设备格式帧池" << std::endl;
+        return;
+    }
+
+    FrameRef frame = m_nativePool.acquire();
+    if (!frame || buffer.bytesUsed > frame.capacity()) {
+        return;
+    }
+
+    memcpy(frame.data(), buffer.data, buffer.bytesUsed);
+
+    FrameInfo info;
+    info.width = m_currentResolution.width;
+    info.height = m_currentResolution.height;
+    info.type = CV_8UC1;
+    info.step = 0;
+    info.bytesUsed = buffer.bytesUsed;
+    info.pixelFormat = m_format.pixelformat;
+    info.timestampUs = buffer.timestampUs;
+    info.sequence = m_nativeSequence++;
+    frame.setInfo(info);
+
+    m_nativeFrameBus.publish(frame);
+}
+
+CaptureStats VideoCapture::getCaptureStats() {
+    std::lock_guard<std::mutex> lock(m_statsMutex);
+    return m_stats;
+}
+
+void VideoCapture::resetStats() {
+    std::lock_guard<std::mutex> lock(m_statsMutex);
+    m_stats = CaptureStats();
+    m_intervalM2 = 0.0;
+    m_lastTimestampUs = 0;
+    m_lastSequence = 0;
+}
+
+void VideoCapture::updateStats(int64_t timestampUs, uint32_t sequence, bool hasSequence) {
+    std::lock_guard<std::mutex> lock(m_statsMutex);
+
+    if (m_stats.frameCount > 0) {
+        // 驱动序号不连续说明内核侧丢了帧
+        if (hasSequence && sequence > m_lastSequence + 1) {
+            m_stats.droppedFrames += sequence - m_lastSequence - 1;
+        }
+
+        // Welford在线算法计算帧间隔均值和标准差
+        double intervalMs = (timestampUs - m_lastTimestampUs) / 1000.0;
+        uint64_t n = m_stats.frameCount;
+        double delta = intervalMs - m_stats.meanIntervalMs;
+        m_stats.meanIntervalMs += delta / n;
+        m_intervalM2 += delta * (intervalMs - m_stats.meanIntervalMs);
+        m_stats.jitterMs = n > 1 ? std::sqrt(m_intervalM2 / (n - 1)) : 0.0;
+        m_stats.maxIntervalMs = std::max(m_stats.maxIntervalMs, intervalMs);
+    }
+
+    m_lastTimestampUs = timestampUs;
+    m_lastSequence = sequence;
+    m_stats.frameCount++;
 }
@@ -2,10 +2,20 @@
 #include "utils.h"
 #include <iostream>
 #include <filesystem>
+#include <algorithm>
 
 namespace fs = std::filesystem;
 
-VideoRecorder::VideoRecorder() : m_isRecording(false) {
+VideoRecorder::VideoRecorder()
+    : m_resolution(0, 0),
+      m_framerate(0),
+      m_isRecording(false),
+      m_queueDepth(8),
+      m_queuePolicy(QueuePolicy::DropOldest),
+      m_encoded(0),
+      m_lastEncodeUs(0),
+      m_maxEncodeUs(0),
+      m_totalEncodeUs(0) {
 }
 
 VideoRecorder::~VideoRecorder() {
@@ -29,25 +39,33 @@ bool VideoRecorder::startRecording(const Resolution& resolution, int framerate)
         return true;  // 已经在录制中
     }
     
-    // 生成文件名
-    m_currentFilePath = generateFileName(resolution, framerate);
-    
-    // 创建视频写入器
+    m_resolution = resolution;
+    m_framerate = framerate;
+
+    // 生成文件名并创建视频写入器（编码线程启动前，无需加锁）
+    std::string filePath = generateFileName(resolution, framerate);
+    m_videoWriter = openWriter(filePath);
+    if (!m_videoWriter) {
+        return false;
+    }
     {
-        std::lock_guard<std::mutex> lock(m_writerMutex);
-        
-        // 使用H.264编码
-        int fourcc = cv::VideoWriter::fourcc('H', '2', '6', '4');
-        
-        // 创建视频写入器
-        m_videoWriter.open(m_currentFilePath, fourcc, framerate, 
-                          cv::Size(resolution.width, resolution.height));
-        
-        if (!m_videoWriter.isOpened()) {
-            std::cerr << "无法创建视频写入器" << std::endl;
-            return false;
-        }
+        std::lock_guard<std::mutex> lock(m_pathMutex);
+        m_currentFilePath = filePath;
     }
+
+    // 每次录制使用新的队列，统计从零开始
+    auto queue = std::make_shared<BoundedQueue<EncoderItem>>(m_queueDepth, m_queuePolicy);
+    {
+        std::lock_guard<std::mutex> lock(m_queueMutex);
+        m_queue = queue;
+    }
+    m_encoded = 0;
+    m_lastEncodeUs = 0;
+    m_maxEncodeUs = 0;
+    m_totalEncodeUs = 0;
+
+    // 启动编码线程
+    m_encoderThread = std::thread(&VideoRecorder::encoderThreadFunc, this, queue);
     
     // 记录开始时间
     m_startTime = std::chrono::steady_clock::now();
@@ -63,26 +81,58 @@ void VideoRecorder::stopRecording() {
         return;  // 没有在录制
     }
     
-    // 清除录制标志
+    // 清除录制标志，不再接受新帧
     m_isRecording = false;
+
+    // 关闭队列，编码线程写完剩余的帧后退出
+    std::shared_ptr<BoundedQueue<EncoderItem>> queue;
+    {
+        std::lock_guard<std::mutex> lock(m_queueMutex);
+        queue = m_queue;
+    }
+    if (queue) {
+        queue->close();
+    }
+    if (m_encoderThread.joinable()) {
+        m_encoderThread.join();
+    }
     
     // 关闭视频写入器
-    {
-        std::lock_guard<std::mutex> lock(m_writerMutex);
-        m_videoWriter.release();
+    m_videoWriter.reset();
+
+    RecorderStats stats = getStats();
+    std::cout << "录制结束: 编码 " << stats.encoded << " 帧, 丢弃 " << stats.dropped
+              << " 帧, 峰值队列 " << stats.maxQueueDepth << std::endl;
+}
+
+void VideoRecorder::processFrame(const FrameRef& frame) {
+    if (!m_isRecording || frame.empty()) {
+        return;  // 没有在录制
     }
+
+    EncoderItem item;
+    item.frame = frame;
+    enqueue(std::move(item));
 }
 
 void VideoRecorder::processFrame(const cv::Mat& frame) {
-    if (!m_isRecording) {
+    if (!m_isRecording || frame.empty()) {
         return;  // 没有在录制
     }
-    
-    // 写入帧
-    std::lock_guard<std::mutex> lock(m_writerMutex);
-    if (m_videoWriter.isOpened()) {
-        m_videoWriter.write(frame);
-    }
+
+    EncoderItem item;
+    item.mat = frame.clone();
+    enqueue(std::move(item));
+}
+
+void VideoRecorder::setQueueDepth(size_t depth, QueuePolicy policy) {
+    m_queueDepth = depth > 0 ? depth : 1;
+    m_queuePolicy = policy;
+}
+
+std::string VideoRecorder::getCurrentFilePath() const {
+    std::lock_guard<std::mutex> lock(m_pathMutex);
+    return m_currentFilePath;
 }
 
 double VideoRecorder::getRecordingDuration() const {
@@ -94,15 +144,134 @@ double VideoRecorder::getRecordingDuration() const {
     return std::chrono::duration<double>(now - m_startTime).count();
 }
 
+RecorderStats VideoRecorder::getStats() const {
+    RecorderStats stats;
+
+    std::shared_ptr<BoundedQueue<EncoderItem>> queue;
+    {
+        std::lock_guard<std::mutex> lock(m_queueMutex);
+        queue = m_queue;
+    }
+    if (queue) {
+        QueueStats queueStats = queue->getStats();
+        stats.queued = queueStats.pushed;
+        stats.dropped = queueStats.dropped;
+        stats.queueDepth = queueStats.depth;
+        stats.maxQueueDepth = queueStats.maxDepth;
+    }
+
+    stats.encoded = m_encoded;
+    stats.lastEncodeMs = m_lastEncodeUs / 1000.0;
+    stats.maxEncodeMs = m_maxEncodeUs / 1000.0;
+    stats.totalEncodeMs = m_totalEncodeUs / 1000.0;
+    return stats;
+}
+
+void VideoRecorder::enqueue(EncoderItem item) {
+    std::shared_ptr<BoundedQueue<EncoderItem>> queue;
+    {
+        std::lock_guard<std::mutex> lock(m_queueMutex);
+        queue = m_queue;
+    }
+    if (queue) {
+        queue->push(std::move(item));
+    }
+}
+
+void VideoRecorder::encoderThreadFunc(std::shared_ptr<BoundedQueue<EncoderItem>> queue) {
+    // 分段按写入的帧数计时长（与文件中的时长一致），文件大小每秒检查一次
+    int64_t segmentFrames = m_segment.segmentSeconds > 0 ?
+                            static_cast<int64_t>(m_segment.segmentSeconds) * std::max(m_framerate, 1) : 0;
+    int64_t sizeCheckInterval = std::max(m_framerate, 1);
+    int64_t framesInSegment = 0;
+
+    EncoderItem item;
+    while (queue->pop(item)) {
+        cv::Mat frame = item.mat.empty() ? item.frame.mat() : item.mat;
+
+        // 在帧边界切换分段，新分段从这一帧开始，不丢帧
+        // 新分段打不开时继续写旧文件，每秒重试一次
+        if (framesInSegment > 0) {
+            bool roll = segmentFrames > 0 && framesInSegment >= segmentFrames &&
+                        (framesInSegment - segmentFrames) % sizeCheckInterval == 0;
+            if (!roll && m_segment.segmentMaxBytes > 0 && framesInSegment % sizeCheckInterval == 0) {
+                std::error_code ec;
+                uintmax_t size = fs::file_size(getCurrentFilePath(), ec);
+                roll = !ec && size >= m_segment.segmentMaxBytes;
+            }
+            if (roll && rollSegment()) {
+                framesInSegment = 0;
+            }
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        m_videoWriter->write(frame);
+        int64_t encodeUs = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start).count();
+
+        m_lastEncodeUs = encodeUs;
+        m_totalEncodeUs += encodeUs;
+        if (encodeUs > m_maxEncodeUs) {
+            m_maxEncodeUs = encodeUs;
+        }
+        m_encoded++;
+        framesInSegment++;
+
+        // 尽早归还帧池缓冲区
+        item.frame.reset();
+        item.mat.release();
+    }
+}
+
+std::unique_ptr<cv::VideoWriter> VideoRecorder::openWriter(const std::string& filePath) {
+    // 使用H.264编码
+    int fourcc = cv::VideoWriter::fourcc('H', '2', '6', '4');
+
+    auto writer = std::make_unique<cv::VideoWriter>();
+    writer->open(filePath, fourcc, m_framerate, cv::Size(m_resolution.width, m_resolution.height));
+
+    if (!writer->isOpened()) {
+        std::cerr << "无法创建视频写入器: " << filePath << std::endl;
+        return nullptr;
+    }
+
+    return writer;
+}
+
+bool VideoRecorder::rollSegment() {
+    // 先打开新分段再关闭旧分段，失败时旧分段保持打开
+    std::string filePath = generateFileName(m_resolution, m_framerate);
+    std::unique_ptr<cv::VideoWriter> writer = openWriter(filePath);
+    if (!writer) {
+        return false;
+    }
+
+    m_videoWriter->release();
+    m_videoWriter = std::move(writer);
+
+    {
+        std::lock_guard<std::mutex> lock(m_pathMutex);
+        m_currentFilePath = filePath;
+    }
+    std::cout << "切换到分段: " << filePath << std::endl;
+    return true;
+}
+
 std::string VideoRecorder::generateFileName(const Resolution& resolution, int framerate) {
     // 获取当前日期时间
     std::string dateTime = Utils::getCurrentDateTimeString();
     
     // 生成文件名：日期时间_分辨率_帧率.mp4
-    std::string fileName = dateTime + "_" + 
+    std::string baseName = dateTime + "_" + 
                           std::to_string(resolution.width) + "x" + std::to_string(resolution.height) + 
-                          "_" + std::to_string(framerate) + "fps.mp4";
+                          "_" + std::to_string(framerate) + "fps";
+
+    // 同一秒内切换分段时加序号
+    fs::path filePath = fs::path(m_outputDir) / (baseName + ".mp4");
+    for (int index = 1; fs::exists(filePath); index++) {
+        filePath = fs::path(m_outputDir) / (baseName + "." + std::to_string(index) + ".mp4");
+    }
     
     // 完整路径
-    return fs::path(m_outputDir) / fileName;
+    return filePath;
 }